@@ -24,7 +24,9 @@
 
 
 
-// Command list (alphabetical order, starting with a value of 0)
+// Command list (alphabetical order, starting with a value of 0).  The values are shared
+// with a web GUI that may have been built from older sources so commands added later are
+// appended (in the order they were added) rather than inserted.
 typedef enum {
 	CMD_BACKLIGHT = 0,
     CMD_INFO,
@@ -34,11 +36,17 @@ typedef enum {
     CMD_SYS_INFO,
     CMD_TIME,
 	CMD_TIMEZONE,
-	CMD_WIFI_INFO
+	CMD_WIFI_INFO,
+	
+	// Added commands
+	CMD_TASK_INFO,
+	CMD_POWER_HIST,
+	CMD_ALARM,
+	CMD_ALARM_NOTIFY
 } cmd_id_t;
 
 // Total Count should always use the last entry
-#define CMD_TOTAL_COUNT   ((uint32_t) CMD_WIFI_INFO + 1)
+#define CMD_TOTAL_COUNT   ((uint32_t) CMD_ALARM_NOTIFY + 1)
 
 
 #endif /* CMD_LIST_H */
@@ -23,6 +23,7 @@
 #include "freertos/task.h"
 #include "gui_screen_main.h"
 #include "ps_utilities.h"
+#include "time_utilities.h"
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -79,7 +80,8 @@ static lv_obj_t* canvas_c2;
 static lv_obj_t* lbl_prim_msg;
 static lv_obj_t* lbl_sec_msg;
 
-static lv_task_t* task_timer;
+// Set while the screen is displayed (and should follow the display tick)
+static bool screen_active = false;
 
 
 // Colon toggle flag
@@ -105,7 +107,6 @@ static char date_string[32];
 //
 // Forward Declarations
 //
-static void cb_timer(lv_task_t* task);
 static void update_time();
 
 
@@ -197,40 +198,21 @@ void gui_screen_main_set_active(bool en)
 	
 		// Update the time display
 		update_time();
-		
-		// Start our timer task
-		task_timer = lv_task_create(cb_timer, 500, LV_TASK_PRIO_LOW, NULL);
-	} else {
-		if (task_timer != NULL) {
-			lv_task_del(task_timer);
-			task_timer = NULL;
-		}
 	}
+	
+	screen_active = en;
 }
 
 
-void gui_screen_main_set_prim_msg(const char* msg, int to)
-{
-	lv_label_set_static_text(lbl_prim_msg, msg);
-	message_prim_timer = to * 2;
-}
-
-
-void gui_screen_main_set_sec_msg(const char* msg, int to)
-{
-	lv_label_set_static_text(lbl_sec_msg, msg);
-	message_sec_timer = to * 2;
-}
-
-
-
-//
-// Internal functions
-//
-static void cb_timer(lv_task_t* task)
+/**
+ * Called by gui_task on each display tick (aligned to the system clock's half-second
+ * boundaries).  The colon is lit for the first half of each second.
+ */
+void gui_screen_main_tick(bool second_start)
 {
-	// Toggle the colon
-	colon_on = !colon_on;
+	if (!screen_active) return;
+	
+	colon_on = second_start;
 	if (colon_on) {
 		lv_img_set_src(canvas_c1, &c1_0_on);
 		lv_img_set_src(canvas_c2, &c1_1_on);
@@ -257,31 +239,51 @@ static void cb_timer(lv_task_t* task)
 }
 
 
+void gui_screen_main_set_prim_msg(const char* msg, int to)
+{
+	lv_label_set_static_text(lbl_prim_msg, msg);
+	message_prim_timer = to * 2;
+}
+
+
+void gui_screen_main_set_sec_msg(const char* msg, int to)
+{
+	lv_label_set_static_text(lbl_sec_msg, msg);
+	message_sec_timer = to * 2;
+}
+
+
+
+//
+// Internal functions
+//
 static void update_time()
 {
 	int cur_h10, cur_h1, cur_m10, cur_m1;
-	time_t systime;
-	struct tm *now;
-	gui_config_t gui_config;
+	tmElements_t now;
+	static gui_config_t gui_config;
+	static time_cache_t time_cache;
+	static uint32_t gui_generation = PS_GENERATION_NONE;
 	
-	ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config);
+	// Only copy the config when it has changed
+	(void) ps_get_config_if_changed(PS_CONFIG_TYPE_GUI, &gui_config, &gui_generation);
 	
-	systime = time(NULL);
-	now = localtime(&systime);
+	// Incremental conversion (we're called every 500 mSec but the minute rarely changes)
+	time_get_cached(&time_cache, &now);
 	
 	if (!gui_config.hour_mode_24) {
 		// Convert 24-hour time to 12-hour time
-		if (now->tm_hour > 12) now->tm_hour -= 12;
+		if (now.tm_hour > 12) now.tm_hour -= 12;
 		
 		// Midnight is "12:XX" instead of "00:XX"
-		if (now->tm_hour == 0) now->tm_hour = 12;
+		if (now.tm_hour == 0) now.tm_hour = 12;
 	}
 	
 	// Check for time digit updates
-	cur_h10 = now->tm_hour / 10;
-	cur_h1 = now->tm_hour % 10;
-	cur_m10 = now->tm_min / 10;
-	cur_m1 = now->tm_min % 10;
+	cur_h10 = now.tm_hour / 10;
+	cur_h1 = now.tm_hour % 10;
+	cur_m10 = now.tm_min / 10;
+	cur_m1 = now.tm_min % 10;
 	
 	if (cur_h10 != prev_h10) {
 		if (cur_h10 == 0) {
@@ -306,11 +308,11 @@ static void update_time()
 	}
 	
 	// Check for a date update
-	if (prev_day != now->tm_mday) {
-		sprintf(date_string, "%s %s %d, %d", days[now->tm_wday], months[now->tm_mon], now->tm_mday, now->tm_year + 1900);
+	if (prev_day != now.tm_mday) {
+		sprintf(date_string, "%s %s %d, %d", days[now.tm_wday], months[now.tm_mon], now.tm_mday, now.tm_year + 1900);
 		if (message_prim_timer == 0) {
 			lv_label_set_static_text(lbl_prim_msg, date_string);
 		}
-		prev_day = now->tm_mday;
+		prev_day = now.tm_mday;
 	}
 }
@@ -75,6 +75,7 @@
 //
 lv_obj_t* gui_screen_main_create();
 void gui_screen_main_set_active(bool en);
+void gui_screen_main_tick(bool second_start);
 void gui_screen_main_set_prim_msg(const char* msg, int to);
 void gui_screen_main_set_sec_msg(const char* msg, int to);
 
@@ -0,0 +1,638 @@
+/*
+ * gCore EFM8 emulator
+ *
+ * Host (IDF linux target) stand-in for the gCore EFM8 co-processor used by the
+ * emulated i2c bus.  Transactions follow the EFM8 protocol: a write starts with a
+ * 16-bit big-endian address followed by data, a read returns data from the current
+ * address.  The address auto-increments across both NVRAM and the register file.
+ *
+ * Measurements, charge state and the power button are driven by a scenario - a list of
+ * timed steps that are linearly interpolated.  Each transaction sleeps for the modelled
+ * bus time so callers see realistic latency.
+ *
+ * Copyright 2020-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_log.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+//
+// gCore emulator constants
+//
+#define REG_END         (GCORE_REG_BASE + GCORE_REG_LEN)
+
+// USB voltage above which the EFM8 considers power present
+#define USB_PRESENT_MV  4000
+
+
+
+//
+// gCore emulator variables
+//
+static const char* TAG = "gcore_emu";
+
+static pthread_mutex_t emu_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static gcore_emu_config_t config;
+static gcore_emu_stats_t stats;
+
+// Memory
+static uint8_t nvram[GCORE_NVRAM_FULL_LEN];
+static uint8_t flash[GCORE_NVRAM_BCKD_LEN];
+static uint8_t regs[GCORE_REG_LEN];
+static uint16_t addr_ptr;
+
+// RTC - seconds count is time_base_secs at time_base_usec
+static uint32_t time_base_secs;
+static int64_t time_base_usec;
+
+// Power state
+static bool powered_off;
+static uint8_t pwr_on_reason;
+static bool pb_latched;
+static bool prev_usb_present;
+
+// NVRAM flash operation end times
+static int64_t erase_end_usec;
+static int64_t write_end_usec;
+
+// Scenario
+static gcore_emu_step_t scn_steps[GCORE_EMU_MAX_STEPS];
+static int scn_num_steps;
+static bool scn_loop;
+static int64_t scn_start_usec;
+
+// Power button
+static bool btn_prev_down;
+static int64_t btn_down_usec;
+static int64_t btn_manual_end_usec;
+static bool btn_press_reported;
+
+// Built-in scenarios
+static const gcore_emu_step_t scn_idle[] = {
+//   msec        vb    il    vu    iu  charge            btn
+	{0,        4000,  250,    0,    0, GCORE_CHG_IDLE,   false}
+};
+
+static const gcore_emu_step_t scn_batt_drain[] = {
+	{0,        4150,  300,    0,    0, GCORE_CHG_IDLE,   false},
+	{600000,   3750,  300,    0,    0, GCORE_CHG_IDLE,   false},
+	{1200000,  3450,  310,    0,    0, GCORE_CHG_IDLE,   false},
+	{1500000,  3200,  320,    0,    0, GCORE_CHG_IDLE,   false},
+	{1560000,  2950,  330,    0,    0, GCORE_CHG_IDLE,   false}
+};
+
+static const gcore_emu_step_t scn_usb_charge[] = {
+	{0,        3500,  250,    0,    0, GCORE_CHG_IDLE,   false},
+	{5000,     3600,  250, 5000,  800, GCORE_CHG_ACTIVE, false},
+	{1800000,  4150,  250, 5000,  550, GCORE_CHG_ACTIVE, false},
+	{2400000,  4200,  250, 5000,  250, GCORE_CHG_DONE,   false},
+	{2700000,  4200,  250,    0,    0, GCORE_CHG_IDLE,   false}
+};
+
+static const gcore_emu_step_t scn_button[] = {
+	{0,        4000,  250,    0,    0, GCORE_CHG_IDLE,   false},
+	{2000,     4000,  250,    0,    0, GCORE_CHG_IDLE,   true},
+	{2300,     4000,  250,    0,    0, GCORE_CHG_IDLE,   false},
+	{5000,     4000,  250,    0,    0, GCORE_CHG_IDLE,   true},
+	{10000,    4000,  250,    0,    0, GCORE_CHG_IDLE,   false}
+};
+
+static const gcore_emu_step_t* scn_builtin[GCORE_EMU_NUM_SCN] = {
+	scn_idle,
+	scn_batt_drain,
+	scn_usb_charge,
+	scn_button
+};
+
+static const int scn_builtin_len[GCORE_EMU_NUM_SCN] = {
+	sizeof(scn_idle) / sizeof(gcore_emu_step_t),
+	sizeof(scn_batt_drain) / sizeof(gcore_emu_step_t),
+	sizeof(scn_usb_charge) / sizeof(gcore_emu_step_t),
+	sizeof(scn_button) / sizeof(gcore_emu_step_t)
+};
+
+
+
+//
+// Forward declarations for internal functions
+//
+static int64_t _gcore_emu_now_usec();
+static void _gcore_emu_model_latency(size_t len);
+static bool _gcore_emu_is_busy(int64_t now);
+static void _gcore_emu_update(int64_t now);
+static void _gcore_emu_eval_scenario(int64_t now, gcore_emu_step_t* cur);
+static uint32_t _gcore_emu_get_time_secs(int64_t now);
+static uint32_t _gcore_emu_get_reg32(uint8_t offset);
+static void _gcore_emu_set_reg16(uint8_t offset, uint16_t val);
+static void _gcore_emu_write_reg(uint8_t offset, uint8_t val, int64_t now);
+static void _gcore_emu_power_on(uint8_t reason);
+static void _gcore_emu_load_flash();
+static void _gcore_emu_save_flash();
+
+
+
+//
+// gCore emulator API
+//
+void gcore_emu_init(const gcore_emu_config_t* cfg)
+{
+	int64_t now;
+
+	pthread_mutex_lock(&emu_mutex);
+
+	if (cfg != NULL) {
+		config = *cfg;
+	} else {
+		config.txn_usec = GCORE_EMU_DEF_TXN_USEC;
+		config.byte_usec = GCORE_EMU_DEF_BYTE_USEC;
+		config.erase_msec = GCORE_EMU_DEF_ERASE_MSEC;
+		config.write_msec = GCORE_EMU_DEF_WRITE_MSEC;
+		config.flash_file = NULL;
+	}
+	memset(&stats, 0, sizeof(stats));
+
+	// Flash powers up erased unless a backing file exists
+	memset(flash, 0xFF, sizeof(flash));
+	_gcore_emu_load_flash();
+	memset(nvram, 0, sizeof(nvram));
+	memcpy(nvram, flash, GCORE_NVRAM_BCKD_LEN);
+
+	memset(regs, 0, sizeof(regs));
+	regs[GCORE_REG_ID] = GCORE_FW_ID;
+	regs[GCORE_REG_VER] = 0x01;
+	regs[GCORE_REG_BL] = 0x80;
+	regs[GCORE_REG_PWR_TM] = 2000 / 10;
+	addr_ptr = 0;
+
+	now = _gcore_emu_now_usec();
+	time_base_secs = 0;
+	time_base_usec = now;
+	erase_end_usec = 0;
+	write_end_usec = 0;
+
+	powered_off = false;
+	pwr_on_reason = GCORE_PWR_ON_BTN_MASK;
+	pb_latched = false;
+	prev_usb_present = false;
+
+	btn_prev_down = false;
+	btn_manual_end_usec = 0;
+	btn_press_reported = false;
+
+	memcpy(scn_steps, scn_idle, sizeof(scn_idle));
+	scn_num_steps = scn_builtin_len[GCORE_EMU_SCN_IDLE];
+	scn_loop = false;
+	scn_start_usec = now;
+
+	pthread_mutex_unlock(&emu_mutex);
+
+	ESP_LOGI(TAG, "Emulating gCore (%u + %u/byte uSec, erase %u mSec)", config.txn_usec,
+		config.byte_usec, config.erase_msec);
+}
+
+
+void gcore_emu_set_scenario(int scenario, bool loop)
+{
+	if ((scenario < 0) || (scenario >= GCORE_EMU_NUM_SCN)) {
+		ESP_LOGE(TAG, "Unknown scenario %d", scenario);
+		return;
+	}
+
+	gcore_emu_load_scenario(scn_builtin[scenario], scn_builtin_len[scenario], loop);
+}
+
+
+/**
+ * Load a custom scenario.  Steps must be in increasing time order starting at 0.
+ */
+void gcore_emu_load_scenario(const gcore_emu_step_t* steps, int num_steps, bool loop)
+{
+	if ((num_steps < 1) || (num_steps > GCORE_EMU_MAX_STEPS)) {
+		ESP_LOGE(TAG, "Illegal scenario length %d", num_steps);
+		return;
+	}
+
+	pthread_mutex_lock(&emu_mutex);
+	memcpy(scn_steps, steps, num_steps * sizeof(gcore_emu_step_t));
+	scn_num_steps = num_steps;
+	scn_loop = loop;
+	scn_start_usec = _gcore_emu_now_usec();
+	pthread_mutex_unlock(&emu_mutex);
+}
+
+
+/**
+ * Hold the power button down for msec (in addition to any scenario button activity)
+ */
+void gcore_emu_press_button(uint32_t msec)
+{
+	pthread_mutex_lock(&emu_mutex);
+	btn_manual_end_usec = _gcore_emu_now_usec() + (int64_t) msec * 1000;
+	pthread_mutex_unlock(&emu_mutex);
+}
+
+
+bool gcore_emu_powered_off()
+{
+	bool off;
+
+	pthread_mutex_lock(&emu_mutex);
+	_gcore_emu_update(_gcore_emu_now_usec());
+	off = powered_off;
+	pthread_mutex_unlock(&emu_mutex);
+
+	return off;
+}
+
+
+void gcore_emu_get_stats(gcore_emu_stats_t* s)
+{
+	pthread_mutex_lock(&emu_mutex);
+	*s = stats;
+	pthread_mutex_unlock(&emu_mutex);
+}
+
+
+/**
+ * Write transaction: 16-bit big-endian address followed by zero or more data bytes
+ */
+esp_err_t gcore_emu_write(const uint8_t* data, size_t len)
+{
+	int64_t now;
+	uint8_t offset;
+	uint32_t time_secs;
+	bool time_written = false;
+
+	_gcore_emu_model_latency(len);
+
+	pthread_mutex_lock(&emu_mutex);
+
+	now = _gcore_emu_now_usec();
+	_gcore_emu_update(now);
+	stats.transactions++;
+
+	if (_gcore_emu_is_busy(now) || (len < 2)) {
+		stats.naks++;
+		pthread_mutex_unlock(&emu_mutex);
+		return ESP_FAIL;
+	}
+	stats.bytes += len;
+
+	addr_ptr = (data[0] << 8) | data[1];
+	data += 2;
+	len -= 2;
+
+	// Latch the current time so a partial write of TIME only changes the written bytes
+	time_secs = _gcore_emu_get_time_secs(now);
+	regs[GCORE_REG_TIME] = time_secs >> 24;
+	regs[GCORE_REG_TIME+1] = time_secs >> 16;
+	regs[GCORE_REG_TIME+2] = time_secs >> 8;
+	regs[GCORE_REG_TIME+3] = time_secs;
+
+	while (len--) {
+		if (addr_ptr < GCORE_NVRAM_FULL_LEN) {
+			nvram[addr_ptr] = *data;
+		} else if ((addr_ptr >= GCORE_REG_BASE) && (addr_ptr < REG_END)) {
+			offset = addr_ptr - GCORE_REG_BASE;
+			if ((offset >= GCORE_REG_TIME) && (offset < GCORE_REG_ALARM)) {
+				regs[offset] = *data;
+				time_written = true;
+			} else {
+				_gcore_emu_write_reg(offset, *data, now);
+			}
+		}
+		data++;
+		addr_ptr++;
+	}
+
+	if (time_written) {
+		time_base_secs = _gcore_emu_get_reg32(GCORE_REG_TIME);
+		time_base_usec = now;
+	}
+
+	pthread_mutex_unlock(&emu_mutex);
+
+	return ESP_OK;
+}
+
+
+/**
+ * Read transaction: data from the current address
+ */
+esp_err_t gcore_emu_read(uint8_t* data, size_t len)
+{
+	int64_t now;
+	uint8_t offset;
+	bool status_read = false;
+
+	_gcore_emu_model_latency(len);
+
+	pthread_mutex_lock(&emu_mutex);
+
+	now = _gcore_emu_now_usec();
+	_gcore_emu_update(now);
+	stats.transactions++;
+
+	if (_gcore_emu_is_busy(now)) {
+		stats.naks++;
+		pthread_mutex_unlock(&emu_mutex);
+		return ESP_FAIL;
+	}
+	stats.bytes += len;
+
+	while (len--) {
+		if (addr_ptr < GCORE_NVRAM_FULL_LEN) {
+			*data = nvram[addr_ptr];
+		} else if ((addr_ptr >= GCORE_REG_BASE) && (addr_ptr < REG_END)) {
+			offset = addr_ptr - GCORE_REG_BASE;
+			*data = regs[offset];
+			if (offset == GCORE_REG_STATUS) status_read = true;
+		} else {
+			*data = 0;
+		}
+		data++;
+		addr_ptr++;
+	}
+
+	// Reading STATUS clears the button press latch
+	if (status_read) {
+		pb_latched = false;
+	}
+
+	pthread_mutex_unlock(&emu_mutex);
+
+	return ESP_OK;
+}
+
+
+
+//
+// Internal functions
+//
+static int64_t _gcore_emu_now_usec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Sleep for the modelled time of a transaction with len data bytes plus the
+ * slave address byte (called without emu_mutex held)
+ */
+static void _gcore_emu_model_latency(size_t len)
+{
+	uint32_t usec;
+
+	usec = config.txn_usec + config.byte_usec * (len + 1);
+	if (usec != 0) {
+		usleep(usec);
+	}
+
+	pthread_mutex_lock(&emu_mutex);
+	stats.busy_usec += usec;
+	pthread_mutex_unlock(&emu_mutex);
+}
+
+
+/**
+ * The EFM8 doesn't respond while powered off or while erasing flash
+ */
+static bool _gcore_emu_is_busy(int64_t now)
+{
+	return powered_off || (now < erase_end_usec);
+}
+
+
+/**
+ * Bring the register file up to date with the scenario, button and RTC
+ */
+static void _gcore_emu_update(int64_t now)
+{
+	bool btn_down;
+	bool usb_present;
+	uint8_t status;
+	uint32_t time_secs;
+	gcore_emu_step_t cur;
+
+	_gcore_emu_eval_scenario(now, &cur);
+
+	// Power button - a press is latched once it has been held for PWR_TM
+	btn_down = cur.btn_down || (now < btn_manual_end_usec);
+	if (btn_down && !btn_prev_down) {
+		btn_down_usec = now;
+		btn_press_reported = false;
+	}
+	if (btn_down && !btn_press_reported &&
+	    ((now - btn_down_usec) >= ((int64_t) regs[GCORE_REG_PWR_TM] * 10000))) {
+		btn_press_reported = true;
+		if (powered_off) {
+			_gcore_emu_power_on(GCORE_PWR_ON_BTN_MASK);
+		} else {
+			pb_latched = true;
+		}
+	}
+	btn_prev_down = btn_down;
+
+	// Wakeup sources while off
+	usb_present = cur.vu >= USB_PRESENT_MV;
+	time_secs = _gcore_emu_get_time_secs(now);
+	if (powered_off) {
+		if ((regs[GCORE_REG_WK_CTRL] & GCORE_WK_ALARM_MASK) &&
+		    (time_secs >= _gcore_emu_get_reg32(GCORE_REG_ALARM))) {
+			_gcore_emu_power_on(GCORE_PWR_ON_ALARM_MASK);
+		} else if ((regs[GCORE_REG_WK_CTRL] & GCORE_WK_CHRG_START_MASK) && usb_present && !prev_usb_present) {
+			_gcore_emu_power_on(GCORE_PWR_ON_CHG_MASK);
+		} else if ((regs[GCORE_REG_WK_CTRL] & GCORE_WK_CHRG_DONE_MASK) && (cur.charge == GCORE_CHG_DONE)) {
+			_gcore_emu_power_on(GCORE_PWR_ON_CHG_MASK);
+		}
+	}
+	prev_usb_present = usb_present;
+
+	// NVRAM flash write completes after the erase and write windows
+	if ((write_end_usec != 0) && (now >= write_end_usec)) {
+		write_end_usec = 0;
+		regs[GCORE_REG_NV_CTRL] = GCORE_NVRAM_IDLE_MASK;
+	}
+
+	// Status and measurement registers
+	status = pwr_on_reason & GCORE_ST_PWR_ON_RSN_MASK;
+	if (pb_latched) status |= GCORE_ST_PB_PRESS_MASK;
+	if (cur.vb < GCORE_EMU_CRIT_BATT_MV) status |= GCORE_ST_CRIT_BATT_MASK;
+	regs[GCORE_REG_STATUS] = status;
+
+	regs[GCORE_REG_GPIO] = (cur.charge & GCORE_GPIO_CHG_MASK) | (btn_down ? GCORE_GPIO_PWR_BTN_MASK : 0);
+	_gcore_emu_set_reg16(GCORE_REG_VU, cur.vu);
+	_gcore_emu_set_reg16(GCORE_REG_IU, cur.iu);
+	_gcore_emu_set_reg16(GCORE_REG_VB, cur.vb);
+	_gcore_emu_set_reg16(GCORE_REG_IL, cur.il);
+	_gcore_emu_set_reg16(GCORE_REG_TEMP, GCORE_EMU_TEMP);
+
+	regs[GCORE_REG_TIME] = time_secs >> 24;
+	regs[GCORE_REG_TIME+1] = time_secs >> 16;
+	regs[GCORE_REG_TIME+2] = time_secs >> 8;
+	regs[GCORE_REG_TIME+3] = time_secs;
+}
+
+
+/**
+ * Interpolate the scenario at the current time
+ */
+static void _gcore_emu_eval_scenario(int64_t now, gcore_emu_step_t* cur)
+{
+	int i;
+	uint32_t t;
+	uint32_t span;
+	uint32_t frac;
+	const gcore_emu_step_t* s0;
+	const gcore_emu_step_t* s1;
+
+	t = (uint32_t) ((now - scn_start_usec) / 1000);
+	if (scn_loop && (scn_steps[scn_num_steps-1].msec != 0)) {
+		t = t % scn_steps[scn_num_steps-1].msec;
+	}
+
+	for (i=0; i<scn_num_steps-1; i++) {
+		if (t < scn_steps[i+1].msec) break;
+	}
+	s0 = &scn_steps[i];
+	*cur = *s0;
+
+	if (i < scn_num_steps-1) {
+		s1 = &scn_steps[i+1];
+		span = s1->msec - s0->msec;
+		frac = t - s0->msec;
+		cur->vb = s0->vb + (int32_t) ((int64_t) (s1->vb - s0->vb) * frac / span);
+		cur->il = s0->il + (int32_t) ((int64_t) (s1->il - s0->il) * frac / span);
+		cur->vu = s0->vu + (int32_t) ((int64_t) (s1->vu - s0->vu) * frac / span);
+		cur->iu = s0->iu + (int32_t) ((int64_t) (s1->iu - s0->iu) * frac / span);
+	}
+}
+
+
+static uint32_t _gcore_emu_get_time_secs(int64_t now)
+{
+	return time_base_secs + (uint32_t) ((now - time_base_usec) / 1000000);
+}
+
+
+static uint32_t _gcore_emu_get_reg32(uint8_t offset)
+{
+	return (regs[offset] << 24) | (regs[offset+1] << 16) | (regs[offset+2] << 8) | regs[offset+3];
+}
+
+
+static void _gcore_emu_set_reg16(uint8_t offset, uint16_t val)
+{
+	regs[offset] = val >> 8;
+	regs[offset+1] = val & 0xFF;
+}
+
+
+/**
+ * Write a register other than TIME (read-only registers ignore writes)
+ */
+static void _gcore_emu_write_reg(uint8_t offset, uint8_t val, int64_t now)
+{
+	switch (offset) {
+		case GCORE_REG_BL:
+		case GCORE_REG_WK_CTRL:
+		case GCORE_REG_PWR_TM:
+			regs[offset] = val;
+			break;
+
+		case GCORE_REG_SHDOWN:
+			if (val == GCORE_SHUTDOWN_TRIG) {
+				ESP_LOGI(TAG, "Power off");
+				powered_off = true;
+				pb_latched = false;
+			}
+			break;
+
+		case GCORE_REG_NV_CTRL:
+			if (val == GCORE_NVRAM_WR_TRIG) {
+				memcpy(flash, nvram, GCORE_NVRAM_BCKD_LEN);
+				_gcore_emu_save_flash();
+				stats.flash_writes++;
+				erase_end_usec = now + (int64_t) config.erase_msec * 1000;
+				write_end_usec = erase_end_usec + (int64_t) config.write_msec * 1000;
+				regs[GCORE_REG_NV_CTRL] = GCORE_NVRAM_BUSY_MASK;
+			} else if (val == GCORE_NVRAM_RD_TRIG) {
+				memcpy(nvram, flash, GCORE_NVRAM_BCKD_LEN);
+			}
+			break;
+
+		default:
+			if ((offset >= GCORE_REG_ALARM) && (offset < GCORE_REG_LEN)) {
+				// ALARM and CORR
+				regs[offset] = val;
+			}
+	}
+}
+
+
+/**
+ * Power on - the EFM8 runs from the battery while the system is off so NVRAM is retained
+ */
+static void _gcore_emu_power_on(uint8_t reason)
+{
+	ESP_LOGI(TAG, "Power on (reason 0x%02x)", reason);
+	powered_off = false;
+	pwr_on_reason = reason;
+}
+
+
+static void _gcore_emu_load_flash()
+{
+	FILE* fp;
+
+	if (config.flash_file == NULL) return;
+
+	fp = fopen(config.flash_file, "rb");
+	if (fp != NULL) {
+		if (fread(flash, 1, GCORE_NVRAM_BCKD_LEN, fp) != GCORE_NVRAM_BCKD_LEN) {
+			ESP_LOGW(TAG, "Short flash file %s", config.flash_file);
+		}
+		fclose(fp);
+	}
+}
+
+
+static void _gcore_emu_save_flash()
+{
+	FILE* fp;
+
+	if (config.flash_file == NULL) return;
+
+	fp = fopen(config.flash_file, "wb");
+	if (fp == NULL) {
+		ESP_LOGE(TAG, "Could not write flash file %s", config.flash_file);
+		return;
+	}
+	(void) fwrite(flash, 1, GCORE_NVRAM_BCKD_LEN, fp);
+	fclose(fp);
+}
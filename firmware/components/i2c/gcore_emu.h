@@ -0,0 +1,110 @@
+/*
+ * gCore EFM8 emulator
+ *
+ * Host (IDF linux target) stand-in for the gCore EFM8 co-processor used by the
+ * emulated i2c bus.  Implements the register map in gcore.h, the 4 kB NVRAM with
+ * its flash-backed region (including the flash erase/write window where the EFM8
+ * NAKs), a per-transaction latency model and scripted battery/USB/button scenarios.
+ *
+ * Copyright 2020-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef GCORE_EMU_H
+#define GCORE_EMU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_system.h"
+
+
+//
+// gCore emulator constants
+//
+
+// Default latency model - approximates a 100 kHz bus (9 bit-times per byte)
+#define GCORE_EMU_DEF_TXN_USEC      50
+#define GCORE_EMU_DEF_BYTE_USEC     90
+
+// Default NVRAM flash erase window (EFM8 NAKs) followed by the write window (NV_CTRL busy)
+#define GCORE_EMU_DEF_ERASE_MSEC    36
+#define GCORE_EMU_DEF_WRITE_MSEC    128
+
+// Maximum scenario length
+#define GCORE_EMU_MAX_STEPS         32
+
+// Battery voltage below which the EFM8 sets the critical battery status bit
+#define GCORE_EMU_CRIT_BATT_MV      3000
+
+// Die temperature reported (C * 10)
+#define GCORE_EMU_TEMP              250
+
+// Built-in scenarios
+#define GCORE_EMU_SCN_IDLE          0
+#define GCORE_EMU_SCN_BATT_DRAIN    1
+#define GCORE_EMU_SCN_USB_CHARGE    2
+#define GCORE_EMU_SCN_BUTTON        3
+#define GCORE_EMU_NUM_SCN           4
+
+
+
+//
+// gCore emulator typedefs
+//
+typedef struct {
+	uint32_t txn_usec;           // Fixed time per transaction
+	uint32_t byte_usec;          // Additional time per byte (address and data)
+	uint32_t erase_msec;         // NVRAM flash erase NAK window
+	uint32_t write_msec;         // NVRAM flash write window (NV_CTRL reads busy)
+	const char* flash_file;      // File backing the flash region (NULL for RAM only)
+} gcore_emu_config_t;
+
+// Scenario step.  Measurements are linearly interpolated between steps.
+typedef struct {
+	uint32_t msec;               // Time since scenario start
+	uint16_t vb;                 // Battery mV
+	uint16_t il;                 // Load mA
+	uint16_t vu;                 // USB mV
+	uint16_t iu;                 // USB mA
+	uint8_t charge;              // GCORE_CHG_xxx
+	bool btn_down;               // Power button state from this step until the next
+} gcore_emu_step_t;
+
+typedef struct {
+	uint32_t transactions;
+	uint32_t naks;
+	uint32_t bytes;
+	uint32_t flash_writes;
+	uint64_t busy_usec;          // Total modelled bus time
+} gcore_emu_stats_t;
+
+
+
+//
+// gCore emulator API
+//
+void gcore_emu_init(const gcore_emu_config_t* cfg);
+void gcore_emu_set_scenario(int scenario, bool loop);
+void gcore_emu_load_scenario(const gcore_emu_step_t* steps, int num_steps, bool loop);
+void gcore_emu_press_button(uint32_t msec);
+bool gcore_emu_powered_off();
+void gcore_emu_get_stats(gcore_emu_stats_t* stats);
+
+// Called by the emulated i2c bus
+esp_err_t gcore_emu_write(const uint8_t* data, size_t len);
+esp_err_t gcore_emu_read(uint8_t* data, size_t len);
+
+
+#endif /* GCORE_EMU_H */
@@ -2,7 +2,9 @@
  * I2C Module
  *
  * Provides I2C Access routines for other modules/tasks.  Provides a locking mechanism
- * since the underlying ESP IDF routines are not thread safe.
+ * since the underlying ESP IDF routines are not thread safe.  Device handles are added
+ * to the bus on first use and cached (keyed by address and speed) so transfers don't
+ * pay the add/remove device overhead.
  *
  * Copyright 2020-2025 Dan Julio
  *
@@ -25,6 +27,21 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "i2c.h"
+#include "i2c_async.h"
+#include <stdbool.h>
+
+
+
+//
+// I2C typedefs
+//
+typedef struct {
+	bool valid;
+	uint8_t addr7;
+	uint32_t speed_hz;
+	i2c_master_dev_handle_t dev_handle;
+} i2c_dev_cache_entry_t;
+
 
 
 //
@@ -33,6 +50,20 @@
 static i2c_master_bus_handle_t bus_handle;
 static SemaphoreHandle_t i2c_mutex;
 
+// Device handle cache (accessed with i2c_mutex held)
+static i2c_dev_cache_entry_t dev_cache[I2C_MAX_DEVICES];
+static int dev_cache_evict_index = 0;
+
+// Statistics
+static uint32_t transaction_count = 0;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static esp_err_t _i2c_get_device(uint8_t addr7, uint32_t speed_hz, i2c_master_dev_handle_t* dev_handle);
+
 
 
 //
@@ -59,7 +90,13 @@ esp_err_t i2c_init(int scl_pin, int sda_pin)
     i2c_mst_config.trans_queue_depth = 0;
     i2c_mst_config.flags.enable_internal_pullup = true;
     
-	return i2c_new_master_bus(&i2c_mst_config, &bus_handle);
+	esp_err_t ret = i2c_new_master_bus(&i2c_mst_config, &bus_handle);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	
+	// Start the asynchronous request handler
+	return i2c_async_init();
 }
 
 
@@ -81,6 +118,15 @@ void i2c_unlock()
 }
 
 
+/**
+ * Return the number of bus transactions since boot (wraps)
+ */
+uint32_t i2c_get_transaction_count()
+{
+	return transaction_count;
+}
+
+
 /**
  * Read esp-i2c-slave
  *
@@ -91,27 +137,19 @@ void i2c_unlock()
  */
 esp_err_t i2c_read_slave(uint8_t addr7, uint8_t *data_rd, size_t size)
 {
-	i2c_device_config_t dev_cfg;
 	i2c_master_dev_handle_t dev_handle;
 	
     if (size == 0) {
         return ESP_OK;
     }
     
-    dev_cfg.dev_addr_length = I2C_ADDR_BIT_LEN_7;
-    dev_cfg.device_address = (uint16_t) addr7;
-    dev_cfg.scl_speed_hz = I2C_MASTER_FREQ_HZ;
-    
-    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev_handle);
+    esp_err_t ret = _i2c_get_device(addr7, I2C_MASTER_FREQ_HZ, &dev_handle);
     if (ret != ESP_OK) {
     	return ret;
     }
     
-    ret = i2c_master_receive(dev_handle, data_rd, size, 1000);
-    
-    i2c_master_bus_rm_device(dev_handle);
-    
-    return ret;
+    transaction_count++;
+    return i2c_master_receive(dev_handle, data_rd, size, 1000);
 }
 
 
@@ -125,21 +163,94 @@ esp_err_t i2c_read_slave(uint8_t addr7, uint8_t *data_rd, size_t size)
  */
 esp_err_t i2c_write_slave(uint8_t addr7, uint8_t *data_wr, size_t size)
 {
-    i2c_device_config_t dev_cfg;
 	i2c_master_dev_handle_t dev_handle;
 	
-	dev_cfg.dev_addr_length = I2C_ADDR_BIT_LEN_7;
-    dev_cfg.device_address = (uint16_t) addr7;
-    dev_cfg.scl_speed_hz = I2C_MASTER_FREQ_HZ;
+    esp_err_t ret = _i2c_get_device(addr7, I2C_MASTER_FREQ_HZ, &dev_handle);
+    if (ret != ESP_OK) {
+    	return ret;
+    }
     
-    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev_handle);
+    transaction_count++;
+    return i2c_master_transmit(dev_handle, data_wr, size, 1000);
+}
+
+
+/**
+ * Write a register address and read from esp-i2c-slave using a repeated start
+ *
+ * _______________________________________________________________________________
+ * | start | slave_addr + wr_bit + ack | write n bytes + ack  | repeated start  ...
+ * --------|---------------------------|----------------------|-----------------
+ *    ____________________________________________________________________________
+ * ... | slave_addr + rd_bit +ack | read n-1 bytes + ack | read 1 byte + nack | stop |
+ *     |--------------------------|----------------------|--------------------|------|
+ *
+ */
+esp_err_t i2c_read_register(uint8_t addr7, uint8_t *reg, size_t reg_size, uint8_t *data_rd, size_t size)
+{
+	i2c_master_dev_handle_t dev_handle;
+	
+    if (size == 0) {
+        return ESP_OK;
+    }
+    
+    esp_err_t ret = _i2c_get_device(addr7, I2C_MASTER_FREQ_HZ, &dev_handle);
     if (ret != ESP_OK) {
     	return ret;
     }
     
-    ret = i2c_master_transmit(dev_handle, data_wr, size, 1000);
+    transaction_count++;
+    return i2c_master_transmit_receive(dev_handle, reg, reg_size, data_rd, size, 1000);
+}
+
+
+
+//
+// I2C internal functions
+//
+
+/**
+ * Return a cached device handle for the address and speed, adding it to the bus
+ * if necessary.  Must be called with the i2c_mutex held.
+ */
+static esp_err_t _i2c_get_device(uint8_t addr7, uint32_t speed_hz, i2c_master_dev_handle_t* dev_handle)
+{
+	int i;
+	int free_index = -1;
+	i2c_device_config_t dev_cfg = {0};
+	esp_err_t ret;
+	
+	for (i=0; i<I2C_MAX_DEVICES; i++) {
+		if (dev_cache[i].valid) {
+			if ((dev_cache[i].addr7 == addr7) && (dev_cache[i].speed_hz == speed_hz)) {
+				*dev_handle = dev_cache[i].dev_handle;
+				return ESP_OK;
+			}
+		} else if (free_index < 0) {
+			free_index = i;
+		}
+	}
+	
+	// Make room by removing an existing device if the cache is full
+	if (free_index < 0) {
+		free_index = dev_cache_evict_index;
+		if (++dev_cache_evict_index == I2C_MAX_DEVICES) dev_cache_evict_index = 0;
+		
+		(void) i2c_master_bus_rm_device(dev_cache[free_index].dev_handle);
+		dev_cache[free_index].valid = false;
+	}
+	
+	dev_cfg.dev_addr_length = I2C_ADDR_BIT_LEN_7;
+    dev_cfg.device_address = (uint16_t) addr7;
+    dev_cfg.scl_speed_hz = speed_hz;
     
-    i2c_master_bus_rm_device(dev_handle);
+    ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, dev_handle);
+    if (ret == ESP_OK) {
+    	dev_cache[free_index].valid = true;
+    	dev_cache[free_index].addr7 = addr7;
+    	dev_cache[free_index].speed_hz = speed_hz;
+    	dev_cache[free_index].dev_handle = *dev_handle;
+    }
     
     return ret;
 }
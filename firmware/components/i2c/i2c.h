@@ -2,7 +2,8 @@
  * I2C Module
  *
  * Provides I2C Access routines for other modules/tasks.  Provides a locking mechanism
- * since the underlying ESP IDF routines are not thread safe.
+ * since the underlying ESP IDF routines are not thread safe.  Also provides an
+ * asynchronous request queue serviced by its own task.
  *
  * Copyright 2020-2025 Dan Julio
  *
@@ -23,19 +24,65 @@
 #ifndef I2C_H
 #define I2C_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "esp_system.h"
 
 
 
+//
+// I2C constants
+//
+
+// Maximum number of cached device handles
+#define I2C_MAX_DEVICES 4
+
+// Asynchronous request queue
+#define I2C_ASYNC_QUEUE_LEN     8
+#define I2C_ASYNC_MAX_REG_LEN   2
+#define I2C_ASYNC_MAX_WR_LEN    8
+
+// Asynchronous request task (runs on the otherwise lightly loaded core 0)
+#define I2C_TASK_STACK          2048
+#define I2C_TASK_PRIO           3
+#define I2C_TASK_CORE           0
+
+
+
+//
+// I2C typedefs
+//
+
+// Completion callback - called from the I2C task after the request has been performed
+typedef void (*i2c_done_cb_t)(esp_err_t status, void* arg);
+
+// Asynchronous request.  A read writes reg then reads len bytes into rd_data (which
+// must remain valid until the callback).  A write sends reg followed by wr_data.
+typedef struct {
+	uint8_t addr7;
+	bool is_read;
+	uint8_t reg[I2C_ASYNC_MAX_REG_LEN];
+	uint8_t reg_len;
+	uint8_t wr_data[I2C_ASYNC_MAX_WR_LEN];
+	uint8_t* rd_data;
+	size_t len;
+	i2c_done_cb_t cb;
+	void* cb_arg;
+} i2c_request_t;
+
+
+
 //
 // I2C API
 //
 esp_err_t i2c_init(int scl_pin, int sda_pin);
 void i2c_lock();
 void i2c_unlock();
+uint32_t i2c_get_transaction_count();
 esp_err_t i2c_read_slave(uint8_t addr7, uint8_t *data_rd, size_t size);
 esp_err_t i2c_write_slave(uint8_t addr7, uint8_t *data_wr, size_t size);
+esp_err_t i2c_read_register(uint8_t addr7, uint8_t *reg, size_t reg_size, uint8_t *data_rd, size_t size);
+esp_err_t i2c_submit(const i2c_request_t* req);
 
 
 #endif /* I2C_H */
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+ * I2C asynchronous request queue
+ *
+ * Asynchronous requests are queued with i2c_submit() and performed by i2c_task.  All
+ * requests waiting in the queue are performed back to back while holding the lock and
+ * their callbacks are then called in submission order.
+ *
+ * Copyright 2020-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include <string.h>
+
+
+
+//
+// I2C async typedefs
+//
+typedef struct {
+	i2c_request_t req;
+	esp_err_t status;
+} i2c_async_result_t;
+
+
+
+//
+// I2C async variables
+//
+static const char* TAG = "i2c";
+
+// Request queue and the batch being performed by i2c_task
+static QueueHandle_t async_queue;
+static i2c_async_result_t async_batch[I2C_ASYNC_QUEUE_LEN];
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _i2c_task(void* args);
+static esp_err_t _i2c_perform_request(i2c_request_t* req);
+
+
+
+//
+// I2C async API
+//
+esp_err_t i2c_async_init()
+{
+	async_queue = xQueueCreate(I2C_ASYNC_QUEUE_LEN, sizeof(i2c_request_t));
+	if (async_queue == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	
+	if (xTaskCreatePinnedToCore(&_i2c_task, "i2c_task", I2C_TASK_STACK, NULL, I2C_TASK_PRIO, NULL, I2C_TASK_CORE) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+	
+	return ESP_OK;
+}
+
+
+/**
+ * Queue an asynchronous request.  The request is copied so the caller's structure
+ * may be reused immediately.  Returns ESP_ERR_TIMEOUT if the queue is full.
+ */
+esp_err_t i2c_submit(const i2c_request_t* req)
+{
+	if ((req->reg_len > I2C_ASYNC_MAX_REG_LEN) || (!req->is_read && (req->len > I2C_ASYNC_MAX_WR_LEN))) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	
+	if (xQueueSendToBack(async_queue, req, 0) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
+	
+	return ESP_OK;
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Perform queued asynchronous requests.  Requests that are already waiting when the
+ * bus is acquired are performed in the same batch.
+ */
+static void _i2c_task(void* args)
+{
+	int i;
+	int n;
+	
+	ESP_LOGI(TAG, "Start task");
+	
+	while (1) {
+		if (xQueueReceive(async_queue, &async_batch[0].req, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+		
+		i2c_lock();
+		n = 0;
+		do {
+			async_batch[n].status = _i2c_perform_request(&async_batch[n].req);
+			n++;
+		} while ((n < I2C_ASYNC_QUEUE_LEN) && (xQueueReceive(async_queue, &async_batch[n].req, 0) == pdTRUE));
+		i2c_unlock();
+		
+		// Callbacks are made without the lock held so they may access the bus
+		for (i=0; i<n; i++) {
+			if (async_batch[i].req.cb != NULL) {
+				async_batch[i].req.cb(async_batch[i].status, async_batch[i].req.cb_arg);
+			}
+		}
+	}
+}
+
+
+/**
+ * Perform one asynchronous request.  Must be called with the i2c lock held.
+ */
+static esp_err_t _i2c_perform_request(i2c_request_t* req)
+{
+	uint8_t buf[I2C_ASYNC_MAX_REG_LEN + I2C_ASYNC_MAX_WR_LEN];
+	
+	if (req->is_read) {
+		if (req->reg_len == 0) {
+			return i2c_read_slave(req->addr7, req->rd_data, req->len);
+		} else {
+			return i2c_read_register(req->addr7, req->reg, req->reg_len, req->rd_data, req->len);
+		}
+	} else {
+		memcpy(buf, req->reg, req->reg_len);
+		memcpy(&buf[req->reg_len], req->wr_data, req->len);
+		return i2c_write_slave(req->addr7, buf, req->reg_len + req->len);
+	}
+}
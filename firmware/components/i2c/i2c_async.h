@@ -0,0 +1,35 @@
+/*
+ * I2C asynchronous request queue
+ *
+ * Queues requests submitted with i2c_submit() for i2c_task.  Shared by the hardware
+ * and emulated bus implementations.
+ *
+ * Copyright 2020-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include "esp_system.h"
+
+
+//
+// I2C async API (called by the bus implementation's i2c_init)
+//
+esp_err_t i2c_async_init();
+
+
+#endif /* I2C_ASYNC_H */
@@ -0,0 +1,141 @@
+/*
+ * I2C Module - host emulation
+ *
+ * Implements the i2c.h API for the IDF linux target.  Transactions addressed to the
+ * gCore are handled by the gCore EFM8 emulator, all other addresses NAK.  The
+ * asynchronous request queue is shared with the hardware implementation.
+ *
+ * Copyright 2020-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include <stdbool.h>
+
+
+
+//
+// I2C variables
+//
+static SemaphoreHandle_t i2c_mutex;
+
+// Statistics
+static uint32_t transaction_count = 0;
+
+
+
+//
+// I2C API
+//
+
+/**
+ * i2c master initialization - the pins are ignored.  The emulator starts with its
+ * default configuration; a test may call gcore_emu_init() afterwards to change it.
+ */
+esp_err_t i2c_init(int scl_pin, int sda_pin)
+{
+	i2c_mutex = xSemaphoreCreateMutex();
+	if (i2c_mutex == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	gcore_emu_init(NULL);
+
+	return i2c_async_init();
+}
+
+
+/**
+ * i2c master lock
+ */
+void i2c_lock()
+{
+	xSemaphoreTake(i2c_mutex, portMAX_DELAY);
+}
+
+
+/**
+ * i2c master unlock
+ */
+void i2c_unlock()
+{
+	xSemaphoreGive(i2c_mutex);
+}
+
+
+/**
+ * Return the number of bus transactions since boot (wraps)
+ */
+uint32_t i2c_get_transaction_count()
+{
+	return transaction_count;
+}
+
+
+esp_err_t i2c_read_slave(uint8_t addr7, uint8_t *data_rd, size_t size)
+{
+	if (size == 0) {
+		return ESP_OK;
+	}
+
+	transaction_count++;
+	if (addr7 != GCORE_I2C_ADDR) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	return gcore_emu_read(data_rd, size);
+}
+
+
+esp_err_t i2c_write_slave(uint8_t addr7, uint8_t *data_wr, size_t size)
+{
+	transaction_count++;
+	if (addr7 != GCORE_I2C_ADDR) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	return gcore_emu_write(data_wr, size);
+}
+
+
+/**
+ * Register write followed by a repeated start read.  Emulated as two transactions
+ * to the EFM8 but counted as one bus transaction.
+ */
+esp_err_t i2c_read_register(uint8_t addr7, uint8_t *reg, size_t reg_size, uint8_t *data_rd, size_t size)
+{
+	esp_err_t ret;
+
+	if (size == 0) {
+		return ESP_OK;
+	}
+
+	transaction_count++;
+	if (addr7 != GCORE_I2C_ADDR) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	ret = gcore_emu_write(reg, reg_size);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	return gcore_emu_read(data_rd, size);
+}
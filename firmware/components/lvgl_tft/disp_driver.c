@@ -3,9 +3,13 @@
  */
 
 #include "disp_driver.h"
+#include "disp_pipeline.h"
 #include "disp_spi.h"
+#include "esp_log.h"
 #include "ili9488.h"
 
+#define TAG "disp_driver"
+
 
 
 void disp_driver_init(bool init_spi)
@@ -15,9 +19,31 @@ void disp_driver_init(bool init_spi)
 	}
 
 	ili9488_init();
+
+#ifdef LCD_PIPELINE_ENABLE
+	disp_pipeline_init();
+#endif
 }
 
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map)
 {
+#ifdef LCD_PIPELINE_ENABLE
+	disp_pipeline_flush(drv, area, color_map);
+#else
 	ili9488_flush(drv, area, color_map);
+#endif
+}
+
+#ifdef LCD_PIPELINE_BENCHMARK
+void disp_driver_monitor(lv_disp_drv_t * drv, uint32_t time, uint32_t px)
+{
+#ifdef LCD_PIPELINE_ENABLE
+	disp_pipeline_monitor(drv, time, px);
+#else
+	// Log full-screen redraws for comparison with the pipelined driver
+	if (px >= (LV_HOR_RES_MAX * LV_VER_RES_MAX)) {
+		ESP_LOGI(TAG, "Full redraw %lu mSec", time);
+	}
+#endif
 }
+#endif
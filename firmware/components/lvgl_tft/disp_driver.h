@@ -32,6 +32,9 @@ extern "C" {
  **********************/
 void disp_driver_init(bool init_spi);
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+#ifdef LCD_PIPELINE_BENCHMARK
+void disp_driver_monitor(lv_disp_drv_t * drv, uint32_t time, uint32_t px);
+#endif
 
 
 /**********************
@@ -0,0 +1,303 @@
+/**
+ * @file disp_pipeline.c
+ *
+ * Render/transfer pipeline.  LVGL (gui_task, core 1) renders a band into its active
+ * buffer and calls disp_pipeline_flush() which hands the band to the flush task
+ * (core 0) through a lock-free single-producer/single-consumer descriptor queue and
+ * immediately gives LVGL a free buffer from the ring so it can start on the next band
+ * while the previous one is still being sent over SPI.  The flush task returns buffers
+ * through a second SPSC queue once their DMA transfer completes.
+ *
+ * LVGL is configured for double buffering and always holds two buffers (active and
+ * inactive).  Each flush replaces the buffer LVGL just handed off with a free one.
+ *
+ * With LCD_PIPELINE_BENCHMARK the monitor callback notes the end of rendering for each
+ * full-screen redraw and the flush task logs the timing once it has sent the last band.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "disp_pipeline.h"
+
+#ifdef LCD_PIPELINE_ENABLE
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ili9488.h"
+
+#include <stdatomic.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+
+/*********************
+ *      DEFINES
+ *********************/
+#define TAG "disp_pipeline"
+
+#if (DISP_PIPELINE_NUM_BUFS < 4) || ((DISP_PIPELINE_NUM_BUFS & (DISP_PIPELINE_NUM_BUFS - 1)) != 0)
+#error "LCD_PIPELINE_NUM_BUFS must be a power of 2 and at least 4"
+#endif
+
+#define RING_MASK (DISP_PIPELINE_NUM_BUFS - 1)
+
+// Flush task notifications
+#define NOTIFY_WORK   0x00000001
+#define NOTIFY_DONE   0x00000002
+
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    lv_area_t area;
+    lv_color_t * buf;
+} band_desc_t;
+
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void disp_pipeline_task(void * args);
+#ifdef LCD_PIPELINE_BENCHMARK
+static void disp_pipeline_report(void);
+#endif
+
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+// Band buffers (statically allocated in internal DMA-capable memory)
+static lv_color_t ring_buf[DISP_PIPELINE_NUM_BUFS][LVGL_DISP_BUF_SIZE];
+
+// Descriptor queue: gui_task -> flush task
+static band_desc_t band_q[DISP_PIPELINE_NUM_BUFS];
+static atomic_uint band_q_head;
+static atomic_uint band_q_tail;
+
+// Free buffer queue: flush task -> gui_task (free_sem counts its entries)
+static lv_color_t * free_q[DISP_PIPELINE_NUM_BUFS];
+static atomic_uint free_q_head;
+static atomic_uint free_q_tail;
+static SemaphoreHandle_t free_sem;
+
+static TaskHandle_t flush_task_handle;
+
+// Benchmark state
+#ifdef LCD_PIPELINE_BENCHMARK
+static atomic_bool flush_busy;
+static atomic_bool redraw_pending;     // A full redraw is waiting for its last band to be sent
+static atomic_uint spi_busy_usec;      // Total time the flush task spent on bands
+static volatile int64_t drain_usec;    // Time the flush task last emptied the descriptor queue
+static uint32_t render_stall_usec;     // Total time LVGL waited for a free buffer
+static uint32_t prev_spi_busy_usec;
+static uint32_t prev_render_stall_usec;
+
+// Pending redraw (written by gui_task before redraw_pending is set)
+static int64_t redraw_start_usec;
+static uint32_t redraw_render_usec;
+static uint32_t redraw_stall_usec;
+static uint32_t redraw_spi_base_usec;
+#endif
+
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void disp_pipeline_init(void)
+{
+    int i;
+
+    // LVGL is given the first two buffers, the rest start out free
+    free_sem = xSemaphoreCreateCounting(DISP_PIPELINE_NUM_BUFS, DISP_PIPELINE_NUM_BUFS - 2);
+    assert(free_sem != NULL);
+    for (i=2; i<DISP_PIPELINE_NUM_BUFS; i++) {
+        free_q[i-2] = ring_buf[i];
+    }
+    atomic_store(&free_q_head, DISP_PIPELINE_NUM_BUFS - 2);
+    atomic_store(&free_q_tail, 0);
+    atomic_store(&band_q_head, 0);
+    atomic_store(&band_q_tail, 0);
+
+    BaseType_t ret = xTaskCreatePinnedToCore(&disp_pipeline_task, "lcd_flush", DISP_PIPELINE_TASK_STACK,
+        NULL, DISP_PIPELINE_TASK_PRIO, &flush_task_handle, DISP_PIPELINE_TASK_CORE);
+    assert(ret == pdPASS);
+
+    ESP_LOGI(TAG, "%d band buffers, flush on core %d", DISP_PIPELINE_NUM_BUFS, DISP_PIPELINE_TASK_CORE);
+}
+
+
+void disp_pipeline_get_lvgl_bufs(lv_color_t ** buf1, lv_color_t ** buf2)
+{
+    *buf1 = ring_buf[0];
+    *buf2 = ring_buf[1];
+}
+
+
+void disp_pipeline_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map)
+{
+    lv_disp_buf_t * vdb = drv->buffer;
+    lv_color_t * new_buf;
+    unsigned int i;
+#ifdef LCD_PIPELINE_BENCHMARK
+    int64_t t;
+#endif
+
+    // Wait for a free buffer (only blocks when rendering has gotten ahead of SPI by the whole ring)
+    if (xSemaphoreTake(free_sem, 0) != pdTRUE) {
+#ifdef LCD_PIPELINE_BENCHMARK
+        t = esp_timer_get_time();
+        xSemaphoreTake(free_sem, portMAX_DELAY);
+        render_stall_usec += (uint32_t) (esp_timer_get_time() - t);
+#else
+        xSemaphoreTake(free_sem, portMAX_DELAY);
+#endif
+    }
+    i = atomic_load_explicit(&free_q_tail, memory_order_relaxed);
+    new_buf = free_q[i & RING_MASK];
+    atomic_store_explicit(&free_q_tail, i + 1, memory_order_release);
+
+    // Hand the rendered band to the flush task
+    i = atomic_load_explicit(&band_q_head, memory_order_relaxed);
+    band_q[i & RING_MASK].area = *area;
+    band_q[i & RING_MASK].buf = color_map;
+    atomic_store_explicit(&band_q_head, i + 1, memory_order_release);
+    xTaskNotify(flush_task_handle, NOTIFY_WORK, eSetBits);
+
+    // Replace the handed-off buffer so LVGL never renders into one still in flight
+    if (vdb->buf1 == (void *) color_map) {
+        vdb->buf1 = new_buf;
+    } else {
+        vdb->buf2 = new_buf;
+    }
+
+    lv_disp_flush_ready(drv);
+}
+
+
+#ifdef LCD_PIPELINE_BENCHMARK
+/**
+ * Called at the end of each LVGL refresh (rendering is done but bands may still be
+ * queued).  A full-screen redraw (screen change) is noted for the flush task which
+ * reports it when the last band is on the display.  Never blocks gui_task.
+ */
+void disp_pipeline_monitor(lv_disp_drv_t * drv, uint32_t time, uint32_t px)
+{
+    if (px >= (LV_HOR_RES_MAX * LV_VER_RES_MAX)) {
+        redraw_start_usec = esp_timer_get_time() - ((int64_t) time * 1000);
+        redraw_render_usec = time * 1000;
+        redraw_stall_usec = render_stall_usec - prev_render_stall_usec;
+        redraw_spi_base_usec = prev_spi_busy_usec;
+        atomic_store(&redraw_pending, true);
+
+        // The flush task may have already sent the last band
+        if (!atomic_load(&flush_busy) && (atomic_load(&band_q_tail) == atomic_load(&band_q_head))) {
+            if (atomic_exchange(&redraw_pending, false)) {
+                disp_pipeline_report();
+            }
+        }
+    }
+
+    prev_spi_busy_usec = atomic_load(&spi_busy_usec);
+    prev_render_stall_usec = render_stall_usec;
+}
+#endif
+
+
+void IRAM_ATTR disp_pipeline_spi_done_isr(void)
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    xTaskNotifyFromISR(flush_task_handle, NOTIFY_DONE, eSetBits, &higher_priority_task_woken);
+    if (higher_priority_task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void disp_pipeline_task(void * args)
+{
+    band_desc_t * desc;
+#ifdef LCD_PIPELINE_BENCHMARK
+    int64_t t;
+#endif
+    uint32_t notification_value;
+    unsigned int i, j;
+
+    ESP_LOGI(TAG, "Start task");
+
+    while (1) {
+        (void) xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, portMAX_DELAY);
+
+        // Drain all queued bands
+        while ((i = atomic_load_explicit(&band_q_tail, memory_order_relaxed)) !=
+               atomic_load_explicit(&band_q_head, memory_order_acquire)) {
+#ifdef LCD_PIPELINE_BENCHMARK
+            atomic_store(&flush_busy, true);
+#endif
+            desc = &band_q[i & RING_MASK];
+
+            // Address setup and the DMA color transfer (which signals NOTIFY_DONE on completion)
+#ifdef LCD_PIPELINE_BENCHMARK
+            t = esp_timer_get_time();
+#endif
+            ili9488_flush(NULL, &desc->area, desc->buf);
+            do {
+                (void) xTaskNotifyWait(0x00, NOTIFY_DONE, &notification_value, portMAX_DELAY);
+            } while ((notification_value & NOTIFY_DONE) == 0);
+#ifdef LCD_PIPELINE_BENCHMARK
+            atomic_fetch_add(&spi_busy_usec, (uint32_t) (esp_timer_get_time() - t));
+#endif
+
+            // Return the buffer to LVGL
+            j = atomic_load_explicit(&free_q_head, memory_order_relaxed);
+            free_q[j & RING_MASK] = desc->buf;
+            atomic_store_explicit(&free_q_head, j + 1, memory_order_release);
+            atomic_store_explicit(&band_q_tail, i + 1, memory_order_release);
+            xSemaphoreGive(free_sem);
+        }
+
+#ifdef LCD_PIPELINE_BENCHMARK
+        if (atomic_load(&flush_busy)) {
+            drain_usec = esp_timer_get_time();
+            atomic_store(&flush_busy, false);
+            if (atomic_exchange(&redraw_pending, false)) {
+                disp_pipeline_report();
+            }
+        }
+#endif
+    }
+}
+
+
+#ifdef LCD_PIPELINE_BENCHMARK
+/**
+ * Log a full redraw timed from the start of rendering until its last band was sent,
+ * with the SPI time and how much of it overlapped rendering
+ */
+static void disp_pipeline_report(void)
+{
+    uint32_t total_usec;
+    uint32_t spi_usec;
+    uint32_t overlap_usec;
+
+    total_usec = (uint32_t) (drain_usec - redraw_start_usec);
+    spi_usec = atomic_load(&spi_busy_usec) - redraw_spi_base_usec;
+    overlap_usec = ((redraw_render_usec + spi_usec) > total_usec) ? (redraw_render_usec + spi_usec - total_usec) : 0;
+
+    ESP_LOGI(TAG, "Full redraw %lu uSec: render %lu uSec (stalled %lu), SPI %lu uSec, overlap %lu uSec",
+        total_usec, redraw_render_usec, redraw_stall_usec, spi_usec, overlap_usec);
+}
+#endif
+
+#endif /* LCD_PIPELINE_ENABLE */
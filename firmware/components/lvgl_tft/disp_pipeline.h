@@ -0,0 +1,54 @@
+/**
+ * @file disp_pipeline.h
+ *
+ * Optional render/transfer pipeline.  LVGL renders bands into a ring of DMA buffers
+ * on one core while a flush task on the other core owns the SPI device and ILI9488
+ * command sequencing.  Enabled by LCD_PIPELINE_ENABLE in system_config.h.
+ */
+
+#ifndef DISP_PIPELINE_H
+#define DISP_PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl/lvgl.h"
+#include "system_config.h"
+
+
+/*********************
+ *      DEFINES
+ *********************/
+
+// Number of band buffers in the ring (power of 2, LVGL always holds two of them)
+#define DISP_PIPELINE_NUM_BUFS   LCD_PIPELINE_NUM_BUFS
+
+// Flush task
+#define DISP_PIPELINE_TASK_CORE  0
+#define DISP_PIPELINE_TASK_PRIO  3
+#define DISP_PIPELINE_TASK_STACK 2048
+
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+void disp_pipeline_init(void);
+void disp_pipeline_get_lvgl_bufs(lv_color_t ** buf1, lv_color_t ** buf2);
+void disp_pipeline_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+#ifdef LCD_PIPELINE_BENCHMARK
+void disp_pipeline_monitor(lv_disp_drv_t * drv, uint32_t time, uint32_t px);
+#endif
+void disp_pipeline_spi_done_isr(void);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*DISP_PIPELINE_H*/
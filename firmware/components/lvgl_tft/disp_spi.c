@@ -20,6 +20,8 @@
 
 #include "disp_spi.h"
 #include "disp_driver.h"
+#include "disp_pipeline.h"
+#include "pm_utilities.h"
 
 
 /*********************
@@ -109,6 +111,7 @@ void disp_spi_send_data(uint8_t * data, uint16_t length)
 
     spi_trans_in_progress = true;
     spi_color_sent = false;             //Mark the "lv_flush_ready" NOT needs to be called in "spi_ready"
+    pm_lock_acquire(PM_LOCK_SPI);       //Held until the transaction completes in "spi_ready"
     spi_device_queue_trans(spi, &t, portMAX_DELAY);
 }
 
@@ -128,6 +131,7 @@ void disp_spi_send_colors(uint8_t * data, uint16_t length)
     
     spi_trans_in_progress = true;
     spi_color_sent = true;              //Mark the "lv_flush_ready" needs to be called in "spi_ready"
+    pm_lock_acquire(PM_LOCK_SPI);       //Held until the transaction completes in "spi_ready"
     spi_device_queue_trans(spi, &t, portMAX_DELAY);
 }
 
@@ -145,8 +149,14 @@ bool disp_spi_is_busy(void)
 
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans)
 {
+    pm_lock_release(PM_LOCK_SPI);       //Before the next transaction can be started
     spi_trans_in_progress = false;
 
+#ifdef LCD_PIPELINE_ENABLE
+    // LVGL was released when the band was queued, let the flush task return the buffer
+    if (spi_color_sent) disp_pipeline_spi_done_isr();
+#else
     lv_disp_t * disp = lv_refr_get_disp_refreshing();
     if (spi_color_sent) lv_disp_flush_ready(&disp->driver);
+#endif
 }
@@ -23,8 +23,13 @@
  */
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "gcore.h"
 #include "i2c.h"
+#include <string.h>
 
 
 //
@@ -32,13 +37,63 @@
 //
 static const char* TAG = "gCore";
 
+// Status/measurement snapshot (protected by the i2c lock)
+static bool snapshot_valid = false;
+static gcore_snapshot_t snapshot;
+static uint8_t snapshot_latched_status = 0;
+
+// Asynchronous snapshot request
+static volatile bool async_snapshot_busy = false;
+static uint8_t async_snapshot_buf[GCORE_SNAP_LEN];
+static gcore_snapshot_cb_t async_snapshot_cb;
+
+// NVRAM write frame (address + data) protected by nvram_mutex
+static SemaphoreHandle_t nvram_mutex;
+static uint8_t nvram_frame[GCORE_NVRAM_FRAME_DATA_LEN + 2];
+
+// Operation statistics (protected by the i2c lock)
+static gcore_op_stats_t op_stats[GCORE_NUM_OPS];
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _gcore_update_snapshot(uint8_t* buf, int64_t t);
+static void _gcore_async_snapshot_done(esp_err_t status, void* arg);
+static esp_err_t _gcore_xfer_retry(int op, uint8_t* reg, uint8_t* data, size_t len);
+static uint16_t _gcore_buf_to_u16(uint8_t* buf);
+
 
 
 //
 // gCore API
 //
+bool gcore_init()
+{
+	nvram_mutex = xSemaphoreCreateMutex();
+	if (nvram_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+	
+	return true;
+}
+
+
+void gcore_get_op_stats(int op, gcore_op_stats_t* stats)
+{
+	if ((op < 0) || (op >= GCORE_NUM_OPS)) return;
+	
+	i2c_lock();
+	*stats = op_stats[op];
+	i2c_unlock();
+}
+
+
 bool gcore_get_reg8(uint8_t offset, uint8_t* dat)
 {
+	uint8_t reg[2];
 	uint8_t buf[2];
 	uint16_t reg_addr;
 	
@@ -48,20 +103,13 @@ bool gcore_get_reg8(uint8_t offset, uint8_t* dat)
 	}
 	
 	reg_addr = GCORE_REG_BASE + offset;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write byte register address 0x%02x", offset);
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 1) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, 1) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read from byte register 0x%02x", offset);
 		return false;
@@ -106,6 +154,7 @@ bool gcore_set_reg8(uint8_t offset, uint8_t dat)
 
 bool gcore_get_reg16(uint8_t offset, uint16_t* dat)
 {
+	uint8_t reg[2];
 	uint8_t buf[2];
 	uint16_t reg_addr;
 	
@@ -115,20 +164,13 @@ bool gcore_get_reg16(uint8_t offset, uint16_t* dat)
 	}
 	
 	reg_addr = GCORE_REG_BASE + offset;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write word register address 0x%02x", offset);
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, 2) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read from word register 0x%02x", offset);
 		return false;
@@ -185,15 +227,8 @@ bool gcore_set_wakeup_bit(uint8_t mask, bool en)
 	// Perform a read-modify-write
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write WK_CTRL address");
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 1) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, buf, 2, &buf[2], 1) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read WK_CTRL");
 		return false;
@@ -201,12 +236,10 @@ bool gcore_set_wakeup_bit(uint8_t mask, bool en)
 	
 	// Write the modified value back
 	if (en) {
-		buf[2] = buf[0] | mask;
+		buf[2] |= mask;
 	} else {
-		buf[2] = buf[0] & ~mask;
+		buf[2] &= ~mask;
 	}
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
 	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 3) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to write WK_CTRL");
@@ -219,37 +252,144 @@ bool gcore_set_wakeup_bit(uint8_t mask, bool en)
 }
 
 
-bool gcore_get_nvram_byte(uint16_t offset, uint8_t* dat)
+/**
+ * Get the status/measurement snapshot.  A new burst read is performed only if the
+ * current snapshot is older than max_age_msec (0 forces a read).  Latched status bits
+ * are accumulated across reads until cleared with gcore_clear_snapshot_status() so they
+ * aren't lost when more than one consumer shares a snapshot.
+ */
+bool gcore_get_snapshot(gcore_snapshot_t* snap, uint32_t max_age_msec)
 {
-	uint8_t buf[2];
+	uint8_t reg[2];
+	uint8_t buf[GCORE_SNAP_LEN];
 	uint16_t reg_addr;
+	int64_t t;
 	
-	if (offset >= GCORE_NVRAM_FULL_LEN) {
-		ESP_LOGE(TAG, "NVRAM offset 0x%04x too large", offset);
-		return false;
+	i2c_lock();
+	
+	t = esp_timer_get_time();
+	if (!snapshot_valid || ((t - snapshot.timestamp_us) >= ((int64_t) max_age_msec * 1000))) {
+		reg_addr = GCORE_REG_BASE + GCORE_SNAP_START;
+		reg[0] = reg_addr >> 8;
+		reg[1] = reg_addr & 0xFF;
+		
+		// Write the register address and burst read the block using a repeated start
+		if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, GCORE_SNAP_LEN) != ESP_OK) {
+			i2c_unlock();
+			ESP_LOGE(TAG, "failed to read status snapshot");
+			return false;
+		}
+		
+		_gcore_update_snapshot(buf, t);
 	}
 	
-	reg_addr = GCORE_NVRAM_BASE + offset;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	snapshot.status = (snapshot.status & ~GCORE_ST_LATCHED_MASK) | snapshot_latched_status;
+	*snap = snapshot;
 	
-	i2c_lock();
+	i2c_unlock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write byte register address 0x%02x", offset);
+	return true;
+}
+
+
+/**
+ * Start an asynchronous snapshot burst read.  The callback is called from the i2c task
+ * with the new snapshot (also available to gcore_get_snapshot()).  Returns false if a
+ * request is already in flight or could not be queued.
+ */
+bool gcore_request_snapshot(gcore_snapshot_cb_t cb)
+{
+	uint16_t reg_addr;
+	i2c_request_t req;
+	
+	if (async_snapshot_busy) {
+		return false;
+	}
+	
+	reg_addr = GCORE_REG_BASE + GCORE_SNAP_START;
+	req.addr7 = GCORE_I2C_ADDR;
+	req.is_read = true;
+	req.reg[0] = reg_addr >> 8;
+	req.reg[1] = reg_addr & 0xFF;
+	req.reg_len = 2;
+	req.rd_data = async_snapshot_buf;
+	req.len = GCORE_SNAP_LEN;
+	req.cb = _gcore_async_snapshot_done;
+	req.cb_arg = NULL;
+	
+	async_snapshot_cb = cb;
+	async_snapshot_busy = true;
+	if (i2c_submit(&req) != ESP_OK) {
+		async_snapshot_busy = false;
+		ESP_LOGE(TAG, "failed to queue status snapshot");
 		return false;
 	}
+	
+	return true;
+}
 
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 1) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to read from byte register 0x%02x", offset);
+
+/**
+ * Queue a byte register write without waiting for it to complete
+ */
+bool gcore_set_reg8_async(uint8_t offset, uint8_t dat)
+{
+	uint16_t reg_addr;
+	i2c_request_t req;
+	
+	if (offset >= GCORE_REG_LEN) {
+		ESP_LOGE(TAG, "REG offset 0x%0x too large", offset);
 		return false;
 	}
 	
+	reg_addr = GCORE_REG_BASE + offset;
+	req.addr7 = GCORE_I2C_ADDR;
+	req.is_read = false;
+	req.reg[0] = reg_addr >> 8;
+	req.reg[1] = reg_addr & 0xFF;
+	req.reg_len = 2;
+	req.wr_data[0] = dat;
+	req.len = 1;
+	req.cb = NULL;
+	req.cb_arg = NULL;
+	
+	if (i2c_submit(&req) != ESP_OK) {
+		ESP_LOGE(TAG, "failed to queue byte register 0x%02x = 0x%2x", offset, dat);
+		return false;
+	}
+	
+	return true;
+}
+
+
+void gcore_clear_snapshot_status(uint8_t mask)
+{
+	i2c_lock();
+	snapshot_latched_status &= ~(mask & GCORE_ST_LATCHED_MASK);
 	i2c_unlock();
+}
+
+
+bool gcore_get_nvram_byte(uint16_t offset, uint8_t* dat)
+{
+	uint8_t reg[2];
+	uint8_t buf[2];
+	uint16_t reg_addr;
+	
+	if (offset >= GCORE_NVRAM_FULL_LEN) {
+		ESP_LOGE(TAG, "NVRAM offset 0x%04x too large", offset);
+		return false;
+	}
+	
+	reg_addr = GCORE_NVRAM_BASE + offset;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
+	
+	// Write the register address and read the byte using a repeated start
+	if (_gcore_xfer_retry(GCORE_OP_NVRAM_RD, reg, buf, 1) != ESP_OK) {
+		ESP_LOGE(TAG, "failed to read NVRAM 0x%04x", offset);
+		return false;
+	}
 
 	*dat = buf[0];
 	return true;
@@ -271,24 +411,19 @@ bool gcore_set_nvram_byte(uint16_t offset, uint8_t dat)
 	buf[1] = reg_addr & 0xFF;
 	buf[2] = dat;
 	
-	i2c_lock();
-	
 	// Write the address + data
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 3) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write NVRAM 0x%02x = 0x%2x", offset, dat);
+	if (_gcore_xfer_retry(GCORE_OP_NVRAM_WR, NULL, buf, 3) != ESP_OK) {
+		ESP_LOGE(TAG, "failed to write NVRAM 0x%04x = 0x%2x", offset, dat);
 		return false;
 	}
 
-	i2c_unlock();
-
 	return true;
 }
 
 
 bool gcore_get_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len)
 {
-	uint8_t buf[2];
+	uint8_t reg[2];
 	uint16_t reg_addr;
 	
 	if ((offset+len) > GCORE_NVRAM_FULL_LEN) {
@@ -297,35 +432,26 @@ bool gcore_get_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len)
 	}
 	
 	reg_addr = GCORE_NVRAM_BASE + offset;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
-	i2c_lock();
-	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write NVRAM register address 0x%04x", offset);
-		return false;
-	}
-
-	// Read the bytes
-	if (i2c_read_slave(GCORE_I2C_ADDR, dat, len) != ESP_OK) {
-		i2c_unlock();
+	// Write the register address and read the bytes using a repeated start
+	if (_gcore_xfer_retry(GCORE_OP_NVRAM_RD, reg, dat, len) != ESP_OK) {
 		ESP_LOGE(TAG, "failed to read %d bytes from NVRAM 0x%04x", len, offset);
 		return false;
 	}
-	
-	i2c_unlock();
 
 	return true;
 }
 
 
+/**
+ * Write NVRAM through the preallocated frame buffer, splitting writes longer than
+ * GCORE_NVRAM_FRAME_DATA_LEN into multiple frames
+ */
 bool gcore_set_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len)
 {
-	int i;
-	uint8_t* buf;
+	uint16_t n;
 	uint16_t reg_addr;
 	
 	if ((offset+len) > GCORE_NVRAM_FULL_LEN) {
@@ -333,32 +459,29 @@ bool gcore_set_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len)
 		return false;
 	}
 	
-	buf = malloc(len+2);
-	if (buf == NULL) {
-		ESP_LOGE(TAG, "Could not malloc %d bytes", len+2);
-		return false;
-	}
-	
-	reg_addr = GCORE_NVRAM_BASE + offset;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
-	for (i=0; i<len; i++) {
-		buf[i+2] = dat[i];
-	}
-	
-	i2c_lock();
+	xSemaphoreTake(nvram_mutex, portMAX_DELAY);
 	
-	// Write the address + data
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, len+2) != ESP_OK) {
-		i2c_unlock();
-		free(buf);
-		ESP_LOGE(TAG, "failed to write %d bytes to NVRAM 0x%04x", len, offset);
-		return false;
+	while (len != 0) {
+		n = (len > GCORE_NVRAM_FRAME_DATA_LEN) ? GCORE_NVRAM_FRAME_DATA_LEN : len;
+		
+		reg_addr = GCORE_NVRAM_BASE + offset;
+		nvram_frame[0] = reg_addr >> 8;
+		nvram_frame[1] = reg_addr & 0xFF;
+		memcpy(&nvram_frame[2], dat, n);
+		
+		// Write the address + data
+		if (_gcore_xfer_retry(GCORE_OP_NVRAM_WR, NULL, nvram_frame, n+2) != ESP_OK) {
+			xSemaphoreGive(nvram_mutex);
+			ESP_LOGE(TAG, "failed to write %d bytes to NVRAM 0x%04x", n, offset);
+			return false;
+		}
+		
+		offset += n;
+		dat += n;
+		len -= n;
 	}
-
-	i2c_unlock();
 	
-	free(buf);
+	xSemaphoreGive(nvram_mutex);
 
 	return true;
 }
@@ -366,24 +489,18 @@ bool gcore_set_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len)
 
 bool gcore_get_time_secs(uint32_t* s)
 {
+	uint8_t reg[2];
 	uint8_t buf[4];
 	uint16_t reg_addr;
 	
 	reg_addr = GCORE_REG_BASE + GCORE_REG_TIME;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write TIME address");
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 4) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, 4) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read TIME register");
 		return false;
@@ -427,24 +544,18 @@ bool gcore_set_time_secs(uint32_t s)
 
 bool gcore_get_alarm_secs(uint32_t* s)
 {
+	uint8_t reg[2];
 	uint8_t buf[4];
 	uint16_t reg_addr;
 	
 	reg_addr = GCORE_REG_BASE + GCORE_REG_ALARM;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write ALARM address");
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 4) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, 4) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read ALARM register");
 		return false;
@@ -487,24 +598,18 @@ bool gcore_set_alarm_secs(uint32_t s)
 
 bool gcore_get_corr_secs(uint32_t* s)
 {
+	uint8_t reg[2];
 	uint8_t buf[4];
 	uint16_t reg_addr;
 	
 	reg_addr = GCORE_REG_BASE + GCORE_REG_CORR;
-	buf[0] = reg_addr >> 8;
-	buf[1] = reg_addr & 0xFF;
+	reg[0] = reg_addr >> 8;
+	reg[1] = reg_addr & 0xFF;
 	
 	i2c_lock();
 	
-	// Write the register address
-	if (i2c_write_slave(GCORE_I2C_ADDR, buf, 2) != ESP_OK) {
-		i2c_unlock();
-		ESP_LOGE(TAG, "failed to write Time Correction address");
-		return false;
-	}
-
-	// Read the register
-	if (i2c_read_slave(GCORE_I2C_ADDR, buf, 4) != ESP_OK) {
+	// Write the register address and read the register using a repeated start
+	if (i2c_read_register(GCORE_I2C_ADDR, reg, 2, buf, 4) != ESP_OK) {
 		i2c_unlock();
 		ESP_LOGE(TAG, "failed to read Time Correction register");
 		return false;
@@ -542,4 +647,104 @@ bool gcore_set_corr_secs(uint32_t s)
 	i2c_unlock();
 
 	return true;
-}
\ No newline at end of file
+}
+
+
+
+//
+// gCore internal functions
+//
+
+/**
+ * Load the snapshot from a burst read buffer.  Must be called with the i2c lock held.
+ */
+static void _gcore_update_snapshot(uint8_t* buf, int64_t t)
+{
+	snapshot_latched_status |= buf[GCORE_REG_STATUS - GCORE_SNAP_START] & GCORE_ST_LATCHED_MASK;
+	
+	snapshot.timestamp_us = t;
+	snapshot.status = buf[GCORE_REG_STATUS - GCORE_SNAP_START];
+	snapshot.gpio = buf[GCORE_REG_GPIO - GCORE_SNAP_START];
+	snapshot.vu = _gcore_buf_to_u16(&buf[GCORE_REG_VU - GCORE_SNAP_START]);
+	snapshot.iu = _gcore_buf_to_u16(&buf[GCORE_REG_IU - GCORE_SNAP_START]);
+	snapshot.vb = _gcore_buf_to_u16(&buf[GCORE_REG_VB - GCORE_SNAP_START]);
+	snapshot.il = _gcore_buf_to_u16(&buf[GCORE_REG_IL - GCORE_SNAP_START]);
+	snapshot.temp = _gcore_buf_to_u16(&buf[GCORE_REG_TEMP - GCORE_SNAP_START]);
+	snapshot_valid = true;
+}
+
+
+static void _gcore_async_snapshot_done(esp_err_t status, void* arg)
+{
+	gcore_snapshot_t snap;
+	gcore_snapshot_cb_t cb = async_snapshot_cb;
+	
+	if (status == ESP_OK) {
+		i2c_lock();
+		_gcore_update_snapshot(async_snapshot_buf, esp_timer_get_time());
+		snapshot.status = (snapshot.status & ~GCORE_ST_LATCHED_MASK) | snapshot_latched_status;
+		snap = snapshot;
+		i2c_unlock();
+	} else {
+		ESP_LOGE(TAG, "failed to read status snapshot");
+	}
+	
+	async_snapshot_busy = false;
+	
+	if (cb != NULL) {
+		cb((status == ESP_OK) ? &snap : NULL);
+	}
+}
+
+
+/**
+ * Perform a gCore transfer, retrying with exponential backoff if it fails (for example
+ * while the EFM8 is erasing flash).  A read writes the 2-byte reg address then reads len
+ * bytes into data.  A write (reg == NULL) sends the len byte frame in data.  The i2c lock
+ * is released between attempts so other bus users can proceed.
+ */
+static esp_err_t _gcore_xfer_retry(int op, uint8_t* reg, uint8_t* data, size_t len)
+{
+	int attempt = 0;
+	uint32_t backoff_msec = GCORE_RETRY_INIT_MSEC;
+	esp_err_t ret;
+	
+	while (1) {
+		i2c_lock();
+		if (reg != NULL) {
+			ret = i2c_read_register(GCORE_I2C_ADDR, reg, 2, data, len);
+		} else {
+			ret = i2c_write_slave(GCORE_I2C_ADDR, data, len);
+		}
+		if (attempt == 0) {
+			op_stats[op].count++;
+		} else {
+			op_stats[op].retries++;
+		}
+		if ((ret != ESP_OK) && (attempt == GCORE_RETRY_MAX)) {
+			op_stats[op].errors++;
+		}
+		i2c_unlock();
+		
+		if ((ret == ESP_OK) || (attempt == GCORE_RETRY_MAX)) {
+			break;
+		}
+		
+		attempt++;
+		vTaskDelay(pdMS_TO_TICKS(backoff_msec));
+		backoff_msec *= 2;
+		if (backoff_msec > GCORE_RETRY_MAX_MSEC) backoff_msec = GCORE_RETRY_MAX_MSEC;
+	}
+	
+	if ((ret == ESP_OK) && (attempt != 0)) {
+		ESP_LOGI(TAG, "%s succeeded after %d retries", (reg != NULL) ? "NVRAM read" : "NVRAM write", attempt);
+	}
+	
+	return ret;
+}
+
+
+static uint16_t _gcore_buf_to_u16(uint8_t* buf)
+{
+	return (buf[0] << 8) | buf[1];
+}
@@ -84,6 +84,9 @@
 #define GCORE_ST_PB_PRESS_MASK   0x10
 #define GCORE_ST_PWR_ON_RSN_MASK 0x07
 
+// Status register bits cleared by reading the register (accumulated in the snapshot)
+#define GCORE_ST_LATCHED_MASK    GCORE_ST_PB_PRESS_MASK
+
 // Status power-on reason bit masks
 #define GCORE_PWR_ON_BTN_MASK    0x01
 #define GCORE_PWR_ON_ALARM_MASK  0x02
@@ -111,6 +114,54 @@
 #define GCORE_SHUTDOWN_TRIG       0x0F
 
 
+//
+// Status/measurement snapshot - the contiguous block from STATUS through TEMP
+// read in one burst
+//
+#define GCORE_SNAP_START          GCORE_REG_STATUS
+#define GCORE_SNAP_LEN            (GCORE_REG_TEMP + 2 - GCORE_REG_STATUS)
+
+typedef struct {
+	int64_t timestamp_us;         // esp_timer time of the burst read
+	uint8_t status;               // Latched bits are accumulated until cleared
+	uint8_t gpio;
+	uint16_t vu;                  // mV
+	uint16_t iu;                  // mA
+	uint16_t vb;                  // mV
+	uint16_t il;                  // mA
+	uint16_t temp;                // C * 10
+} gcore_snapshot_t;
+
+// Asynchronous snapshot callback (snap is NULL if the read failed)
+typedef void (*gcore_snapshot_cb_t)(const gcore_snapshot_t* snap);
+
+
+//
+// NVRAM access
+//
+
+// Largest NVRAM write sent as one frame (sized for the persistent storage region,
+// longer writes are split)
+#define GCORE_NVRAM_FRAME_DATA_LEN 384
+
+// Retries with exponential backoff while the EFM8 is busy (it NAKs for about 36 mSec
+// while erasing flash)
+#define GCORE_RETRY_MAX           6
+#define GCORE_RETRY_INIT_MSEC     2
+#define GCORE_RETRY_MAX_MSEC      32
+
+// Operation statistics
+#define GCORE_OP_NVRAM_RD         0
+#define GCORE_OP_NVRAM_WR         1
+#define GCORE_NUM_OPS             2
+
+typedef struct {
+	uint32_t count;               // Operations requested
+	uint32_t retries;             // Additional attempts
+	uint32_t errors;              // Operations that failed after all retries
+} gcore_op_stats_t;
+
+
 //
 // Charge status bit values
 //
@@ -123,13 +174,21 @@
 //
 // gCore API
 //
+bool gcore_init();
+void gcore_get_op_stats(int op, gcore_op_stats_t* stats);
+
 bool gcore_get_reg8(uint8_t offset, uint8_t* dat);
 bool gcore_set_reg8(uint8_t offset, uint8_t dat);
 bool gcore_get_reg16(uint8_t offset, uint16_t* dat);
 bool gcore_set_reg16(uint8_t offset, uint16_t dat);
+bool gcore_set_reg8_async(uint8_t offset, uint8_t dat);
 
 bool gcore_set_wakeup_bit(uint8_t mask, bool en);
 
+bool gcore_get_snapshot(gcore_snapshot_t* snap, uint32_t max_age_msec);
+bool gcore_request_snapshot(gcore_snapshot_cb_t cb);
+void gcore_clear_snapshot_status(uint8_t mask);
+
 bool gcore_get_nvram_byte(uint16_t offset, uint8_t* dat);
 bool gcore_set_nvram_byte(uint16_t offset, uint8_t dat);
 bool gcore_get_nvram_bytes(uint16_t offset, uint8_t* dat, uint16_t len);
@@ -0,0 +1,227 @@
+/*
+ * Power management utilities
+ *
+ * Configure ESP32 dynamic frequency scaling and automatic light sleep and manage
+ * the named locks that hold the system out of its low power states while Wi-Fi or
+ * a web session is active (and account for the time LCD SPI DMA is in flight).
+ *
+ * Locks may be acquired and released from ISRs (the SPI lock is released in the
+ * SPI transaction done callback).  Each lock counts nested acquires and keeps
+ * accounting of its hold times.  Without CONFIG_PM_ENABLE (or on a host build) only
+ * the accounting is done so the lock policy can still be observed.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "pm_utilities.h"
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	int count;                         // Nested acquires outstanding
+	int64_t start_usec;                // Time the current hold started
+	pm_lock_stats_t stats;
+#ifdef CONFIG_PM_ENABLE
+	esp_pm_lock_handle_t handle;
+#endif
+} pm_lock_t;
+
+
+
+//
+// Variables
+//
+static const char* TAG = "pm_utilities";
+
+static const char* lock_names[PM_NUM_LOCKS] = {
+	"SPI",
+	"WIFI",
+	"WEB"
+};
+
+#ifdef CONFIG_PM_ENABLE
+// The spi_master driver already holds its own APB lock for every transaction in flight
+// so the SPI lock only keeps accounting (and adds no esp_pm work to the SPI ISR)
+static const bool lock_uses_esp_pm[PM_NUM_LOCKS] = {
+	false,
+	true,
+	true
+};
+
+static const esp_pm_lock_type_t lock_types[PM_NUM_LOCKS] = {
+	ESP_PM_APB_FREQ_MAX,
+	ESP_PM_NO_LIGHT_SLEEP,
+	ESP_PM_CPU_FREQ_MAX
+};
+#endif
+
+static DRAM_ATTR pm_lock_t locks[PM_NUM_LOCKS];
+
+static portMUX_TYPE pm_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool pm_configured = false;
+
+
+
+//
+// PM Utilities API
+//
+bool pm_init()
+{
+	int i;
+#ifdef CONFIG_PM_ENABLE
+	esp_err_t ret;
+	esp_pm_config_t pm_config = {
+		.max_freq_mhz = PM_MAX_CPU_FREQ_MHZ,
+		.min_freq_mhz = PM_MIN_CPU_FREQ_MHZ,
+		.light_sleep_enable = PM_LIGHT_SLEEP_ENABLE
+	};
+#endif
+
+	for (i=0; i<PM_NUM_LOCKS; i++) {
+		locks[i].count = 0;
+		locks[i].stats.acquires = 0;
+		locks[i].stats.max_usec = 0;
+		locks[i].stats.total_usec = 0;
+		locks[i].stats.held = false;
+	}
+
+#ifdef CONFIG_PM_ENABLE
+	// Locks must exist before the policy is enabled so nothing runs unprotected
+	for (i=0; i<PM_NUM_LOCKS; i++) {
+		if (!lock_uses_esp_pm[i]) continue;
+		ret = esp_pm_lock_create(lock_types[i], 0, lock_names[i], &locks[i].handle);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "Could not create %s lock - %d", lock_names[i], ret);
+			return false;
+		}
+	}
+
+	ret = esp_pm_configure(&pm_config);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Could not configure power management - %d", ret);
+		return false;
+	}
+	pm_configured = true;
+
+	ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep %s", PM_MIN_CPU_FREQ_MHZ, PM_MAX_CPU_FREQ_MHZ,
+		PM_LIGHT_SLEEP_ENABLE ? "enabled" : "disabled");
+#else
+	ESP_LOGI(TAG, "Power management not enabled - lock accounting only");
+#endif
+
+	return true;
+}
+
+
+bool pm_enabled()
+{
+	return pm_configured;
+}
+
+
+/**
+ * Acquire a lock - may be called from an ISR
+ */
+void IRAM_ATTR pm_lock_acquire(int lock)
+{
+	pm_lock_t* lp;
+
+	if ((lock < 0) || (lock >= PM_NUM_LOCKS)) return;
+	lp = &locks[lock];
+
+	portENTER_CRITICAL_SAFE(&pm_spinlock);
+	if (lp->count++ == 0) {
+		lp->start_usec = esp_timer_get_time();
+		lp->stats.acquires++;
+		lp->stats.held = true;
+	}
+	portEXIT_CRITICAL_SAFE(&pm_spinlock);
+
+#ifdef CONFIG_PM_ENABLE
+	if (lp->handle != NULL) {
+		(void) esp_pm_lock_acquire(lp->handle);
+	}
+#endif
+}
+
+
+/**
+ * Release a lock - may be called from an ISR
+ */
+void IRAM_ATTR pm_lock_release(int lock)
+{
+	bool released = false;
+	uint32_t held_usec;
+	pm_lock_t* lp;
+
+	if ((lock < 0) || (lock >= PM_NUM_LOCKS)) return;
+	lp = &locks[lock];
+
+	portENTER_CRITICAL_SAFE(&pm_spinlock);
+	if (lp->count > 0) {
+		released = true;
+		if (--lp->count == 0) {
+			held_usec = (uint32_t) (esp_timer_get_time() - lp->start_usec);
+			lp->stats.total_usec += held_usec;
+			if (held_usec > lp->stats.max_usec) lp->stats.max_usec = held_usec;
+			lp->stats.held = false;
+		}
+	}
+	portEXIT_CRITICAL_SAFE(&pm_spinlock);
+
+#ifdef CONFIG_PM_ENABLE
+	if (released && (lp->handle != NULL)) {
+		(void) esp_pm_lock_release(lp->handle);
+	}
+#else
+	(void) released;
+#endif
+}
+
+
+void pm_get_lock_stats(int lock, pm_lock_stats_t* stats)
+{
+	int64_t cur_usec;
+
+	if ((lock < 0) || (lock >= PM_NUM_LOCKS)) return;
+
+	cur_usec = esp_timer_get_time();
+
+	portENTER_CRITICAL(&pm_spinlock);
+	*stats = locks[lock].stats;
+	if (locks[lock].count > 0) {
+		stats->total_usec += (uint64_t) (cur_usec - locks[lock].start_usec);
+	}
+	portEXIT_CRITICAL(&pm_spinlock);
+}
+
+
+const char* pm_get_lock_name(int lock)
+{
+	if ((lock < 0) || (lock >= PM_NUM_LOCKS)) return "";
+
+	return lock_names[lock];
+}
@@ -0,0 +1,76 @@
+/*
+ * Power management utilities
+ *
+ * Configure ESP32 dynamic frequency scaling and automatic light sleep and manage
+ * the named locks that hold the system out of its low power states while SPI DMA,
+ * Wi-Fi or a web session is active.  Every lock keeps acquire counts and hold times
+ * so the policy can be checked (on hardware or on a host build without esp_pm).
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef PM_UTILITIES_H
+#define PM_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// PM Utilities constants
+//
+
+// CPU frequency limits (MHz) - the CPU runs at the minimum whenever no lock requires more
+#define PM_MAX_CPU_FREQ_MHZ      240
+#define PM_MIN_CPU_FREQ_MHZ      80
+
+// Set false to only use frequency scaling
+#define PM_LIGHT_SLEEP_ENABLE    true
+
+// Locks
+//   SPI  - Accounting for LCD SPI DMA transactions in flight (spi_master holds the APB lock)
+//   WIFI - No light sleep while the radio must stay up (AP mode)
+//   WEB  - CPU at maximum while a web client is connected
+#define PM_LOCK_SPI              0
+#define PM_LOCK_WIFI             1
+#define PM_LOCK_WEB              2
+#define PM_NUM_LOCKS             3
+
+
+
+//
+// PM Utilities typedefs
+//
+typedef struct {
+	uint32_t acquires;                 // Times the lock went from released to held
+	uint32_t max_usec;                 // Longest single hold
+	uint64_t total_usec;               // Total held time (including a hold in progress)
+	bool held;
+} pm_lock_stats_t;
+
+
+
+//
+// PM Utilities API
+//
+bool pm_init();
+bool pm_enabled();
+void pm_lock_acquire(int lock);
+void pm_lock_release(int lock);
+void pm_get_lock_stats(int lock, pm_lock_stats_t* stats);
+const char* pm_get_lock_name(int lock);
+
+#endif /* PM_UTILITIES_H */
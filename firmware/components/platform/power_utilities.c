@@ -23,6 +23,7 @@
  */
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "gcore.h"
@@ -30,6 +31,16 @@
 #include "system_config.h"
 
 
+//
+// Power Utilities typedefs
+//
+typedef struct {
+	uint16_t mv;
+	uint8_t percent;
+} soc_curve_entry_t;
+
+
+
 //
 // Power Utilities variables
 //
@@ -45,21 +56,50 @@ static bool power_long_btn_pressed;
 static bool sdcard_present;
 static SemaphoreHandle_t status_mutex;
 
-// Averaging arrays
+// Averaging arrays and their running sums
 static uint16_t batt_average_array[BATT_NUM_AVG_SAMPLES];
 static uint16_t load_average_array[POWER_AUX_AVG_SAMPLES];
 static uint16_t vusb_average_array[POWER_AUX_AVG_SAMPLES];
 static uint16_t lusb_average_array[POWER_AUX_AVG_SAMPLES];
+static uint32_t batt_average_sum;
+static uint32_t load_average_sum;
+static uint32_t vusb_average_sum;
+static uint32_t lusb_average_sum;
 static int batt_average_index;
 static int aux_average_index;
 
+// State-of-charge estimator
+static float soc_mah;
+static int64_t soc_prev_usec;
+
+// Resting (open-circuit) voltage to state-of-charge curve for a typical LiPo cell
+static const soc_curve_entry_t soc_curve[] = {
+	{4200, 100},
+	{4110, 90},
+	{4020, 80},
+	{3950, 70},
+	{3870, 60},
+	{3840, 50},
+	{3800, 40},
+	{3770, 30},
+	{3730, 20},
+	{3690, 10},
+	{3610, 5},
+	{3270, 0}
+};
+
+#define SOC_CURVE_LEN (sizeof(soc_curve) / sizeof(soc_curve_entry_t))
+
 
 
 //
 // Power Utilities Forward Declarations for internal functions
 //
 static enum CHARGE_STATE_t gpio_to_charge_state(uint8_t reg);
-static enum BATT_STATE_t batt_mv_to_level(uint16_t mv);
+static enum BATT_STATE_t batt_to_level(uint16_t mv, uint8_t percent);
+static float _power_mv_to_soc(uint16_t mv);
+static void _power_update_soc(uint16_t mv, uint16_t il, uint16_t vu, uint16_t iu, uint16_t il_avg);
+static void _power_status_done(const gcore_snapshot_t* snap);
 
 
 
@@ -68,8 +108,9 @@ static enum BATT_STATE_t batt_mv_to_level(uint16_t mv);
 //
 bool power_init()
 {
+	int i;
 	uint8_t t8;
-	uint16_t t16;
+	gcore_snapshot_t snap;
 	
 	// Create our mutex
 	status_mutex = xSemaphoreCreateMutex();
@@ -90,56 +131,45 @@ bool power_init()
 		return false;
 	}
 	
-	// Get initial charge and battery voltage
-	if (!gcore_get_reg8(GCORE_REG_GPIO, &t8)) {
-		ESP_LOGE(TAG, "Could not read GPIO register");
+	// Get initial charge, battery voltage and auxiliary power information
+	if (!gcore_get_snapshot(&snap, 0)) {
+		ESP_LOGE(TAG, "Could not read status snapshot");
 		return false;
 	}
-	batt_status.charge_state = gpio_to_charge_state(t8);
-	sdcard_present = (t8 & GCORE_GPIO_SD_CARD_MASK) == GCORE_GPIO_SD_CARD_MASK;
+	batt_status.charge_state = gpio_to_charge_state(snap.gpio);
+	sdcard_present = (snap.gpio & GCORE_GPIO_SD_CARD_MASK) == GCORE_GPIO_SD_CARD_MASK;
 	
-	if (!gcore_get_reg16(GCORE_REG_VB, &t16)) {
-		ESP_LOGE(TAG, "Could not read battery voltage");
-		return false;
-	}
-	for (t8=0; t8<BATT_NUM_AVG_SAMPLES; t8++) {
-		batt_average_array[t8] = t16;
+	for (i=0; i<BATT_NUM_AVG_SAMPLES; i++) {
+		batt_average_array[i] = snap.vb;
 	}
+	batt_average_sum = (uint32_t) snap.vb * BATT_NUM_AVG_SAMPLES;
 	batt_average_index = 0;
-	batt_status.batt_voltage = (float) t16 / 1000.0;
-	batt_status.batt_state = batt_mv_to_level(t16);
+	batt_status.batt_voltage = (float) snap.vb / 1000.0;
 	
-	// Get auxiliary power information
-	if (!gcore_get_reg16(GCORE_REG_IL, &t16)) {
-		ESP_LOGE(TAG, "Could not read system load");
-		return false;
-	}
-	for (t8=0; t8<POWER_AUX_AVG_SAMPLES; t8++) {
-		load_average_array[t8] = t16;
+	for (i=0; i<POWER_AUX_AVG_SAMPLES; i++) {
+		load_average_array[i] = snap.il;
+		vusb_average_array[i] = snap.vu;
+		lusb_average_array[i] = snap.iu;
 	}
-	batt_status.load_ma = t16;
+	load_average_sum = (uint32_t) snap.il * POWER_AUX_AVG_SAMPLES;
+	vusb_average_sum = (uint32_t) snap.vu * POWER_AUX_AVG_SAMPLES;
+	lusb_average_sum = (uint32_t) snap.iu * POWER_AUX_AVG_SAMPLES;
 	
-	if (!gcore_get_reg16(GCORE_REG_VU, &t16)) {
-		ESP_LOGE(TAG, "Could not read VUSB");
-		return false;
-	}
-	for (t8=0; t8<POWER_AUX_AVG_SAMPLES; t8++) {
-		vusb_average_array[t8] = t16;
-	}
-	batt_status.usb_voltage = (float) t16 / 1000.0;
+	// Seed the state-of-charge from the voltage curve (compensated for the load)
+	soc_mah = _power_mv_to_soc(snap.vb + (uint16_t) (((uint32_t) snap.il * BATT_INT_RESISTANCE_MOHM) / 1000)) *
+	          BATT_CAPACITY_MAH / 100.0;
+	soc_prev_usec = esp_timer_get_time();
+	batt_status.soc_percent = (uint8_t) (soc_mah * 100.0 / BATT_CAPACITY_MAH + 0.5);
+	batt_status.tte_min = POWER_TTE_UNKNOWN;
+	batt_status.batt_state = batt_to_level(snap.vb, batt_status.soc_percent);
 	
-	if (!gcore_get_reg16(GCORE_REG_IU, &t16)) {
-		ESP_LOGE(TAG, "Could not read IUSB");
-		return false;
-	}
-	for (t8=0; t8<POWER_AUX_AVG_SAMPLES; t8++) {
-		lusb_average_array[t8] = t16;
-	}
-	batt_status.usb_ma = t16;
+	batt_status.load_ma = snap.il;
+	batt_status.usb_voltage = (float) snap.vu / 1000.0;
+	batt_status.usb_ma = snap.iu;
 	aux_average_index = 0;
 	
-	// Read STATUS register to clear power-on button press
-	(void) gcore_get_reg8(GCORE_REG_STATUS, &t8);
+	// Discard the power-on button press latched in the STATUS register
+	gcore_clear_snapshot_status(GCORE_ST_PB_PRESS_MASK);
 	btn_down = false;
 	btn_prev = false;
 	power_short_btn_pressed = false;
@@ -158,98 +188,80 @@ void power_set_brightness(int percent)
 	
 	pwm_val = percent * 255 / 255;
 	
-	(void) gcore_set_reg8(GCORE_REG_BL, pwm_val);
+	(void) gcore_set_reg8_async(GCORE_REG_BL, pwm_val);
 }
 
 
 void power_batt_update()
 {
-	int i;
-	uint16_t mv[2] = {0, 0};
-	uint16_t ma[2] = {0, 0};
-	uint32_t sum = 0;
-	
-	// Update voltages and currents - assume, at this point, gCore accesses are working
-	if (gcore_get_reg16(GCORE_REG_VB, &mv[0])) {
-		batt_average_array[batt_average_index] = mv[0];
-		if (++batt_average_index == BATT_NUM_AVG_SAMPLES) batt_average_index = 0;
-		
-		// Compute the battery voltage average mV
-		for (i=0; i<BATT_NUM_AVG_SAMPLES; i++) {
-			sum += batt_average_array[i];
-		}
-		mv[0] = sum / BATT_NUM_AVG_SAMPLES;
-	}
+	int32_t net_ma;
+	uint8_t percent;
+	uint16_t mv[2];
+	uint16_t ma[2];
+	uint16_t tte;
+	gcore_snapshot_t snap;
 	
-	(void) gcore_get_reg16(GCORE_REG_IL, &ma[0]);
-	load_average_array[aux_average_index] = ma[0];
-	sum = 0;
-	for (i=0; i<POWER_AUX_AVG_SAMPLES; i++) {
-		sum += load_average_array[i];
+	// Update voltages and currents from a recent snapshot (power_status_update keeps
+	// it fresh) - assume, at this point, gCore accesses are working
+	if (!gcore_get_snapshot(&snap, POWER_SNAPSHOT_MAX_AGE_MSEC)) {
+		return;
 	}
-	ma[0] = sum / POWER_AUX_AVG_SAMPLES;
 	
-	(void) gcore_get_reg16(GCORE_REG_VU, &mv[1]);
-	vusb_average_array[aux_average_index] = mv[1];
-	sum = 0;
-	for (i=0; i<POWER_AUX_AVG_SAMPLES; i++) {
-		sum += vusb_average_array[i];
+	// Update the moving averages (replace the oldest sample in each running sum)
+	batt_average_sum += snap.vb - batt_average_array[batt_average_index];
+	batt_average_array[batt_average_index] = snap.vb;
+	if (++batt_average_index == BATT_NUM_AVG_SAMPLES) batt_average_index = 0;
+	mv[0] = batt_average_sum / BATT_NUM_AVG_SAMPLES;
+	
+	load_average_sum += snap.il - load_average_array[aux_average_index];
+	load_average_array[aux_average_index] = snap.il;
+	ma[0] = load_average_sum / POWER_AUX_AVG_SAMPLES;
+	
+	vusb_average_sum += snap.vu - vusb_average_array[aux_average_index];
+	vusb_average_array[aux_average_index] = snap.vu;
+	mv[1] = vusb_average_sum / POWER_AUX_AVG_SAMPLES;
+	
+	lusb_average_sum += snap.iu - lusb_average_array[aux_average_index];
+	lusb_average_array[aux_average_index] = snap.iu;
+	ma[1] = lusb_average_sum / POWER_AUX_AVG_SAMPLES;
+	if (++aux_average_index == POWER_AUX_AVG_SAMPLES) aux_average_index = 0;
+	
+	// Update the state-of-charge estimate
+	if (gpio_to_charge_state(snap.gpio) == CHARGE_DONE) {
+		soc_mah = BATT_CAPACITY_MAH;
+		soc_prev_usec = esp_timer_get_time();
+	} else {
+		_power_update_soc(snap.vb, snap.il, snap.vu, snap.iu, ma[0]);
 	}
-	mv[1] = sum / POWER_AUX_AVG_SAMPLES;
+	percent = (uint8_t) (soc_mah * 100.0 / BATT_CAPACITY_MAH + 0.5);
 	
-	(void) gcore_get_reg16(GCORE_REG_IU, &ma[1]);
-	lusb_average_array[aux_average_index] = ma[1];
-	sum = 0;
-	for (i=0; i<POWER_AUX_AVG_SAMPLES; i++) {
-		sum += lusb_average_array[i];
+	// Time-to-empty from the average battery current
+	net_ma = (int32_t) ma[1] - (int32_t) ma[0];
+	if (net_ma < -POWER_MIN_DISCHG_MA) {
+		tte = (uint16_t) ((soc_mah * 60.0) / (float) (-net_ma));
+	} else {
+		tte = POWER_TTE_UNKNOWN;
 	}
-	ma[1] = sum / POWER_AUX_AVG_SAMPLES;
-	if (++aux_average_index == POWER_AUX_AVG_SAMPLES) aux_average_index = 0;
 	
 	xSemaphoreTake(status_mutex, portMAX_DELAY);
 	batt_status.batt_voltage = (float) mv[0] / 1000.0;
 	batt_status.load_ma = ma[0];
 	batt_status.usb_voltage = (float) mv[1] / 1000.0;
 	batt_status.usb_ma = ma[1];
-	batt_status.batt_state = batt_mv_to_level(mv[0]);
+	batt_status.soc_percent = percent;
+	batt_status.tte_min = tte;
+	batt_status.batt_state = batt_to_level(mv[0], percent);
 	xSemaphoreGive(status_mutex);
 }
 
 
+/**
+ * Start a status snapshot read.  The results are processed by _power_status_done when
+ * the read completes so the caller isn't blocked while it is in flight.
+ */
 void power_status_update()
 {
-	bool btn = false;
-	bool btn_short_pressed = false;
-	bool btn_long_pressed = false;
-	bool sdcard = false;
-	enum CHARGE_STATE_t cs = CHARGE_OFF;
-	uint8_t t8;
-	
-	// Update sd card present
-	if (gcore_get_reg8(GCORE_REG_GPIO, &t8)) {
-		btn = (t8 & GCORE_GPIO_PWR_BTN_MASK) == GCORE_GPIO_PWR_BTN_MASK;
-		cs = gpio_to_charge_state(t8);
-		sdcard = (t8 & GCORE_GPIO_SD_CARD_MASK) == GCORE_GPIO_SD_CARD_MASK;
-		
-		btn_short_pressed = btn_down && !btn;
-		btn_down = btn && btn_prev;
-		btn_prev = btn;
-	} else {
-		btn_down = false;
-		btn_prev = false;
-	}
-	
-	// Update button press state
-	if (gcore_get_reg8(GCORE_REG_STATUS, &t8)) {
-		btn_long_pressed = (t8 & GCORE_ST_PB_PRESS_MASK);
-	}
-	
-	xSemaphoreTake(status_mutex, portMAX_DELAY);
-	batt_status.charge_state = cs;
-	power_short_btn_pressed = btn_short_pressed && !btn_long_pressed;
-	power_long_btn_pressed = btn_long_pressed;
-	sdcard_present = sdcard;
-	xSemaphoreGive(status_mutex);
+	(void) gcore_request_snapshot(_power_status_done);
 }
 
 
@@ -260,6 +272,8 @@ void power_get_batt(batt_status_t* bs)
 	bs->load_ma = batt_status.load_ma;
 	bs->usb_voltage = batt_status.usb_voltage;
 	bs->usb_ma = batt_status.usb_ma;
+	bs->soc_percent = batt_status.soc_percent;
+	bs->tte_min = batt_status.tte_min;
 	bs->batt_state = batt_status.batt_state;
 	bs->charge_state = batt_status.charge_state;
 	xSemaphoreGive(status_mutex);
@@ -339,18 +353,109 @@ static enum CHARGE_STATE_t gpio_to_charge_state(uint8_t reg)
 }
 
 
-static enum BATT_STATE_t batt_mv_to_level(uint16_t mv)
+/**
+ * Called from the i2c task when a status snapshot completes.  Button presses are held
+ * until read by power_short_button_pressed() or power_long_button_pressed().
+ */
+static void _power_status_done(const gcore_snapshot_t* snap)
+{
+	bool btn = false;
+	bool btn_short_pressed = false;
+	bool btn_long_pressed = false;
+	bool sdcard = false;
+	enum CHARGE_STATE_t cs = CHARGE_OFF;
+	
+	if (snap != NULL) {
+		// Update sd card present
+		btn = (snap->gpio & GCORE_GPIO_PWR_BTN_MASK) == GCORE_GPIO_PWR_BTN_MASK;
+		cs = gpio_to_charge_state(snap->gpio);
+		sdcard = (snap->gpio & GCORE_GPIO_SD_CARD_MASK) == GCORE_GPIO_SD_CARD_MASK;
+		
+		btn_short_pressed = btn_down && !btn;
+		btn_down = btn && btn_prev;
+		btn_prev = btn;
+		
+		// Update button press state
+		btn_long_pressed = (snap->status & GCORE_ST_PB_PRESS_MASK);
+		gcore_clear_snapshot_status(GCORE_ST_PB_PRESS_MASK);
+	} else {
+		btn_down = false;
+		btn_prev = false;
+	}
+	
+	xSemaphoreTake(status_mutex, portMAX_DELAY);
+	if (snap != NULL) {
+		batt_status.charge_state = cs;
+		sdcard_present = sdcard;
+	}
+	if (btn_short_pressed && !btn_long_pressed) power_short_btn_pressed = true;
+	if (btn_long_pressed) power_long_btn_pressed = true;
+	xSemaphoreGive(status_mutex);
+}
+
+
+static enum BATT_STATE_t batt_to_level(uint16_t mv, uint8_t percent)
 {
 	enum BATT_STATE_t bs;
 	float bv = (float) mv / 1000.0;
 	
-	// Set the battery state
-	if (bv <= BATT_CRIT_THRESHOLD) bs = BATT_CRIT;
-	else if (bv <= BATT_0_THRESHOLD) bs = BATT_0;
-	else if (bv <= BATT_25_THRESHOLD) bs = BATT_25;
-	else if (bv <= BATT_50_THRESHOLD) bs = BATT_50;
-	else if (bv <= BATT_75_THRESHOLD) bs = BATT_75;
+	// Set the battery state (critical is always based on the measured voltage)
+	if (bv <= BATT_CRIT_THRESHOLD_V) bs = BATT_CRIT;
+	else if (percent <= BATT_0_THRESHOLD_PCT) bs = BATT_0;
+	else if (percent <= BATT_25_THRESHOLD_PCT) bs = BATT_25;
+	else if (percent <= BATT_50_THRESHOLD_PCT) bs = BATT_50;
+	else if (percent <= BATT_75_THRESHOLD_PCT) bs = BATT_75;
 	else bs = BATT_100;
 	
 	return bs;
 }
+
+
+/**
+ * Interpolate the resting voltage curve.  Returns percent.
+ */
+static float _power_mv_to_soc(uint16_t mv)
+{
+	int i;
+	
+	if (mv >= soc_curve[0].mv) return 100.0;
+	
+	for (i=1; i<SOC_CURVE_LEN; i++) {
+		if (mv >= soc_curve[i].mv) {
+			return soc_curve[i].percent + (float) (soc_curve[i-1].percent - soc_curve[i].percent) *
+			       (mv - soc_curve[i].mv) / (soc_curve[i-1].mv - soc_curve[i].mv);
+		}
+	}
+	
+	return 0.0;
+}
+
+
+/**
+ * Integrate the battery current (USB input less the load) into the coulomb count and,
+ * when the battery is at rest, nudge the count toward the load-compensated voltage curve
+ * to cancel accumulated integration error.
+ */
+static void _power_update_soc(uint16_t mv, uint16_t il, uint16_t vu, uint16_t iu, uint16_t il_avg)
+{
+	int64_t now;
+	float hours;
+	float ocv_mah;
+	uint16_t ocv_mv;
+	
+	now = esp_timer_get_time();
+	hours = (float) (now - soc_prev_usec) / 3600000000.0;
+	soc_prev_usec = now;
+	
+	soc_mah += ((float) iu - (float) il) * hours;
+	
+	if ((vu < POWER_USB_PRESENT_MV) &&
+	    (il <= (il_avg + POWER_REST_MA_DELTA)) && ((il + POWER_REST_MA_DELTA) >= il_avg)) {
+		ocv_mv = mv + (uint16_t) (((uint32_t) il * BATT_INT_RESISTANCE_MOHM) / 1000);
+		ocv_mah = _power_mv_to_soc(ocv_mv) * BATT_CAPACITY_MAH / 100.0;
+		soc_mah += (ocv_mah - soc_mah) * POWER_SOC_CORR_GAIN;
+	}
+	
+	if (soc_mah < 0) soc_mah = 0;
+	if (soc_mah > BATT_CAPACITY_MAH) soc_mah = BATT_CAPACITY_MAH;
+}
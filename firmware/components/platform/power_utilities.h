@@ -35,10 +35,25 @@
 // Power button press duration for power-on/off
 #define POWER_BUTTON_DUR_MSEC 1000
 
+// Maximum age of the gCore snapshot used for battery updates (mSec)
+#define POWER_SNAPSHOT_MAX_AGE_MSEC 100
+
 // Averaging sample counts
 #define BATT_NUM_AVG_SAMPLES  16
 #define POWER_AUX_AVG_SAMPLES 8
 
+// State-of-charge estimator
+//   The coulomb count is only corrected toward the voltage curve when the battery is
+//   at rest: no USB power and the load within POWER_REST_MA_DELTA of its average.
+//   Each correction moves the count POWER_SOC_CORR_GAIN of the way to the curve.
+#define POWER_USB_PRESENT_MV  4000
+#define POWER_REST_MA_DELTA   10
+#define POWER_SOC_CORR_GAIN   0.002
+#define POWER_MIN_DISCHG_MA   5
+
+// Time-to-empty value when the battery isn't discharging
+#define POWER_TTE_UNKNOWN     0xFFFF
+
 
 
 //
@@ -65,6 +80,8 @@ typedef struct {
 	float usb_voltage;
 	uint16_t load_ma;
 	uint16_t usb_ma;
+	uint8_t soc_percent;               // Estimated state-of-charge
+	uint16_t tte_min;                  // Estimated time-to-empty or POWER_TTE_UNKNOWN
 	enum BATT_STATE_t batt_state;
 	enum CHARGE_STATE_t charge_state;
 } batt_status_t;
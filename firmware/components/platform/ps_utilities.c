@@ -4,6 +4,21 @@
  * Manage the persistent storage kept in the gCore EFM8 RAM and provide access
  * routines to it.
  *
+ * Settings are stored as key/length/value records described by a compile-time schema.
+ * Each schema entry maps a stable one-byte key to a field in one of the config structs
+ * along with its default value.  Strings are stored at their actual length.  A record
+ * whose length is unchanged is updated in place, otherwise it is marked deleted and
+ * appended at the end of the store.  The store is compacted when it fills.  An index
+ * from key to record address is built at boot.  Adding a setting only requires adding
+ * its struct field and a schema entry with a new key; existing records are untouched
+ * and the new record is appended with its default value on the first boot.
+ *
+ * The decoded configs are published to readers with a per-config seqlock so readers
+ * never see a partially updated struct and can cheaply check a config's generation
+ * (incremented on each change) to copy it only when it has changed.  Tasks may also
+ * subscribe to a task notification when a config changes.  Changes take effect in
+ * memory immediately while NVRAM writes are deferred and coalesced by the commit task.
+ *
  * Copyright 2024-2025 Dan Julio
  *
  * This program is free software: you can redistribute it and/or modify
@@ -25,10 +40,15 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "gcore.h"
+#include "tzdb.h"
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 
@@ -42,41 +62,144 @@
 
 // Layout version - to allow future firmware versions to change the layout without
 // losing data
-#define PS_LAYOUT_VERSION      1 
+//   1 - Fixed config structs, additive 8-bit checksum in the last byte
+//   2 - Fixed config structs, CRC-16 in the last two bytes
+//   3 - Key/length/value records, CRC-16 in the last two bytes
+//   4 - Version 3 records in a larger store
+#define PS_LAYOUT_VERSION      4
+#define PS_LAYOUT_VERSION_V1   1
+#define PS_LAYOUT_VERSION_V2   2
+#define PS_LAYOUT_VERSION_V3   3
+
+// Store size used by layout versions 1-3
+#define PS_V3_RAM_SIZE         320
+
+// Configs stored by the fixed struct layouts (versions 1 and 2)
+#define PS_NUM_FIXED_CONFIGS   3
 
 // Static Memory Array indicies
 #define PS_MAGIC_WORD_0_ADDR   0
 #define PS_MAGIC_WORD_1_ADDR   1
 #define PS_LAYOUT_VERSION_ADDR 2
 #define PS_FIRST_DATA_ADDR     3
-#define PS_CHECKSUM_ADDR       (PS_RAM_SIZE - 1)
+#define PS_CRC_ADDR            (PS_RAM_SIZE - 2)
+#define PS_V3_CRC_ADDR         (PS_V3_RAM_SIZE - 2)
+#define PS_V1_CHECKSUM_ADDR    (PS_V3_RAM_SIZE - 1)
+
+// Maximum bytes available for records
+#define PS_MAX_DATA_BYTES      (PS_CRC_ADDR - PS_FIRST_DATA_ADDR)
+
+// Record format: key, value length, value
+#define PS_RECORD_HDR_LEN      2
+
+// Special keys
+#define PS_KEY_DELETED         0x00
+#define PS_KEY_END             0xFF
 
-// Maximum bytes available for storage
-#define PS_MAX_DATA_BYTES      (PS_RAM_SIZE - 4)
+// Setting keys - must never be changed or reused once released
+#define PS_KEY_HOUR_MODE_24    0x01
+#define PS_KEY_LCD_BRIGHTNESS  0x02
+#define PS_KEY_MDNS_EN         0x10
+#define PS_KEY_STA_MODE        0x11
+#define PS_KEY_STA_STATIC_IP   0x12
+#define PS_KEY_AP_SSID         0x13
+#define PS_KEY_STA_SSID        0x14
+#define PS_KEY_AP_PW           0x15
+#define PS_KEY_STA_PW          0x16
+#define PS_KEY_AP_IP_ADDR      0x17
+#define PS_KEY_STA_IP_ADDR     0x18
+#define PS_KEY_STA_NETMASK     0x19
+#define PS_KEY_TZ_RULE         0x20    // Retired - POSIX rule converted to PS_KEY_TZ_ID
+#define PS_KEY_TZ_ID           0x21
+#define PS_KEY_RTC_OFFSET      0x30
+#define PS_KEY_RTC_REBASE      0x31
+#define PS_KEY_RTC_PAIRS       0x32
+#define PS_KEY_RTC_FIT_START   0x33
+#define PS_KEY_RTC_FIT_END     0x34
+#define PS_KEY_RTC_FIT_ERR     0x35
+#define PS_KEY_RTC_DRIFT       0x36
+#define PS_KEY_RTC_DRIFT_SD    0x37
+#define PS_KEY_RTC_RESID       0x38
+#define PS_KEY_RTC_WEEK_ERR    0x39
+#define PS_KEY_ALARMS          0x40
+
+// Value types
+#define PS_TYPE_FIXED          0
+#define PS_TYPE_STR            1
+
+// Seqlock read attempts before a reader sleeps to let a preempted writer finish
+#define PS_SEQ_SPIN_LIMIT      100
+
+// Commit task notifications
+#define PS_NOTIFY_CHANGE       0x00000001
+#define PS_NOTIFY_COMMIT_NOW   0x00000002
+#define PS_NOTIFY_WRITE        0x00000004
+
+// Unchanged bytes between modified spans shorter than this are written along with
+// the spans rather than starting a new I2C transfer (each costs 3 address bytes plus
+// transaction overhead)
+#define PS_SPAN_MERGE_GAP      8
 
 
 //
-// PS Utilities enums and structs
+// PS Utilities typedefs
 //
 
-enum ps_update_types_t {
-	FULL,                      // Update all bytes in the external SRAM
-	GUI,                       // Update GUI state related and checksum
-	NET,                       // Update network state related and checksum
-	TZ                         // Update timezone state and checksum
-};
+// Schema entry.  For strings len is the maximum string length (the struct field also
+// holds a terminator which is not stored).
+typedef struct {
+	uint8_t key;
+	uint8_t config;            // PS_CONFIG_TYPE_xxx
+	uint8_t type;              // PS_TYPE_xxx
+	uint8_t len;
+	uint16_t offset;           // Offset of the field in the config struct
+	const void* dflt;          // Default value (NULL for zero/empty)
+} ps_schema_entry_t;
+
+#define PS_FIELD(k, c, s, f, d) {k, c, PS_TYPE_FIXED, sizeof(((s*)0)->f), offsetof(s, f), d}
+#define PS_STR(k, c, s, f, d)   {k, c, PS_TYPE_STR, sizeof(((s*)0)->f) - 1, offsetof(s, f), d}
 
 
 //
-// Persistent Storage data structures - data stored in battery backed RAM
-// Note: Careful attention must be paid to make sure these are packed structures
+// PS Utilities schema
 //
+static const bool ps_def_true = true;
+static const bool ps_def_hour_mode_24 = PS_DEFAULT_HOUR_MODE_24;
+static const uint8_t ps_def_backlight = PS_DEFAULT_BACKLIGHT;
 
-// PS pointers into the shadow buffer for parameter sub-regions
-typedef struct {
-	uint8_t start_index[PS_NUM_CONFIGS];
-	uint8_t length[PS_NUM_CONFIGS];
-} ps_sub_region_t;
+// IP addresses are stored least significant byte first (match espressif defaults)
+static const uint8_t ps_def_ap_ip_addr[4] = {1, 4, 168, 192};
+static const uint8_t ps_def_sta_ip_addr[4] = {2, 4, 168, 192};
+static const uint8_t ps_def_sta_netmask[4] = {0, 255, 255, 255};
+
+static const ps_schema_entry_t ps_schema[] = {
+	PS_FIELD(PS_KEY_HOUR_MODE_24,   PS_CONFIG_TYPE_GUI, gui_config_t, hour_mode_24,   &ps_def_hour_mode_24),
+	PS_FIELD(PS_KEY_LCD_BRIGHTNESS, PS_CONFIG_TYPE_GUI, gui_config_t, lcd_brightness, &ps_def_backlight),
+	PS_FIELD(PS_KEY_MDNS_EN,        PS_CONFIG_TYPE_NET, net_config_t, mdns_en,        &ps_def_true),
+	PS_FIELD(PS_KEY_STA_MODE,       PS_CONFIG_TYPE_NET, net_config_t, sta_mode,       NULL),
+	PS_FIELD(PS_KEY_STA_STATIC_IP,  PS_CONFIG_TYPE_NET, net_config_t, sta_static_ip,  NULL),
+	PS_STR(  PS_KEY_AP_SSID,        PS_CONFIG_TYPE_NET, net_config_t, ap_ssid,        NULL),   // Set from MAC
+	PS_STR(  PS_KEY_STA_SSID,       PS_CONFIG_TYPE_NET, net_config_t, sta_ssid,       NULL),
+	PS_STR(  PS_KEY_AP_PW,          PS_CONFIG_TYPE_NET, net_config_t, ap_pw,          NULL),
+	PS_STR(  PS_KEY_STA_PW,         PS_CONFIG_TYPE_NET, net_config_t, sta_pw,         NULL),
+	PS_FIELD(PS_KEY_AP_IP_ADDR,     PS_CONFIG_TYPE_NET, net_config_t, ap_ip_addr,     ps_def_ap_ip_addr),
+	PS_FIELD(PS_KEY_STA_IP_ADDR,    PS_CONFIG_TYPE_NET, net_config_t, sta_ip_addr,    ps_def_sta_ip_addr),
+	PS_FIELD(PS_KEY_STA_NETMASK,    PS_CONFIG_TYPE_NET, net_config_t, sta_netmask,    ps_def_sta_netmask),
+	PS_FIELD(PS_KEY_TZ_ID,          PS_CONFIG_TYPE_TZ,  tz_config_t,  zone_id,        NULL),   // Set from PS_DEFAULT_TZ
+	PS_FIELD(PS_KEY_RTC_OFFSET,     PS_CONFIG_TYPE_RTC, rtc_config_t, rtc_offset,     NULL),
+	PS_FIELD(PS_KEY_RTC_REBASE,     PS_CONFIG_TYPE_RTC, rtc_config_t, rebase,         NULL),
+	PS_FIELD(PS_KEY_RTC_PAIRS,      PS_CONFIG_TYPE_RTC, rtc_config_t, pairs,          NULL),
+	PS_FIELD(PS_KEY_RTC_FIT_START,  PS_CONFIG_TYPE_RTC, rtc_config_t, fit_start,      NULL),
+	PS_FIELD(PS_KEY_RTC_FIT_END,    PS_CONFIG_TYPE_RTC, rtc_config_t, fit_end,        NULL),
+	PS_FIELD(PS_KEY_RTC_FIT_ERR,    PS_CONFIG_TYPE_RTC, rtc_config_t, fit_err_msec,   NULL),
+	PS_FIELD(PS_KEY_RTC_DRIFT,      PS_CONFIG_TYPE_RTC, rtc_config_t, drift_ppb,      NULL),
+	PS_FIELD(PS_KEY_RTC_DRIFT_SD,   PS_CONFIG_TYPE_RTC, rtc_config_t, drift_sd_ppb,   NULL),
+	PS_FIELD(PS_KEY_RTC_RESID,      PS_CONFIG_TYPE_RTC, rtc_config_t, resid_msec,     NULL),
+	PS_FIELD(PS_KEY_RTC_WEEK_ERR,   PS_CONFIG_TYPE_RTC, rtc_config_t, week_err_msec,  NULL),
+	PS_FIELD(PS_KEY_ALARMS,         PS_CONFIG_TYPE_ALARM, alarm_config_t, alarm,      NULL)
+};
+
+#define PS_NUM_FIELDS (sizeof(ps_schema) / sizeof(ps_schema_entry_t))
 
 
 
@@ -85,26 +208,102 @@ typedef struct {
 //
 static const char* TAG = "ps_utilities";
 
-// Our local copy for reading
+// Our copy of the NVRAM record store
 static uint8_t ps_shadow_buffer[PS_RAM_SIZE];
 
-// Copy read at boot to check for changes (and flash update)
-static uint8_t ps_check_buffer[PS_RAM_SIZE];
+// Decoded configs
+static gui_config_t ps_gui_config;
+static net_config_t ps_net_config;
+static tz_config_t ps_tz_config;
+static rtc_config_t ps_rtc_config;
+static alarm_config_t ps_alarm_config;
+
+static void* const ps_config_ptr[PS_NUM_CONFIGS] = {
+	&ps_gui_config,
+	&ps_net_config,
+	&ps_tz_config,
+	&ps_rtc_config,
+	&ps_alarm_config
+};
+
+static const uint16_t ps_config_len[PS_NUM_CONFIGS] = {
+	sizeof(gui_config_t),
+	sizeof(net_config_t),
+	sizeof(tz_config_t),
+	sizeof(rtc_config_t),
+	sizeof(alarm_config_t)
+};
+
+// Per-config sequence counter (odd while a config is being updated, generation = seq/2)
+static atomic_uint ps_config_seq[PS_NUM_CONFIGS];
+static portMUX_TYPE ps_seq_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// Serializes writers (the record store and NVRAM updates)
+static SemaphoreHandle_t ps_mutex;
+
+// Change subscriptions
+typedef struct {
+	int index;
+	TaskHandle_t task;
+	uint32_t notify_mask;
+} ps_subscriber_t;
+
+static ps_subscriber_t ps_subscribers[PS_MAX_SUBSCRIBERS];
+static int ps_num_subscribers = 0;
 
-// Indexes of and lengths of the parameter sub-regions
-static ps_sub_region_t ps_sub_regions;
+// Index - schema entry for each key and the shadow buffer address of each entry's
+// record (0 if not present)
+static uint8_t ps_key_map[256];
+static uint16_t ps_record_addr[PS_NUM_FIELDS];
+
+// Address of the first free byte after the last record
+static uint16_t ps_end_addr;
+
+// Set when NVRAM has been modified since it was last saved to flash
+static volatile bool ps_flash_dirty = false;
+
+// Configs changed in memory but not yet written to NVRAM (bit per config index)
+static volatile uint32_t ps_nvram_pending = 0;
+
+// Flash commit scheduling
+static TaskHandle_t commit_task_handle = NULL;
+static volatile int commit_state = PS_COMMIT_IDLE;
+static ps_commit_stats_t commit_stats;
+static portMUX_TYPE commit_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
 
 
 //
 // PS Utilities Forward Declarations for internal functions
 //
+static void _ps_commit_task(void* args);
+static bool _ps_commit();
+static bool _ps_flush_nvram();
+static void _ps_note_change();
+static uint32_t _ps_read_config(int index, void* cfg);
+static void _ps_publish_config(int index, const void* cfg);
+static void _ps_notify_subscribers(int index);
 static bool _ps_read_array();
-static bool _ps_write_array(enum ps_update_types_t t);
-static void _ps_init_config_memory(int index);
+static bool _ps_write_array();
+static bool _ps_load_store();
+static void _ps_build_store();
+static bool _ps_compact_store();
+static bool _ps_set_field(int field, const uint8_t* cfg, bool* changed);
+static bool _ps_append_record(int field, const uint8_t* val, uint8_t len);
+static void _ps_decode_record(int field, uint8_t* cfg);
+static uint8_t _ps_field_value_len(int field, const uint8_t* cfg);
+static bool _ps_update_region(uint16_t start_addr, const uint8_t* src, uint16_t len, bool* changed);
+static bool _ps_write_crc();
+static void _ps_set_crc();
+static void _ps_init_config_memory(int index, uint8_t* buf);
 static void _ps_init_array();
 static bool _ps_valid_magic_word();
-static uint8_t _ps_compute_checksum();
+static bool _ps_migrate_fixed();
+static bool _ps_migrate_v3();
+static void _ps_convert_tz_rule(const char* rule);
+static uint8_t _ps_compute_v1_checksum();
+static uint16_t _ps_compute_crc(uint16_t crc_addr);
+static uint16_t _ps_get_crc(uint16_t crc_addr);
 static bool _ps_write_bytes_to_gcore(uint16_t start_addr, uint16_t data_len);
 
 
@@ -120,26 +319,28 @@ static bool _ps_write_bytes_to_gcore(uint16_t start_addr, uint16_t data_len);
  */
 bool ps_init()
 {
-	int n;
-	
-	// Setup our access data structure
-	ps_sub_regions.start_index[PS_CONFIG_TYPE_GUI] = PS_FIRST_DATA_ADDR;
-	ps_sub_regions.length[PS_CONFIG_TYPE_GUI] = sizeof(gui_config_t);
-	n = sizeof(gui_config_t);
-	ps_sub_regions.start_index[PS_CONFIG_TYPE_NET] = ps_sub_regions.start_index[PS_CONFIG_TYPE_GUI] +
-	                                            ps_sub_regions.length[PS_CONFIG_TYPE_GUI];
-	ps_sub_regions.length[PS_CONFIG_TYPE_NET] = sizeof(net_config_t);
-	n += sizeof(net_config_t);
-	ps_sub_regions.start_index[PS_CONFIG_TYPE_TZ] = ps_sub_regions.start_index[PS_CONFIG_TYPE_NET] +
-	                                            ps_sub_regions.length[PS_CONFIG_TYPE_NET];
-	ps_sub_regions.length[PS_CONFIG_TYPE_TZ] = sizeof(tz_config_t);
-	n += sizeof(tz_config_t);
+	bool valid = true;
+	int i;
+	int n = 0;
+	
+	ps_mutex = xSemaphoreCreateMutex();
+	if (ps_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+	
+	// Build the key map and make sure the store can hold every setting at its maximum length
+	memset(ps_key_map, 0xFF, sizeof(ps_key_map));
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		ps_key_map[ps_schema[i].key] = i;
+		n += PS_RECORD_HDR_LEN + ps_schema[i].len;
+	}
 	if (n > PS_MAX_DATA_BYTES) {
 		// This should never occur - mainly for debugging
 		ESP_LOGE(TAG, "NVRAM does not have enough room for %d bytes\n", n);
 		return false;
 	} else {
-		ESP_LOGI(TAG, "Using %d of %d bytes", n, PS_MAX_DATA_BYTES);
+		ESP_LOGI(TAG, "Using at most %d of %d bytes", n, PS_MAX_DATA_BYTES);
 	}
 	
 	// Get the persistent data from the battery-backed PMIC/RTC chip
@@ -147,97 +348,132 @@ bool ps_init()
 		ESP_LOGE(TAG, "Failed to read persistent data from NVRAM");
 	}
 	
-	// Make a copy to check for changes
-	for (n=0; n<PS_RAM_SIZE; n++) {
-		ps_check_buffer[n] = ps_shadow_buffer[n];
+	// Check if it is initialized with valid data (converting an older layout), initialize if not
+	if (_ps_valid_magic_word() && (ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR] == PS_LAYOUT_VERSION) &&
+	    (_ps_compute_crc(PS_CRC_ADDR) == _ps_get_crc(PS_CRC_ADDR))) {
+		if (!_ps_load_store()) {
+			ESP_LOGE(TAG, "Corrupt record store");
+			valid = false;
+		}
+	} else {
+		valid = false;
 	}
 	
-	// Check if it is initialized with valid data, initialize if not
-	if (!_ps_valid_magic_word() || (_ps_compute_checksum() != ps_shadow_buffer[PS_CHECKSUM_ADDR])) {
-		ESP_LOGI(TAG, "Initialize persistent storage with default values");
-		_ps_init_array();
-		if (!_ps_write_array(FULL)) {
+	if (!valid) {
+		if (!_ps_migrate_fixed() && !_ps_migrate_v3()) {
+			ESP_LOGI(TAG, "Initialize persistent storage with default values");
+			_ps_init_array();
+		}
+		
+		_ps_note_change();
+		if (!_ps_write_array()) {
 			ESP_LOGE(TAG, "Failed to write persistent data to NVRAM");
 			return false;
 		}
 	}
 	
+	// Start the background flash commit task (it commits any changes made above)
+	if (xTaskCreatePinnedToCore(&_ps_commit_task, "ps_commit", PS_COMMIT_TASK_STACK, NULL,
+	                            PS_COMMIT_TASK_PRIO, &commit_task_handle, PS_COMMIT_TASK_CORE) != pdPASS) {
+		ESP_LOGE(TAG, "Could not start commit task");
+		return false;
+	}
+	
 	return true;
 }
 
 
 /**
  * Reset persistent storage to factory default values.  Store these in both the
- * battery-backed PMIC/RTC chip and backing flash (if necessary).
+ * battery-backed PMIC/RTC chip and backing flash.
  */
 void ps_set_factory_default()
 {
+	int i;
+	union {
+		gui_config_t gui;
+		net_config_t net;
+		tz_config_t tz;
+		rtc_config_t rtc;
+		alarm_config_t alarm;
+	} cfg;
+	
 	// Re-initialize persistent data and write it to battery-backed RAM
 	ESP_LOGI(TAG, "Re-initialize persistent storage with default values");
-	_ps_init_array();
-	if (!_ps_write_array(FULL)) {
+	xSemaphoreTake(ps_mutex, portMAX_DELAY);
+	for (i=0; i<PS_NUM_CONFIGS; i++) {
+		memset(&cfg, 0, sizeof(cfg));
+		_ps_init_config_memory(i, (uint8_t*) &cfg);
+		_ps_publish_config(i, &cfg);
+	}
+	_ps_build_store();
+	portENTER_CRITICAL(&commit_spinlock);
+	ps_nvram_pending = 0;
+	portEXIT_CRITICAL(&commit_spinlock);
+	_ps_note_change();
+	if (!_ps_write_array()) {
 		ESP_LOGE(TAG, "Failed to write persistent data to NVRAM");
 	}
+	xSemaphoreGive(ps_mutex);
 	
-	// Save to the PMIC/RTC flash memory (will execute only if changes are detected)
-	ps_save_to_flash();
+	for (i=0; i<PS_NUM_CONFIGS; i++) {
+		_ps_notify_subscribers(i);
+	}
+	
+	// Save to the PMIC/RTC flash memory without waiting for changes to settle
+	ps_commit_now();
 }
 
 
 /**
- * Write battery-backed RAM to flash in the PMIC/RTC if any changes are detected.
- * We perform the dirty check to avoid unnecessary flash writes.
+ * Request an immediate write of any pending changes to NVRAM and commit to flash (for
+ * example before shutdown).  Does not block - use ps_wait_commit() to wait for completion.
  */
-void ps_save_to_flash()
+void ps_commit_now()
 {
-	bool dirty_flag = false;
-	int i;
-	uint8_t reg = 1;
-	
-	// Check for any changed data since we booted indicating the need to save
-	// NVRAM to flash
-	for (i=0; i<PS_RAM_SIZE; i++) {
-		if (ps_check_buffer[i] != ps_shadow_buffer[i]) {
-			dirty_flag = true;
-			break;
+	if (commit_task_handle != NULL) {
+		xTaskNotify(commit_task_handle, PS_NOTIFY_COMMIT_NOW, eSetBits);
+	}
+}
+
+
+/**
+ * Wait up to timeout_msec for any pending or in-progress commit to complete.  Returns
+ * true if there are no uncommitted changes.
+ */
+bool ps_wait_commit(uint32_t timeout_msec)
+{
+	while (commit_state != PS_COMMIT_IDLE) {
+		if (timeout_msec < 10) {
+			return false;
 		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+		timeout_msec -= 10;
 	}
 	
-	if (dirty_flag) {
-		ESP_LOGI(TAG, "Saving NVRAM");
-		
-		// Trigger a write of the NVRAM to backing flash
-		if (gcore_set_reg8(GCORE_REG_NV_CTRL, GCORE_NVRAM_WR_TRIG)) {
-			// Wait after triggering the write
-			//   1. 36 mSec to allow the EFM8 to erase the flash memory (it is essentially
-			//      locked up while doing this and won't respond to I2C cycles).
-			//   2. 128 mSec to allow the NVRAM to be written to flash.  This isn't
-			//      strictly necessary before starting to poll for completion but since 
-			//      it's possible an I2C cycle will fail during the writing process we
-			//      wait so we don't freak anyone out who might be looking at the log
-			//      output.
-			vTaskDelay(pdMS_TO_TICKS(155));
-			
-			// Poll until write is done - this should fall through immediately
-			while (reg != 0) {
-				vTaskDelay(pdMS_TO_TICKS(10));
-				(void) gcore_get_reg8(GCORE_REG_NV_CTRL, &reg);
-			}
-			
-			// Update the check buffer
-			for (int i=0; i<PS_RAM_SIZE; i++) {
-				ps_check_buffer[i] = ps_shadow_buffer[i];
-			}
-		}
-	} 
+	return true;
+}
+
+
+int ps_get_commit_state()
+{
+	return commit_state;
+}
+
+
+void ps_get_commit_stats(ps_commit_stats_t* stats)
+{
+	portENTER_CRITICAL(&commit_spinlock);
+	*stats = commit_stats;
+	portEXIT_CRITICAL(&commit_spinlock);
 }
 
 
 bool ps_get_config(int index, void* cfg)
 {
 	if ((index >=0) && (index < PS_NUM_CONFIGS)) {
-		// Give them our local copy
-		(void) memcpy(cfg,  &ps_shadow_buffer[ps_sub_regions.start_index[index]], ps_sub_regions.length[index]);
+		// Give them a consistent copy of our local copy
+		(void) _ps_read_config(index, cfg);
 		return true;
 	} else {
 		ESP_LOGE(TAG, "Requested read of illegal config index %d", index);
@@ -246,29 +482,70 @@ bool ps_get_config(int index, void* cfg)
 }
 
 
+/**
+ * Copy the config only if its generation differs from *generation (which is then
+ * updated).  Returns true if cfg was updated.  Initialize *generation to
+ * PS_GENERATION_NONE to force the first copy.
+ */
+bool ps_get_config_if_changed(int index, void* cfg, uint32_t* generation)
+{
+	if ((index < 0) || (index >= PS_NUM_CONFIGS)) {
+		ESP_LOGE(TAG, "Requested read of illegal config index %d", index);
+		return false;
+	}
+	
+	if (ps_get_config_generation(index) == *generation) {
+		return false;
+	}
+	
+	*generation = _ps_read_config(index, cfg);
+	return true;
+}
+
+
+uint32_t ps_get_config_generation(int index)
+{
+	if ((index < 0) || (index >= PS_NUM_CONFIGS)) return 0;
+	
+	return atomic_load_explicit(&ps_config_seq[index], memory_order_acquire) >> 1;
+}
 
+
+
+/**
+ * Update a config.  The change takes effect immediately (readers and subscribers see
+ * it) while the NVRAM write is deferred to the commit task so a burst of changes (for
+ * example dragging the brightness slider) results in a single write.
+ */
 bool ps_set_config(int index, void* cfg)
 {
-	enum ps_update_types_t t;
+	bool changed;
 
 	if ((index >=0) && (index < PS_NUM_CONFIGS)) {
+		xSemaphoreTake(ps_mutex, portMAX_DELAY);
+		
 		// Update our local copy
-		(void) memcpy(&ps_shadow_buffer[ps_sub_regions.start_index[index]], cfg, ps_sub_regions.length[index]);
+		changed = (memcmp(ps_config_ptr[index], cfg, ps_config_len[index]) != 0);
+		if (changed) {
+			_ps_publish_config(index, cfg);
+			
+			portENTER_CRITICAL(&commit_spinlock);
+			ps_nvram_pending |= (1 << index);
+			if (commit_state == PS_COMMIT_IDLE) {
+				commit_state = PS_COMMIT_PENDING;
+			}
+			commit_stats.sets++;
+			portEXIT_CRITICAL(&commit_spinlock);
+		}
+		
+		xSemaphoreGive(ps_mutex);
 		
-		// Update NVRAM
-		switch (index) {
-			case PS_CONFIG_TYPE_GUI:
-				t = GUI;
-				break;
-			case PS_CONFIG_TYPE_NET:
-				t = NET;
-				break;
-			default:
-				t = TZ;
-		}
-		ps_shadow_buffer[PS_CHECKSUM_ADDR] = _ps_compute_checksum();
-		if (!_ps_write_array(t)) {
-			ESP_LOGE(TAG, "Failed to write config index %d to NVRAM", index);
+		if (changed) {
+			_ps_notify_subscribers(index);
+			
+			if (commit_task_handle != NULL) {
+				xTaskNotify(commit_task_handle, PS_NOTIFY_WRITE, eSetBits);
+			}
 		}
 		
 		return true;
@@ -279,6 +556,34 @@ bool ps_set_config(int index, void* cfg)
 }
 
 
+/**
+ * Request a task notification with notify_mask whenever the config changes
+ */
+bool ps_subscribe(int index, TaskHandle_t task, uint32_t notify_mask)
+{
+	bool ret = false;
+	
+	if ((index < 0) || (index >= PS_NUM_CONFIGS)) {
+		ESP_LOGE(TAG, "Requested subscription to illegal config index %d", index);
+		return false;
+	}
+	
+	xSemaphoreTake(ps_mutex, portMAX_DELAY);
+	if (ps_num_subscribers < PS_MAX_SUBSCRIBERS) {
+		ps_subscribers[ps_num_subscribers].index = index;
+		ps_subscribers[ps_num_subscribers].task = task;
+		ps_subscribers[ps_num_subscribers].notify_mask = notify_mask;
+		ps_num_subscribers++;
+		ret = true;
+	} else {
+		ESP_LOGE(TAG, "Too many subscribers");
+	}
+	xSemaphoreGive(ps_mutex);
+	
+	return ret;
+}
+
+
 bool ps_reinit_all()
 {
 	bool ret = true;
@@ -286,6 +591,8 @@ bool ps_reinit_all()
 	ret &= ps_reinit_config(PS_CONFIG_TYPE_GUI);
 	ret &= ps_reinit_config(PS_CONFIG_TYPE_NET);
 	ret &= ps_reinit_config(PS_CONFIG_TYPE_TZ);
+	ret &= ps_reinit_config(PS_CONFIG_TYPE_RTC);
+	ret &= ps_reinit_config(PS_CONFIG_TYPE_ALARM);
 	
 	return ret;
 }
@@ -294,29 +601,20 @@ bool ps_reinit_all()
 
 bool ps_reinit_config(int index)
 {
-	enum ps_update_types_t t;
+	union {
+		gui_config_t gui;
+		net_config_t net;
+		tz_config_t tz;
+		rtc_config_t rtc;
+		alarm_config_t alarm;
+	} cfg;
 
 	if ((index >=0) && (index < PS_NUM_CONFIGS)) {
-		// Reset default values to our local copy
-		_ps_init_config_memory(index);
+		// Build the default values and store them like any other change
+		memset(&cfg, 0, sizeof(cfg));
+		_ps_init_config_memory(index, (uint8_t*) &cfg);
 		
-		// Update NVRAM
-		switch (index) {
-			case PS_CONFIG_TYPE_GUI:
-				t = GUI;
-				break;
-			case PS_CONFIG_TYPE_NET:
-				t = NET;
-				break;
-			default:
-				t = TZ;
-		}
-		ps_shadow_buffer[PS_CHECKSUM_ADDR] = _ps_compute_checksum();
-		if (!_ps_write_array(t)) {
-			ESP_LOGE(TAG, "Failed to write config index %d to NVRAM", index);
-		}
-		
-		return true;
+		return ps_set_config(index, &cfg);
 	} else {
 		ESP_LOGE(TAG, "Requested reinit of illegal config index %d", index);
 		return false;
@@ -326,12 +624,11 @@ bool ps_reinit_config(int index)
 
 bool ps_has_new_ap_name(const char* name)
 {
-	net_config_t* net_configP;
+	net_config_t net_config;
 	
-	// Get a config-specific pointer to the data so we can parse it
-	net_configP = (net_config_t*) &ps_shadow_buffer[ps_sub_regions.start_index[PS_CONFIG_TYPE_NET]];
+	(void) _ps_read_config(PS_CONFIG_TYPE_NET, &net_config);
 	
-	return(strncmp(name, net_configP->ap_ssid, PS_SSID_MAX_LEN) != 0);
+	return(strncmp(name, net_config.ap_ssid, PS_SSID_MAX_LEN) != 0);
 }
 
 
@@ -352,145 +649,655 @@ char ps_nibble_to_ascii(uint8_t n)
 // PS Utilities internal functions
 //
 
+/**
+ * Seqlock read of a config.  Returns its generation.
+ */
+static uint32_t _ps_read_config(int index, void* cfg)
+{
+	int spins = 0;
+	unsigned int seq1, seq2;
+	
+	while (1) {
+		seq1 = atomic_load_explicit(&ps_config_seq[index], memory_order_acquire);
+		if ((seq1 & 1) == 0) {
+			memcpy(cfg, ps_config_ptr[index], ps_config_len[index]);
+			atomic_thread_fence(memory_order_acquire);
+			seq2 = atomic_load_explicit(&ps_config_seq[index], memory_order_relaxed);
+			if (seq1 == seq2) {
+				return seq1 >> 1;
+			}
+		}
+		
+		if (++spins == PS_SEQ_SPIN_LIMIT) {
+			spins = 0;
+			vTaskDelay(1);
+		}
+	}
+}
+
+
+/**
+ * Seqlock write of a config (the writer holds ps_mutex).  Done in a critical section
+ * so a reader on the same core can never observe the update in progress.
+ */
+static void _ps_publish_config(int index, const void* cfg)
+{
+	portENTER_CRITICAL(&ps_seq_spinlock);
+	atomic_fetch_add_explicit(&ps_config_seq[index], 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(ps_config_ptr[index], cfg, ps_config_len[index]);
+	atomic_fetch_add_explicit(&ps_config_seq[index], 1, memory_order_release);
+	portEXIT_CRITICAL(&ps_seq_spinlock);
+}
+
+
+static void _ps_notify_subscribers(int index)
+{
+	int i;
+	
+	for (i=0; i<ps_num_subscribers; i++) {
+		if (ps_subscribers[i].index == index) {
+			xTaskNotify(ps_subscribers[i].task, ps_subscribers[i].notify_mask, eSetBits);
+		}
+	}
+}
+
+
+/**
+ * Write changed configs to NVRAM and commit NVRAM to flash in the background.  Config
+ * changes are written once they have been quiet for PS_WRITE_QUIET_MSEC.  NVRAM changes
+ * are coalesced until they have been quiet for PS_COMMIT_QUIET_MSEC (bounded by
+ * PS_COMMIT_MAX_DELAY_MSEC) to limit wear on the EFM8 flash.  A commit request is
+ * handled immediately.
+ */
+static void _ps_commit_task(void* args)
+{
+	bool commit_requested = false;
+	int64_t last_write_usec = 0;
+	int64_t first_change_usec = 0;
+	int64_t last_change_usec = 0;
+	int64_t due_usec;
+	int64_t flash_due_usec;
+	int64_t now;
+	uint32_t notification_value;
+	TickType_t wait_ticks;
+	
+	ESP_LOGI(TAG, "Start commit task");
+	
+	// Changes made during initialization
+	if (ps_flash_dirty) {
+		first_change_usec = esp_timer_get_time();
+		last_change_usec = first_change_usec;
+	}
+	if (ps_nvram_pending != 0) {
+		last_write_usec = esp_timer_get_time();
+	}
+	
+	while (1) {
+		// Sleep until notified or until a pending write or commit is due
+		due_usec = 0;
+		if ((ps_nvram_pending != 0) && (last_write_usec != 0)) {
+			due_usec = last_write_usec + (int64_t) PS_WRITE_QUIET_MSEC * 1000;
+		}
+		if (ps_flash_dirty && (first_change_usec != 0)) {
+			flash_due_usec = last_change_usec + (int64_t) PS_COMMIT_QUIET_MSEC * 1000;
+			if (flash_due_usec > (first_change_usec + (int64_t) PS_COMMIT_MAX_DELAY_MSEC * 1000)) {
+				flash_due_usec = first_change_usec + (int64_t) PS_COMMIT_MAX_DELAY_MSEC * 1000;
+			}
+			if ((due_usec == 0) || (flash_due_usec < due_usec)) {
+				due_usec = flash_due_usec;
+			}
+		}
+		if (due_usec != 0) {
+			now = esp_timer_get_time();
+			wait_ticks = (due_usec > now) ? pdMS_TO_TICKS((due_usec - now + 999) / 1000) : 0;
+		} else {
+			wait_ticks = portMAX_DELAY;
+		}
+		
+		notification_value = 0;
+		(void) xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, wait_ticks);
+		now = esp_timer_get_time();
+		
+		if ((notification_value & PS_NOTIFY_WRITE) != 0) {
+			last_write_usec = now;
+		}
+		if ((notification_value & PS_NOTIFY_CHANGE) != 0) {
+			if (first_change_usec == 0) {
+				first_change_usec = now;
+			}
+			last_change_usec = now;
+		}
+		if ((notification_value & PS_NOTIFY_COMMIT_NOW) != 0) {
+			commit_requested = true;
+		}
+		
+		// Write coalesced config changes to NVRAM
+		if ((ps_nvram_pending != 0) &&
+		    (commit_requested || (now >= (last_write_usec + (int64_t) PS_WRITE_QUIET_MSEC * 1000)))) {
+			
+			last_write_usec = 0;
+			if (_ps_flush_nvram()) {
+				now = esp_timer_get_time();
+				if (first_change_usec == 0) {
+					first_change_usec = now;
+				}
+				last_change_usec = now;
+			}
+		}
+		
+		if (!ps_flash_dirty) {
+			commit_requested = false;
+			first_change_usec = 0;
+			portENTER_CRITICAL(&commit_spinlock);
+			if ((ps_nvram_pending == 0) && (commit_state == PS_COMMIT_PENDING)) {
+				// Changes were reverted before being written
+				commit_state = PS_COMMIT_IDLE;
+			}
+			portEXIT_CRITICAL(&commit_spinlock);
+			continue;
+		}
+		
+		if (commit_requested ||
+		    (now >= (last_change_usec + (int64_t) PS_COMMIT_QUIET_MSEC * 1000)) ||
+		    (now >= (first_change_usec + (int64_t) PS_COMMIT_MAX_DELAY_MSEC * 1000))) {
+			
+			commit_requested = false;
+			first_change_usec = 0;
+			if (!_ps_commit() || ps_flash_dirty) {
+				// Failed (try again after another quiet period) or changed while committing
+				first_change_usec = esp_timer_get_time();
+				last_change_usec = first_change_usec;
+			}
+		}
+	}
+}
+
+
+/**
+ * Write battery-backed RAM to flash in the PMIC/RTC.  Changes made while the commit is
+ * in progress mark the storage dirty again.
+ */
+static bool _ps_commit()
+{
+	bool success = false;
+	int64_t t0;
+	uint32_t dur_msec;
+	uint32_t wait_msec = 0;
+	uint8_t reg = 1;
+	
+	ESP_LOGI(TAG, "Saving NVRAM");
+	portENTER_CRITICAL(&commit_spinlock);
+	commit_state = PS_COMMIT_BUSY;
+	ps_flash_dirty = false;
+	portEXIT_CRITICAL(&commit_spinlock);
+	t0 = esp_timer_get_time();
+	
+	// Trigger a write of the NVRAM to backing flash
+	if (gcore_set_reg8(GCORE_REG_NV_CTRL, GCORE_NVRAM_WR_TRIG)) {
+		// Wait after triggering the write
+		//   1. 36 mSec to allow the EFM8 to erase the flash memory (it is essentially
+		//      locked up while doing this and won't respond to I2C cycles).
+		//   2. 128 mSec to allow the NVRAM to be written to flash.  This isn't
+		//      strictly necessary before starting to poll for completion but since 
+		//      it's possible an I2C cycle will fail during the writing process we
+		//      wait so we don't freak anyone out who might be looking at the log
+		//      output.
+		vTaskDelay(pdMS_TO_TICKS(155));
+		
+		// Poll until write is done - this should fall through immediately
+		while ((reg != 0) && (wait_msec < PS_COMMIT_TIMEOUT_MSEC)) {
+			vTaskDelay(pdMS_TO_TICKS(10));
+			wait_msec += 10;
+			(void) gcore_get_reg8(GCORE_REG_NV_CTRL, &reg);
+		}
+		success = (reg == 0);
+	}
+	
+	dur_msec = (uint32_t) ((esp_timer_get_time() - t0) / 1000);
+	
+	portENTER_CRITICAL(&commit_spinlock);
+	if (success) {
+		commit_stats.count++;
+		commit_stats.last_msec = dur_msec;
+		commit_stats.total_msec += dur_msec;
+		if (dur_msec > commit_stats.max_msec) commit_stats.max_msec = dur_msec;
+	} else {
+		commit_stats.failures++;
+		ps_flash_dirty = true;
+	}
+	commit_state = (ps_flash_dirty || (ps_nvram_pending != 0)) ? PS_COMMIT_PENDING : PS_COMMIT_IDLE;
+	portEXIT_CRITICAL(&commit_spinlock);
+	
+	if (!success) {
+		ESP_LOGE(TAG, "NVRAM save failed");
+	}
+	
+	return success;
+}
+
+
+/**
+ * Write the configs changed since the last flush to NVRAM (only bytes that changed are
+ * written).  Returns true if NVRAM was modified.
+ */
+static bool _ps_flush_nvram()
+{
+	bool changed = false;
+	bool ret = true;
+	int i;
+	uint32_t pending;
+	
+	xSemaphoreTake(ps_mutex, portMAX_DELAY);
+	
+	portENTER_CRITICAL(&commit_spinlock);
+	pending = ps_nvram_pending;
+	ps_nvram_pending = 0;
+	commit_stats.nvram_flushes++;
+	portEXIT_CRITICAL(&commit_spinlock);
+	
+	// Our local copies only change while holding the mutex
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		if ((pending & (1 << ps_schema[i].config)) != 0) {
+			ret &= _ps_set_field(i, (const uint8_t*) ps_config_ptr[ps_schema[i].config], &changed);
+		}
+	}
+	if (changed) {
+		ret &= _ps_write_crc();
+		_ps_note_change();
+	}
+	
+	xSemaphoreGive(ps_mutex);
+	
+	if (!ret) {
+		ESP_LOGE(TAG, "Failed to write config changes to NVRAM");
+	}
+	
+	return changed;
+}
+
+
+/**
+ * Mark NVRAM modified and let the commit task know
+ */
+static void _ps_note_change()
+{
+	portENTER_CRITICAL(&commit_spinlock);
+	ps_flash_dirty = true;
+	if (commit_state == PS_COMMIT_IDLE) {
+		commit_state = PS_COMMIT_PENDING;
+	}
+	portEXIT_CRITICAL(&commit_spinlock);
+	
+	if (commit_task_handle != NULL) {
+		xTaskNotify(commit_task_handle, PS_NOTIFY_CHANGE, eSetBits);
+	}
+}
+
 static bool _ps_read_array()
 {
 	return (gcore_get_nvram_bytes(PS_RAM_STARTADDR, ps_shadow_buffer, PS_RAM_SIZE) == true);
 }
 
 
-static bool _ps_write_array(enum ps_update_types_t t)
+static bool _ps_write_array()
 {
-	bool ret = false;
+	return _ps_write_bytes_to_gcore(0, PS_RAM_SIZE);
+}
+
+
+/**
+ * Index the records in a valid store and decode them into the config structs.  Settings
+ * without a record (added since the store was written) get their default value and
+ * are appended to the store.
+ */
+static bool _ps_load_store()
+{
+	bool changed = false;
+	bool ret = true;
+	int i;
+	char rule[PS_TZ_MAX_LEN+1];
+	uint8_t key;
+	uint8_t len;
+	uint16_t addr = PS_FIRST_DATA_ADDR;
+	uint16_t tz_rule_addr = 0;
 	
-	switch(t) {
-	case FULL:
-		ret = _ps_write_bytes_to_gcore(0, PS_RAM_SIZE);
-		break;
-
-	case GUI:
-		if (_ps_write_bytes_to_gcore(ps_sub_regions.start_index[PS_CONFIG_TYPE_GUI],
-		                          ps_sub_regions.length[PS_CONFIG_TYPE_GUI]))
-		{
-			ret = gcore_set_nvram_byte(PS_RAM_STARTADDR + PS_CHECKSUM_ADDR,
-			                       ps_shadow_buffer[PS_CHECKSUM_ADDR]);
-		} else {
-			ret = false;
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		ps_record_addr[i] = 0;
+	}
+	
+	while ((addr + PS_RECORD_HDR_LEN) <= PS_CRC_ADDR) {
+		key = ps_shadow_buffer[addr];
+		if (key == PS_KEY_END) break;
+		len = ps_shadow_buffer[addr+1];
+		if ((addr + PS_RECORD_HDR_LEN + len) > PS_CRC_ADDR) {
+			return false;
+		}
+		
+		// Records with unknown keys (from newer firmware) are kept but not indexed
+		if ((key != PS_KEY_DELETED) && (ps_key_map[key] != 0xFF)) {
+			ps_record_addr[ps_key_map[key]] = addr;
 		}
-		break;
+		if ((key == PS_KEY_TZ_RULE) && (len <= PS_TZ_MAX_LEN)) {
+			tz_rule_addr = addr;
+		}
+		addr += PS_RECORD_HDR_LEN + len;
+	}
+	ps_end_addr = addr;
+	
+	for (i=0; i<PS_NUM_CONFIGS; i++) {
+		memset(ps_config_ptr[i], 0, ps_config_len[i]);
+		_ps_init_config_memory(i, (uint8_t*) ps_config_ptr[i]);
+	}
 	
-	case NET:
-		if (_ps_write_bytes_to_gcore(ps_sub_regions.start_index[PS_CONFIG_TYPE_NET],
-		                          ps_sub_regions.length[PS_CONFIG_TYPE_NET]))
-		{
-			ret = gcore_set_nvram_byte(PS_RAM_STARTADDR + PS_CHECKSUM_ADDR,
-			                       ps_shadow_buffer[PS_CHECKSUM_ADDR]);
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		if (ps_record_addr[i] != 0) {
+			_ps_decode_record(i, (uint8_t*) ps_config_ptr[ps_schema[i].config]);
 		} else {
-			ret = false;
+			if ((ps_schema[i].key == PS_KEY_TZ_ID) && (tz_rule_addr != 0)) {
+				// Timezone from before zone IDs
+				len = ps_shadow_buffer[tz_rule_addr+1];
+				memcpy(rule, &ps_shadow_buffer[tz_rule_addr + PS_RECORD_HDR_LEN], len);
+				rule[len] = 0;
+				_ps_convert_tz_rule(rule);
+			}
+			ESP_LOGI(TAG, "Add setting 0x%02x", ps_schema[i].key);
+			ret &= _ps_set_field(i, (const uint8_t*) ps_config_ptr[ps_schema[i].config], &changed);
 		}
-		break;	
+	}
+	
+	// The old timezone record is no longer used
+	if (tz_rule_addr != 0) {
+		key = PS_KEY_DELETED;
+		ret &= _ps_update_region(tz_rule_addr, &key, 1, &changed);
+	}
+	if (changed) {
+		ret &= _ps_write_crc();
+		_ps_note_change();
+	}
+	if (!ret) {
+		ESP_LOGE(TAG, "Failed to write new settings to NVRAM");
+	}
+	
+	return true;
+}
+
+
+/**
+ * Build a complete store in the shadow buffer from the config structs
+ */
+static void _ps_build_store()
+{
+	int i;
+	
+	memset(ps_shadow_buffer, PS_KEY_END, PS_RAM_SIZE);
+	ps_shadow_buffer[PS_MAGIC_WORD_0_ADDR] = PS_MAGIC_WORD_0;
+	ps_shadow_buffer[PS_MAGIC_WORD_1_ADDR] = PS_MAGIC_WORD_1;
+	ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR] = PS_LAYOUT_VERSION;
+	ps_end_addr = PS_FIRST_DATA_ADDR;
+	
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		const uint8_t* cfg = (const uint8_t*) ps_config_ptr[ps_schema[i].config];
+		uint8_t len = _ps_field_value_len(i, cfg);
 		
-	case TZ:
-		if (_ps_write_bytes_to_gcore(ps_sub_regions.start_index[PS_CONFIG_TYPE_TZ],
-		                          ps_sub_regions.length[PS_CONFIG_TYPE_TZ]))
-		{
-			ret = gcore_set_nvram_byte(PS_RAM_STARTADDR + PS_CHECKSUM_ADDR,
-			                       ps_shadow_buffer[PS_CHECKSUM_ADDR]);
-		} else {
-			ret = false;
+		ps_record_addr[i] = ps_end_addr;
+		ps_shadow_buffer[ps_end_addr] = ps_schema[i].key;
+		ps_shadow_buffer[ps_end_addr+1] = len;
+		memcpy(&ps_shadow_buffer[ps_end_addr + PS_RECORD_HDR_LEN], &cfg[ps_schema[i].offset], len);
+		ps_end_addr += PS_RECORD_HDR_LEN + len;
+	}
+	
+	_ps_set_crc();
+}
+
+
+/**
+ * Remove deleted records by moving live records down and rewrite the whole store
+ */
+static bool _ps_compact_store()
+{
+	int i;
+	uint8_t key;
+	uint16_t rec_len;
+	uint16_t rd_addr = PS_FIRST_DATA_ADDR;
+	uint16_t wr_addr = PS_FIRST_DATA_ADDR;
+	
+	while (rd_addr < ps_end_addr) {
+		key = ps_shadow_buffer[rd_addr];
+		rec_len = PS_RECORD_HDR_LEN + ps_shadow_buffer[rd_addr+1];
+		if (key != PS_KEY_DELETED) {
+			if (wr_addr != rd_addr) {
+				memmove(&ps_shadow_buffer[wr_addr], &ps_shadow_buffer[rd_addr], rec_len);
+			}
+			if (ps_key_map[key] != 0xFF) {
+				ps_record_addr[ps_key_map[key]] = wr_addr;
+			}
+			wr_addr += rec_len;
 		}
-		break;
+		rd_addr += rec_len;
 	}
+	
+	ESP_LOGI(TAG, "Compacted store from %d to %d bytes", ps_end_addr - PS_FIRST_DATA_ADDR,
+		wr_addr - PS_FIRST_DATA_ADDR);
+	
+	for (i=wr_addr; i<PS_CRC_ADDR; i++) {
+		ps_shadow_buffer[i] = PS_KEY_END;
+	}
+	ps_end_addr = wr_addr;
+	_ps_set_crc();
+	_ps_note_change();
+	
+	return _ps_write_array();
+}
+
+
+/**
+ * Update the record for a field from its value in cfg (a config struct).  A value of
+ * the same length is updated in place, otherwise the old record is deleted and a new
+ * one appended.  The caller updates the CRC if changed is set.
+ */
+static bool _ps_set_field(int field, const uint8_t* cfg, bool* changed)
+{
+	bool ret;
+	uint8_t len;
+	uint16_t addr;
+	const uint8_t* val;
+	
+	val = &cfg[ps_schema[field].offset];
+	len = _ps_field_value_len(field, cfg);
+	addr = ps_record_addr[field];
+	
+	if ((addr != 0) && (ps_shadow_buffer[addr+1] == len)) {
+		return _ps_update_region(addr + PS_RECORD_HDR_LEN, val, len, changed);
+	}
+	
+	ret = true;
+	if (addr != 0) {
+		ps_shadow_buffer[addr] = PS_KEY_DELETED;
+		ps_record_addr[field] = 0;
+		ret &= _ps_write_bytes_to_gcore(addr, 1);
+	}
+	ret &= _ps_append_record(field, val, len);
+	*changed = true;
+	
 	return ret;
 }
 
 
-// This routine has to be updated if any config changes.  It assumes the index is valid.
-static void _ps_init_config_memory(int index)
+static bool _ps_append_record(int field, const uint8_t* val, uint8_t len)
 {
-	gui_config_t* gui_configP;
-	net_config_t* net_configP;
-	tz_config_t* tz_configP;
-	uint8_t sys_mac_addr[6];
+	uint16_t addr;
 	
-	switch (index) {
-		case PS_CONFIG_TYPE_GUI:
-			gui_configP = (gui_config_t*) &ps_shadow_buffer[ps_sub_regions.start_index[index]];
-			
-			gui_configP->hour_mode_24 = PS_DEFAULT_HOUR_MODE_24;
-			gui_configP->lcd_brightness = PS_DEFAULT_BACKLIGHT;
-			break;
+	if ((ps_end_addr + PS_RECORD_HDR_LEN + len) > PS_CRC_ADDR) {
+		if (!_ps_compact_store()) {
+			return false;
+		}
+		if ((ps_end_addr + PS_RECORD_HDR_LEN + len) > PS_CRC_ADDR) {
+			ESP_LOGE(TAG, "No room for setting 0x%02x", ps_schema[field].key);
+			return false;
+		}
+	}
+	
+	addr = ps_end_addr;
+	ps_shadow_buffer[addr] = ps_schema[field].key;
+	ps_shadow_buffer[addr+1] = len;
+	memcpy(&ps_shadow_buffer[addr + PS_RECORD_HDR_LEN], val, len);
+	ps_record_addr[field] = addr;
+	ps_end_addr += PS_RECORD_HDR_LEN + len;
+	
+	return _ps_write_bytes_to_gcore(addr, PS_RECORD_HDR_LEN + len);
+}
+
+
+/**
+ * Load a field in cfg from its record.  A fixed-size record whose length doesn't match
+ * the schema leaves the default value.
+ */
+static void _ps_decode_record(int field, uint8_t* cfg)
+{
+	uint8_t len;
+	uint16_t addr;
+	const ps_schema_entry_t* e = &ps_schema[field];
+	
+	addr = ps_record_addr[field];
+	len = ps_shadow_buffer[addr+1];
+	
+	if (e->type == PS_TYPE_STR) {
+		if (len > e->len) len = e->len;
+		memset(&cfg[e->offset], 0, e->len + 1);
+		memcpy(&cfg[e->offset], &ps_shadow_buffer[addr + PS_RECORD_HDR_LEN], len);
+	} else if (len == e->len) {
+		memcpy(&cfg[e->offset], &ps_shadow_buffer[addr + PS_RECORD_HDR_LEN], len);
+	}
+}
+
+
+static uint8_t _ps_field_value_len(int field, const uint8_t* cfg)
+{
+	const ps_schema_entry_t* e = &ps_schema[field];
+	
+	if (e->type == PS_TYPE_STR) {
+		return strnlen((const char*) &cfg[e->offset], e->len);
+	}
+	
+	return e->len;
+}
+
+
+/**
+ * Copy len bytes from src into the shadow buffer at start_addr, writing only the
+ * modified spans to NVRAM.  Sets changed if anything was modified.
+ */
+static bool _ps_update_region(uint16_t start_addr, const uint8_t* src, uint16_t len, bool* changed)
+{
+	bool ret = true;
+	uint16_t i = 0;
+	uint16_t span_start;
+	uint16_t span_end;
+	uint16_t gap;
+	
+	while (i < len) {
+		// Find the start of the next modified span
+		if (src[i] == ps_shadow_buffer[start_addr + i]) {
+			i++;
+			continue;
+		}
 		
-		case PS_CONFIG_TYPE_NET:
-			// Get the system's default MAC address and add 1 to match the "Soft AP" mode
-			esp_efuse_mac_get_default(sys_mac_addr);
-			sys_mac_addr[5] = sys_mac_addr[5] + 1;
-			
-			// Get a struct-friendly pointer to local storage and initialize the struct
-			net_configP = (net_config_t*) &ps_shadow_buffer[ps_sub_regions.start_index[index]];
-			net_configP->mdns_en = true;
-			net_configP->sta_mode = false;
-			net_configP->sta_static_ip = false;
-						
-			// Text fields start off empty
-			for (int i=0; i<PS_SSID_MAX_LEN+1; i++) {
-				net_configP->ap_ssid[i] = 0;
-				net_configP->ap_pw[i] = 0;
-				net_configP->sta_ssid[i] = 0;
-				net_configP->sta_pw[i] = 0;
+		// Extend it, absorbing short runs of unchanged bytes
+		span_start = i;
+		span_end = i;
+		gap = 0;
+		while ((i < len) && (gap < PS_SPAN_MERGE_GAP)) {
+			if (src[i] != ps_shadow_buffer[start_addr + i]) {
+				span_end = i;
+				gap = 0;
+			} else {
+				gap++;
 			}
-			
-			// Add our default AP SSID/Clock name
-			sprintf(net_configP->ap_ssid, "%s%c%c%c%c", PS_DEFAULT_AP_SSID,
-				ps_nibble_to_ascii(sys_mac_addr[4] >> 4),
-		    	ps_nibble_to_ascii(sys_mac_addr[4]),
-		    	ps_nibble_to_ascii(sys_mac_addr[5] >> 4),
-	 	    	ps_nibble_to_ascii(sys_mac_addr[5]));
+			i++;
+		}
+		
+		memcpy(&ps_shadow_buffer[start_addr + span_start], &src[span_start], span_end - span_start + 1);
+		ret &= _ps_write_bytes_to_gcore(start_addr + span_start, span_end - span_start + 1);
+		*changed = true;
+		i = span_end + 1;
+	}
+	
+	return ret;
+}
 
-			
-			// Default IP addresses (match espressif defaults)
-			net_configP->ap_ip_addr[3] = 192;
-			net_configP->ap_ip_addr[2] = 168;
-			net_configP->ap_ip_addr[1] = 4;
-			net_configP->ap_ip_addr[0] = 1;
-			net_configP->sta_ip_addr[3] = 192;
-			net_configP->sta_ip_addr[2] = 168;
-			net_configP->sta_ip_addr[1] = 4;
-			net_configP->sta_ip_addr[0] = 2;
-			net_configP->sta_netmask[3] = 255;
-			net_configP->sta_netmask[2] = 255;
-			net_configP->sta_netmask[1] = 255;
-			net_configP->sta_netmask[0] = 0;
-			break;
+
+static bool _ps_write_crc()
+{
+	_ps_set_crc();
+	
+	return _ps_write_bytes_to_gcore(PS_CRC_ADDR, 2);
+}
+
+
+static void _ps_set_crc()
+{
+	uint16_t crc;
+	
+	crc = _ps_compute_crc(PS_CRC_ADDR);
+	ps_shadow_buffer[PS_CRC_ADDR] = crc >> 8;
+	ps_shadow_buffer[PS_CRC_ADDR + 1] = crc & 0xFF;
+}
+
+
+/**
+ * Load the default values for a config into buf (which must be zeroed).  Settings that
+ * can't be expressed as a constant default in the schema are set here.
+ */
+static void _ps_init_config_memory(int index, uint8_t* buf)
+{
+	int i;
+	net_config_t* net_configP;
+	uint8_t sys_mac_addr[6];
+	
+	for (i=0; i<PS_NUM_FIELDS; i++) {
+		if ((ps_schema[i].config == index) && (ps_schema[i].dflt != NULL)) {
+			if (ps_schema[i].type == PS_TYPE_STR) {
+				strncpy((char*) &buf[ps_schema[i].offset], (const char*) ps_schema[i].dflt, ps_schema[i].len);
+			} else {
+				memcpy(&buf[ps_schema[i].offset], ps_schema[i].dflt, ps_schema[i].len);
+			}
+		}
+	}
+	
+	if (index == PS_CONFIG_TYPE_TZ) {
+		((tz_config_t*) buf)->zone_id = tzdb_get_id(tzdb_find(PS_DEFAULT_TZ));
+	}
+	
+	if (index == PS_CONFIG_TYPE_NET) {
+		// Get the system's default MAC address and add 1 to match the "Soft AP" mode
+		esp_efuse_mac_get_default(sys_mac_addr);
+		sys_mac_addr[5] = sys_mac_addr[5] + 1;
 		
-		case PS_CONFIG_TYPE_TZ:
-			tz_configP = (tz_config_t*) &ps_shadow_buffer[ps_sub_regions.start_index[index]];
-			
-			strcpy(tz_configP->tz, PS_DEFAULT_TZ);
-			break;
+		// Add our default AP SSID/Clock name
+		net_configP = (net_config_t*) buf;
+		sprintf(net_configP->ap_ssid, "%s%c%c%c%c", PS_DEFAULT_AP_SSID,
+			ps_nibble_to_ascii(sys_mac_addr[4] >> 4),
+		    ps_nibble_to_ascii(sys_mac_addr[4]),
+		    ps_nibble_to_ascii(sys_mac_addr[5] >> 4),
+		    ps_nibble_to_ascii(sys_mac_addr[5]));
 	}
 }
 
 
 /**
- * Initialize our local array with default values.
+ * Initialize the configs and the store with default values.
  */
 static void _ps_init_array()
 {
-	// Zero buffer
-	memset(ps_shadow_buffer, 0, PS_RAM_SIZE);
-	
-	// Control fields
-	ps_shadow_buffer[PS_MAGIC_WORD_0_ADDR] = PS_MAGIC_WORD_0;
-	ps_shadow_buffer[PS_MAGIC_WORD_1_ADDR] = PS_MAGIC_WORD_1;
-	ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR] = PS_LAYOUT_VERSION;
+	int i;
 	
-	// Parameters
-	_ps_init_config_memory(PS_CONFIG_TYPE_GUI);
-	_ps_init_config_memory(PS_CONFIG_TYPE_NET);
-	_ps_init_config_memory(PS_CONFIG_TYPE_TZ);
+	for (i=0; i<PS_NUM_CONFIGS; i++) {
+		memset(ps_config_ptr[i], 0, ps_config_len[i]);
+		_ps_init_config_memory(i, (uint8_t*) ps_config_ptr[i]);
+	}
 	
-	// Finally compute and load checksum
-	ps_shadow_buffer[PS_CHECKSUM_ADDR] = _ps_compute_checksum();
+	_ps_build_store();
 }
 
 
@@ -501,12 +1308,107 @@ static bool _ps_valid_magic_word()
 }
 
 
-static uint8_t _ps_compute_checksum()
+/**
+ * Convert a valid version 1 or 2 layout (the config structs stored back to back) in
+ * the shadow buffer to a record store.
+ */
+static bool _ps_migrate_fixed()
+{
+	int i;
+	uint8_t version;
+	uint16_t addr;
+	
+	if (!_ps_valid_magic_word()) {
+		return false;
+	}
+	
+	version = ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR];
+	if (version == PS_LAYOUT_VERSION_V1) {
+		if (_ps_compute_v1_checksum() != ps_shadow_buffer[PS_V1_CHECKSUM_ADDR]) return false;
+	} else if (version == PS_LAYOUT_VERSION_V2) {
+		if (_ps_compute_crc(PS_V3_CRC_ADDR) != _ps_get_crc(PS_V3_CRC_ADDR)) return false;
+	} else {
+		return false;
+	}
+	
+	ESP_LOGI(TAG, "Convert persistent storage from layout version %d to %d", version, PS_LAYOUT_VERSION);
+	for (i=0; i<PS_NUM_CONFIGS; i++) {
+		memset(ps_config_ptr[i], 0, ps_config_len[i]);
+		_ps_init_config_memory(i, (uint8_t*) ps_config_ptr[i]);
+	}
+	addr = PS_FIRST_DATA_ADDR;
+	for (i=0; i<PS_NUM_FIXED_CONFIGS; i++) {
+		if (i == PS_CONFIG_TYPE_TZ) {
+			// Stored as a POSIX rule string
+			ps_shadow_buffer[addr + PS_TZ_MAX_LEN] = 0;
+			_ps_convert_tz_rule((const char*) &ps_shadow_buffer[addr]);
+			addr += PS_TZ_MAX_LEN + 1;
+		} else {
+			memcpy(ps_config_ptr[i], &ps_shadow_buffer[addr], ps_config_len[i]);
+			addr += ps_config_len[i];
+		}
+	}
+	
+	// Strings are always terminated in the config structs
+	ps_net_config.ap_ssid[PS_SSID_MAX_LEN] = 0;
+	ps_net_config.sta_ssid[PS_SSID_MAX_LEN] = 0;
+	ps_net_config.ap_pw[PS_PW_MAX_LEN] = 0;
+	ps_net_config.sta_pw[PS_PW_MAX_LEN] = 0;
+	
+	_ps_build_store();
+	
+	return true;
+}
+
+
+/**
+ * Convert a valid version 3 record store in the shadow buffer to the current layout.
+ * The records are unchanged, the store just has room for more of them.
+ */
+static bool _ps_migrate_v3()
+{
+	if (!_ps_valid_magic_word() || (ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR] != PS_LAYOUT_VERSION_V3)) {
+		return false;
+	}
+	if (_ps_compute_crc(PS_V3_CRC_ADDR) != _ps_get_crc(PS_V3_CRC_ADDR)) {
+		return false;
+	}
+	
+	ESP_LOGI(TAG, "Convert persistent storage from layout version %d to %d", PS_LAYOUT_VERSION_V3, PS_LAYOUT_VERSION);
+	memset(&ps_shadow_buffer[PS_V3_CRC_ADDR], PS_KEY_END, PS_RAM_SIZE - PS_V3_CRC_ADDR);
+	ps_shadow_buffer[PS_LAYOUT_VERSION_ADDR] = PS_LAYOUT_VERSION;
+	_ps_set_crc();
+	
+	// Loads the records and adds settings that are new since version 3
+	return _ps_load_store();
+}
+
+
+/**
+ * Set the timezone config from a POSIX rule stored by older firmware.  The default
+ * zone is kept if no zone uses the rule.
+ */
+static void _ps_convert_tz_rule(const char* rule)
+{
+	int zone;
+	
+	zone = tzdb_find_rule(rule);
+	if (zone >= 0) {
+		ps_tz_config.zone_id = tzdb_get_id(zone);
+		ESP_LOGI(TAG, "Convert timezone %s to %s/%s", rule, tzdb_get_region_name(tzdb_get_region(zone)),
+			tzdb_get_city(zone));
+	} else {
+		ESP_LOGE(TAG, "No zone uses timezone %s - using %s", rule, PS_DEFAULT_TZ);
+	}
+}
+
+
+static uint8_t _ps_compute_v1_checksum()
 {
 	int i;
 	uint8_t cs = 0;
 	
-	for (i=0; i<PS_CHECKSUM_ADDR; i++) {
+	for (i=0; i<PS_V1_CHECKSUM_ADDR; i++) {
 		cs += ps_shadow_buffer[i];
 	}
 	
@@ -514,6 +1416,36 @@ static uint8_t _ps_compute_checksum()
 }
 
 
+/**
+ * CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of everything
+ * preceding the CRC at crc_addr
+ */
+static uint16_t _ps_compute_crc(uint16_t crc_addr)
+{
+	int i, j;
+	uint16_t crc = 0xFFFF;
+	
+	for (i=0; i<crc_addr; i++) {
+		crc ^= (uint16_t) ps_shadow_buffer[i] << 8;
+		for (j=0; j<8; j++) {
+			if (crc & 0x8000) {
+				crc = (crc << 1) ^ 0x1021;
+			} else {
+				crc = crc << 1;
+			}
+		}
+	}
+	
+	return crc;
+}
+
+
+static uint16_t _ps_get_crc(uint16_t crc_addr)
+{
+	return (ps_shadow_buffer[crc_addr] << 8) | ps_shadow_buffer[crc_addr + 1];
+}
+
+
 static bool _ps_write_bytes_to_gcore(uint16_t start_addr, uint16_t data_len)
 {
 	return (gcore_set_nvram_bytes(PS_RAM_STARTADDR + start_addr, &ps_shadow_buffer[start_addr], data_len));
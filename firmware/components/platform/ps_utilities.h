@@ -25,6 +25,9 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tzdb.h"
 
 
 
@@ -34,38 +37,72 @@
 
 //
 // Configuration types
-#define PS_NUM_CONFIGS           3
+#define PS_NUM_CONFIGS           5
 
 #define PS_CONFIG_TYPE_GUI       0
 #define PS_CONFIG_TYPE_NET       1
 #define PS_CONFIG_TYPE_TZ        2
+#define PS_CONFIG_TYPE_RTC       3
+#define PS_CONFIG_TYPE_ALARM     4
 
 // PS Size
 //  - must be less than contained in gCore's EFM8 RAM
 //  - should be fairly small to keep I2C burst length down
-#define PS_RAM_SIZE         320
+#define PS_RAM_SIZE         384
 #define PS_RAM_STARTADDR    0
 
+// Settings changes are applied in memory immediately and written to NVRAM once they
+// have been quiet for PS_WRITE_QUIET_MSEC (repeated changes coalesce, last value wins)
+#define PS_WRITE_QUIET_MSEC      250
+
+// NVRAM to flash commit scheduling (mSec).  Changes are committed once they have
+// been quiet for PS_COMMIT_QUIET_MSEC but no later than PS_COMMIT_MAX_DELAY_MSEC after
+// the first change.
+#define PS_COMMIT_QUIET_MSEC     5000
+#define PS_COMMIT_MAX_DELAY_MSEC 60000
+
+// Time allowed for the EFM8 to erase and write flash before a commit is failed (mSec)
+#define PS_COMMIT_TIMEOUT_MSEC   1000
+
+// Commit task
+#define PS_COMMIT_TASK_STACK     2048
+#define PS_COMMIT_TASK_PRIO      1
+#define PS_COMMIT_TASK_CORE      0
+
+// Maximum number of config change subscriptions
+#define PS_MAX_SUBSCRIBERS       8
+
+// Generation value that never matches a config (forces ps_get_config_if_changed to copy)
+#define PS_GENERATION_NONE       0xFFFFFFFF
+
+// Commit states
+#define PS_COMMIT_IDLE           0
+#define PS_COMMIT_PENDING        1
+#define PS_COMMIT_BUSY           2
+
 // Default 24-hour mode display
 #define PS_DEFAULT_HOUR_MODE_24 false
 
 // Default backlight brightness (percent)
 #define PS_DEFAULT_BACKLIGHT    80
 
-// Default timezone
-#define PS_DEFAULT_TZ           "MST7MDT,M3.2.0,M11.1.0"
+// Default timezone (zone name)
+#define PS_DEFAULT_TZ           TZDB_DEFAULT_ZONE
 
 // Base part of the default SSID/Clock name - the last 4 nibbles of the ESP32's
 // mac address are appended as ASCII characters
 #define PS_DEFAULT_AP_SSID "NixieClock-"
 
-// Maximum timezone length
+// Maximum length of the POSIX timezone rule stored before zone IDs
 #define PS_TZ_MAX_LEN       80
 
 // Field lengths
 #define PS_SSID_MAX_LEN     32
 #define PS_PW_MAX_LEN       63
 
+// Number of alarms
+#define PS_NUM_ALARMS       8
+
 
 
 //
@@ -91,18 +128,62 @@ typedef struct {
 } net_config_t;
 
 typedef struct {
-	char tz[PS_TZ_MAX_LEN+1];
+	uint16_t zone_id;                  // Stable tzdb zone ID
 } tz_config_t;
 
+// RTC drift model (maintained by rtc_drift, not a user setting)
+typedef struct {
+	int32_t rtc_offset;                // Virtual RTC - RTC (seconds) accumulated over RTC writes
+	bool rebase;                       // Time was set by hand - next sync re-anchors the fit
+	uint16_t pairs;                    // Sync pairs in the fit (0: no fit)
+	uint32_t fit_start;                // True time of the oldest pair in the fit
+	uint32_t fit_end;                  // True time of the newest pair in the fit
+	int32_t fit_err_msec;              // Fitted virtual RTC - true time at fit_end
+	int32_t drift_ppb;                 // Fitted RTC frequency error (+ RTC runs fast)
+	uint32_t drift_sd_ppb;             // Standard error of drift_ppb
+	uint32_t resid_msec;               // RMS residual of the fit
+	uint32_t week_err_msec;            // Predicted corrected error one week after fit_end (2 sigma)
+} rtc_config_t;
+
+// Alarm.  Days has bit 0 for Sunday through bit 6 for Saturday.  An alarm with no days
+// is a one-shot alarm: it fires at the first match after it was armed and is then disabled.
+typedef struct {
+	uint32_t armed;                    // Time the alarm was last enabled or changed
+	bool enable;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t days;
+} ps_alarm_t;
+
+typedef struct {
+	ps_alarm_t alarm[PS_NUM_ALARMS];
+} alarm_config_t;
+
+typedef struct {
+	uint32_t count;                    // Successful flash commits since boot
+	uint32_t failures;
+	uint32_t last_msec;                // Duration of the most recent commit
+	uint32_t max_msec;
+	uint32_t total_msec;
+	uint32_t sets;                     // ps_set_config calls that changed a config
+	uint32_t nvram_flushes;            // Coalesced writes of changed configs to NVRAM
+} ps_commit_stats_t;
+
 
 
 //
 // PS Utilities API
 //
 bool ps_init();
-void ps_save_to_flash();
+void ps_commit_now();
+bool ps_wait_commit(uint32_t timeout_msec);
+int ps_get_commit_state();
+void ps_get_commit_stats(ps_commit_stats_t* stats);
 bool ps_get_config(int index, void* cfg);
+bool ps_get_config_if_changed(int index, void* cfg, uint32_t* generation);
+uint32_t ps_get_config_generation(int index);
 bool ps_set_config(int index, void* cfg);
+bool ps_subscribe(int index, TaskHandle_t task, uint32_t notify_mask);
 bool ps_reinit_all();
 bool ps_reinit_config(int index);
 bool ps_has_new_ap_name(const char* name);
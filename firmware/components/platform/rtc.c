@@ -22,18 +22,11 @@
  *
  */
 #include "esp_system.h"
-#include "esp_log.h"
 #include "gcore.h"
 #include "rtc.h"
 
 
 
-//
-// RTC variables
-//
-static const char* TAG = "RTC";
-
-
 //
 // RTC API
 //
@@ -0,0 +1,289 @@
+/*
+ * Compiled IANA timezone database
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "tzdb.h"
+#include "tzdb_data.h"
+#include <string.h>
+
+
+
+//
+// Variables
+//
+
+// POSIX rules offered by the original web GUI and the zones they were chosen for.  Used
+// to convert settings stored as a rule (many zones share each rule).
+static const char* legacy_rules[][2] = {
+	{"ACST-9:30ACDT,M10.1.0,M4.1.0/3", "Australia/Adelaide"},
+	{"AEST-10AEDT,M10.1.0,M4.1.0/3",   "Australia/Sydney"},
+	{"AKST9AKDT,M3.2.0,M11.1.0",       "America/Anchorage"},
+	{"ANAT-12",                        "Asia/Anadyr"},
+	{"AWST-8",                         "Australia/Perth"},
+	{"GMT0BST,M3.5.0/1,M10.5.0",       "Europe/London"},
+	{"CET-1CEST,M3.5.0,M10.5.0/3",     "Europe/Berlin"},
+	{"CST6CDT,M3.2.0,M11.1.0",         "America/Chicago"},
+	{"CST-8",                          "Asia/Shanghai"},
+	{"EET-2EEST,M3.5.0/3,M10.5.0/4",   "Europe/Athens"},
+	{"EST5EDT,M3.2.0,M11.1.0",         "America/New_York"},
+	{"GMT",                            "Etc/GMT"},
+	{"HST10HDT,M3.2.0,M11.1.0",        "America/Adak"},
+	{"IST-5:30",                       "Asia/Kolkata"},
+	{"JST-9",                          "Asia/Tokyo"},
+	{"MST7MDT,M3.2.0,M11.1.0",         "America/Denver"},
+	{"MST7",                           "America/Phoenix"},
+	{"NZST-12NZDT,M9.5.0,M4.1.0/3",    "Pacific/Auckland"},
+	{"PST8PDT,M3.2.0,M11.1.0",         "America/Los_Angeles"},
+	{"SAST-2",                         "Africa/Johannesburg"}
+};
+
+#define TZDB_NUM_LEGACY_RULES (sizeof(legacy_rules) / sizeof(legacy_rules[0]))
+
+
+
+//
+// Forward declarations for internal functions
+//
+static int _tzdb_compare(const char* name, int zone);
+
+
+
+//
+// API
+//
+const char* tzdb_get_version()
+{
+	return tzdb_version;
+}
+
+
+int tzdb_get_num_zones()
+{
+	return (int) tzdb_num_zones;
+}
+
+
+int tzdb_get_num_regions()
+{
+	return (int) tzdb_num_regions;
+}
+
+
+const char* tzdb_get_region_name(int region)
+{
+	if ((region < 0) || (region >= tzdb_num_regions)) return "";
+	
+	return &tzdb_strings[tzdb_region_name[region]];
+}
+
+
+/**
+ * Returns the number of zones in a region and sets first to the index of the first
+ */
+int tzdb_get_region_zones(int region, int* first)
+{
+	if ((region < 0) || (region >= tzdb_num_regions)) {
+		*first = 0;
+		return 0;
+	}
+	
+	*first = tzdb_region_first[region];
+	return tzdb_region_first[region+1] - tzdb_region_first[region];
+}
+
+
+/**
+ * Load buf with the region's city names for display, one per line, with '_'
+ * shown as a space.  Returns the number of cities loaded.
+ */
+int tzdb_get_city_list(int region, char* buf, int len)
+{
+	int first, i, n, num;
+	const char* city;
+	char* p = buf;
+	
+	if (len < 1) return 0;
+	
+	num = tzdb_get_region_zones(region, &first);
+	for (i=0; i<num; i++) {
+		city = tzdb_get_city(first + i);
+		n = strlen(city);
+		if ((p - buf) + n + 1 >= len) break;
+		
+		if (i != 0) *p++ = '\n';
+		while (*city != 0) {
+			*p++ = (*city == '_') ? ' ' : *city;
+			city++;
+		}
+	}
+	*p = 0;
+	
+	return i;
+}
+
+
+/**
+ * Find a zone by name.  Returns its index or -1 if there is no such zone.
+ */
+int tzdb_find(const char* name)
+{
+	int lo = 0;
+	int hi = tzdb_num_zones - 1;
+	int mid, c;
+	
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		c = _tzdb_compare(name, mid);
+		if (c == 0) {
+			return mid;
+		} else if (c < 0) {
+			hi = mid - 1;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	
+	return -1;
+}
+
+
+/**
+ * Find a zone by its stable ID.  Returns its index or -1 if there is no such zone.
+ */
+int tzdb_find_id(uint16_t id)
+{
+	int i;
+	
+	if (id == TZDB_ID_NONE) return -1;
+	
+	for (i=0; i<tzdb_num_zones; i++) {
+		if (tzdb_zone[i].id == id) {
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+
+/**
+ * Find a zone using a POSIX rule.  Returns its index or -1 if no zone uses the rule.
+ */
+int tzdb_find_rule(const char* rule)
+{
+	int i;
+	
+	for (i=0; i<TZDB_NUM_LEGACY_RULES; i++) {
+		if (strcmp(rule, legacy_rules[i][0]) == 0) {
+			return tzdb_find(legacy_rules[i][1]);
+		}
+	}
+	
+	for (i=0; i<tzdb_num_zones; i++) {
+		if (strcmp(rule, &tzdb_strings[tzdb_rule[tzdb_zone[i].rule]]) == 0) {
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+
+/**
+ * Load buf with the zone's full name
+ */
+bool tzdb_get_name(int zone, char* buf, int len)
+{
+	const char* region;
+	const char* city;
+	
+	if ((zone < 0) || (zone >= tzdb_num_zones)) return false;
+	
+	region = tzdb_get_region_name(tzdb_get_region(zone));
+	city = tzdb_get_city(zone);
+	if ((strlen(region) + strlen(city) + 2) > len) return false;
+	
+	strcpy(buf, region);
+	strcat(buf, "/");
+	strcat(buf, city);
+	
+	return true;
+}
+
+
+const char* tzdb_get_city(int zone)
+{
+	if ((zone < 0) || (zone >= tzdb_num_zones)) return "";
+	
+	return &tzdb_strings[tzdb_zone[zone].city];
+}
+
+
+int tzdb_get_region(int zone)
+{
+	int region;
+	
+	if ((zone < 0) || (zone >= tzdb_num_zones)) return -1;
+	
+	for (region=0; region<tzdb_num_regions; region++) {
+		if (zone < tzdb_region_first[region+1]) break;
+	}
+	
+	return region;
+}
+
+
+const char* tzdb_get_rule(int zone)
+{
+	if ((zone < 0) || (zone >= tzdb_num_zones)) return "UTC0";
+	
+	return &tzdb_strings[tzdb_rule[tzdb_zone[zone].rule]];
+}
+
+
+uint16_t tzdb_get_id(int zone)
+{
+	if ((zone < 0) || (zone >= tzdb_num_zones)) return TZDB_ID_NONE;
+	
+	return tzdb_zone[zone].id;
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * strcmp of a full name against a zone's "Region/City"
+ */
+static int _tzdb_compare(const char* name, int zone)
+{
+	const char* region;
+	int n;
+	
+	region = tzdb_get_region_name(tzdb_get_region(zone));
+	n = strlen(region);
+	if (strncmp(name, region, n) != 0) {
+		return strncmp(name, region, n);
+	}
+	if (name[n] != '/') {
+		return (unsigned char) name[n] - (unsigned char) '/';
+	}
+	
+	return strcmp(&name[n+1], tzdb_get_city(zone));
+}
@@ -0,0 +1,69 @@
+/*
+ * Compiled IANA timezone database.  Zone names ("Region/City"), their current POSIX
+ * rule and region.  Designed to be built by both the ESP32 IDF and emscripten build
+ * tools so the clock and web GUI share the same list.
+ *
+ * Zones are referred to by their index in the (name sorted) table.  Each zone also has
+ * a stable ID that does not change when the table is regenerated for storage.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TZDB_H
+#define TZDB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+//
+// Constants
+//
+
+// Default zone
+#define TZDB_DEFAULT_ZONE        "America/Denver"
+
+// Maximum lengths (must match tzdb_gen.py)
+#define TZDB_NAME_MAX_LEN        63
+#define TZDB_RULE_MAX_LEN        63
+#define TZDB_CITY_LIST_MAX_LEN   4096
+
+// Not a zone ID
+#define TZDB_ID_NONE             0
+
+
+
+//
+// API
+//
+const char* tzdb_get_version();
+int tzdb_get_num_zones();
+int tzdb_get_num_regions();
+const char* tzdb_get_region_name(int region);
+int tzdb_get_region_zones(int region, int* first);
+int tzdb_get_city_list(int region, char* buf, int len);
+
+int tzdb_find(const char* name);
+int tzdb_find_id(uint16_t id);
+int tzdb_find_rule(const char* rule);
+
+bool tzdb_get_name(int zone, char* buf, int len);
+const char* tzdb_get_city(int zone);
+int tzdb_get_region(int zone);
+const char* tzdb_get_rule(int zone);
+uint16_t tzdb_get_id(int zone);
+
+#endif /* TZDB_H */
@@ -0,0 +1,1116 @@
+/*
+ * Compiled timezone database - generated by tzdb_gen.py from tzdata 2025b.  Do not edit.
+ *
+ * 435 zones in 10 regions using 93 rules (5334 string bytes)
+ *
+ * The timezone data is in the public domain.
+ */
+#include "tzdb_data.h"
+
+
+const char tzdb_version[] = "2025b";
+
+const uint16_t tzdb_num_regions = 10;
+const uint16_t tzdb_num_zones = 435;
+const uint16_t tzdb_num_rules = 93;
+
+const uint16_t tzdb_region_name[] = {
+	0,
+	7,
+	15,
+	26,
+	31,
+	40,
+	50,
+	54,
+	61,
+	68
+};
+
+const uint16_t tzdb_region_first[] = {
+	0,
+	52,
+	192,
+	203,
+	285,
+	295,
+	306,
+	334,
+	386,
+	397,
+	435
+};
+
+const tzdb_zone_entry_t tzdb_zone[] = {
+	{76, 0, 1},         // Africa/Abidjan
+	{84, 0, 2},         // Africa/Accra
+	{90, 1, 3},         // Africa/Addis_Ababa
+	{102, 2, 4},        // Africa/Algiers
+	{110, 1, 5},        // Africa/Asmara
+	{117, 0, 6},        // Africa/Bamako
+	{124, 3, 7},        // Africa/Bangui
+	{131, 0, 8},        // Africa/Banjul
+	{138, 0, 9},        // Africa/Bissau
+	{145, 4, 10},       // Africa/Blantyre
+	{154, 3, 11},       // Africa/Brazzaville
+	{166, 4, 12},       // Africa/Bujumbura
+	{176, 5, 13},       // Africa/Cairo
+	{182, 6, 14},       // Africa/Casablanca
+	{193, 7, 15},       // Africa/Ceuta
+	{199, 0, 16},       // Africa/Conakry
+	{207, 0, 17},       // Africa/Dakar
+	{213, 1, 18},       // Africa/Dar_es_Salaam
+	{227, 1, 19},       // Africa/Djibouti
+	{236, 3, 20},       // Africa/Douala
+	{243, 6, 21},       // Africa/El_Aaiun
+	{252, 0, 22},       // Africa/Freetown
+	{261, 4, 23},       // Africa/Gaborone
+	{270, 4, 24},       // Africa/Harare
+	{277, 8, 25},       // Africa/Johannesburg
+	{290, 4, 26},       // Africa/Juba
+	{295, 1, 27},       // Africa/Kampala
+	{303, 4, 28},       // Africa/Khartoum
+	{312, 4, 29},       // Africa/Kigali
+	{319, 3, 30},       // Africa/Kinshasa
+	{328, 3, 31},       // Africa/Lagos
+	{334, 3, 32},       // Africa/Libreville
+	{345, 0, 33},       // Africa/Lome
+	{350, 3, 34},       // Africa/Luanda
+	{357, 4, 35},       // Africa/Lubumbashi
+	{368, 4, 36},       // Africa/Lusaka
+	{375, 3, 37},       // Africa/Malabo
+	{382, 4, 38},       // Africa/Maputo
+	{389, 8, 39},       // Africa/Maseru
+	{396, 8, 40},       // Africa/Mbabane
+	{404, 1, 41},       // Africa/Mogadishu
+	{414, 0, 42},       // Africa/Monrovia
+	{423, 1, 43},       // Africa/Nairobi
+	{431, 3, 44},       // Africa/Ndjamena
+	{440, 3, 45},       // Africa/Niamey
+	{447, 0, 46},       // Africa/Nouakchott
+	{458, 0, 47},       // Africa/Ouagadougou
+	{470, 3, 48},       // Africa/Porto-Novo
+	{481, 0, 49},       // Africa/Sao_Tome
+	{490, 9, 50},       // Africa/Tripoli
+	{498, 2, 51},       // Africa/Tunis
+	{504, 4, 52},       // Africa/Windhoek
+	{513, 10, 53},      // America/Adak
+	{518, 11, 54},      // America/Anchorage
+	{528, 12, 55},      // America/Anguilla
+	{537, 12, 56},      // America/Antigua
+	{545, 13, 57},      // America/Araguaina
+	{555, 13, 58},      // America/Argentina/Buenos_Aires
+	{578, 13, 59},      // America/Argentina/Catamarca
+	{598, 13, 60},      // America/Argentina/Cordoba
+	{616, 13, 61},      // America/Argentina/Jujuy
+	{632, 13, 62},      // America/Argentina/La_Rioja
+	{651, 13, 63},      // America/Argentina/Mendoza
+	{669, 13, 64},      // America/Argentina/Rio_Gallegos
+	{692, 13, 65},      // America/Argentina/Salta
+	{708, 13, 66},      // America/Argentina/San_Juan
+	{727, 13, 67},      // America/Argentina/San_Luis
+	{746, 13, 68},      // America/Argentina/Tucuman
+	{764, 13, 69},      // America/Argentina/Ushuaia
+	{782, 12, 70},      // America/Aruba
+	{788, 13, 71},      // America/Asuncion
+	{797, 14, 72},      // America/Atikokan
+	{806, 13, 73},      // America/Bahia
+	{812, 15, 74},      // America/Bahia_Banderas
+	{827, 12, 75},      // America/Barbados
+	{836, 13, 76},      // America/Belem
+	{842, 15, 77},      // America/Belize
+	{849, 12, 78},      // America/Blanc-Sablon
+	{862, 16, 79},      // America/Boa_Vista
+	{872, 17, 80},      // America/Bogota
+	{879, 18, 81},      // America/Boise
+	{885, 18, 82},      // America/Cambridge_Bay
+	{899, 16, 83},      // America/Campo_Grande
+	{912, 14, 84},      // America/Cancun
+	{919, 16, 85},      // America/Caracas
+	{927, 13, 86},      // America/Cayenne
+	{935, 14, 87},      // America/Cayman
+	{942, 19, 88},      // America/Chicago
+	{950, 15, 89},      // America/Chihuahua
+	{960, 18, 90},      // America/Ciudad_Juarez
+	{974, 15, 91},      // America/Costa_Rica
+	{985, 13, 92},      // America/Coyhaique
+	{995, 20, 93},      // America/Creston
+	{1003, 16, 94},     // America/Cuiaba
+	{1010, 12, 95},     // America/Curacao
+	{1018, 0, 96},      // America/Danmarkshavn
+	{1031, 20, 97},     // America/Dawson
+	{1038, 20, 98},     // America/Dawson_Creek
+	{1051, 18, 99},     // America/Denver
+	{1058, 21, 100},    // America/Detroit
+	{1066, 12, 101},    // America/Dominica
+	{1075, 18, 102},    // America/Edmonton
+	{1084, 17, 103},    // America/Eirunepe
+	{1093, 15, 104},    // America/El_Salvador
+	{1105, 20, 105},    // America/Fort_Nelson
+	{1117, 13, 106},    // America/Fortaleza
+	{1127, 22, 107},    // America/Glace_Bay
+	{1137, 22, 108},    // America/Goose_Bay
+	{1147, 21, 109},    // America/Grand_Turk
+	{1158, 12, 110},    // America/Grenada
+	{1166, 12, 111},    // America/Guadeloupe
+	{1177, 15, 112},    // America/Guatemala
+	{1187, 17, 113},    // America/Guayaquil
+	{1197, 16, 114},    // America/Guyana
+	{1204, 22, 115},    // America/Halifax
+	{1212, 23, 116},    // America/Havana
+	{1219, 20, 117},    // America/Hermosillo
+	{1230, 21, 118},    // America/Indiana/Indianapolis
+	{1251, 19, 119},    // America/Indiana/Knox
+	{1264, 21, 120},    // America/Indiana/Marengo
+	{1280, 21, 121},    // America/Indiana/Petersburg
+	{1299, 19, 122},    // America/Indiana/Tell_City
+	{1317, 21, 123},    // America/Indiana/Vevay
+	{1331, 21, 124},    // America/Indiana/Vincennes
+	{1349, 21, 125},    // America/Indiana/Winamac
+	{1365, 18, 126},    // America/Inuvik
+	{1372, 21, 127},    // America/Iqaluit
+	{1380, 14, 128},    // America/Jamaica
+	{1388, 11, 129},    // America/Juneau
+	{1395, 21, 130},    // America/Kentucky/Louisville
+	{1415, 21, 131},    // America/Kentucky/Monticello
+	{1435, 16, 132},    // America/La_Paz
+	{1442, 17, 133},    // America/Lima
+	{1447, 24, 134},    // America/Los_Angeles
+	{1459, 13, 135},    // America/Maceio
+	{1466, 15, 136},    // America/Managua
+	{1474, 16, 137},    // America/Manaus
+	{1481, 12, 138},    // America/Martinique
+	{1492, 19, 139},    // America/Matamoros
+	{1502, 20, 140},    // America/Mazatlan
+	{1511, 19, 141},    // America/Menominee
+	{1521, 15, 142},    // America/Merida
+	{1528, 11, 143},    // America/Metlakatla
+	{1539, 15, 144},    // America/Mexico_City
+	{1551, 25, 145},    // America/Miquelon
+	{1560, 22, 146},    // America/Moncton
+	{1568, 15, 147},    // America/Monterrey
+	{1578, 13, 148},    // America/Montevideo
+	{1589, 12, 149},    // America/Montserrat
+	{1600, 21, 150},    // America/Nassau
+	{1607, 21, 151},    // America/New_York
+	{1616, 11, 152},    // America/Nome
+	{1621, 26, 153},    // America/Noronha
+	{1629, 19, 154},    // America/North_Dakota/Beulah
+	{1649, 19, 155},    // America/North_Dakota/Center
+	{1669, 19, 156},    // America/North_Dakota/New_Salem
+	{1692, 27, 157},    // America/Nuuk
+	{1697, 19, 158},    // America/Ojinaga
+	{1705, 14, 159},    // America/Panama
+	{1712, 13, 160},    // America/Paramaribo
+	{1723, 20, 161},    // America/Phoenix
+	{1731, 21, 162},    // America/Port-au-Prince
+	{1746, 12, 163},    // America/Port_of_Spain
+	{1760, 16, 164},    // America/Porto_Velho
+	{1772, 12, 165},    // America/Puerto_Rico
+	{1784, 13, 166},    // America/Punta_Arenas
+	{1797, 19, 167},    // America/Rankin_Inlet
+	{1810, 13, 168},    // America/Recife
+	{1817, 15, 169},    // America/Regina
+	{1824, 19, 170},    // America/Resolute
+	{1833, 17, 171},    // America/Rio_Branco
+	{1844, 13, 172},    // America/Santarem
+	{1853, 28, 173},    // America/Santiago
+	{1862, 12, 174},    // America/Santo_Domingo
+	{1876, 13, 175},    // America/Sao_Paulo
+	{1886, 27, 176},    // America/Scoresbysund
+	{1899, 11, 177},    // America/Sitka
+	{1905, 29, 178},    // America/St_Johns
+	{1914, 12, 179},    // America/St_Kitts
+	{1923, 12, 180},    // America/St_Lucia
+	{1932, 12, 181},    // America/St_Thomas
+	{1942, 12, 182},    // America/St_Vincent
+	{1953, 15, 183},    // America/Swift_Current
+	{1967, 15, 184},    // America/Tegucigalpa
+	{1979, 22, 185},    // America/Thule
+	{1985, 24, 186},    // America/Tijuana
+	{1993, 21, 187},    // America/Toronto
+	{2001, 12, 188},    // America/Tortola
+	{2009, 24, 189},    // America/Vancouver
+	{2019, 20, 190},    // America/Whitehorse
+	{2030, 19, 191},    // America/Winnipeg
+	{2039, 11, 192},    // America/Yakutat
+	{2047, 30, 193},    // Antarctica/Casey
+	{2053, 31, 194},    // Antarctica/Davis
+	{2059, 32, 195},    // Antarctica/DumontDUrville
+	{2074, 33, 196},    // Antarctica/Macquarie
+	{2084, 34, 197},    // Antarctica/Mawson
+	{2091, 35, 198},    // Antarctica/McMurdo
+	{2099, 13, 199},    // Antarctica/Palmer
+	{2106, 13, 200},    // Antarctica/Rothera
+	{2114, 36, 201},    // Antarctica/Syowa
+	{2120, 37, 202},    // Antarctica/Troll
+	{2126, 34, 203},    // Antarctica/Vostok
+	{2133, 36, 204},    // Asia/Aden
+	{2138, 34, 205},    // Asia/Almaty
+	{2145, 36, 206},    // Asia/Amman
+	{2151, 38, 207},    // Asia/Anadyr
+	{2158, 34, 208},    // Asia/Aqtau
+	{2164, 34, 209},    // Asia/Aqtobe
+	{2171, 34, 210},    // Asia/Ashgabat
+	{2180, 34, 211},    // Asia/Atyrau
+	{2187, 36, 212},    // Asia/Baghdad
+	{2195, 36, 213},    // Asia/Bahrain
+	{2203, 39, 214},    // Asia/Baku
+	{2208, 31, 215},    // Asia/Bangkok
+	{2216, 31, 216},    // Asia/Barnaul
+	{2224, 40, 217},    // Asia/Beirut
+	{2231, 41, 218},    // Asia/Bishkek
+	{2239, 30, 219},    // Asia/Brunei
+	{2246, 42, 220},    // Asia/Chita
+	{2252, 43, 221},    // Asia/Colombo
+	{2260, 36, 222},    // Asia/Damascus
+	{2269, 41, 223},    // Asia/Dhaka
+	{2275, 42, 224},    // Asia/Dili
+	{2280, 39, 225},    // Asia/Dubai
+	{2286, 34, 226},    // Asia/Dushanbe
+	{2295, 44, 227},    // Asia/Famagusta
+	{2305, 45, 228},    // Asia/Gaza
+	{2310, 45, 229},    // Asia/Hebron
+	{2317, 31, 230},    // Asia/Ho_Chi_Minh
+	{2329, 46, 231},    // Asia/Hong_Kong
+	{2339, 31, 232},    // Asia/Hovd
+	{2344, 30, 233},    // Asia/Irkutsk
+	{2352, 47, 234},    // Asia/Jakarta
+	{2360, 48, 235},    // Asia/Jayapura
+	{2369, 49, 236},    // Asia/Jerusalem
+	{2379, 50, 237},    // Asia/Kabul
+	{2385, 38, 238},    // Asia/Kamchatka
+	{2395, 51, 239},    // Asia/Karachi
+	{2403, 52, 240},    // Asia/Kathmandu
+	{2413, 42, 241},    // Asia/Khandyga
+	{2422, 53, 242},    // Asia/Kolkata
+	{2430, 31, 243},    // Asia/Krasnoyarsk
+	{2442, 30, 244},    // Asia/Kuala_Lumpur
+	{2455, 30, 245},    // Asia/Kuching
+	{2463, 36, 246},    // Asia/Kuwait
+	{2470, 54, 247},    // Asia/Macau
+	{2476, 55, 248},    // Asia/Magadan
+	{2484, 56, 249},    // Asia/Makassar
+	{2493, 57, 250},    // Asia/Manila
+	{2500, 39, 251},    // Asia/Muscat
+	{2507, 44, 252},    // Asia/Nicosia
+	{2515, 31, 253},    // Asia/Novokuznetsk
+	{2528, 31, 254},    // Asia/Novosibirsk
+	{2540, 41, 255},    // Asia/Omsk
+	{2545, 34, 256},    // Asia/Oral
+	{2550, 31, 257},    // Asia/Phnom_Penh
+	{2561, 47, 258},    // Asia/Pontianak
+	{2571, 58, 259},    // Asia/Pyongyang
+	{2581, 36, 260},    // Asia/Qatar
+	{2587, 34, 261},    // Asia/Qostanay
+	{2596, 34, 262},    // Asia/Qyzylorda
+	{2606, 36, 263},    // Asia/Riyadh
+	{2613, 55, 264},    // Asia/Sakhalin
+	{2622, 34, 265},    // Asia/Samarkand
+	{2632, 58, 266},    // Asia/Seoul
+	{2638, 54, 267},    // Asia/Shanghai
+	{2647, 30, 268},    // Asia/Singapore
+	{2657, 55, 269},    // Asia/Srednekolymsk
+	{2671, 54, 270},    // Asia/Taipei
+	{2678, 34, 271},    // Asia/Tashkent
+	{2687, 39, 272},    // Asia/Tbilisi
+	{2695, 59, 273},    // Asia/Tehran
+	{2702, 41, 274},    // Asia/Thimphu
+	{2710, 60, 275},    // Asia/Tokyo
+	{2716, 31, 276},    // Asia/Tomsk
+	{2722, 30, 277},    // Asia/Ulaanbaatar
+	{2734, 41, 278},    // Asia/Urumqi
+	{2741, 32, 279},    // Asia/Ust-Nera
+	{2750, 31, 280},    // Asia/Vientiane
+	{2760, 32, 281},    // Asia/Vladivostok
+	{2772, 42, 282},    // Asia/Yakutsk
+	{2780, 61, 283},    // Asia/Yangon
+	{2787, 34, 284},    // Asia/Yekaterinburg
+	{2801, 39, 285},    // Asia/Yerevan
+	{2809, 62, 286},    // Atlantic/Azores
+	{2816, 22, 287},    // Atlantic/Bermuda
+	{2824, 63, 288},    // Atlantic/Canary
+	{2831, 64, 289},    // Atlantic/Cape_Verde
+	{2842, 63, 290},    // Atlantic/Faroe
+	{2848, 63, 291},    // Atlantic/Madeira
+	{2856, 0, 292},     // Atlantic/Reykjavik
+	{2866, 26, 293},    // Atlantic/South_Georgia
+	{2880, 0, 294},     // Atlantic/St_Helena
+	{2890, 13, 295},    // Atlantic/Stanley
+	{2898, 65, 296},    // Australia/Adelaide
+	{2907, 66, 297},    // Australia/Brisbane
+	{2916, 65, 298},    // Australia/Broken_Hill
+	{2928, 67, 299},    // Australia/Darwin
+	{2935, 68, 300},    // Australia/Eucla
+	{2941, 33, 301},    // Australia/Hobart
+	{2948, 66, 302},    // Australia/Lindeman
+	{2957, 69, 303},    // Australia/Lord_Howe
+	{2967, 33, 304},    // Australia/Melbourne
+	{2977, 70, 305},    // Australia/Perth
+	{2983, 33, 306},    // Australia/Sydney
+	{2990, 0, 307},     // Etc/GMT
+	{2994, 64, 308},    // Etc/GMT+1
+	{3000, 71, 309},    // Etc/GMT+10
+	{3007, 72, 310},    // Etc/GMT+11
+	{3014, 73, 311},    // Etc/GMT+12
+	{3021, 26, 312},    // Etc/GMT+2
+	{3027, 13, 313},    // Etc/GMT+3
+	{3033, 16, 314},    // Etc/GMT+4
+	{3039, 17, 315},    // Etc/GMT+5
+	{3045, 74, 316},    // Etc/GMT+6
+	{3051, 75, 317},    // Etc/GMT+7
+	{3057, 76, 318},    // Etc/GMT+8
+	{3063, 77, 319},    // Etc/GMT+9
+	{3069, 6, 320},     // Etc/GMT-1
+	{3075, 32, 321},    // Etc/GMT-10
+	{3082, 55, 322},    // Etc/GMT-11
+	{3089, 38, 323},    // Etc/GMT-12
+	{3096, 78, 324},    // Etc/GMT-13
+	{3103, 79, 325},    // Etc/GMT-14
+	{3110, 80, 326},    // Etc/GMT-2
+	{3116, 36, 327},    // Etc/GMT-3
+	{3122, 39, 328},    // Etc/GMT-4
+	{3128, 34, 329},    // Etc/GMT-5
+	{3134, 41, 330},    // Etc/GMT-6
+	{3140, 31, 331},    // Etc/GMT-7
+	{3146, 30, 332},    // Etc/GMT-8
+	{3152, 42, 333},    // Etc/GMT-9
+	{3158, 81, 334},    // Etc/UTC
+	{3162, 7, 335},     // Europe/Amsterdam
+	{3172, 7, 336},     // Europe/Andorra
+	{3180, 39, 337},    // Europe/Astrakhan
+	{3190, 44, 338},    // Europe/Athens
+	{3197, 7, 339},     // Europe/Belgrade
+	{3206, 7, 340},     // Europe/Berlin
+	{3213, 7, 341},     // Europe/Brussels
+	{3222, 44, 342},    // Europe/Bucharest
+	{3232, 7, 343},     // Europe/Budapest
+	{3241, 82, 344},    // Europe/Chisinau
+	{3250, 7, 345},     // Europe/Copenhagen
+	{3261, 83, 346},    // Europe/Dublin
+	{3268, 7, 347},     // Europe/Gibraltar
+	{3278, 84, 348},    // Europe/Guernsey
+	{3287, 44, 349},    // Europe/Helsinki
+	{3296, 84, 350},    // Europe/Isle_of_Man
+	{3308, 36, 351},    // Europe/Istanbul
+	{3317, 84, 352},    // Europe/Jersey
+	{3324, 9, 353},     // Europe/Kaliningrad
+	{3336, 85, 354},    // Europe/Kirov
+	{3342, 44, 355},    // Europe/Kyiv
+	{3347, 63, 356},    // Europe/Lisbon
+	{3354, 7, 357},     // Europe/Ljubljana
+	{3364, 84, 358},    // Europe/London
+	{3371, 7, 359},     // Europe/Luxembourg
+	{3382, 7, 360},     // Europe/Madrid
+	{3389, 7, 361},     // Europe/Malta
+	{3395, 36, 362},    // Europe/Minsk
+	{3401, 7, 363},     // Europe/Monaco
+	{3408, 85, 364},    // Europe/Moscow
+	{3415, 7, 365},     // Europe/Oslo
+	{3420, 7, 366},     // Europe/Paris
+	{3426, 7, 367},     // Europe/Prague
+	{3433, 44, 368},    // Europe/Riga
+	{3438, 7, 369},     // Europe/Rome
+	{3443, 39, 370},    // Europe/Samara
+	{3450, 7, 371},     // Europe/Sarajevo
+	{3459, 39, 372},    // Europe/Saratov
+	{3467, 85, 373},    // Europe/Simferopol
+	{3478, 7, 374},     // Europe/Skopje
+	{3485, 44, 375},    // Europe/Sofia
+	{3491, 7, 376},     // Europe/Stockholm
+	{3501, 44, 377},    // Europe/Tallinn
+	{3509, 7, 378},     // Europe/Tirane
+	{3516, 39, 379},    // Europe/Ulyanovsk
+	{3526, 7, 380},     // Europe/Vaduz
+	{3532, 7, 381},     // Europe/Vienna
+	{3539, 44, 382},    // Europe/Vilnius
+	{3547, 85, 383},    // Europe/Volgograd
+	{3557, 7, 384},     // Europe/Warsaw
+	{3564, 7, 385},     // Europe/Zagreb
+	{3571, 7, 386},     // Europe/Zurich
+	{3578, 1, 387},     // Indian/Antananarivo
+	{3591, 41, 388},    // Indian/Chagos
+	{3598, 31, 389},    // Indian/Christmas
+	{3608, 61, 390},    // Indian/Cocos
+	{3614, 1, 391},     // Indian/Comoro
+	{3621, 34, 392},    // Indian/Kerguelen
+	{3631, 39, 393},    // Indian/Mahe
+	{3636, 34, 394},    // Indian/Maldives
+	{3645, 39, 395},    // Indian/Mauritius
+	{3655, 1, 396},     // Indian/Mayotte
+	{3663, 39, 397},    // Indian/Reunion
+	{3671, 78, 398},    // Pacific/Apia
+	{3676, 35, 399},    // Pacific/Auckland
+	{3685, 55, 400},    // Pacific/Bougainville
+	{3698, 86, 401},    // Pacific/Chatham
+	{3706, 32, 402},    // Pacific/Chuuk
+	{3712, 87, 403},    // Pacific/Easter
+	{3719, 55, 404},    // Pacific/Efate
+	{3725, 78, 405},    // Pacific/Fakaofo
+	{3733, 38, 406},    // Pacific/Fiji
+	{3738, 38, 407},    // Pacific/Funafuti
+	{3747, 74, 408},    // Pacific/Galapagos
+	{3757, 77, 409},    // Pacific/Gambier
+	{3765, 55, 410},    // Pacific/Guadalcanal
+	{3777, 88, 411},    // Pacific/Guam
+	{3782, 89, 412},    // Pacific/Honolulu
+	{3791, 78, 413},    // Pacific/Kanton
+	{3798, 79, 414},    // Pacific/Kiritimati
+	{3809, 55, 415},    // Pacific/Kosrae
+	{3816, 38, 416},    // Pacific/Kwajalein
+	{3826, 38, 417},    // Pacific/Majuro
+	{3833, 90, 418},    // Pacific/Marquesas
+	{3843, 91, 419},    // Pacific/Midway
+	{3850, 38, 420},    // Pacific/Nauru
+	{3856, 72, 421},    // Pacific/Niue
+	{3861, 92, 422},    // Pacific/Norfolk
+	{3869, 55, 423},    // Pacific/Noumea
+	{3876, 91, 424},    // Pacific/Pago_Pago
+	{3886, 42, 425},    // Pacific/Palau
+	{3892, 76, 426},    // Pacific/Pitcairn
+	{3901, 55, 427},    // Pacific/Pohnpei
+	{3909, 32, 428},    // Pacific/Port_Moresby
+	{3922, 71, 429},    // Pacific/Rarotonga
+	{3932, 88, 430},    // Pacific/Saipan
+	{3939, 71, 431},    // Pacific/Tahiti
+	{3946, 38, 432},    // Pacific/Tarawa
+	{3953, 78, 433},    // Pacific/Tongatapu
+	{3963, 38, 434},    // Pacific/Wake
+	{3968, 38, 435}     // Pacific/Wallis
+};
+
+const uint16_t tzdb_rule[] = {
+	3975,
+	3980,
+	3986,
+	3992,
+	3998,
+	4004,
+	4034,
+	4042,
+	4069,
+	4076,
+	4082,
+	4106,
+	4131,
+	4136,
+	4143,
+	4148,
+	4153,
+	4160,
+	4167,
+	4190,
+	4213,
+	4218,
+	4241,
+	4264,
+	4291,
+	4314,
+	4341,
+	4348,
+	4380,
+	4412,
+	4438,
+	4446,
+	4454,
+	4463,
+	4492,
+	4500,
+	4528,
+	4536,
+	4569,
+	4578,
+	4586,
+	4615,
+	4623,
+	4631,
+	4644,
+	4673,
+	4704,
+	4710,
+	4716,
+	4722,
+	4749,
+	4762,
+	4768,
+	4781,
+	4790,
+	4796,
+	4805,
+	4812,
+	4818,
+	4824,
+	4837,
+	4843,
+	4856,
+	4887,
+	4913,
+	4920,
+	4951,
+	4959,
+	4969,
+	4982,
+	5019,
+	5026,
+	5034,
+	5042,
+	5050,
+	5057,
+	5064,
+	5071,
+	5078,
+	5087,
+	5096,
+	5104,
+	5109,
+	5136,
+	5163,
+	5188,
+	5194,
+	5239,
+	5271,
+	5279,
+	5285,
+	5297,
+	5303
+};
+
+const char tzdb_strings[] =
+	"Africa\000"
+	"America\000"
+	"Antarctica\000"
+	"Asia\000"
+	"Atlantic\000"
+	"Australia\000"
+	"Etc\000"
+	"Europe\000"
+	"Indian\000"
+	"Pacific\000"
+	"Abidjan\000"
+	"Accra\000"
+	"Addis_Ababa\000"
+	"Algiers\000"
+	"Asmara\000"
+	"Bamako\000"
+	"Bangui\000"
+	"Banjul\000"
+	"Bissau\000"
+	"Blantyre\000"
+	"Brazzaville\000"
+	"Bujumbura\000"
+	"Cairo\000"
+	"Casablanca\000"
+	"Ceuta\000"
+	"Conakry\000"
+	"Dakar\000"
+	"Dar_es_Salaam\000"
+	"Djibouti\000"
+	"Douala\000"
+	"El_Aaiun\000"
+	"Freetown\000"
+	"Gaborone\000"
+	"Harare\000"
+	"Johannesburg\000"
+	"Juba\000"
+	"Kampala\000"
+	"Khartoum\000"
+	"Kigali\000"
+	"Kinshasa\000"
+	"Lagos\000"
+	"Libreville\000"
+	"Lome\000"
+	"Luanda\000"
+	"Lubumbashi\000"
+	"Lusaka\000"
+	"Malabo\000"
+	"Maputo\000"
+	"Maseru\000"
+	"Mbabane\000"
+	"Mogadishu\000"
+	"Monrovia\000"
+	"Nairobi\000"
+	"Ndjamena\000"
+	"Niamey\000"
+	"Nouakchott\000"
+	"Ouagadougou\000"
+	"Porto-Novo\000"
+	"Sao_Tome\000"
+	"Tripoli\000"
+	"Tunis\000"
+	"Windhoek\000"
+	"Adak\000"
+	"Anchorage\000"
+	"Anguilla\000"
+	"Antigua\000"
+	"Araguaina\000"
+	"Argentina/Buenos_Aires\000"
+	"Argentina/Catamarca\000"
+	"Argentina/Cordoba\000"
+	"Argentina/Jujuy\000"
+	"Argentina/La_Rioja\000"
+	"Argentina/Mendoza\000"
+	"Argentina/Rio_Gallegos\000"
+	"Argentina/Salta\000"
+	"Argentina/San_Juan\000"
+	"Argentina/San_Luis\000"
+	"Argentina/Tucuman\000"
+	"Argentina/Ushuaia\000"
+	"Aruba\000"
+	"Asuncion\000"
+	"Atikokan\000"
+	"Bahia\000"
+	"Bahia_Banderas\000"
+	"Barbados\000"
+	"Belem\000"
+	"Belize\000"
+	"Blanc-Sablon\000"
+	"Boa_Vista\000"
+	"Bogota\000"
+	"Boise\000"
+	"Cambridge_Bay\000"
+	"Campo_Grande\000"
+	"Cancun\000"
+	"Caracas\000"
+	"Cayenne\000"
+	"Cayman\000"
+	"Chicago\000"
+	"Chihuahua\000"
+	"Ciudad_Juarez\000"
+	"Costa_Rica\000"
+	"Coyhaique\000"
+	"Creston\000"
+	"Cuiaba\000"
+	"Curacao\000"
+	"Danmarkshavn\000"
+	"Dawson\000"
+	"Dawson_Creek\000"
+	"Denver\000"
+	"Detroit\000"
+	"Dominica\000"
+	"Edmonton\000"
+	"Eirunepe\000"
+	"El_Salvador\000"
+	"Fort_Nelson\000"
+	"Fortaleza\000"
+	"Glace_Bay\000"
+	"Goose_Bay\000"
+	"Grand_Turk\000"
+	"Grenada\000"
+	"Guadeloupe\000"
+	"Guatemala\000"
+	"Guayaquil\000"
+	"Guyana\000"
+	"Halifax\000"
+	"Havana\000"
+	"Hermosillo\000"
+	"Indiana/Indianapolis\000"
+	"Indiana/Knox\000"
+	"Indiana/Marengo\000"
+	"Indiana/Petersburg\000"
+	"Indiana/Tell_City\000"
+	"Indiana/Vevay\000"
+	"Indiana/Vincennes\000"
+	"Indiana/Winamac\000"
+	"Inuvik\000"
+	"Iqaluit\000"
+	"Jamaica\000"
+	"Juneau\000"
+	"Kentucky/Louisville\000"
+	"Kentucky/Monticello\000"
+	"La_Paz\000"
+	"Lima\000"
+	"Los_Angeles\000"
+	"Maceio\000"
+	"Managua\000"
+	"Manaus\000"
+	"Martinique\000"
+	"Matamoros\000"
+	"Mazatlan\000"
+	"Menominee\000"
+	"Merida\000"
+	"Metlakatla\000"
+	"Mexico_City\000"
+	"Miquelon\000"
+	"Moncton\000"
+	"Monterrey\000"
+	"Montevideo\000"
+	"Montserrat\000"
+	"Nassau\000"
+	"New_York\000"
+	"Nome\000"
+	"Noronha\000"
+	"North_Dakota/Beulah\000"
+	"North_Dakota/Center\000"
+	"North_Dakota/New_Salem\000"
+	"Nuuk\000"
+	"Ojinaga\000"
+	"Panama\000"
+	"Paramaribo\000"
+	"Phoenix\000"
+	"Port-au-Prince\000"
+	"Port_of_Spain\000"
+	"Porto_Velho\000"
+	"Puerto_Rico\000"
+	"Punta_Arenas\000"
+	"Rankin_Inlet\000"
+	"Recife\000"
+	"Regina\000"
+	"Resolute\000"
+	"Rio_Branco\000"
+	"Santarem\000"
+	"Santiago\000"
+	"Santo_Domingo\000"
+	"Sao_Paulo\000"
+	"Scoresbysund\000"
+	"Sitka\000"
+	"St_Johns\000"
+	"St_Kitts\000"
+	"St_Lucia\000"
+	"St_Thomas\000"
+	"St_Vincent\000"
+	"Swift_Current\000"
+	"Tegucigalpa\000"
+	"Thule\000"
+	"Tijuana\000"
+	"Toronto\000"
+	"Tortola\000"
+	"Vancouver\000"
+	"Whitehorse\000"
+	"Winnipeg\000"
+	"Yakutat\000"
+	"Casey\000"
+	"Davis\000"
+	"DumontDUrville\000"
+	"Macquarie\000"
+	"Mawson\000"
+	"McMurdo\000"
+	"Palmer\000"
+	"Rothera\000"
+	"Syowa\000"
+	"Troll\000"
+	"Vostok\000"
+	"Aden\000"
+	"Almaty\000"
+	"Amman\000"
+	"Anadyr\000"
+	"Aqtau\000"
+	"Aqtobe\000"
+	"Ashgabat\000"
+	"Atyrau\000"
+	"Baghdad\000"
+	"Bahrain\000"
+	"Baku\000"
+	"Bangkok\000"
+	"Barnaul\000"
+	"Beirut\000"
+	"Bishkek\000"
+	"Brunei\000"
+	"Chita\000"
+	"Colombo\000"
+	"Damascus\000"
+	"Dhaka\000"
+	"Dili\000"
+	"Dubai\000"
+	"Dushanbe\000"
+	"Famagusta\000"
+	"Gaza\000"
+	"Hebron\000"
+	"Ho_Chi_Minh\000"
+	"Hong_Kong\000"
+	"Hovd\000"
+	"Irkutsk\000"
+	"Jakarta\000"
+	"Jayapura\000"
+	"Jerusalem\000"
+	"Kabul\000"
+	"Kamchatka\000"
+	"Karachi\000"
+	"Kathmandu\000"
+	"Khandyga\000"
+	"Kolkata\000"
+	"Krasnoyarsk\000"
+	"Kuala_Lumpur\000"
+	"Kuching\000"
+	"Kuwait\000"
+	"Macau\000"
+	"Magadan\000"
+	"Makassar\000"
+	"Manila\000"
+	"Muscat\000"
+	"Nicosia\000"
+	"Novokuznetsk\000"
+	"Novosibirsk\000"
+	"Omsk\000"
+	"Oral\000"
+	"Phnom_Penh\000"
+	"Pontianak\000"
+	"Pyongyang\000"
+	"Qatar\000"
+	"Qostanay\000"
+	"Qyzylorda\000"
+	"Riyadh\000"
+	"Sakhalin\000"
+	"Samarkand\000"
+	"Seoul\000"
+	"Shanghai\000"
+	"Singapore\000"
+	"Srednekolymsk\000"
+	"Taipei\000"
+	"Tashkent\000"
+	"Tbilisi\000"
+	"Tehran\000"
+	"Thimphu\000"
+	"Tokyo\000"
+	"Tomsk\000"
+	"Ulaanbaatar\000"
+	"Urumqi\000"
+	"Ust-Nera\000"
+	"Vientiane\000"
+	"Vladivostok\000"
+	"Yakutsk\000"
+	"Yangon\000"
+	"Yekaterinburg\000"
+	"Yerevan\000"
+	"Azores\000"
+	"Bermuda\000"
+	"Canary\000"
+	"Cape_Verde\000"
+	"Faroe\000"
+	"Madeira\000"
+	"Reykjavik\000"
+	"South_Georgia\000"
+	"St_Helena\000"
+	"Stanley\000"
+	"Adelaide\000"
+	"Brisbane\000"
+	"Broken_Hill\000"
+	"Darwin\000"
+	"Eucla\000"
+	"Hobart\000"
+	"Lindeman\000"
+	"Lord_Howe\000"
+	"Melbourne\000"
+	"Perth\000"
+	"Sydney\000"
+	"GMT\000"
+	"GMT+1\000"
+	"GMT+10\000"
+	"GMT+11\000"
+	"GMT+12\000"
+	"GMT+2\000"
+	"GMT+3\000"
+	"GMT+4\000"
+	"GMT+5\000"
+	"GMT+6\000"
+	"GMT+7\000"
+	"GMT+8\000"
+	"GMT+9\000"
+	"GMT-1\000"
+	"GMT-10\000"
+	"GMT-11\000"
+	"GMT-12\000"
+	"GMT-13\000"
+	"GMT-14\000"
+	"GMT-2\000"
+	"GMT-3\000"
+	"GMT-4\000"
+	"GMT-5\000"
+	"GMT-6\000"
+	"GMT-7\000"
+	"GMT-8\000"
+	"GMT-9\000"
+	"UTC\000"
+	"Amsterdam\000"
+	"Andorra\000"
+	"Astrakhan\000"
+	"Athens\000"
+	"Belgrade\000"
+	"Berlin\000"
+	"Brussels\000"
+	"Bucharest\000"
+	"Budapest\000"
+	"Chisinau\000"
+	"Copenhagen\000"
+	"Dublin\000"
+	"Gibraltar\000"
+	"Guernsey\000"
+	"Helsinki\000"
+	"Isle_of_Man\000"
+	"Istanbul\000"
+	"Jersey\000"
+	"Kaliningrad\000"
+	"Kirov\000"
+	"Kyiv\000"
+	"Lisbon\000"
+	"Ljubljana\000"
+	"London\000"
+	"Luxembourg\000"
+	"Madrid\000"
+	"Malta\000"
+	"Minsk\000"
+	"Monaco\000"
+	"Moscow\000"
+	"Oslo\000"
+	"Paris\000"
+	"Prague\000"
+	"Riga\000"
+	"Rome\000"
+	"Samara\000"
+	"Sarajevo\000"
+	"Saratov\000"
+	"Simferopol\000"
+	"Skopje\000"
+	"Sofia\000"
+	"Stockholm\000"
+	"Tallinn\000"
+	"Tirane\000"
+	"Ulyanovsk\000"
+	"Vaduz\000"
+	"Vienna\000"
+	"Vilnius\000"
+	"Volgograd\000"
+	"Warsaw\000"
+	"Zagreb\000"
+	"Zurich\000"
+	"Antananarivo\000"
+	"Chagos\000"
+	"Christmas\000"
+	"Cocos\000"
+	"Comoro\000"
+	"Kerguelen\000"
+	"Mahe\000"
+	"Maldives\000"
+	"Mauritius\000"
+	"Mayotte\000"
+	"Reunion\000"
+	"Apia\000"
+	"Auckland\000"
+	"Bougainville\000"
+	"Chatham\000"
+	"Chuuk\000"
+	"Easter\000"
+	"Efate\000"
+	"Fakaofo\000"
+	"Fiji\000"
+	"Funafuti\000"
+	"Galapagos\000"
+	"Gambier\000"
+	"Guadalcanal\000"
+	"Guam\000"
+	"Honolulu\000"
+	"Kanton\000"
+	"Kiritimati\000"
+	"Kosrae\000"
+	"Kwajalein\000"
+	"Majuro\000"
+	"Marquesas\000"
+	"Midway\000"
+	"Nauru\000"
+	"Niue\000"
+	"Norfolk\000"
+	"Noumea\000"
+	"Pago_Pago\000"
+	"Palau\000"
+	"Pitcairn\000"
+	"Pohnpei\000"
+	"Port_Moresby\000"
+	"Rarotonga\000"
+	"Saipan\000"
+	"Tahiti\000"
+	"Tarawa\000"
+	"Tongatapu\000"
+	"Wake\000"
+	"Wallis\000"
+	"GMT0\000"
+	"EAT-3\000"
+	"CET-1\000"
+	"WAT-1\000"
+	"CAT-2\000"
+	"EET-2EEST,M4.5.5/0,M10.5.4/24\000"
+	"<+01>-1\000"
+	"CET-1CEST,M3.5.0,M10.5.0/3\000"
+	"SAST-2\000"
+	"EET-2\000"
+	"HST10HDT,M3.2.0,M11.1.0\000"
+	"AKST9AKDT,M3.2.0,M11.1.0\000"
+	"AST4\000"
+	"<-03>3\000"
+	"EST5\000"
+	"CST6\000"
+	"<-04>4\000"
+	"<-05>5\000"
+	"MST7MDT,M3.2.0,M11.1.0\000"
+	"CST6CDT,M3.2.0,M11.1.0\000"
+	"MST7\000"
+	"EST5EDT,M3.2.0,M11.1.0\000"
+	"AST4ADT,M3.2.0,M11.1.0\000"
+	"CST5CDT,M3.2.0/0,M11.1.0/1\000"
+	"PST8PDT,M3.2.0,M11.1.0\000"
+	"<-03>3<-02>,M3.2.0,M11.1.0\000"
+	"<-02>2\000"
+	"<-02>2<-01>,M3.5.0/-1,M10.5.0/0\000"
+	"<-04>4<-03>,M9.1.6/24,M4.1.6/24\000"
+	"NST3:30NDT,M3.2.0,M11.1.0\000"
+	"<+08>-8\000"
+	"<+07>-7\000"
+	"<+10>-10\000"
+	"AEST-10AEDT,M10.1.0,M4.1.0/3\000"
+	"<+05>-5\000"
+	"NZST-12NZDT,M9.5.0,M4.1.0/3\000"
+	"<+03>-3\000"
+	"<+00>0<+02>-2,M3.5.0/1,M10.5.0/3\000"
+	"<+12>-12\000"
+	"<+04>-4\000"
+	"EET-2EEST,M3.5.0/0,M10.5.0/0\000"
+	"<+06>-6\000"
+	"<+09>-9\000"
+	"<+0530>-5:30\000"
+	"EET-2EEST,M3.5.0/3,M10.5.0/4\000"
+	"EET-2EEST,M3.4.4/50,M10.4.4/50\000"
+	"HKT-8\000"
+	"WIB-7\000"
+	"WIT-9\000"
+	"IST-2IDT,M3.4.4/26,M10.5.0\000"
+	"<+0430>-4:30\000"
+	"PKT-5\000"
+	"<+0545>-5:45\000"
+	"IST-5:30\000"
+	"CST-8\000"
+	"<+11>-11\000"
+	"WITA-8\000"
+	"PST-8\000"
+	"KST-9\000"
+	"<+0330>-3:30\000"
+	"JST-9\000"
+	"<+0630>-6:30\000"
+	"<-01>1<+00>,M3.5.0/0,M10.5.0/1\000"
+	"WET0WEST,M3.5.0/1,M10.5.0\000"
+	"<-01>1\000"
+	"ACST-9:30ACDT,M10.1.0,M4.1.0/3\000"
+	"AEST-10\000"
+	"ACST-9:30\000"
+	"<+0845>-8:45\000"
+	"<+1030>-10:30<+11>-11,M10.1.0,M4.1.0\000"
+	"AWST-8\000"
+	"<-10>10\000"
+	"<-11>11\000"
+	"<-12>12\000"
+	"<-06>6\000"
+	"<-07>7\000"
+	"<-08>8\000"
+	"<-09>9\000"
+	"<+13>-13\000"
+	"<+14>-14\000"
+	"<+02>-2\000"
+	"UTC0\000"
+	"EET-2EEST,M3.5.0,M10.5.0/3\000"
+	"IST-1GMT0,M10.5.0,M3.5.0/1\000"
+	"GMT0BST,M3.5.0/1,M10.5.0\000"
+	"MSK-3\000"
+	"<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45\000"
+	"<-06>6<-05>,M9.1.6/22,M4.1.6/22\000"
+	"ChST-10\000"
+	"HST10\000"
+	"<-0930>9:30\000"
+	"SST11\000"
+	"<+11>-11<+12>,M10.1.0,M4.1.0/3\000";
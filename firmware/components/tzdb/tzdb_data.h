@@ -0,0 +1,53 @@
+/*
+ * Compiled timezone database tables (generated into tzdb_data.c by tzdb_gen.py).
+ * Only used by tzdb.c.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TZDB_DATA_H
+#define TZDB_DATA_H
+
+#include <stdint.h>
+
+
+
+//
+// Typedefs
+//
+
+// Zone entry (in name order)
+typedef struct {
+	uint16_t city;                     // City name offset in tzdb_strings
+	uint16_t rule;                     // Index in tzdb_rule
+	uint16_t id;                       // Stable zone ID
+} tzdb_zone_entry_t;
+
+
+
+//
+// Tables
+//
+extern const char tzdb_version[];
+extern const uint16_t tzdb_num_regions;
+extern const uint16_t tzdb_num_zones;
+extern const uint16_t tzdb_num_rules;
+extern const uint16_t tzdb_region_name[];     // Region name offsets in tzdb_strings
+extern const uint16_t tzdb_region_first[];    // First zone of each region (plus the end)
+extern const tzdb_zone_entry_t tzdb_zone[];
+extern const uint16_t tzdb_rule[];            // POSIX rule offsets in tzdb_strings
+extern const char tzdb_strings[];
+
+#endif /* TZDB_DATA_H */
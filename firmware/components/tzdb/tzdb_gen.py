@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+#
+# Compile the IANA timezone database into tzdb_data.c
+#
+# Reads the zone names from tzdata.zi and the current POSIX rule for each zone from
+# the footer of its compiled TZif file.  Zones are grouped by region (the first part
+# of the name) and sorted by name so the firmware and web GUI can binary search them.
+# Identical rules and all names are stored once in a string pool.
+#
+# Zone IDs are stored in the clock's persistent storage so they must never change.
+# tzdb_ids.txt records every ID ever assigned - new zones are appended and zones
+# removed from tzdata keep their (now unused) ID.
+#
+# Usage: tzdb_gen.py [zoneinfo directory (default /usr/share/zoneinfo)]
+#
+# Copyright 2024-2025 Dan Julio
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+import os
+import sys
+
+# Regions offered (zones outside these, such as "EST5EDT" or "Factory", are skipped)
+REGIONS = ["Africa", "America", "Antarctica", "Asia", "Atlantic", "Australia",
+           "Etc", "Europe", "Indian", "Pacific"]
+
+# Must match tzdb.h
+MAX_RULE_LEN = 63
+MAX_CITY_LIST_LEN = 4096
+
+my_dir = os.path.dirname(os.path.abspath(__file__))
+ids_path = os.path.join(my_dir, "tzdb_ids.txt")
+out_path = os.path.join(my_dir, "tzdb_data.c")
+
+
+def read_zone_names(zoneinfo):
+	version = "unknown"
+	names = []
+	with open(os.path.join(zoneinfo, "tzdata.zi")) as f:
+		for line in f:
+			if line.startswith("# version"):
+				version = line.split()[2]
+			elif line.startswith("Z "):
+				names.append(line.split()[1])
+	return version, names
+
+
+def read_posix_rule(zoneinfo, name):
+	with open(os.path.join(zoneinfo, name), "rb") as f:
+		data = f.read()
+	if data[:4] != b"TZif" or data[4:5] < b"2":
+		raise ValueError(name + ": no POSIX footer (TZif version 1)")
+	footer = data[data.rindex(b"\n", 0, len(data) - 1) + 1:-1].decode("ascii")
+	if footer == "":
+		raise ValueError(name + ": empty POSIX footer")
+	if len(footer) > MAX_RULE_LEN:
+		raise ValueError(name + ": POSIX rule too long")
+	return footer
+
+
+def read_ids():
+	ids = {}
+	if os.path.exists(ids_path):
+		with open(ids_path) as f:
+			for line in f:
+				line = line.strip()
+				if line == "" or line.startswith("#"):
+					continue
+				i, name = line.split()
+				ids[name] = int(i)
+	return ids
+
+
+def write_ids(ids):
+	with open(ids_path, "w") as f:
+		f.write("# Stable timezone IDs stored by the clock - generated by tzdb_gen.py.\n")
+		f.write("# Never edit or remove a line, IDs of deleted zones are not reused.\n")
+		for name, i in sorted(ids.items(), key=lambda x: x[1]):
+			f.write("%d %s\n" % (i, name))
+
+
+def c_string(s):
+	return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '\\000"'
+
+
+def main():
+	zoneinfo = sys.argv[1] if len(sys.argv) > 1 else "/usr/share/zoneinfo"
+
+	version, names = read_zone_names(zoneinfo)
+
+	zones = []
+	for name in names:
+		parts = name.split("/", 1)
+		if len(parts) != 2 or parts[0] not in REGIONS:
+			continue
+		zones.append((REGIONS.index(parts[0]), parts[1], name, read_posix_rule(zoneinfo, name)))
+	zones.sort(key=lambda z: z[2])
+
+	# Assign IDs to new zones
+	ids = read_ids()
+	next_id = max(ids.values(), default=0) + 1
+	for z in zones:
+		if z[2] not in ids:
+			ids[z[2]] = next_id
+			next_id += 1
+	if next_id > 0xFFFF:
+		raise ValueError("Out of zone IDs")
+
+	# String pool: regions, then cities, then unique rules
+	pool = []
+	pool_len = 0
+
+	def add_string(s):
+		nonlocal pool_len
+		offset = pool_len
+		pool.append(s)
+		pool_len += len(s) + 1
+		return offset
+
+	region_off = [add_string(r) for r in REGIONS]
+	city_off = [add_string(z[1]) for z in zones]
+	rules = []
+	for z in zones:
+		if z[3] not in rules:
+			rules.append(z[3])
+	rule_off = [add_string(r) for r in rules]
+	if pool_len > 0xFFFF:
+		raise ValueError("String pool too large")
+
+	# Zones are sorted by name so each region's zones are contiguous
+	region_first = []
+	for r in range(len(REGIONS)):
+		region_first.append(len([z for z in zones if z[0] < r]))
+	region_first.append(len(zones))
+
+	for r in range(len(REGIONS)):
+		list_len = sum(len(z[1]) + 1 for z in zones if z[0] == r)
+		if list_len > MAX_CITY_LIST_LEN:
+			print("Warning: %s city list is %d bytes" % (REGIONS[r], list_len))
+
+	with open(out_path, "w") as f:
+		f.write("/*\n")
+		f.write(" * Compiled timezone database - generated by tzdb_gen.py from tzdata %s.  Do not edit.\n" % version)
+		f.write(" *\n")
+		f.write(" * %d zones in %d regions using %d rules (%d string bytes)\n" % (len(zones), len(REGIONS), len(rules), pool_len))
+		f.write(" *\n")
+		f.write(" * The timezone data is in the public domain.\n")
+		f.write(" */\n")
+		f.write('#include "tzdb_data.h"\n\n\n')
+
+		f.write('const char tzdb_version[] = "%s";\n\n' % version)
+		f.write("const uint16_t tzdb_num_regions = %d;\n" % len(REGIONS))
+		f.write("const uint16_t tzdb_num_zones = %d;\n" % len(zones))
+		f.write("const uint16_t tzdb_num_rules = %d;\n\n" % len(rules))
+
+		f.write("const uint16_t tzdb_region_name[] = {\n")
+		f.write(",\n".join("\t%d" % o for o in region_off))
+		f.write("\n};\n\n")
+
+		f.write("const uint16_t tzdb_region_first[] = {\n")
+		f.write(",\n".join("\t%d" % o for o in region_first))
+		f.write("\n};\n\n")
+
+		f.write("const tzdb_zone_entry_t tzdb_zone[] = {\n")
+		for i, z in enumerate(zones):
+			entry = "{%d, %d, %d}%s" % (city_off[i], rules.index(z[3]), ids[z[2]], "," if i < len(zones) - 1 else "")
+			f.write("\t%-20s// %s\n" % (entry, z[2]))
+		f.write("};\n\n")
+
+		f.write("const uint16_t tzdb_rule[] = {\n")
+		f.write(",\n".join("\t%d" % o for o in rule_off))
+		f.write("\n};\n\n")
+
+		f.write("const char tzdb_strings[] =\n")
+		f.write("\n".join("\t" + c_string(s) for s in pool))
+		f.write(";\n")
+
+	write_ids(ids)
+	print("%s: %d zones, %d rules, %d string bytes" % (version, len(zones), len(rules), pool_len))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,420 @@
+/*
+ * Alarms - one-shot and weekly alarms that can power the clock on from off
+ *
+ * Fire times are computed in local time (mktime) so they follow DST transitions and
+ * are recomputed whenever the alarms, timezone or clock change.  The RTC value for the
+ * earliest fire time comes from the RTC drift model so a clock that has been off for a
+ * long time still wakes on time.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "alarm_utilities.h"
+#include "gcore.h"
+#include "rtc.h"
+#include "rtc_drift.h"
+#include "time_utilities.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint32_t t;                        // Next fire time
+	uint8_t index;                     // Alarm
+} alarm_queue_entry_t;
+
+
+
+//
+// Variables
+//
+static const char* TAG = "alarm";
+
+static SemaphoreHandle_t alarm_mutex;
+
+// Our copy of the alarm settings
+static alarm_config_t alarm_config;
+static uint32_t alarm_generation = PS_GENERATION_NONE;
+
+// Timezone and clock step state the queue was built with
+static uint32_t tz_generation;
+static uint32_t step_count;
+
+// Enabled alarms as a binary min-heap on fire time
+static alarm_queue_entry_t queue[ALARM_NUM];
+static int queue_len = 0;
+
+// Alarms up to this time have been handled (0 = clock not valid yet)
+static uint32_t eval_secs = 0;
+
+// Most recent notification
+static char alarm_msg[ALARM_MSG_MAX_LEN+1];
+
+static alarm_stats_t alarm_stats;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _alarm_rebuild(uint32_t now);
+static void _alarm_fire(uint32_t now);
+static uint32_t _alarm_next(const ps_alarm_t* a, uint32_t after);
+static void _alarm_program_rtc(bool force);
+static void _alarm_save();
+static void _alarm_queue_push(uint32_t t, int index);
+static void _alarm_queue_pop();
+static void _alarm_queue_sift_down(int i);
+
+
+
+//
+// API
+//
+bool alarm_init()
+{
+	uint32_t now;
+	gcore_snapshot_t snap;
+	
+	alarm_mutex = xSemaphoreCreateMutex();
+	if (alarm_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+	
+	// Alarms that powered us on may have passed while we started
+	if (gcore_get_snapshot(&snap, 0)) {
+		alarm_stats.alarm_wake = (snap.status & GCORE_PWR_ON_ALARM_MASK) != 0;
+	}
+	
+	now = (uint32_t) time(NULL);
+	if (now >= ALARM_MIN_VALID_SECS) {
+		eval_secs = alarm_stats.alarm_wake ? now - ALARM_LATE_SECS : now;
+	}
+	
+	alarm_stats.next_index = -1;
+	if (alarm_stats.alarm_wake) {
+		ESP_LOGI(TAG, "Powered on by alarm");
+	}
+	
+	return true;
+}
+
+
+/**
+ * Called periodically to fire alarms that are due.  Returns true if an alarm fired
+ * (alarm_get_msg() has its notification).
+ */
+bool alarm_eval()
+{
+	bool fired = false;
+	uint32_t now;
+	
+	now = (uint32_t) time(NULL);
+	if (now < ALARM_MIN_VALID_SECS) {
+		return false;
+	}
+	
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	
+	// Fire times are recomputed after any change that could move them
+	if (ps_get_config_if_changed(PS_CONFIG_TYPE_ALARM, &alarm_config, &alarm_generation) ||
+	    (time_get_tz_generation() != tz_generation) ||
+	    (time_get_step_count() != step_count)) {
+		
+		tz_generation = time_get_tz_generation();
+		step_count = time_get_step_count();
+		_alarm_rebuild(now);
+	}
+	
+	while ((queue_len > 0) && (queue[0].t <= now)) {
+		_alarm_fire(now);
+		fired = true;
+	}
+	
+	// Held after a small step back so alarms already fired are not repeated
+	if (now > eval_secs) {
+		eval_secs = now;
+	} else if ((eval_secs - now) > ALARM_STEP_BACK_SECS) {
+		eval_secs = now;
+	}
+	
+	if (fired) {
+		_alarm_program_rtc(false);
+	}
+	
+	xSemaphoreGive(alarm_mutex);
+	
+	return fired;
+}
+
+
+void alarm_get_msg(char* msg)
+{
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	strcpy(msg, alarm_msg);
+	xSemaphoreGive(alarm_mutex);
+}
+
+
+/**
+ * Program the gCore alarm with the earliest alarm using the current drift model.
+ * Returns true if there is an alarm to wake for.
+ */
+bool alarm_prepare_shutdown()
+{
+	bool armed;
+	
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	_alarm_program_rtc(true);
+	armed = (alarm_stats.rtc_alarm_secs != 0);
+	xSemaphoreGive(alarm_mutex);
+	
+	if (armed) {
+		ESP_LOGI(TAG, "Wake for alarm %d at %" PRIu32, alarm_stats.next_index + 1, alarm_stats.next_secs);
+	}
+	
+	return armed;
+}
+
+
+void alarm_get_stats(alarm_stats_t* stats)
+{
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	*stats = alarm_stats;
+	xSemaphoreGive(alarm_mutex);
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Compute the next fire time of each enabled alarm.  Alarms that were due since the last
+ * evaluation are kept (up to ALARM_LATE_SECS late) so they fire now.
+ */
+static void _alarm_rebuild(uint32_t now)
+{
+	int i;
+	uint32_t from, after, t;
+	ps_alarm_t* a;
+	
+	if (eval_secs == 0) {
+		from = now;
+	} else if (eval_secs > now) {
+		// Clock stepped back
+		from = ((eval_secs - now) <= ALARM_STEP_BACK_SECS) ? eval_secs : now;
+	} else if ((now - eval_secs) > ALARM_LATE_SECS) {
+		from = now - ALARM_LATE_SECS;
+	} else {
+		from = eval_secs;
+	}
+	
+	queue_len = 0;
+	alarm_stats.enabled = 0;
+	for (i=0; i<ALARM_NUM; i++) {
+		a = &alarm_config.alarm[i];
+		if (!a->enable) continue;
+		alarm_stats.enabled++;
+		
+		// Never fire for a time before the alarm was set
+		after = (a->armed > from) ? a->armed : from;
+		
+		// Count alarms skipped by a forward step
+		if ((eval_secs != 0) && (eval_secs < from) && (a->armed < from)) {
+			t = _alarm_next(a, (a->armed > eval_secs) ? a->armed : eval_secs);
+			if ((t != 0) && (t <= from)) {
+				ESP_LOGI(TAG, "Alarm %d skipped by clock step", i + 1);
+				alarm_stats.dropped++;
+			}
+		}
+		
+		t = _alarm_next(a, after);
+		if (t != 0) {
+			_alarm_queue_push(t, i);
+		}
+	}
+	
+	alarm_stats.rebuilds++;
+	_alarm_program_rtc(false);
+}
+
+
+/**
+ * Fire the alarm at the top of the queue and requeue it (one-shot alarms are disabled)
+ */
+static void _alarm_fire(uint32_t now)
+{
+	int index;
+	gui_config_t gui_config;
+	ps_alarm_t* a;
+	
+	index = queue[0].index;
+	a = &alarm_config.alarm[index];
+	
+	ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config);
+	if (gui_config.hour_mode_24) {
+		sprintf(alarm_msg, "Alarm %02u:%02u", a->hour, a->minute);
+	} else {
+		sprintf(alarm_msg, "Alarm %u:%02u %s", (a->hour % 12 == 0) ? 12 : a->hour % 12, a->minute,
+		        (a->hour < 12) ? "AM" : "PM");
+	}
+	ESP_LOGI(TAG, "Alarm %d fired %" PRIu32 " sec late", index + 1, now - queue[0].t);
+	alarm_stats.fired++;
+	
+	if (a->days == 0) {
+		a->enable = false;
+		_alarm_queue_pop();
+		alarm_stats.enabled--;
+		_alarm_save();
+	} else {
+		queue[0].t = _alarm_next(a, queue[0].t);
+		if (queue[0].t == 0) {
+			_alarm_queue_pop();
+		} else {
+			_alarm_queue_sift_down(0);
+		}
+	}
+}
+
+
+/**
+ * First time after the given time the alarm matches in local time (0 if none).  A time
+ * skipped by a DST change resolves to the equivalent time after the change and a
+ * repeated time matches once.
+ */
+static uint32_t _alarm_next(const ps_alarm_t* a, uint32_t after)
+{
+	int d;
+	time_t t;
+	time_t after_t = (time_t) after;
+	struct tm base, te;
+	
+	localtime_r(&after_t, &base);
+	for (d=0; d<=7; d++) {
+		te = base;
+		te.tm_mday += d;
+		te.tm_hour = a->hour;
+		te.tm_min = a->minute;
+		te.tm_sec = 0;
+		te.tm_isdst = -1;
+		t = mktime(&te);
+		if ((t > after_t) && ((a->days == 0) || ((a->days & (1 << te.tm_wday)) != 0))) {
+			return (uint32_t) t;
+		}
+	}
+	
+	return 0;
+}
+
+
+/**
+ * Load the gCore alarm with the RTC value for the earliest alarm (less the wake lead)
+ * if it has changed
+ */
+static void _alarm_program_rtc(bool force)
+{
+	uint32_t rtc_secs = 0;
+	
+	if (queue_len > 0) {
+		alarm_stats.next_index = queue[0].index;
+		alarm_stats.next_secs = queue[0].t;
+		rtc_secs = rtc_drift_get_rtc_secs(queue[0].t - ALARM_WAKE_LEAD_SECS);
+	} else {
+		alarm_stats.next_index = -1;
+		alarm_stats.next_secs = 0;
+	}
+	
+	if (force || (rtc_secs != alarm_stats.rtc_alarm_secs)) {
+		if ((rtc_secs != 0) && !rtc_set_alarm_secs(rtc_secs)) {
+			ESP_LOGE(TAG, "Could not set RTC alarm");
+			rtc_secs = 0;
+		}
+		alarm_stats.rtc_alarm_secs = rtc_secs;
+	}
+}
+
+
+static void _alarm_save()
+{
+	(void) ps_set_config(PS_CONFIG_TYPE_ALARM, &alarm_config);
+	alarm_generation = ps_get_config_generation(PS_CONFIG_TYPE_ALARM);
+}
+
+
+static void _alarm_queue_push(uint32_t t, int index)
+{
+	int i, parent;
+	alarm_queue_entry_t e;
+	
+	if (queue_len >= ALARM_NUM) return;
+	
+	// Sift up
+	e.t = t;
+	e.index = (uint8_t) index;
+	i = queue_len++;
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (queue[parent].t <= e.t) break;
+		queue[i] = queue[parent];
+		i = parent;
+	}
+	queue[i] = e;
+}
+
+
+static void _alarm_queue_pop()
+{
+	if (queue_len == 0) return;
+	
+	queue[0] = queue[--queue_len];
+	_alarm_queue_sift_down(0);
+}
+
+
+/**
+ * Restore the heap order below entry i after its time increased
+ */
+static void _alarm_queue_sift_down(int i)
+{
+	int child;
+	alarm_queue_entry_t e;
+	
+	if (queue_len == 0) return;
+	
+	e = queue[i];
+	while ((child = 2*i + 1) < queue_len) {
+		if (((child + 1) < queue_len) && (queue[child + 1].t < queue[child].t)) {
+			child++;
+		}
+		if (e.t <= queue[child].t) break;
+		queue[i] = queue[child];
+		i = child;
+	}
+	queue[i] = e;
+}
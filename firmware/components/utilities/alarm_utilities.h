@@ -0,0 +1,97 @@
+/*
+ * Alarms - one-shot and weekly alarms that can power the clock on from off
+ *
+ * Enabled alarms are kept in a queue ordered by their next fire time.  The earliest is
+ * programmed into the gCore RTC alarm so the EFM8 can power the system on in time for it.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ALARM_UTILITIES_H
+#define ALARM_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps_utilities.h"
+
+
+//
+// Constants
+//
+#define ALARM_NUM                PS_NUM_ALARMS
+
+// Day masks
+#define ALARM_DAY_SUN            0x01
+#define ALARM_DAY_SAT            0x40
+#define ALARM_DAYS_ALL           0x7F
+#define ALARM_DAYS_WEEKDAYS      0x3E
+
+// Alarms are not evaluated until the clock has been set (2024-01-01)
+#define ALARM_MIN_VALID_SECS     1704067200
+
+// The gCore alarm is set this early so the system has started when the alarm fires
+#define ALARM_WAKE_LEAD_SECS     15
+
+// An alarm is still fired when this late (after an alarm power-on or a forward clock step).
+// Alarms skipped by larger steps are dropped.
+#define ALARM_LATE_SECS          120
+
+// Alarms already fired are not repeated when the clock steps back this much or less.  A
+// larger step means the clock was wrong and alarms are computed from the corrected time.
+#define ALARM_STEP_BACK_SECS     3600
+
+// On-screen notification duration (seconds)
+#define ALARM_NOTIFY_SECS        60
+
+// Notification message
+#define ALARM_MSG_MAX_LEN        31
+
+// Command packet - one entry per alarm
+//   uint8_t enable
+//   uint8_t hour
+//   uint8_t minute
+//   uint8_t days
+#define ALARM_CMD_ENTRY_LEN      4
+#define ALARM_CMD_LEN            (ALARM_NUM * ALARM_CMD_ENTRY_LEN)
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint8_t enabled;                   // Alarms in the queue
+	int8_t next_index;                 // Next alarm to fire (-1 for none)
+	uint32_t next_secs;                // Its fire time
+	uint32_t rtc_alarm_secs;           // Value programmed into the gCore alarm (0 = none)
+	uint32_t fired;                    // Alarms fired since boot
+	uint32_t dropped;                  // Alarms skipped by a clock step
+	uint32_t rebuilds;                 // Queue rebuilds
+	bool alarm_wake;                   // The system was powered on by the gCore alarm
+} alarm_stats_t;
+
+
+
+//
+// API
+//
+bool alarm_init();
+bool alarm_eval();
+void alarm_get_msg(char* msg);
+bool alarm_prepare_shutdown();
+void alarm_get_stats(alarm_stats_t* stats);
+
+#endif /* ALARM_UTILITIES_H */
@@ -22,12 +22,16 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "alarm_utilities.h"
 #include "cmd_handlers.h"
 #include "cmd_utilities.h"
+#include "power_history.h"
 #include "ps_utilities.h"
 #include "sys_info.h"
 #include "sys_utilities.h"
+#include "task_stats.h"
 #include "time_utilities.h"
+#include "tzdb.h"
 #include <string.h>
 #include "ctrl_task.h"
 #include "web_task.h"
@@ -67,6 +71,27 @@ static bool net_config_structs_eq(net_config_t* s1, net_config_t* s2);
 //
 // API
 //
+void cmd_handler_get_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	int i, n = 0;
+	alarm_config_t alarm_config;
+	
+	ps_get_config(PS_CONFIG_TYPE_ALARM, &alarm_config);
+	
+	// Pack the byte array - the response handler must unpack in the same order
+	for (i=0; i<ALARM_NUM; i++) {
+		send_buf[n++] = (uint8_t) alarm_config.alarm[i].enable;
+		send_buf[n++] = alarm_config.alarm[i].hour;
+		send_buf[n++] = alarm_config.alarm[i].minute;
+		send_buf[n++] = alarm_config.alarm[i].days;
+	}
+	
+	if (!cmd_send_binary(CMD_RSP, CMD_ALARM, ALARM_CMD_LEN, send_buf)) {
+		ESP_LOGE(TAG, "Couldn't send alarms");
+	}
+}
+
+
 void cmd_handler_get_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	gui_config_t gui_config;
@@ -89,6 +114,27 @@ void cmd_handler_get_mode(cmd_data_t data_type, uint32_t len, uint8_t* data)
 }
 
 
+void cmd_handler_get_power_hist(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	int tier;
+	uint32_t start;
+	uint32_t max_count;
+	uint32_t rsp_len;
+	uint8_t* rsp;
+	
+	if ((data_type == CMD_DATA_BINARY) && (len == POWER_HIST_QUERY_LEN)) {
+		tier = (int) ntohl(*((uint32_t*) &data[0]));
+		start = ntohl(*((uint32_t*) &data[4]));
+		max_count = ntohl(*((uint32_t*) &data[8]));
+		
+		rsp = power_history_get_packet(tier, start, max_count, &rsp_len);
+		if (!cmd_send_binary(CMD_RSP, CMD_POWER_HIST, rsp_len, rsp)) {
+			ESP_LOGE(TAG, "Couldn't send power history");
+		}
+	}
+}
+
+
 void cmd_handler_get_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	if (!cmd_send_string(CMD_RSP, CMD_SYS_INFO, sys_info_get_string())) {
@@ -97,6 +143,14 @@ void cmd_handler_get_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
 }
 
 
+void cmd_handler_get_task_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	if (!cmd_send_string(CMD_RSP, CMD_TASK_INFO, task_stats_get_string())) {
+		ESP_LOGE(TAG, "Couldn't send task_info");
+	}
+}
+
+
 void cmd_handler_get_time(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	// Get the current time
@@ -121,12 +175,16 @@ void cmd_handler_get_time(cmd_data_t data_type, uint32_t len, uint8_t* data)
 
 void cmd_handler_get_timezone(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
+	char name[TZDB_NAME_MAX_LEN+1];
 	tz_config_t tz_config;
 	
 	// Get the current timezone configuration
 	ps_get_config(PS_CONFIG_TYPE_TZ, &tz_config);
+	if (!tzdb_get_name(tzdb_find_id(tz_config.zone_id), name, sizeof(name))) {
+		name[0] = 0;
+	}
 	
-	if (!(cmd_send_string(CMD_RSP, CMD_TIMEZONE, tz_config.tz))) {
+	if (!(cmd_send_string(CMD_RSP, CMD_TIMEZONE, name))) {
 		ESP_LOGE(TAG, "Couldn't send timezone");
 	}
 }
@@ -159,6 +217,42 @@ void cmd_handler_get_wifi(cmd_data_t data_type, uint32_t len, uint8_t* data)
 }
 
 
+void cmd_handler_set_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	int i, n = 0;
+	alarm_config_t alarm_config;
+	ps_alarm_t a;
+	
+	if ((data_type == CMD_DATA_BINARY) && (len == ALARM_CMD_LEN)) {
+		ps_get_config(PS_CONFIG_TYPE_ALARM, &alarm_config);
+		
+		// Unpack in same order as loaded
+		for (i=0; i<ALARM_NUM; i++) {
+			a.enable = (bool) data[n++];
+			a.hour = data[n++];
+			a.minute = data[n++];
+			a.days = data[n++] & ALARM_DAYS_ALL;
+			if ((a.hour > 23) || (a.minute > 59)) {
+				ESP_LOGE(TAG, "Illegal alarm %d time %u:%u", i + 1, a.hour, a.minute);
+				return;
+			}
+			
+			// An alarm that is changed or enabled is (re)armed now so it only fires in the future
+			if (a.enable && (!alarm_config.alarm[i].enable || (a.hour != alarm_config.alarm[i].hour) ||
+			    (a.minute != alarm_config.alarm[i].minute) || (a.days != alarm_config.alarm[i].days))) {
+				a.armed = (uint32_t) time(NULL);
+			} else {
+				a.armed = alarm_config.alarm[i].armed;
+			}
+			alarm_config.alarm[i] = a;
+		}
+		
+		// alarm_utilities picks up the change
+		ps_set_config(PS_CONFIG_TYPE_ALARM, &alarm_config);
+	}
+}
+
+
 void cmd_handler_set_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	gui_config_t gui_config;
@@ -166,10 +260,9 @@ void cmd_handler_set_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data
 	if ((data_type == CMD_DATA_INT32) && (len == 4)) {
 		ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config);
 		gui_config.lcd_brightness = ntohl(*((uint32_t*) &data[0]));
-		ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config);
 		
-		// Update ctrl_task to change the backlight level
-		xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_UPD_BACKLIGHT, eSetBits);
+		// ctrl_task is subscribed to changes and will update the backlight level
+		ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config);
 	}
 }
 
@@ -215,15 +308,26 @@ void cmd_handler_set_time(cmd_data_t data_type, uint32_t len, uint8_t* data)
 
 void cmd_handler_set_timezone(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
+	int zone;
 	tz_config_t tz_config;
 	
 	if (data_type == CMD_DATA_STRING) {
+		// Only zones we know are accepted.  Older web GUIs send a POSIX rule
+		// instead of a zone name so map that to its zone.
+		zone = tzdb_find((char*) data);
+		if (zone < 0) {
+			zone = tzdb_find_rule((char*) data);
+		}
+		if (zone < 0) {
+			ESP_LOGE(TAG, "Unknown timezone %s", (char*) data);
+			return;
+		}
+		
 		ps_get_config(PS_CONFIG_TYPE_TZ, &tz_config);
-		if (strcmp(tz_config.tz, (char*) data) != 0) {
-			strncpy(tz_config.tz, (char*) data, PS_TZ_MAX_LEN);
-			tz_config.tz[PS_TZ_MAX_LEN] = 0;
+		if (tz_config.zone_id != tzdb_get_id(zone)) {
+			tz_config.zone_id = tzdb_get_id(zone);
 			ps_set_config(PS_CONFIG_TYPE_TZ, &tz_config);
-			time_timezone_set(tz_config.tz);
+			time_timezone_set(tzdb_get_rule(zone));
 		}
 	}
 }
@@ -252,11 +356,8 @@ void cmd_handler_set_wifi(cmd_data_t data_type, uint32_t len, uint8_t* data)
 		for (i=0; i<4; i++) new_net_config.sta_netmask[i] = data[n++];
 		
 		if (!net_config_structs_eq(&orig_net_config, &new_net_config)) {
-			// Update PS if changed
+			// Update PS if changed (ctrl_task is subscribed to changes and will restart the network)
 			ps_set_config(PS_CONFIG_TYPE_NET, &new_net_config);
-			
-			// Notify ctrl_task to restart the network
-			xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_RESTART_NETWORK, eSetBits);
 		}
 	}
 }
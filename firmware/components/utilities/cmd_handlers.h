@@ -28,13 +28,17 @@
 //
 // API
 //
+void cmd_handler_get_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_mode(cmd_data_t data_type, uint32_t len, uint8_t* data);
+void cmd_handler_get_power_hist(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data);
+void cmd_handler_get_task_info(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_time(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_timezone(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_get_wifi(cmd_data_t data_type, uint32_t len, uint8_t* data);
 
+void cmd_handler_set_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_set_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_set_mode(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_set_poweroff(cmd_data_t data_type, uint32_t len, uint8_t* data);
@@ -0,0 +1,264 @@
+/*
+ * Local NTP stand-in
+ *
+ * Each server has its own task and answers one request at a time.  The request path
+ * delay is simulated before the receive timestamp is taken and the response path delay
+ * after the transmit timestamp so the client sees a real round trip.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "ntp_standin.h"
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+
+//
+// Internal constants
+//
+#define STANDIN_PKT_LEN          48
+#define STANDIN_UNIX_OFFSET      2208988800ULL
+#define STANDIN_PRECISION        -20
+
+
+
+//
+// Variables
+//
+static const char* TAG = "ntp_standin";
+
+static ntp_standin_config_t standin_config[NTP_STANDIN_MAX_SERVERS];
+static ntp_standin_stats_t standin_stats[NTP_STANDIN_MAX_SERVERS];
+static int standin_num_servers = 0;
+
+static SemaphoreHandle_t standin_mutex = NULL;
+
+// Reference clock: system time (uSec) at esp_timer time 0
+static int64_t standin_ref_usec;
+
+
+
+//
+// Internal functions
+//
+static void _standin_task(void* args);
+static void _standin_delay(int msec);
+static void _standin_put_ts(uint8_t* p, int32_t offset_msec);
+
+
+
+//
+// API
+//
+/**
+ * Start num_servers servers on consecutive ports from config->port, all with config
+ * (the default config if NULL).  Servers that are already running keep their current
+ * config so a client restarting them doesn't undo changes made for a test.
+ */
+bool ntp_standin_start(const ntp_standin_config_t* config, int num_servers)
+{
+	int i;
+	struct timeval tv;
+	ntp_standin_config_t def_config = NTP_STANDIN_DEFAULT_CONFIG;
+	
+	if (standin_mutex != NULL) {
+		// Already running
+		return true;
+	}
+	
+	if (num_servers > NTP_STANDIN_MAX_SERVERS) num_servers = NTP_STANDIN_MAX_SERVERS;
+	if (config == NULL) config = &def_config;
+	for (i=0; i<num_servers; i++) {
+		standin_config[i] = *config;
+		standin_config[i].port = config->port + i;
+	}
+	
+	gettimeofday(&tv, NULL);
+	standin_ref_usec = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+	
+	standin_mutex = xSemaphoreCreateMutex();
+	if (standin_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+	
+	for (i=0; i<num_servers; i++) {
+		if (xTaskCreatePinnedToCore(&_standin_task, "ntp_standin", NTP_STANDIN_TASK_STACK, (void*) (intptr_t) i,
+		                            NTP_STANDIN_TASK_PRIO, NULL, NTP_STANDIN_TASK_CORE) != pdPASS) {
+			ESP_LOGE(TAG, "Could not start task");
+			break;
+		}
+		standin_num_servers++;
+	}
+	
+	return (standin_num_servers == num_servers);
+}
+
+
+/**
+ * Change a simulated server.  The port is only used when the stand-in starts.
+ */
+void ntp_standin_set_config(int index, const ntp_standin_config_t* config)
+{
+	if ((config == NULL) || (standin_mutex == NULL)) return;
+	if ((index < 0) || (index >= standin_num_servers)) return;
+	
+	xSemaphoreTake(standin_mutex, portMAX_DELAY);
+	standin_config[index].offset_msec = config->offset_msec;
+	standin_config[index].delay_msec = config->delay_msec;
+	standin_config[index].asym_msec = config->asym_msec;
+	standin_config[index].jitter_msec = config->jitter_msec;
+	standin_config[index].stratum = config->stratum;
+	standin_config[index].loss_pct = config->loss_pct;
+	xSemaphoreGive(standin_mutex);
+}
+
+
+void ntp_standin_get_stats(int index, ntp_standin_stats_t* stats)
+{
+	if ((standin_mutex == NULL) || (index < 0) || (index >= standin_num_servers)) {
+		memset(stats, 0, sizeof(ntp_standin_stats_t));
+		return;
+	}
+	
+	xSemaphoreTake(standin_mutex, portMAX_DELAY);
+	*stats = standin_stats[index];
+	xSemaphoreGive(standin_mutex);
+}
+
+
+
+//
+// Internal functions
+//
+static void _standin_task(void* args)
+{
+	int index = (int) (intptr_t) args;
+	int len;
+	int sock;
+	int path_msec;
+	ntp_standin_config_t cfg;
+	socklen_t from_len;
+	struct sockaddr_in addr;
+	struct sockaddr_in from;
+	uint8_t pkt[STANDIN_PKT_LEN];
+	
+	ESP_LOGI(TAG, "Start task on port %d", standin_config[index].port);
+	
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		ESP_LOGE(TAG, "Could not create socket");
+		vTaskDelete(NULL);
+	}
+	
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(standin_config[index].port);
+	if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		ESP_LOGE(TAG, "Could not bind port %d", standin_config[index].port);
+		close(sock);
+		vTaskDelete(NULL);
+	}
+	
+	while (1) {
+		from_len = sizeof(from);
+		len = recvfrom(sock, pkt, sizeof(pkt), 0, (struct sockaddr*) &from, &from_len);
+		if ((len < STANDIN_PKT_LEN) || ((pkt[0] & 0x07) != 3)) {
+			continue;
+		}
+		
+		xSemaphoreTake(standin_mutex, portMAX_DELAY);
+		cfg = standin_config[index];
+		standin_stats[index].requests++;
+		xSemaphoreGive(standin_mutex);
+		
+		if ((esp_random() % 100) < cfg.loss_pct) {
+			xSemaphoreTake(standin_mutex, portMAX_DELAY);
+			standin_stats[index].dropped++;
+			xSemaphoreGive(standin_mutex);
+			continue;
+		}
+		
+		// Request path
+		path_msec = cfg.delay_msec / 2 + cfg.asym_msec;
+		if (cfg.jitter_msec != 0) path_msec += esp_random() % (cfg.jitter_msec + 1);
+		_standin_delay(path_msec);
+		
+		// Response: the client's transmit timestamp becomes the origin timestamp
+		memcpy(&pkt[24], &pkt[40], 8);
+		pkt[0] = (0 << 6) | (4 << 3) | 4;
+		pkt[1] = cfg.stratum;
+		pkt[2] = 6;
+		pkt[3] = (uint8_t) STANDIN_PRECISION;
+		memset(&pkt[4], 0, 8);
+		pkt[10] = 0x04;                    // Root dispersion ~15 mSec (16.16 seconds)
+		memcpy(&pkt[12], (cfg.stratum == 0) ? "RATE" : "TEST", 4);
+		if (cfg.stratum == 0) {
+			memset(&pkt[16], 0, 8);
+			memset(&pkt[32], 0, 16);
+		} else {
+			_standin_put_ts(&pkt[16], cfg.offset_msec);
+			_standin_put_ts(&pkt[32], cfg.offset_msec);
+			_standin_put_ts(&pkt[40], cfg.offset_msec);
+		}
+		
+		// Response path
+		path_msec = cfg.delay_msec / 2 - cfg.asym_msec;
+		if (cfg.jitter_msec != 0) path_msec += esp_random() % (cfg.jitter_msec + 1);
+		_standin_delay(path_msec);
+		
+		if (sendto(sock, pkt, sizeof(pkt), 0, (struct sockaddr*) &from, from_len) == sizeof(pkt)) {
+			xSemaphoreTake(standin_mutex, portMAX_DELAY);
+			standin_stats[index].replies++;
+			xSemaphoreGive(standin_mutex);
+		}
+	}
+}
+
+
+static void _standin_delay(int msec)
+{
+	if (msec > 0) {
+		vTaskDelay(pdMS_TO_TICKS(msec));
+	}
+}
+
+
+/**
+ * Store the reference time plus offset as an NTP timestamp
+ */
+static void _standin_put_ts(uint8_t* p, int32_t offset_msec)
+{
+	int64_t usec;
+	uint32_t secs, frac;
+	
+	usec = standin_ref_usec + esp_timer_get_time() + (int64_t) offset_msec * 1000;
+	secs = (uint32_t) (usec / 1000000 + STANDIN_UNIX_OFFSET);
+	frac = (uint32_t) (((uint64_t) (usec % 1000000) << 32) / 1000000);
+	*(uint32_t*) &p[0] = htonl(secs);
+	*(uint32_t*) &p[4] = htonl(frac);
+}
@@ -0,0 +1,86 @@
+/*
+ * Local NTP stand-in
+ *
+ * Minimal NTP servers for testing the SNTP client without network access.  Each one
+ * answers requests with a reference clock plus a configurable offset and simulates
+ * network delay, path asymmetry, jitter, packet loss and kiss-o'-death responses.
+ * The reference clock is the system time when the stand-in started advanced by
+ * esp_timer so corrections the client makes to the system time don't move it.
+ * Enabled in the client by setting SNTP_STANDIN_PORT.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _NTP_STANDIN_H
+#define _NTP_STANDIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Constants
+//
+#define NTP_STANDIN_DEF_PORT     12300
+
+// Servers on consecutive ports (enough for the client to vote out a falseticker)
+#define NTP_STANDIN_MAX_SERVERS  3
+
+// Task
+#define NTP_STANDIN_TASK_STACK   2560
+#define NTP_STANDIN_TASK_PRIO    1
+#define NTP_STANDIN_TASK_CORE    0
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint16_t port;                     // First server's port
+	int32_t offset_msec;               // Served time - reference time
+	uint16_t delay_msec;               // Round trip network delay
+	int16_t asym_msec;                 // Added to the request path, taken from the response path
+	uint16_t jitter_msec;              // Random added delay on each path (0 - jitter)
+	uint8_t stratum;                   // 0 sends kiss-o'-death responses
+	uint8_t loss_pct;                  // Requests dropped
+} ntp_standin_config_t;
+
+#define NTP_STANDIN_DEFAULT_CONFIG { \
+	.port = NTP_STANDIN_DEF_PORT,    \
+	.offset_msec = 0,                \
+	.delay_msec = 20,                \
+	.asym_msec = 0,                  \
+	.jitter_msec = 5,                \
+	.stratum = 2,                    \
+	.loss_pct = 0                    \
+}
+
+typedef struct {
+	uint32_t requests;
+	uint32_t replies;
+	uint32_t dropped;
+} ntp_standin_stats_t;
+
+
+
+//
+// API
+//
+bool ntp_standin_start(const ntp_standin_config_t* config, int num_servers);
+void ntp_standin_set_config(int index, const ntp_standin_config_t* config);
+void ntp_standin_get_stats(int index, ntp_standin_stats_t* stats);
+
+#endif /* _NTP_STANDIN_H */
@@ -0,0 +1,272 @@
+/*
+ * Power history - Keep battery voltage, load current, USB voltage/current and charge
+ * state at three resolutions (1 second for an hour, 1 minute for a day and 15 minutes
+ * for a month) so power problems can be diagnosed after the fact.
+ *
+ * ctrl_task adds each battery update.  Each tier has an accumulator that is closed
+ * into the tier's ring buffer when its interval ends and is then added to the next
+ * tier's accumulator, so downsampling is incremental and each sample carries the
+ * min/max/average of the measurements it covers.  The ring buffers are in PSRAM.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <arpa/inet.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "power_history.h"
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint32_t t;                            // Uptime (seconds) at the start of the interval
+	uint16_t avg[POWER_HIST_NUM_CH];
+	uint16_t min[POWER_HIST_NUM_CH];
+	uint16_t max[POWER_HIST_NUM_CH];
+	uint8_t charge;
+} power_hist_sample_t;
+
+typedef struct {
+	uint32_t t;
+	uint32_t count;
+	uint32_t sum[POWER_HIST_NUM_CH];
+	uint16_t min[POWER_HIST_NUM_CH];
+	uint16_t max[POWER_HIST_NUM_CH];
+	uint8_t charge;
+} power_hist_acc_t;
+
+typedef struct {
+	power_hist_sample_t* samples;
+	int len;
+	int push_index;
+	int count;
+	uint32_t interval;
+	power_hist_acc_t acc;
+} power_hist_tier_t;
+
+
+
+//
+// Variables
+//
+static const char* TAG = "power_history";
+
+static power_hist_tier_t tiers[POWER_HIST_NUM_TIERS] = {
+	{NULL, POWER_HIST_SEC_LEN, 0, 0, POWER_HIST_SEC_INTERVAL, {0}},
+	{NULL, POWER_HIST_MIN_LEN, 0, 0, POWER_HIST_MIN_INTERVAL, {0}},
+	{NULL, POWER_HIST_15MIN_LEN, 0, 0, POWER_HIST_15MIN_INTERVAL, {0}}
+};
+
+static SemaphoreHandle_t hist_mutex;
+
+// Response packet
+static uint8_t* rsp_buf;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _power_history_add_tier(int tier, const power_hist_sample_t* s);
+static void _power_history_close_acc(power_hist_tier_t* tp, power_hist_sample_t* s);
+static uint8_t* _power_history_pack16(uint8_t* p, uint16_t v);
+
+
+
+//
+// API
+//
+bool power_history_init()
+{
+	int i;
+
+	hist_mutex = xSemaphoreCreateMutex();
+	if (hist_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+
+	for (i=0; i<POWER_HIST_NUM_TIERS; i++) {
+		tiers[i].samples = (power_hist_sample_t*) heap_caps_malloc(tiers[i].len * sizeof(power_hist_sample_t), MALLOC_CAP_SPIRAM);
+		if (tiers[i].samples == NULL) {
+			ESP_LOGE(TAG, "Could not allocate tier %d", i);
+			return false;
+		}
+	}
+
+	rsp_buf = (uint8_t*) heap_caps_malloc(POWER_HIST_RSP_MAX_LEN, MALLOC_CAP_SPIRAM);
+	if (rsp_buf == NULL) {
+		ESP_LOGE(TAG, "Could not allocate response buffer");
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Called by ctrl_task with each battery status update
+ */
+void power_history_add(const batt_status_t* bs)
+{
+	power_hist_sample_t s;
+
+	s.t = (uint32_t) (esp_timer_get_time() / 1000000);
+	s.avg[POWER_HIST_CH_VB] = (uint16_t) (bs->batt_voltage * 1000.0 + 0.5);
+	s.avg[POWER_HIST_CH_IL] = bs->load_ma;
+	s.avg[POWER_HIST_CH_VU] = (uint16_t) (bs->usb_voltage * 1000.0 + 0.5);
+	s.avg[POWER_HIST_CH_IU] = bs->usb_ma;
+	memcpy(s.min, s.avg, sizeof(s.avg));
+	memcpy(s.max, s.avg, sizeof(s.avg));
+	s.charge = (uint8_t) bs->charge_state;
+
+	xSemaphoreTake(hist_mutex, portMAX_DELAY);
+	_power_history_add_tier(POWER_HIST_TIER_SEC, &s);
+	xSemaphoreGive(hist_mutex);
+}
+
+
+/**
+ * Build a response packet containing up to max_count samples from tier starting with
+ * the first sample at or after start.  Returns a pointer to the packet and its length.
+ */
+uint8_t* power_history_get_packet(int tier, uint32_t start, uint32_t max_count, uint32_t* len)
+{
+	int i, n, first, num;
+	uint8_t* p;
+	power_hist_tier_t* tp;
+	power_hist_sample_t* s;
+
+	if ((tier < 0) || (tier >= POWER_HIST_NUM_TIERS)) {
+		tier = POWER_HIST_TIER_SEC;
+		max_count = 0;
+	}
+	if (max_count > POWER_HIST_MAX_QUERY) max_count = POWER_HIST_MAX_QUERY;
+	tp = &tiers[tier];
+
+	xSemaphoreTake(hist_mutex, portMAX_DELAY);
+
+	// Find the oldest sample at or after start (samples are in time order)
+	first = (tp->push_index - tp->count + tp->len) % tp->len;
+	for (i=0; i<tp->count; i++) {
+		if (tp->samples[(first + i) % tp->len].t >= start) break;
+	}
+	num = tp->count - i;
+	if (num > max_count) num = max_count;
+	first = (first + i) % tp->len;
+
+	p = rsp_buf;
+	*(uint32_t*) &p[0] = htonl((uint32_t) tier);
+	*(uint32_t*) &p[4] = htonl((uint32_t) (esp_timer_get_time() / 1000000));
+	*(uint32_t*) &p[8] = htonl((uint32_t) time(NULL));
+	*(uint32_t*) &p[12] = htonl(tp->interval);
+	*(uint32_t*) &p[16] = htonl((uint32_t) num);
+	p += POWER_HIST_RSP_HDR_LEN;
+
+	for (n=0; n<num; n++) {
+		s = &tp->samples[(first + n) % tp->len];
+		*(uint32_t*) p = htonl(s->t);
+		p += 4;
+		for (i=0; i<POWER_HIST_NUM_CH; i++) p = _power_history_pack16(p, s->avg[i]);
+		for (i=0; i<POWER_HIST_NUM_CH; i++) p = _power_history_pack16(p, s->min[i]);
+		for (i=0; i<POWER_HIST_NUM_CH; i++) p = _power_history_pack16(p, s->max[i]);
+		p = _power_history_pack16(p, (uint16_t) s->charge);
+	}
+
+	xSemaphoreGive(hist_mutex);
+
+	*len = (uint32_t) (p - rsp_buf);
+	return rsp_buf;
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Add a sample to a tier's accumulator, first closing the accumulator into the tier
+ * (and passing it up to the next tier) if the sample starts a new interval.
+ */
+static void _power_history_add_tier(int tier, const power_hist_sample_t* s)
+{
+	int i;
+	power_hist_tier_t* tp = &tiers[tier];
+	power_hist_acc_t* ap = &tp->acc;
+	power_hist_sample_t closed;
+
+	if ((ap->count != 0) && ((s->t / tp->interval) != (ap->t / tp->interval))) {
+		_power_history_close_acc(tp, &closed);
+		if ((tier + 1) < POWER_HIST_NUM_TIERS) {
+			_power_history_add_tier(tier + 1, &closed);
+		}
+	}
+
+	if (ap->count == 0) {
+		ap->t = s->t - (s->t % tp->interval);
+		for (i=0; i<POWER_HIST_NUM_CH; i++) {
+			ap->sum[i] = 0;
+			ap->min[i] = s->min[i];
+			ap->max[i] = s->max[i];
+		}
+	}
+
+	for (i=0; i<POWER_HIST_NUM_CH; i++) {
+		ap->sum[i] += s->avg[i];
+		if (s->min[i] < ap->min[i]) ap->min[i] = s->min[i];
+		if (s->max[i] > ap->max[i]) ap->max[i] = s->max[i];
+	}
+	ap->charge = s->charge;
+	ap->count++;
+}
+
+
+static void _power_history_close_acc(power_hist_tier_t* tp, power_hist_sample_t* s)
+{
+	int i;
+	power_hist_acc_t* ap = &tp->acc;
+
+	s->t = ap->t;
+	for (i=0; i<POWER_HIST_NUM_CH; i++) {
+		s->avg[i] = (uint16_t) ((ap->sum[i] + ap->count/2) / ap->count);
+		s->min[i] = ap->min[i];
+		s->max[i] = ap->max[i];
+	}
+	s->charge = ap->charge;
+	ap->count = 0;
+
+	tp->samples[tp->push_index] = *s;
+	if (++tp->push_index == tp->len) tp->push_index = 0;
+	if (tp->count < tp->len) tp->count++;
+}
+
+
+static uint8_t* _power_history_pack16(uint8_t* p, uint16_t v)
+{
+	*p++ = v >> 8;
+	*p++ = v & 0xFF;
+
+	return p;
+}
@@ -0,0 +1,85 @@
+/*
+ * Power history - Multi-resolution history of battery and USB power measurements
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef POWER_HISTORY_H
+#define POWER_HISTORY_H
+
+#include "power_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Constants
+//
+
+// Tiers (interval and number of samples kept)
+#define POWER_HIST_TIER_SEC         0
+#define POWER_HIST_TIER_MIN         1
+#define POWER_HIST_TIER_15MIN       2
+#define POWER_HIST_NUM_TIERS        3
+
+#define POWER_HIST_SEC_INTERVAL     1
+#define POWER_HIST_SEC_LEN          3600
+#define POWER_HIST_MIN_INTERVAL     60
+#define POWER_HIST_MIN_LEN          1440
+#define POWER_HIST_15MIN_INTERVAL   900
+#define POWER_HIST_15MIN_LEN        2976
+
+// Channels
+#define POWER_HIST_CH_VB            0
+#define POWER_HIST_CH_IL            1
+#define POWER_HIST_CH_VU            2
+#define POWER_HIST_CH_IU            3
+#define POWER_HIST_NUM_CH           4
+
+// Maximum samples returned by one query (sized to fit a websocket packet)
+#define POWER_HIST_MAX_QUERY        256
+
+// Query packet (network byte order)
+//   uint32_t tier
+//   uint32_t start               Return samples starting at this time (uptime seconds)
+//   uint32_t max_count
+#define POWER_HIST_QUERY_LEN        12
+
+// Response packet (network byte order)
+//   uint32_t tier
+//   uint32_t uptime              Current uptime (seconds)
+//   uint32_t epoch               Current time (seconds since 1970) for converting sample times
+//   uint32_t interval            Sample interval (seconds)
+//   uint32_t num                 Number of samples that follow (0 when there are no more)
+//   Samples (oldest first)
+//     uint32_t t                 Uptime (seconds) at the start of the sample interval
+//     uint16_t avg[4]            Vb mV, Il mA, Vu mV, Iu mA
+//     uint16_t min[4]
+//     uint16_t max[4]
+//     uint16_t charge            CHARGE_STATE_t at the end of the interval
+#define POWER_HIST_RSP_HDR_LEN      20
+#define POWER_HIST_RSP_SAMPLE_LEN   (4 + 3*2*POWER_HIST_NUM_CH + 2)
+#define POWER_HIST_RSP_MAX_LEN      (POWER_HIST_RSP_HDR_LEN + POWER_HIST_MAX_QUERY*POWER_HIST_RSP_SAMPLE_LEN)
+
+
+
+//
+// API
+//
+bool power_history_init();
+void power_history_add(const batt_status_t* bs);
+uint8_t* power_history_get_packet(int tier, uint32_t start, uint32_t max_count, uint32_t* len);
+
+#endif /* POWER_HISTORY_H */
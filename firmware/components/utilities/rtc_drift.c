@@ -0,0 +1,631 @@
+/*
+ * RTC drift model
+ *
+ * Learns the frequency error of the gCore RTC from SNTP syncs and uses it to correct
+ * the time read from the RTC when there is no network time.
+ *
+ * The fit is a line through (true time, virtual RTC - true time) pairs.  It is persisted
+ * as its end points, error and drift, and after a restart the end points are used as
+ * two "seed" pairs so the fit continues with the pairs from new syncs.
+ *
+ * A hand set time (time_set) re-anchors the line to the new time (keeping the drift)
+ * so the clock keeps the user's time.  The next sync re-anchors it again before adding
+ * its pair.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "ps_utilities.h"
+#include "rtc.h"
+#include "rtc_drift.h"
+#include "time_utilities.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint32_t t;                        // True time (seconds)
+	double e;                          // Virtual RTC - true time (seconds)
+	bool seed;                         // End point of a fit from before a restart
+} rtc_drift_pair_t;
+
+
+
+//
+// Variables
+//
+static const char* TAG = "rtc_drift";
+
+static SemaphoreHandle_t drift_mutex;
+
+// Our copy of the persisted model
+static rtc_config_t rtc_config;
+static uint32_t rtc_generation = PS_GENERATION_NONE;
+
+// Pairs in time order
+static rtc_drift_pair_t pairs[RTC_DRIFT_MAX_PAIRS];
+static int num_pairs = 0;
+
+// Sync and discipline state
+static int64_t last_sync_usec = 0;     // Uptime of the last sync this boot (0 = none)
+static uint32_t last_sync_secs = 0;    // True time of the last known sync
+static int discipline_elapsed_msec = 0;
+
+static rtc_drift_stats_t drift_stats;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _rtc_drift_reload();
+static void _rtc_drift_seed();
+static void _rtc_drift_save();
+static bool _rtc_drift_valid();
+static double _rtc_drift_model_err(uint32_t t);
+static double _rtc_drift_true_time(double rtc);
+static void _rtc_drift_add_pair(uint32_t t, double e);
+static void _rtc_drift_rebase(uint32_t t, double e);
+static void _rtc_drift_fit();
+static double _rtc_drift_median(double* v, int n);
+
+
+
+//
+// RTC Drift API
+//
+bool rtc_drift_init()
+{
+	drift_mutex = xSemaphoreCreateMutex();
+	if (drift_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+
+	_rtc_drift_reload();
+
+	if (_rtc_drift_valid()) {
+		ESP_LOGI(TAG, "Drift %" PRId32 " ppb from %u pairs", rtc_config.drift_ppb, rtc_config.pairs);
+	}
+
+	return true;
+}
+
+
+/**
+ * Get the time from the RTC corrected for its drift since the last sync.  Returns false
+ * if the RTC could not be read.
+ */
+bool rtc_drift_get_time(struct timeval* tv)
+{
+	double t;
+	uint32_t rtc_secs;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+	rtc_secs = rtc_get_time_secs();
+	if (rtc_secs != 0) {
+		t = _rtc_drift_true_time((double) rtc_secs + 0.5);
+	}
+	xSemaphoreGive(drift_mutex);
+
+	if (rtc_secs == 0) {
+		return false;
+	}
+
+	tv->tv_sec = (time_t) t;
+	tv->tv_usec = (suseconds_t) ((t - (double) tv->tv_sec) * 1000000.0);
+
+	return true;
+}
+
+
+/**
+ * Get the corrected time with its sub-second phase by watching for the RTC's seconds
+ * edge.  Blocks for up to RTC_DRIFT_EDGE_MSEC.  Returns false if the RTC could not be
+ * read or no edge was seen in time.
+ */
+bool rtc_drift_get_edge_time(struct timeval* tv)
+{
+	double t;
+	int64_t start_usec, prev_usec, cur_usec, end_usec, edge_usec;
+	uint32_t rtc_secs, prev_secs;
+
+	// Back-to-back reads until the value changes.  The edge is between the start of the
+	// last read of the old second and the end of the first read of the new one.
+	start_usec = esp_timer_get_time();
+	prev_usec = start_usec;
+	prev_secs = rtc_get_time_secs();
+	if (prev_secs == 0) {
+		return false;
+	}
+	while (1) {
+		cur_usec = esp_timer_get_time();
+		rtc_secs = rtc_get_time_secs();
+		end_usec = esp_timer_get_time();
+		if (rtc_secs == 0) {
+			return false;
+		}
+		if (rtc_secs != prev_secs) {
+			break;
+		}
+		if ((end_usec - start_usec) >= ((int64_t) RTC_DRIFT_EDGE_MSEC * 1000)) {
+			ESP_LOGE(TAG, "No RTC seconds edge in %d mSec", RTC_DRIFT_EDGE_MSEC);
+			return false;
+		}
+		prev_usec = cur_usec;
+	}
+	edge_usec = (prev_usec + end_usec) / 2;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+	t = _rtc_drift_true_time((double) rtc_secs);
+	drift_stats.edge_window_usec = (uint32_t) (end_usec - prev_usec);
+	xSemaphoreGive(drift_mutex);
+
+	// Advance to now
+	t += (double) (esp_timer_get_time() - edge_usec) / 1000000.0;
+	tv->tv_sec = (time_t) t;
+	tv->tv_usec = (suseconds_t) ((t - (double) tv->tv_sec) * 1000000.0);
+
+	return true;
+}
+
+
+/**
+ * Get the RTC value that is reached at true time secs (for programming the RTC's alarm).
+ * The RTC reaches the value at the start of its second so it is never late.
+ */
+uint32_t rtc_drift_get_rtc_secs(uint32_t secs)
+{
+	double v;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+	if (_rtc_drift_valid()) {
+		v = (double) secs + _rtc_drift_model_err(secs) - (double) rtc_config.rtc_offset;
+	} else {
+		v = (double) secs;
+	}
+	xSemaphoreGive(drift_mutex);
+
+	return (uint32_t) floor(v);
+}
+
+
+/**
+ * Called with the system time just set by SNTP.  Records a pair (if it's been long
+ * enough since the last one) and keeps the RTC close to true time.
+ */
+void rtc_drift_note_sync(const struct timeval* tv)
+{
+	bool changed = false;
+	double t, e;
+	uint32_t rtc_secs, w;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+
+	rtc_secs = rtc_get_time_secs();
+	if (rtc_secs == 0) {
+		xSemaphoreGive(drift_mutex);
+		ESP_LOGE(TAG, "Could not read RTC for sync");
+		return;
+	}
+
+	// The RTC was read somewhere within its current second
+	t = (double) tv->tv_sec + (double) tv->tv_usec / 1000000.0;
+	e = (double) rtc_secs + 0.5 + (double) rtc_config.rtc_offset - t;
+
+	last_sync_usec = esp_timer_get_time();
+	last_sync_secs = (uint32_t) tv->tv_sec;
+
+	if (rtc_config.rebase) {
+		_rtc_drift_rebase((uint32_t) tv->tv_sec, e);
+		rtc_config.rebase = false;
+		changed = true;
+	}
+
+	// Signed so a sync earlier than the newest pair (the clock stepped back) adds nothing
+	// instead of wrapping into a new pair out of time order
+	if ((num_pairs == 0) || ((int32_t) ((uint32_t) tv->tv_sec - pairs[num_pairs-1].t) >= RTC_DRIFT_PAIR_SECS)) {
+		_rtc_drift_add_pair((uint32_t) tv->tv_sec, e);
+		_rtc_drift_fit();
+		changed = true;
+		ESP_LOGI(TAG, "Pair %d: err %d mSec, drift %" PRId32 " ppb", num_pairs, (int) (e * 1000.0), rtc_config.drift_ppb);
+	}
+
+	// Keep the RTC itself close to true time for anything using it directly
+	if (fabs((double) rtc_secs + 0.5 - t) >= RTC_DRIFT_REWRITE_SECS) {
+		w = (uint32_t) tv->tv_sec;
+		if (tv->tv_usec >= 500000) w += 1;
+		if (rtc_set_time_secs(w)) {
+			rtc_config.rtc_offset += (int32_t) (rtc_secs - w);
+			changed = true;
+		} else {
+			ESP_LOGE(TAG, "Update RTC failed");
+		}
+	}
+
+	if (changed) {
+		_rtc_drift_save();
+	}
+	xSemaphoreGive(drift_mutex);
+}
+
+
+/**
+ * Set the RTC, keeping the virtual RTC continuous.  Rebase is set when the time was set
+ * by hand so the fit follows the new time until the next sync.
+ */
+bool rtc_drift_set_rtc(uint32_t secs, bool rebase)
+{
+	bool ret;
+	uint32_t rtc_secs;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+
+	rtc_secs = rtc_get_time_secs();
+	ret = rtc_set_time_secs(secs);
+	if (ret) {
+		if (rtc_secs == 0) {
+			// Can't follow the write so the pairs no longer line up with the RTC
+			ESP_LOGE(TAG, "Could not read RTC before set - discarding fit");
+			num_pairs = 0;
+			rtc_config.pairs = 0;
+			rtc_config.drift_ppb = 0;
+		} else {
+			if (rebase) {
+				_rtc_drift_rebase(secs, (double) rtc_secs + 0.5 + (double) rtc_config.rtc_offset - (double) secs);
+				rtc_config.rebase = true;
+			}
+			rtc_config.rtc_offset += (int32_t) (rtc_secs - secs);
+		}
+		_rtc_drift_save();
+	}
+	xSemaphoreGive(drift_mutex);
+
+	return ret;
+}
+
+
+bool rtc_drift_discipline_due(int elapsed_msec)
+{
+	discipline_elapsed_msec += elapsed_msec;
+	if (discipline_elapsed_msec >= RTC_DRIFT_DISCIPLINE_MSEC) {
+		discipline_elapsed_msec = 0;
+		return true;
+	}
+
+	return false;
+}
+
+
+/**
+ * Keep the system time on the corrected RTC while there is no network time.  The
+ * ESP32 keeps time from its RC slow clock during light sleep which is much less
+ * accurate than the RTC.
+ */
+void rtc_drift_discipline()
+{
+	bool stepped = false;
+	double t, offset;
+	int32_t offset_msec;
+	struct timeval tv;
+	uint32_t rtc_secs;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+
+	if ((last_sync_usec != 0) && ((esp_timer_get_time() - last_sync_usec) < ((int64_t) RTC_DRIFT_HOLDOFF_SECS * 1000000))) {
+		xSemaphoreGive(drift_mutex);
+		return;
+	}
+
+	rtc_secs = rtc_get_time_secs();
+	if (rtc_secs == 0) {
+		xSemaphoreGive(drift_mutex);
+		return;
+	}
+
+	t = _rtc_drift_true_time((double) rtc_secs + 0.5);
+	gettimeofday(&tv, NULL);
+	offset = t - ((double) tv.tv_sec + (double) tv.tv_usec / 1000000.0);
+	offset_msec = (int32_t) (offset * 1000.0);
+	drift_stats.last_offset_msec = offset_msec;
+
+	if (abs(offset_msec) >= RTC_DRIFT_STEP_MSEC) {
+		tv.tv_sec = (time_t) t;
+		tv.tv_usec = (suseconds_t) ((t - (double) tv.tv_sec) * 1000000.0);
+		settimeofday(&tv, NULL);
+		drift_stats.steps++;
+		stepped = true;
+	} else if (abs(offset_msec) >= RTC_DRIFT_SLEW_MIN_MSEC) {
+		tv.tv_sec = offset_msec / 1000;
+		tv.tv_usec = (offset_msec % 1000) * 1000;
+		(void) adjtime(&tv, NULL);
+		drift_stats.slews++;
+	}
+	xSemaphoreGive(drift_mutex);
+
+	if (stepped) {
+		ESP_LOGI(TAG, "Stepped system time %" PRId32 " mSec to RTC", offset_msec);
+		time_note_step();
+	}
+}
+
+
+void rtc_drift_get_stats(rtc_drift_stats_t* stats)
+{
+	time_t now;
+
+	xSemaphoreTake(drift_mutex, portMAX_DELAY);
+	_rtc_drift_reload();
+
+	*stats = drift_stats;
+	stats->valid = _rtc_drift_valid();
+	stats->pairs = rtc_config.pairs;
+	stats->span_secs = (rtc_config.pairs > 1) ? rtc_config.fit_end - rtc_config.fit_start : 0;
+	stats->drift_ppb = rtc_config.drift_ppb;
+	stats->drift_sd_ppb = rtc_config.drift_sd_ppb;
+	stats->resid_msec = rtc_config.resid_msec;
+	stats->week_raw_msec = (uint32_t) (fabs((double) rtc_config.drift_ppb) * RTC_DRIFT_PREDICT_SECS / 1000000.0);
+	stats->week_err_msec = rtc_config.week_err_msec;
+
+	time(&now);
+	stats->offline_secs = ((last_sync_secs != 0) && ((uint32_t) now > last_sync_secs)) ? (uint32_t) now - last_sync_secs : 0;
+	xSemaphoreGive(drift_mutex);
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Load the persisted model if it changed (at start and after a factory reset)
+ */
+static void _rtc_drift_reload()
+{
+	if (ps_get_config_if_changed(PS_CONFIG_TYPE_RTC, &rtc_config, &rtc_generation)) {
+		_rtc_drift_seed();
+		last_sync_secs = rtc_config.fit_end;
+	}
+}
+
+
+/**
+ * Start the pairs with the end points of the persisted fit
+ */
+static void _rtc_drift_seed()
+{
+	double err;
+
+	num_pairs = 0;
+	err = (double) rtc_config.fit_err_msec / 1000.0;
+
+	if ((rtc_config.pairs > 1) && (rtc_config.fit_end > rtc_config.fit_start)) {
+		pairs[num_pairs].t = rtc_config.fit_start;
+		pairs[num_pairs].e = _rtc_drift_model_err(rtc_config.fit_start);
+		pairs[num_pairs++].seed = true;
+	}
+	if (rtc_config.pairs > 0) {
+		pairs[num_pairs].t = rtc_config.fit_end;
+		pairs[num_pairs].e = err;
+		pairs[num_pairs++].seed = true;
+	}
+}
+
+
+static void _rtc_drift_save()
+{
+	(void) ps_set_config(PS_CONFIG_TYPE_RTC, &rtc_config);
+	rtc_generation = ps_get_config_generation(PS_CONFIG_TYPE_RTC);
+}
+
+
+static bool _rtc_drift_valid()
+{
+	return ((rtc_config.pairs >= RTC_DRIFT_MIN_PAIRS) &&
+	        ((rtc_config.fit_end - rtc_config.fit_start) >= RTC_DRIFT_MIN_SPAN_SECS));
+}
+
+
+/**
+ * Fitted virtual RTC - true time at true time t
+ */
+static double _rtc_drift_model_err(uint32_t t)
+{
+	return ((double) rtc_config.fit_err_msec / 1000.0) +
+	       ((double) rtc_config.drift_ppb / 1e9) * (double) ((int32_t) (t - rtc_config.fit_end));
+}
+
+
+/**
+ * True time for an RTC value (a reading is taken as the middle of the RTC's second).
+ * The raw RTC is used until there is a valid fit.
+ */
+static double _rtc_drift_true_time(double rtc)
+{
+	double v, d;
+
+	if (!_rtc_drift_valid()) {
+		return rtc;
+	}
+
+	// v = t + err(fit_end) + d * (t - fit_end), solved for t
+	v = rtc + (double) rtc_config.rtc_offset;
+	d = (double) rtc_config.drift_ppb / 1e9;
+
+	return (double) rtc_config.fit_end +
+	       (v - (double) rtc_config.fit_end - (double) rtc_config.fit_err_msec / 1000.0) / (1.0 + d);
+}
+
+
+static void _rtc_drift_add_pair(uint32_t t, double e)
+{
+	int i;
+
+	if (num_pairs == RTC_DRIFT_MAX_PAIRS) {
+		for (i=1; i<RTC_DRIFT_MAX_PAIRS; i++) {
+			pairs[i-1] = pairs[i];
+		}
+		num_pairs--;
+	}
+
+	pairs[num_pairs].t = t;
+	pairs[num_pairs].e = e;
+	pairs[num_pairs++].seed = false;
+}
+
+
+/**
+ * Move the fit and its pairs so the fit passes through (t, e), keeping the drift
+ */
+static void _rtc_drift_rebase(uint32_t t, double e)
+{
+	int i;
+	double delta;
+
+	if (num_pairs == 0) return;
+
+	delta = e - _rtc_drift_model_err(t);
+	for (i=0; i<num_pairs; i++) {
+		pairs[i].e += delta;
+	}
+	rtc_config.fit_err_msec += (int32_t) lround(delta * 1000.0);
+}
+
+
+/**
+ * Least-squares fit of the pairs, repeatedly dropping the worst outlier
+ */
+static void _rtc_drift_fit()
+{
+	int i, n, worst;
+	double x[RTC_DRIFT_MAX_PAIRS];
+	double r[RTC_DRIFT_MAX_PAIRS];
+	double mx, me, sxx, sxe, c, d, ss, s2, limit, worst_r;
+	uint32_t t_ref;
+
+	while (1) {
+		n = num_pairs;
+		t_ref = pairs[n-1].t;
+
+		// Fit e = c + d * x with x relative to the newest pair
+		mx = 0;
+		me = 0;
+		for (i=0; i<n; i++) {
+			x[i] = (double) ((int32_t) (pairs[i].t - t_ref));
+			mx += x[i];
+			me += pairs[i].e;
+		}
+		mx /= n;
+		me /= n;
+		sxx = 0;
+		sxe = 0;
+		for (i=0; i<n; i++) {
+			sxx += (x[i] - mx) * (x[i] - mx);
+			sxe += (x[i] - mx) * (pairs[i].e - me);
+		}
+		d = (sxx > 0) ? sxe / sxx : 0;
+		c = me - d * mx;
+
+		ss = 0;
+		for (i=0; i<n; i++) {
+			r[i] = pairs[i].e - (c + d * x[i]);
+			ss += r[i] * r[i];
+		}
+
+		if (n < RTC_DRIFT_OUTLIER_PAIRS) break;
+
+		// Find the worst new pair outside the limit (r is reordered by the median)
+		worst = -1;
+		worst_r = 0;
+		for (i=0; i<n; i++) {
+			if (!pairs[i].seed && (fabs(r[i]) > worst_r)) {
+				worst = i;
+				worst_r = fabs(r[i]);
+			}
+		}
+		for (i=0; i<n; i++) {
+			r[i] = fabs(r[i]);
+		}
+		limit = RTC_DRIFT_OUTLIER_MADS * 1.4826 * _rtc_drift_median(r, n);
+		if (limit < (RTC_DRIFT_OUTLIER_MIN_MSEC / 1000.0)) limit = RTC_DRIFT_OUTLIER_MIN_MSEC / 1000.0;
+		if ((worst < 0) || (worst_r <= limit)) break;
+
+		ESP_LOGI(TAG, "Reject pair with %d mSec residual", (int) (worst_r * 1000.0));
+		for (i=worst+1; i<num_pairs; i++) {
+			pairs[i-1] = pairs[i];
+		}
+		num_pairs--;
+		drift_stats.rejected++;
+	}
+
+	if (d > (RTC_DRIFT_MAX_PPB / 1e9)) d = RTC_DRIFT_MAX_PPB / 1e9;
+	if (d < -(RTC_DRIFT_MAX_PPB / 1e9)) d = -(RTC_DRIFT_MAX_PPB / 1e9);
+
+	rtc_config.pairs = (uint16_t) n;
+	rtc_config.fit_start = pairs[0].t;
+	rtc_config.fit_end = t_ref;
+	rtc_config.fit_err_msec = (int32_t) lround(c * 1000.0);
+	rtc_config.drift_ppb = (int32_t) lround(d * 1e9);
+	rtc_config.resid_msec = (uint32_t) lround(sqrt(ss / n) * 1000.0);
+
+	// Slope standard error and the 2 sigma confidence of the line extrapolated a week
+	if ((n > 2) && (sxx > 0)) {
+		s2 = ss / (n - 2);
+		rtc_config.drift_sd_ppb = (uint32_t) lround(sqrt(s2 / sxx) * 1e9);
+		rtc_config.week_err_msec = (uint32_t) lround(2.0 * sqrt(s2 * (1.0/n + (RTC_DRIFT_PREDICT_SECS - mx) * (RTC_DRIFT_PREDICT_SECS - mx) / sxx)) * 1000.0);
+	} else {
+		rtc_config.drift_sd_ppb = 0;
+		rtc_config.week_err_msec = 0;
+	}
+}
+
+
+/**
+ * Median of v (v is sorted)
+ */
+static double _rtc_drift_median(double* v, int n)
+{
+	int i, j;
+	double t;
+
+	for (i=1; i<n; i++) {
+		t = v[i];
+		for (j=i; (j > 0) && (v[j-1] > t); j--) {
+			v[j] = v[j-1];
+		}
+		v[j] = t;
+	}
+
+	return ((n & 1) ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2.0);
+}
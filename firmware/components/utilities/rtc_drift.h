@@ -0,0 +1,118 @@
+/*
+ * RTC drift model
+ *
+ * Learns the frequency error of the gCore RTC from SNTP syncs and uses it to correct
+ * the time read from the RTC when there is no network time (at boot and while the
+ * clock is offline or in AP mode).
+ *
+ * Each sync records a (virtual RTC, true time) pair.  The virtual RTC is the RTC
+ * plus an offset that accumulates every write to the RTC so it counts continuously
+ * across time sets.  A least-squares line through the pairs, with outlier rejection,
+ * gives the drift.  The fit is persisted so it survives restarts.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RTC_DRIFT_H
+#define RTC_DRIFT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+
+//
+// RTC Drift constants
+//
+
+// Sync pairs kept for the fit
+#define RTC_DRIFT_MAX_PAIRS        32
+
+// Minimum time between recorded pairs (seconds) - the RTC only has 1 second resolution
+// so pairs need to be well separated.  Syncs in between only keep the RTC close.
+#define RTC_DRIFT_PAIR_SECS        21600
+
+// The fit is applied once it has this many pairs spanning at least this long (seconds)
+#define RTC_DRIFT_MIN_PAIRS        3
+#define RTC_DRIFT_MIN_SPAN_SECS    43200
+
+// Outlier rejection starts with this many pairs.  Pairs with a residual larger than the
+// greater of the minimum and RTC_DRIFT_OUTLIER_MADS scaled median absolute deviations
+// are dropped.
+#define RTC_DRIFT_OUTLIER_PAIRS    5
+#define RTC_DRIFT_OUTLIER_MIN_MSEC 1500
+#define RTC_DRIFT_OUTLIER_MADS     4
+
+// Largest believable drift (ppb)
+#define RTC_DRIFT_MAX_PPB          200000
+
+// Longest wait for the RTC's seconds edge when recovering its sub-second phase (mSec)
+#define RTC_DRIFT_EDGE_MSEC        1100
+
+// A sync rewrites the RTC when it is this far from true time (seconds)
+#define RTC_DRIFT_REWRITE_SECS     30
+
+// System time discipline while not syncing
+//   - interval (mSec)
+//   - not done for this long after a sync (seconds)
+//   - offsets smaller than the slew minimum are within the RTC's resolution (mSec)
+//   - offsets larger than the step limit are stepped instead of slewed (mSec)
+#define RTC_DRIFT_DISCIPLINE_MSEC  60000
+#define RTC_DRIFT_HOLDOFF_SECS     7200
+#define RTC_DRIFT_SLEW_MIN_MSEC    1000
+#define RTC_DRIFT_STEP_MSEC        30000
+
+// Offline period the accuracy is predicted for (seconds)
+#define RTC_DRIFT_PREDICT_SECS     604800
+
+
+
+//
+// RTC Drift typedefs
+//
+typedef struct {
+	bool valid;                        // Fit is being applied
+	uint16_t pairs;                    // Pairs in the fit
+	uint32_t rejected;                 // Pairs rejected as outliers since boot
+	uint32_t span_secs;                // Time covered by the fit
+	int32_t drift_ppb;                 // + RTC runs fast
+	uint32_t drift_sd_ppb;
+	uint32_t resid_msec;               // RMS residual of the fit
+	uint32_t week_raw_msec;            // Uncorrected RTC error after RTC_DRIFT_PREDICT_SECS
+	uint32_t week_err_msec;            // Predicted corrected error after RTC_DRIFT_PREDICT_SECS (2 sigma)
+	uint32_t offline_secs;             // Time since the last sync
+	int32_t last_offset_msec;          // Last measured corrected RTC - system time
+	uint32_t slews;                    // System time slews and steps by the discipline
+	uint32_t steps;
+	uint32_t edge_window_usec;         // Uncertainty of the last seconds edge found (0 = none)
+} rtc_drift_stats_t;
+
+
+
+//
+// RTC Drift API
+//
+bool rtc_drift_init();
+bool rtc_drift_get_time(struct timeval* tv);
+bool rtc_drift_get_edge_time(struct timeval* tv);
+uint32_t rtc_drift_get_rtc_secs(uint32_t secs);
+void rtc_drift_note_sync(const struct timeval* tv);
+bool rtc_drift_set_rtc(uint32_t secs, bool rebase);
+bool rtc_drift_discipline_due(int elapsed_msec);
+void rtc_drift_discipline();
+void rtc_drift_get_stats(rtc_drift_stats_t* stats);
+
+#endif /* RTC_DRIFT_H */
@@ -1,6 +1,20 @@
 /*
  * NTP access utilities
  *
+ * A small SNTP client that polls several servers (configured and DHCP-provided),
+ * runs each server's samples through an NTP style clock filter, selects the best
+ * server and disciplines the system clock.  Small offsets are slewed with adjtime so
+ * the display never jumps, only large offsets step the clock.
+ *
+ *   - Clock filter: the last SNTP_FILTER_LEN samples of each server.  The sample with
+ *     the smallest delay (plus dispersion growing with its age) gives the server's
+ *     offset and delay.  The RMS difference of the other samples from it is the jitter.
+ *   - Selection: servers far from the median offset are falsetickers (with at least
+ *     3 servers).  Of the rest the one with the smallest root distance is used.
+ *   - Each filtered sample is only used once to correct the clock and no correction
+ *     is made while a slew is in progress.
+ *   - A step discards every server's samples and polls each in a burst again.
+ *
  * Copyright 2024-2025 Dan Julio
  *
  * This program is free software: you can redistribute it and/or modify
@@ -18,12 +32,87 @@
  */
 #include "esp_system.h"
 #include "esp_log.h"
-#include "esp_netif_sntp.h"
 #include "esp_sntp.h"
-#include "rtc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "ntp_standin.h"
+#include "rtc_drift.h"
 #include "sntp_utilities.h"
 #include "time_utilities.h"
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
+
+
+
+//
+// Internal constants
+//
+
+// Packet
+#define SNTP_PKT_LEN             48
+#define SNTP_PKT_LI_VN_MODE      0
+#define SNTP_PKT_STRATUM         1
+#define SNTP_PKT_ROOT_DELAY      4
+#define SNTP_PKT_ROOT_DISP       8
+#define SNTP_PKT_ORIGIN_TS       24
+#define SNTP_PKT_RX_TS           32
+#define SNTP_PKT_TX_TS           40
+
+#define SNTP_VERSION             4
+#define SNTP_MODE_CLIENT         3
+#define SNTP_MODE_SERVER         4
+#define SNTP_LI_UNSYNC           3
+#define SNTP_MAX_STRATUM         15
+
+// Seconds from 1900 (NTP era 0) to 1970
+#define SNTP_UNIX_OFFSET         2208988800ULL
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	bool valid;
+	int64_t t_usec;                    // Uptime when taken
+	int64_t offset_usec;
+	int64_t delay_usec;
+} sntp_sample_t;
+
+typedef struct {
+	char name[SNTP_NAME_MAX_LEN+1];
+	uint16_t port;
+	bool from_dhcp;
+	bool resolved;
+	struct sockaddr_in addr;
+	sntp_sample_t filter[SNTP_FILTER_LEN];
+	int filter_index;                  // Next sample slot
+	int sel;                           // Filter sample selected (-1 = none)
+	int64_t offset_usec;               // Filter outputs
+	int64_t delay_usec;
+	int64_t jitter_usec;
+	int64_t root_dist_usec;            // From the server's root delay and dispersion
+	int64_t last_used_usec;            // Time of the last sample used to correct the clock
+	int64_t next_poll_usec;
+	int poll_secs;
+	int burst;                         // Quick polls remaining
+	uint8_t reach;
+	uint8_t stratum;
+	bool falseticker;
+	uint32_t polls;
+	uint32_t responses;
+} sntp_server_t;
 
 
 
@@ -32,13 +121,49 @@
 //
 static const char* TAG = "sntp_utilities";
 
+#if SNTP_STANDIN_PORT == 0
+static const char* cfg_servers[SNTP_NUM_CFG_SERVERS] = SNTP_CFG_SERVERS;
+#endif
+
+static sntp_server_t servers[SNTP_MAX_SERVERS];
+static int num_servers = 0;
+static int selected = -1;
+
+// Protects the server table and statistics (only the task changes them)
+static SemaphoreHandle_t sntp_mutex;
+
+static TaskHandle_t sntp_task_handle = NULL;
+static volatile bool sntp_enable = false;
+static bool sntp_running = false;
+static int sntp_sock = -1;
+
+static uint32_t stat_steps = 0;
+static uint32_t stat_slews = 0;
+static int32_t stat_last_offset_usec = 0;
 
 
 
 //
 // Internal functions
 //
-static void _time_sync_notification_cb(struct timeval *tv);
+static void _sntp_task(void* args);
+static bool _sntp_start();
+static void _sntp_stop();
+static void _sntp_add_server(const char* name, bool from_dhcp);
+static void _sntp_add_dhcp_servers();
+static bool _sntp_resolve(sntp_server_t* s);
+static void _sntp_poll(sntp_server_t* s);
+static bool _sntp_exchange(sntp_server_t* s, int64_t* offset_usec, int64_t* delay_usec);
+static void _sntp_filter(sntp_server_t* s);
+static int64_t _sntp_root_distance(const sntp_server_t* s, int64_t now_usec);
+static void _sntp_select();
+static void _sntp_correct();
+static int64_t _sntp_slew_remaining();
+static int64_t _sntp_tv_to_usec(const struct timeval* tv);
+static void _sntp_usec_to_tv(int64_t usec, struct timeval* tv);
+static void _sntp_put_ts(uint8_t* p, int64_t usec);
+static int64_t _sntp_get_ts(const uint8_t* p);
+static int64_t _sntp_get_short(const uint8_t* p);
 
 
 
@@ -47,14 +172,24 @@ static void _time_sync_notification_cb(struct timeval *tv);
 //
 void sntp_start_service()
 {
-	esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(NTP_POOL_SERVER);
-	
-	config.sync_cb = _time_sync_notification_cb;
-	
-	esp_netif_sntp_init(&config);
+	if (sntp_task_handle == NULL) {
+		sntp_mutex = xSemaphoreCreateMutex();
+		if (sntp_mutex == NULL) {
+			ESP_LOGE(TAG, "Could not create mutex");
+			return;
+		}
+		
+		if (xTaskCreatePinnedToCore(&_sntp_task, "sntp_task", SNTP_TASK_STACK, NULL,
+		                            SNTP_TASK_PRIO, &sntp_task_handle, SNTP_TASK_CORE) != pdPASS) {
+			ESP_LOGE(TAG, "Could not start task");
+			sntp_task_handle = NULL;
+			return;
+		}
+	}
 	
 	ESP_LOGI(TAG, "Starting SNTP service");
-	esp_netif_sntp_start();
+	sntp_enable = true;
+	xTaskNotifyGive(sntp_task_handle);
 }
 
 
@@ -62,8 +197,58 @@ void sntp_stop_service()
 {
 	ESP_LOGI(TAG, "Stopping SNTP service");
 	
-	esp_sntp_stop();
-	esp_netif_sntp_deinit();
+	sntp_enable = false;
+	if (sntp_task_handle != NULL) {
+		xTaskNotifyGive(sntp_task_handle);
+	}
+}
+
+
+void sntp_get_stats(sntp_stats_t* stats)
+{
+	memset(stats, 0, sizeof(sntp_stats_t));
+	stats->selected = -1;
+	if (sntp_task_handle == NULL) return;
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	stats->running = sntp_running;
+	stats->num_servers = num_servers;
+	stats->selected = selected;
+	stats->steps = stat_steps;
+	stats->slews = stat_slews;
+	stats->last_offset_usec = stat_last_offset_usec;
+	xSemaphoreGive(sntp_mutex);
+}
+
+
+bool sntp_get_server_stats(int index, sntp_server_stats_t* stats)
+{
+	sntp_server_t* s;
+	
+	if ((sntp_task_handle == NULL) || (index < 0)) return false;
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	if (index >= num_servers) {
+		xSemaphoreGive(sntp_mutex);
+		return false;
+	}
+	s = &servers[index];
+	strcpy(stats->name, s->name);
+	stats->from_dhcp = s->from_dhcp;
+	stats->valid = (s->sel >= 0);
+	stats->selected = (index == selected);
+	stats->falseticker = s->falseticker;
+	stats->reach = s->reach;
+	stats->stratum = s->stratum;
+	stats->poll_secs = (uint16_t) s->poll_secs;
+	stats->offset_usec = (int32_t) s->offset_usec;
+	stats->delay_usec = (uint32_t) s->delay_usec;
+	stats->jitter_usec = (uint32_t) s->jitter_usec;
+	stats->polls = s->polls;
+	stats->responses = s->responses;
+	xSemaphoreGive(sntp_mutex);
+	
+	return true;
 }
 
 
@@ -71,21 +256,568 @@ void sntp_stop_service()
 //
 // Internal functions
 //
-static void _time_sync_notification_cb(struct timeval *tv)
+static void _sntp_task(void* args)
 {
+	int i;
+	int64_t now_usec;
+	
+	ESP_LOGI(TAG, "Start task");
+	
+	while (1) {
+		(void) ulTaskNotifyTake(pdTRUE, sntp_enable ? pdMS_TO_TICKS(SNTP_TASK_EVAL_MSEC) : portMAX_DELAY);
+		
+		if (sntp_enable && !sntp_running) {
+			if (!_sntp_start()) continue;
+		} else if (!sntp_enable && sntp_running) {
+			_sntp_stop();
+		}
+		if (!sntp_running) continue;
+		
+		_sntp_add_dhcp_servers();
+		
+		for (i=0; i<num_servers; i++) {
+			now_usec = esp_timer_get_time();
+			if (now_usec >= servers[i].next_poll_usec) {
+				_sntp_poll(&servers[i]);
+			}
+		}
+		
+		xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+		_sntp_select();
+		xSemaphoreGive(sntp_mutex);
+		
+		_sntp_correct();
+	}
+}
+
+
+static bool _sntp_start()
+{
+	int i;
+#if SNTP_STANDIN_PORT != 0
+	char name[SNTP_NAME_MAX_LEN+1];
+	ntp_standin_config_t standin_config = NTP_STANDIN_DEFAULT_CONFIG;
+#endif
+	
+	sntp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sntp_sock < 0) {
+		ESP_LOGE(TAG, "Could not create socket");
+		return false;
+	}
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	num_servers = 0;
+	selected = -1;
+#if SNTP_STANDIN_PORT != 0
+	standin_config.port = SNTP_STANDIN_PORT;
+	(void) ntp_standin_start(&standin_config, SNTP_STANDIN_SERVERS);
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		sprintf(name, "127.0.0.1:%d", SNTP_STANDIN_PORT + i);
+		_sntp_add_server(name, false);
+	}
+#else
+	for (i=0; i<SNTP_NUM_CFG_SERVERS; i++) {
+		_sntp_add_server(cfg_servers[i], false);
+	}
+#endif
+	sntp_running = true;
+	xSemaphoreGive(sntp_mutex);
+	
+	return true;
+}
+
+
+static void _sntp_stop()
+{
+	close(sntp_sock);
+	sntp_sock = -1;
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	sntp_running = false;
+	selected = -1;
+	xSemaphoreGive(sntp_mutex);
+}
+
+
+/**
+ * Add a server ("name" or "name:port") - called with sntp_mutex held
+ */
+static void _sntp_add_server(const char* name, bool from_dhcp)
+{
+	char* c;
+	sntp_server_t* s;
+	
+	if (num_servers == SNTP_MAX_SERVERS) return;
+	
+	s = &servers[num_servers++];
+	memset(s, 0, sizeof(sntp_server_t));
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	s->port = SNTP_PORT;
+	c = strchr(s->name, ':');
+	if (c != NULL) {
+		*c = 0;
+		s->port = (uint16_t) atoi(c + 1);
+	}
+	s->from_dhcp = from_dhcp;
+	s->sel = -1;
+	s->poll_secs = SNTP_MIN_POLL_SECS;
+	s->burst = SNTP_BURST_POLLS;
+	s->next_poll_usec = esp_timer_get_time();
+}
+
+
+/**
+ * Add any servers DHCP told lwIP about that we don't already have
+ */
+static void _sntp_add_dhcp_servers()
+{
+#if SNTP_STANDIN_PORT == 0
+	char name[SNTP_NAME_MAX_LEN+1];
+	const ip_addr_t* ip;
+	int i, j;
+	
+	for (i=0; i<SNTP_MAX_DHCP_SERVERS; i++) {
+		ip = esp_sntp_getserver(i);
+		if ((ip == NULL) || !IP_IS_V4(ip) || ip_addr_isany(ip)) continue;
+		
+		(void) ip4addr_ntoa_r(ip_2_ip4(ip), name, sizeof(name));
+		for (j=0; j<num_servers; j++) {
+			if (strcmp(servers[j].name, name) == 0) break;
+		}
+		if (j == num_servers) {
+			ESP_LOGI(TAG, "Add DHCP server %s", name);
+			xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+			_sntp_add_server(name, true);
+			xSemaphoreGive(sntp_mutex);
+		}
+	}
+#endif
+}
+
+
+static bool _sntp_resolve(sntp_server_t* s)
+{
+	struct addrinfo hints;
+	struct addrinfo* res = NULL;
+	
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	
+	if ((getaddrinfo(s->name, NULL, &hints, &res) != 0) || (res == NULL)) {
+		ESP_LOGE(TAG, "Could not resolve %s", s->name);
+		return false;
+	}
+	
+	memcpy(&s->addr, res->ai_addr, sizeof(struct sockaddr_in));
+	s->addr.sin_port = htons(s->port);
+	freeaddrinfo(res);
+	s->resolved = true;
+	
+	return true;
+}
+
+
+/**
+ * Poll a server and add the result to its clock filter
+ */
+static void _sntp_poll(sntp_server_t* s)
+{
+	bool success = false;
+	int64_t offset_usec, delay_usec;
+	sntp_sample_t* sp;
+	
+	if (s->resolved || _sntp_resolve(s)) {
+		success = _sntp_exchange(s, &offset_usec, &delay_usec);
+	}
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	s->polls++;
+	s->reach <<= 1;
+	if (success) {
+		s->reach |= 1;
+		s->responses++;
+		
+		sp = &s->filter[s->filter_index];
+		sp->valid = true;
+		sp->t_usec = esp_timer_get_time();
+		sp->offset_usec = offset_usec;
+		sp->delay_usec = delay_usec;
+		if (++s->filter_index == SNTP_FILTER_LEN) s->filter_index = 0;
+		
+		_sntp_filter(s);
+	} else if (s->reach == 0) {
+		// Pool servers come and go so look the name up again
+		s->resolved = false;
+	}
+	
+	if (s->burst > 0) {
+		s->burst--;
+		s->next_poll_usec = esp_timer_get_time() + (int64_t) SNTP_BURST_SECS * 1000000;
+	} else {
+		s->next_poll_usec = esp_timer_get_time() + (int64_t) s->poll_secs * 1000000;
+	}
+	xSemaphoreGive(sntp_mutex);
+}
+
+
+/**
+ * Send a request and wait for the matching response.  Returns the measured offset
+ * (corrected for any slew still in progress) and round trip delay.
+ */
+static bool _sntp_exchange(sntp_server_t* s, int64_t* offset_usec, int64_t* delay_usec)
+{
+	fd_set rfds;
+	int len;
+	int64_t t1, t2, t3, t4, remain_usec;
+	socklen_t from_len;
+	struct sockaddr_in from;
+	struct timeval tv;
+	uint8_t req[SNTP_PKT_LEN];
+	uint8_t rsp[SNTP_PKT_LEN];
+	
+	memset(req, 0, sizeof(req));
+	req[SNTP_PKT_LI_VN_MODE] = (SNTP_VERSION << 3) | SNTP_MODE_CLIENT;
+	gettimeofday(&tv, NULL);
+	t1 = _sntp_tv_to_usec(&tv);
+	_sntp_put_ts(&req[SNTP_PKT_TX_TS], t1);
+	
+	if (sendto(sntp_sock, req, sizeof(req), 0, (struct sockaddr*) &s->addr, sizeof(s->addr)) < 0) {
+		ESP_LOGE(TAG, "Send to %s failed", s->name);
+		return false;
+	}
+	
+	// Wait for the response to our request (ignoring anything else)
+	remain_usec = (int64_t) SNTP_TIMEOUT_MSEC * 1000;
+	while (remain_usec > 0) {
+		FD_ZERO(&rfds);
+		FD_SET(sntp_sock, &rfds);
+		tv.tv_sec = remain_usec / 1000000;
+		tv.tv_usec = remain_usec % 1000000;
+		if (select(sntp_sock + 1, &rfds, NULL, NULL, &tv) <= 0) {
+			return false;
+		}
+		
+		from_len = sizeof(from);
+		len = recvfrom(sntp_sock, rsp, sizeof(rsp), 0, (struct sockaddr*) &from, &from_len);
+		gettimeofday(&tv, NULL);
+		t4 = _sntp_tv_to_usec(&tv);
+		remain_usec = (int64_t) SNTP_TIMEOUT_MSEC * 1000 - (t4 - t1);
+		
+		if ((len < SNTP_PKT_LEN) ||
+		    (from.sin_addr.s_addr != s->addr.sin_addr.s_addr) ||
+		    (from.sin_port != s->addr.sin_port) ||
+		    (memcmp(&rsp[SNTP_PKT_ORIGIN_TS], &req[SNTP_PKT_TX_TS], 8) != 0)) {
+			continue;
+		}
+		
+		if ((rsp[SNTP_PKT_LI_VN_MODE] & 0x07) != SNTP_MODE_SERVER) {
+			return false;
+		}
+		
+		s->stratum = rsp[SNTP_PKT_STRATUM];
+		if (s->stratum == 0) {
+			// Kiss-o'-death: poll as slowly as possible
+			ESP_LOGI(TAG, "%s sent kiss code %.4s", s->name, &rsp[12]);
+			s->poll_secs = SNTP_MAX_POLL_SECS;
+			s->burst = 0;
+			return false;
+		}
+		if ((s->stratum > SNTP_MAX_STRATUM) || ((rsp[SNTP_PKT_LI_VN_MODE] >> 6) == SNTP_LI_UNSYNC)) {
+			return false;
+		}
+		
+		t2 = _sntp_get_ts(&rsp[SNTP_PKT_RX_TS]);
+		t3 = _sntp_get_ts(&rsp[SNTP_PKT_TX_TS]);
+		if (t3 == 0) {
+			return false;
+		}
+		
+		*offset_usec = ((t2 - t1) + (t3 - t4)) / 2 - _sntp_slew_remaining();
+		*delay_usec = (t4 - t1) - (t3 - t2);
+		if (*delay_usec < 0) *delay_usec = 0;
+		s->root_dist_usec = _sntp_get_short(&rsp[SNTP_PKT_ROOT_DELAY]) / 2 +
+		                    _sntp_get_short(&rsp[SNTP_PKT_ROOT_DISP]);
+		
+		return true;
+	}
+	
+	return false;
+}
+
+
+/**
+ * Clock filter - called with sntp_mutex held
+ */
+static void _sntp_filter(sntp_server_t* s)
+{
+	int i, n;
+	int64_t now_usec, dist, best_dist, d;
+	double sum;
+	
+	now_usec = esp_timer_get_time();
+	
+	// The sample with the lowest delay (aged by its dispersion growth) is the most accurate
+	s->sel = -1;
+	best_dist = 0;
+	for (i=0; i<SNTP_FILTER_LEN; i++) {
+		if (!s->filter[i].valid) continue;
+		dist = s->filter[i].delay_usec / 2 + ((now_usec - s->filter[i].t_usec) / 1000000) * SNTP_PHI_USEC;
+		if ((s->sel < 0) || (dist < best_dist)) {
+			s->sel = i;
+			best_dist = dist;
+		}
+	}
+	if (s->sel < 0) return;
+	
+	s->offset_usec = s->filter[s->sel].offset_usec;
+	s->delay_usec = s->filter[s->sel].delay_usec;
+	
+	// Jitter is the RMS difference of the other samples from the selected one
+	n = 0;
+	sum = 0;
+	for (i=0; i<SNTP_FILTER_LEN; i++) {
+		if (!s->filter[i].valid || (i == s->sel)) continue;
+		d = s->filter[i].offset_usec - s->offset_usec;
+		sum += (double) d * (double) d;
+		n++;
+	}
+	s->jitter_usec = (n > 0) ? (int64_t) sqrt(sum / n) : 0;
+}
+
+
+static int64_t _sntp_root_distance(const sntp_server_t* s, int64_t now_usec)
+{
+	return s->root_dist_usec + s->delay_usec / 2 + s->jitter_usec +
+	       ((now_usec - s->filter[s->sel].t_usec) / 1000000) * SNTP_PHI_USEC;
+}
+
+
+/**
+ * Select the server to discipline the clock with - called with sntp_mutex held
+ */
+static void _sntp_select()
+{
+	int cand[SNTP_MAX_SERVERS];
+	int64_t offsets[SNTP_MAX_SERVERS];
+	int i, j, n;
+	int64_t now_usec, median, t, dist, best_dist;
+	
+	now_usec = esp_timer_get_time();
+	
+	// Candidates are reachable servers with a filtered sample
+	n = 0;
+	for (i=0; i<num_servers; i++) {
+		servers[i].falseticker = false;
+		if ((servers[i].sel >= 0) && (servers[i].reach != 0)) {
+			cand[n] = i;
+			offsets[n++] = servers[i].offset_usec;
+		}
+	}
+	
+	// Vote out servers that disagree with the majority
+	if (n >= 3) {
+		for (i=1; i<n; i++) {
+			t = offsets[i];
+			for (j=i; (j > 0) && (offsets[j-1] > t); j--) {
+				offsets[j] = offsets[j-1];
+			}
+			offsets[j] = t;
+		}
+		median = offsets[n/2];
+		
+		for (i=0; i<n; i++) {
+			t = llabs(servers[cand[i]].offset_usec - median);
+			if (t > (SNTP_FALSETICKER_USEC + _sntp_root_distance(&servers[cand[i]], now_usec))) {
+				servers[cand[i]].falseticker = true;
+			}
+		}
+	}
+	
+	selected = -1;
+	best_dist = 0;
+	for (i=0; i<n; i++) {
+		if (servers[cand[i]].falseticker) continue;
+		dist = _sntp_root_distance(&servers[cand[i]], now_usec);
+		if ((selected < 0) || (dist < best_dist)) {
+			selected = cand[i];
+			best_dist = dist;
+		}
+	}
+}
+
+
+/**
+ * Correct the system clock using the selected server's latest filtered sample
+ */
+static void _sntp_correct()
+{
+	bool stepped = false;
 	char buf[32];
-	time_t now;
+	int i, j;
+	int64_t offset_usec;
+	sntp_server_t* s;
+	struct timeval tv;
 	tmElements_t te;
+	time_t now;
+	
+	xSemaphoreTake(sntp_mutex, portMAX_DELAY);
+	if (selected < 0) {
+		xSemaphoreGive(sntp_mutex);
+		return;
+	}
+	s = &servers[selected];
+	
+	// Wait for the burst to fill the filter, only use each sample once and let any
+	// previous slew finish
+	if ((s->burst > 0) || (s->filter[s->sel].t_usec <= s->last_used_usec) || (_sntp_slew_remaining() != 0)) {
+		xSemaphoreGive(sntp_mutex);
+		return;
+	}
+	s->last_used_usec = s->filter[s->sel].t_usec;
+	offset_usec = s->offset_usec;
+	
+	gettimeofday(&tv, NULL);
+	if (llabs(offset_usec) >= SNTP_STEP_USEC) {
+		_sntp_usec_to_tv(_sntp_tv_to_usec(&tv) + offset_usec, &tv);
+		settimeofday(&tv, NULL);
+		stat_steps++;
+		stepped = true;
+	} else {
+		_sntp_usec_to_tv(offset_usec, &tv);
+		(void) adjtime(&tv, NULL);
+		stat_slews++;
+	}
+	stat_last_offset_usec = (int32_t) offset_usec;
+	
+	if (stepped) {
+		// Samples from before a step may have been measured against a clock that was
+		// wrong by any amount so start every filter again with a burst
+		for (i=0; i<num_servers; i++) {
+			memset(servers[i].filter, 0, sizeof(servers[i].filter));
+			servers[i].filter_index = 0;
+			servers[i].sel = -1;
+			servers[i].falseticker = false;
+			if (servers[i].stratum == 0) continue;   // Keep backing off a kiss-o'-death
+			servers[i].poll_secs = SNTP_MIN_POLL_SECS;
+			servers[i].burst = SNTP_BURST_POLLS;
+			servers[i].next_poll_usec = esp_timer_get_time();
+		}
+		selected = -1;
+	} else {
+		// Existing samples were measured against the unslewed clock
+		for (i=0; i<num_servers; i++) {
+			for (j=0; j<SNTP_FILTER_LEN; j++) {
+				servers[i].filter[j].offset_usec -= offset_usec;
+			}
+			servers[i].offset_usec -= offset_usec;
+		}
+	}
 	
-	now = tv->tv_sec;
-	if (tv->tv_usec > 500000) now += 1;
-	localtime_r(&now, &te);   // Get the unix formatted timeinfo
-	mktime(&te);              // Fill in the DOW and DOY fields
+	// Poll less often while the clock is stable
+	if (llabs(offset_usec) < SNTP_STABLE_USEC) {
+		if (s->poll_secs < SNTP_MAX_POLL_SECS) s->poll_secs *= 2;
+	} else {
+		// Check the correction soon instead of at the end of the interval already scheduled
+		s->poll_secs = SNTP_MIN_POLL_SECS;
+		if (s->next_poll_usec > (esp_timer_get_time() + (int64_t) SNTP_MIN_POLL_SECS * 1000000)) {
+			s->next_poll_usec = esp_timer_get_time() + (int64_t) SNTP_MIN_POLL_SECS * 1000000;
+		}
+	}
+	xSemaphoreGive(sntp_mutex);
 	
-	time_get_disp_string(&te, buf);
-	ESP_LOGI(TAG, "SNTP Set %s", buf);
+	if (stepped) {
+		now = tv.tv_sec;
+		localtime_r(&now, &te);   // Get the unix formatted timeinfo
+		mktime(&te);              // Fill in the DOW and DOY fields
+		time_get_disp_string(&te, buf);
+		ESP_LOGI(TAG, "SNTP Set %s (%" PRId64 " uSec)", buf, offset_usec);
+		
+		// The clock was stepped so re-align anything locked to its phase
+		time_note_step();
+	} else {
+		ESP_LOGD(TAG, "SNTP Slew %" PRId64 " uSec", offset_usec);
+	}
 	
-	if (!rtc_set_time_secs((uint32_t) now) != 0) {
-		ESP_LOGE(TAG, "Update RTC failed");
+	// Learn the RTC's drift against the corrected time
+	gettimeofday(&tv, NULL);
+	if (!stepped) {
+		_sntp_usec_to_tv(_sntp_tv_to_usec(&tv) + offset_usec, &tv);
 	}
+	rtc_drift_note_sync(&tv);
+}
+
+
+/**
+ * Correction still to be applied by a slew in progress (uSec)
+ */
+static int64_t _sntp_slew_remaining()
+{
+	struct timeval tv;
+	
+	if (adjtime(NULL, &tv) != 0) {
+		return 0;
+	}
+	
+	return _sntp_tv_to_usec(&tv);
+}
+
+
+static int64_t _sntp_tv_to_usec(const struct timeval* tv)
+{
+	return (int64_t) tv->tv_sec * 1000000 + (int64_t) tv->tv_usec;
+}
+
+
+static void _sntp_usec_to_tv(int64_t usec, struct timeval* tv)
+{
+	tv->tv_sec = (time_t) (usec / 1000000);
+	tv->tv_usec = (suseconds_t) (usec % 1000000);
+	if (tv->tv_usec < 0) {
+		tv->tv_sec -= 1;
+		tv->tv_usec += 1000000;
+	}
+}
+
+
+/**
+ * Store unix time (uSec) as an NTP timestamp
+ */
+static void _sntp_put_ts(uint8_t* p, int64_t usec)
+{
+	uint32_t secs, frac;
+	
+	secs = (uint32_t) (usec / 1000000 + SNTP_UNIX_OFFSET);
+	frac = (uint32_t) (((uint64_t) (usec % 1000000) << 32) / 1000000);
+	*(uint32_t*) &p[0] = htonl(secs);
+	*(uint32_t*) &p[4] = htonl(frac);
+}
+
+
+/**
+ * Get an NTP timestamp as unix time (uSec).  Era 0 timestamps wrap in 2036 so times
+ * with the high bit clear are taken to be in era 1.
+ */
+static int64_t _sntp_get_ts(const uint8_t* p)
+{
+	uint32_t secs, frac;
+	int64_t s;
+	
+	secs = ntohl(*(const uint32_t*) &p[0]);
+	frac = ntohl(*(const uint32_t*) &p[4]);
+	if ((secs == 0) && (frac == 0)) return 0;
+	
+	s = (int64_t) secs;
+	if ((secs & 0x80000000) == 0) s += 0x100000000LL;
+	
+	return (s - (int64_t) SNTP_UNIX_OFFSET) * 1000000 + (int64_t) (((uint64_t) frac * 1000000) >> 32);
+}
+
+
+/**
+ * Get an NTP short format (16.16 seconds) value in uSec
+ */
+static int64_t _sntp_get_short(const uint8_t* p)
+{
+	return ((int64_t) ntohl(*(const uint32_t*) p) * 1000000) >> 16;
 }
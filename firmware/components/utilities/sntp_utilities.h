@@ -19,17 +19,103 @@
 #ifndef _SNTP_UTILS_H
 #define _SNTP_UTILS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 
 //
 // Constants
 //
 #define NTP_POOL_SERVER "pool.ntp.org"
 
+// Configured servers ("name" or "name:port").  Servers provided by DHCP are added to these.
+#define SNTP_NUM_CFG_SERVERS     3
+#define SNTP_CFG_SERVERS         {"0." NTP_POOL_SERVER, "1." NTP_POOL_SERVER, "2." NTP_POOL_SERVER}
+
+// Set non-zero to replace the servers with local NTP stand-ins (ntp_standin) listening
+// on this and the following ports for testing
+#ifndef SNTP_STANDIN_PORT
+#define SNTP_STANDIN_PORT        0
+#endif
+#define SNTP_STANDIN_SERVERS     3
+
+// Maximum number of servers (configured + DHCP)
+#define SNTP_MAX_DHCP_SERVERS    2
+#define SNTP_MAX_SERVERS         (SNTP_NUM_CFG_SERVERS + SNTP_MAX_DHCP_SERVERS)
+#define SNTP_NAME_MAX_LEN        47
+
+#define SNTP_PORT                123
+
+// Poll interval limits (seconds).  Each server starts with a burst of quick polls to
+// fill its clock filter.
+#define SNTP_MIN_POLL_SECS       64
+#define SNTP_MAX_POLL_SECS       1024
+#define SNTP_BURST_POLLS         4
+#define SNTP_BURST_SECS          2
+
+// Response timeout (mSec)
+#define SNTP_TIMEOUT_MSEC        1000
+
+// Clock filter samples per server
+#define SNTP_FILTER_LEN          8
+
+// Dispersion growth of a sample with age (uSec per second - 15 PPM)
+#define SNTP_PHI_USEC            15
+
+// Servers more than this (plus their root distance) from the median offset are
+// falsetickers when there are at least 3 servers to compare (uSec)
+#define SNTP_FALSETICKER_USEC    100000
+
+// Offsets at least this large step the clock, smaller ones are slewed (uSec)
+#define SNTP_STEP_USEC           1000000
+
+// The poll interval doubles while offsets stay under this (uSec)
+#define SNTP_STABLE_USEC         20000
+
+// Task
+#define SNTP_TASK_STACK          3072
+#define SNTP_TASK_PRIO           1
+#define SNTP_TASK_CORE           0
+#define SNTP_TASK_EVAL_MSEC      1000
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	char name[SNTP_NAME_MAX_LEN+1];
+	bool from_dhcp;
+	bool valid;                        // Clock filter has a sample
+	bool selected;                     // Currently used to discipline the clock
+	bool falseticker;
+	uint8_t reach;                     // Shift register of poll successes
+	uint8_t stratum;
+	uint16_t poll_secs;
+	int32_t offset_usec;               // Clock filter outputs
+	uint32_t delay_usec;
+	uint32_t jitter_usec;
+	uint32_t polls;
+	uint32_t responses;
+} sntp_server_stats_t;
+
+typedef struct {
+	bool running;
+	int num_servers;
+	int selected;                      // Server index or -1
+	uint32_t steps;
+	uint32_t slews;
+	int32_t last_offset_usec;          // Last correction
+} sntp_stats_t;
+
+
 
 //
 // API
 //
 void sntp_start_service();
 void sntp_stop_service();
+void sntp_get_stats(sntp_stats_t* stats);
+bool sntp_get_server_stats(int index, sntp_server_stats_t* stats);
 
-#endif /* _SNTP_UTILS_H */
\ No newline at end of file
+#endif /* _SNTP_UTILS_H */
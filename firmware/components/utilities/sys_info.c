@@ -21,13 +21,23 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "alarm_utilities.h"
+#include "gcore.h"
+#include "i2c.h"
 #include "sys_info.h"
+#include "web_task.h"
 #include "time_utilities.h"
+#include "tzdb.h"
+#include "pm_utilities.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
+#include "rtc_drift.h"
+#include "sntp_utilities.h"
 #include "wifi_utilities.h"
+#include <stdio.h>
 #include <string.h>
 
 
@@ -41,6 +51,10 @@ static char info_buf[SYS_INFO_MAX_LEN+1];
 
 static net_config_t wifi_info;
 
+// I2C transaction rate is measured between info requests
+static uint32_t prev_i2c_count = 0;
+static int64_t prev_i2c_usec = 0;
+
 static const char* copyright_info = "\nFauxNixieClock copyright (c) 2024-2025\n" \
                                     "by Dan Julio.  All rights reserved.\n";
 
@@ -53,12 +67,18 @@ static void _update_info();
 static int _add_fw_version(int n);
 static int _add_sdk_version(int n);
 static int _add_battery_info(int n);
+static int _add_i2c_info(int n);
 static int _add_time(int n);
+static int _add_rtc_info(int n);
+static int _add_ntp_info(int n);
+static int _add_alarm_info(int n);
 static int _add_mem_info(int n);
+static int _add_pm_info(int n);
 static int _add_copyright_info(int n);
 static int _add_wifi_mode(int n);
 static int _add_ip_address(int n);
 static int _add_mac_address(int n);
+static int _add_web_info(int n);
 
 
 
@@ -87,11 +107,17 @@ static void _update_info()
 	n = _add_fw_version(n);
 	n = _add_sdk_version(n);
 	n = _add_battery_info(n);
+	n = _add_i2c_info(n);
 	n = _add_wifi_mode(n);
 	n = _add_ip_address(n);
 	n = _add_mac_address(n);
+	n = _add_web_info(n);
 	n = _add_time(n);
+	n = _add_rtc_info(n);
+	n = _add_ntp_info(n);
+	n = _add_alarm_info(n);
 	n = _add_mem_info(n);
+	n = _add_pm_info(n);
 	n = _add_copyright_info(n);
 }
 
@@ -101,7 +127,7 @@ static int _add_fw_version(int n)
 	const esp_app_desc_t* app_desc;
 	
 	app_desc = esp_app_get_description();
-	sprintf(&info_buf[n], "FW Version: %s\n", app_desc->version);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "FW Version: %s\n", app_desc->version);
 	
 	return (strlen(info_buf));
 }
@@ -109,7 +135,7 @@ static int _add_fw_version(int n)
 
 static int _add_sdk_version(int n)
 {
-	sprintf(&info_buf[n], "SDK Version: %s\n", esp_get_idf_version());
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "SDK Version: %s\n", esp_get_idf_version());
 	
 	return (strlen(info_buf));
 }
@@ -117,28 +143,90 @@ static int _add_sdk_version(int n)
 
 static int _add_battery_info(int n)
 {
+	int temp_mag;
+	int16_t temp;
 	batt_status_t bs;
+	gcore_snapshot_t snap;
 	
 	power_get_batt(&bs);
 
-	sprintf(&info_buf[n], "Battery: %1.2f V, Charge ", bs.batt_voltage);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Battery: %1.2f V, Charge ", bs.batt_voltage);
 	n = strlen(info_buf);
 	
 	switch (bs.charge_state) {
 		case CHARGE_OFF:
-			sprintf(&info_buf[n], "off\n");
+			snprintf(&info_buf[n], sizeof(info_buf) - n, "off\n");
 			break;
 		case CHARGE_ON:
-			sprintf(&info_buf[n], "on\n");
+			snprintf(&info_buf[n], sizeof(info_buf) - n, "on\n");
 			break;
 		case CHARGE_DONE:
-			sprintf(&info_buf[n], "done\n");
+			snprintf(&info_buf[n], sizeof(info_buf) - n, "done\n");
 			break;
 		case CHARGE_FAULT:
-			sprintf(&info_buf[n], "fault\n");
+			snprintf(&info_buf[n], sizeof(info_buf) - n, "fault\n");
 			break;
 	}
+	n = strlen(info_buf);
+	
+	if (bs.tte_min != POWER_TTE_UNKNOWN) {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Battery Charge: %d%%, %d:%02d remaining\n", bs.soc_percent,
+			bs.tte_min / 60, bs.tte_min % 60);
+	} else {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Battery Charge: %d%%\n", bs.soc_percent);
+	}
+	n = strlen(info_buf);
+	
+	// Temperature from the shared gCore snapshot (usually no additional I2C access)
+	if (gcore_get_snapshot(&snap, SYS_INFO_SNAPSHOT_MAX_AGE_MSEC)) {
+		// The register holds a signed value (formatted by magnitude so -0.5 keeps its sign)
+		temp = (int16_t) snap.temp;
+		temp_mag = (temp < 0) ? -temp : temp;
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "gCore Temp: %s%d.%d C\n", (temp < 0) ? "-" : "", temp_mag / 10, temp_mag % 10);
+	}
+
+	return (strlen(info_buf));
+}
+
 
+static int _add_i2c_info(int n)
+{
+	int64_t cur_usec;
+	uint32_t cur_count;
+	uint32_t rate = 0;
+	gcore_op_stats_t rd_stats;
+	gcore_op_stats_t wr_stats;
+	ps_commit_stats_t commit_stats;
+	
+	cur_count = i2c_get_transaction_count();
+	cur_usec = esp_timer_get_time();
+	
+	if (cur_usec > prev_i2c_usec) {
+		rate = (uint32_t) (((uint64_t) (cur_count - prev_i2c_count) * 1000000) / (cur_usec - prev_i2c_usec));
+	}
+	prev_i2c_count = cur_count;
+	prev_i2c_usec = cur_usec;
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "I2C: %lu transactions/sec\n", rate);
+	n = strlen(info_buf);
+	
+	gcore_get_op_stats(GCORE_OP_NVRAM_RD, &rd_stats);
+	gcore_get_op_stats(GCORE_OP_NVRAM_WR, &wr_stats);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "NVRAM: %lu rd (%lu retry, %lu err), %lu wr (%lu retry, %lu err)\n",
+		rd_stats.count, rd_stats.retries, rd_stats.errors,
+		wr_stats.count, wr_stats.retries, wr_stats.errors);
+	n = strlen(info_buf);
+	
+	ps_get_commit_stats(&commit_stats);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "NVRAM commits: %lu (%lu fail), %lu mSec avg, %lu max\n",
+		commit_stats.count, commit_stats.failures,
+		(commit_stats.count == 0) ? 0 : (commit_stats.total_msec / commit_stats.count),
+		commit_stats.max_msec);
+	n = strlen(info_buf);
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Settings: %lu changes in %lu NVRAM writes\n",
+		commit_stats.sets, commit_stats.nvram_flushes);
+	
 	return (strlen(info_buf));
 }
 
@@ -146,11 +234,125 @@ static int _add_battery_info(int n)
 static int _add_time(int n)
 {
 	char buf[28];
+	char name[TZDB_NAME_MAX_LEN+1];
 	tmElements_t te;
+	time_tick_stats_t tick_stats;
+	tz_config_t tz_config;
 	
 	time_get(&te);
 	time_get_disp_string(&te, buf);
-	sprintf(&info_buf[n], "Time: %s\n", buf);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Time: %s\n", buf);
+	n = strlen(info_buf);
+	
+	ps_get_config(PS_CONFIG_TYPE_TZ, &tz_config);
+	if (!tzdb_get_name(tzdb_find_id(tz_config.zone_id), name, sizeof(name))) {
+		strcpy(name, "Unknown");
+	}
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Timezone: %s (tzdata %s)\n", name, tzdb_get_version());
+	n = strlen(info_buf);
+	
+	// Display tick phase error against the system clock's half-second boundaries
+	time_get_tick_stats(&tick_stats);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Display Tick: %ld uSec err (avg %lu, max %lu), %lu of %lu late, %lu realigned\n",
+		tick_stats.last_err_usec, tick_stats.avg_err_usec, tick_stats.max_err_usec,
+		tick_stats.late, tick_stats.count, tick_stats.realigns);
+	
+	return (strlen(info_buf));
+}
+
+
+static int _add_rtc_info(int n)
+{
+	rtc_drift_stats_t stats;
+	
+	rtc_drift_get_stats(&stats);
+	
+	if (stats.valid) {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "RTC Drift: %+1.3f ppm (sd %1.3f), %u pairs over %1.1f h, resid %lu mSec\n",
+			stats.drift_ppb / 1000.0, stats.drift_sd_ppb / 1000.0, stats.pairs,
+			stats.span_secs / 3600.0, stats.resid_msec);
+		n = strlen(info_buf);
+		
+		// What a week without network time would look like
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "RTC Week Offline: %1.1f sec uncorrected, %1.2f sec corrected\n",
+			stats.week_raw_msec / 1000.0, stats.week_err_msec / 1000.0);
+	} else {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "RTC Drift: learning, %u pairs over %1.1f h\n", stats.pairs,
+			stats.span_secs / 3600.0);
+	}
+	n = strlen(info_buf);
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "RTC Discipline: %lu sec since sync, offset %ld mSec, %lu slews, %lu steps, %lu rejected\n",
+		stats.offline_secs, stats.last_offset_msec, stats.slews, stats.steps, stats.rejected);
+	n = strlen(info_buf);
+	
+	if (stats.edge_window_usec != 0) {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "RTC Boot Phase: seconds edge found within %lu uSec\n", stats.edge_window_usec);
+	}
+	
+	return (strlen(info_buf));
+}
+
+
+static int _add_ntp_info(int n)
+{
+	int i;
+	sntp_stats_t stats;
+	sntp_server_stats_t server;
+	
+	sntp_get_stats(&stats);
+	
+	if (!stats.running) {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "NTP: not running\n");
+		return (strlen(info_buf));
+	}
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "NTP: %d servers, last correction %ld uSec, %lu slews, %lu steps\n",
+		stats.num_servers, stats.last_offset_usec, stats.slews, stats.steps);
+	n = strlen(info_buf);
+	
+	// One line per server: '*' is the selected server, 'x' a falseticker
+	for (i=0; i<stats.num_servers; i++) {
+		if (!sntp_get_server_stats(i, &server)) break;
+		
+		if (server.valid) {
+			snprintf(&info_buf[n], sizeof(info_buf) - n, " %c %s%s: reach %03o, st %u, poll %u, off %ld, dly %lu, jit %lu uSec\n",
+				server.selected ? '*' : (server.falseticker ? 'x' : ' '), server.name,
+				server.from_dhcp ? " (DHCP)" : "", server.reach, server.stratum, server.poll_secs,
+				server.offset_usec, server.delay_usec, server.jitter_usec);
+		} else {
+			snprintf(&info_buf[n], sizeof(info_buf) - n, "   %s%s: reach %03o, %lu/%lu responses\n", server.name,
+				server.from_dhcp ? " (DHCP)" : "", server.reach, server.responses, server.polls);
+		}
+		n = strlen(info_buf);
+	}
+	
+	return n;
+}
+
+
+static int _add_alarm_info(int n)
+{
+	char buf[28];
+	time_t t;
+	struct tm te;
+	alarm_stats_t stats;
+	
+	alarm_get_stats(&stats);
+	
+	if (stats.next_index >= 0) {
+		t = (time_t) stats.next_secs;
+		localtime_r(&t, &te);
+		strftime(buf, sizeof(buf), "%a %m/%d %H:%M", &te);
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Alarms: %u enabled, next #%d at %s (RTC wake %lu)\n",
+			stats.enabled, stats.next_index + 1, buf, stats.rtc_alarm_secs);
+	} else {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Alarms: %u enabled, none pending\n", stats.enabled);
+	}
+	n = strlen(info_buf);
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Alarm Events: %lu fired, %lu skipped by clock steps, %lu rebuilds%s\n",
+		stats.fired, stats.dropped, stats.rebuilds, stats.alarm_wake ? ", powered on by alarm" : "");
 	
 	return (strlen(info_buf));
 }
@@ -158,7 +360,7 @@ static int _add_time(int n)
 
 static int _add_mem_info(int n)
 {
-	sprintf(&info_buf[n], "Heap Free: Int %d (min %d)\n            PSRAM %d (min %d)\n",
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Heap Free: Int %d (min %d)\n            PSRAM %d (min %d)\n",
 		heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
 		heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
 		heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
@@ -168,14 +370,39 @@ static int _add_mem_info(int n)
 }
 
 
+static int _add_pm_info(int n)
+{
+	int i;
+	pm_lock_stats_t stats;
+	
+	if (pm_enabled()) {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Power Mgmt: %d-%d MHz, light sleep %s\n", PM_MIN_CPU_FREQ_MHZ,
+			PM_MAX_CPU_FREQ_MHZ, PM_LIGHT_SLEEP_ENABLE ? "on" : "off");
+	} else {
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Power Mgmt: disabled\n");
+	}
+	n = strlen(info_buf);
+	
+	for (i=0; i<PM_NUM_LOCKS; i++) {
+		pm_get_lock_stats(i, &stats);
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "  %s lock: %lu holds, %lu mSec total, %lu uSec max%s\n",
+			pm_get_lock_name(i), stats.acquires, (uint32_t) (stats.total_usec / 1000),
+			stats.max_usec, stats.held ? " (held)" : "");
+		n = strlen(info_buf);
+	}
+	
+	return n;
+}
+
+
 static int _add_wifi_mode(int n)
 {
 	if (!wifi_info.sta_mode) {
-		sprintf(&info_buf[n], "Wifi Mode: AP\n");
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Wifi Mode: AP\n");
 	} else if (wifi_info.sta_static_ip) {
-		sprintf(&info_buf[n], "Wifi Mode: STA with static IP address\n");
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Wifi Mode: STA with static IP address\n");
 	} else {
-		sprintf(&info_buf[n], "Wifi Mode: STA\n");
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "Wifi Mode: STA\n");
 	}
 	
 	return (strlen(info_buf));
@@ -190,9 +417,9 @@ static int _add_ip_address(int n)
 	    ( wifi_info.sta_mode && wifi_is_connected())) {
 	    
 	    wifi_get_ipv4_addr(buf);
-		sprintf(&info_buf[n], "IP Address: %s\n", buf);
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "IP Address: %s\n", buf);
 	} else {
-		sprintf(&info_buf[n], "IP Address: - \n");
+		snprintf(&info_buf[n], sizeof(info_buf) - n, "IP Address: - \n");
 	}
 	
 	return (strlen(info_buf));
@@ -208,7 +435,7 @@ static int _add_mac_address(int n)
 	// Add 1 for soft AP mode (see "Miscellaneous System APIs" in the ESP-IDF documentation)
 	if (!wifi_info.sta_mode) sys_mac_addr[5] += 1;
 	
-	sprintf(&info_buf[n], "MAC Address: %02X:%02X:%02X:%02X:%02X:%02X\n",
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "MAC Address: %02X:%02X:%02X:%02X:%02X:%02X\n",
 		sys_mac_addr[0], sys_mac_addr[1], sys_mac_addr[2],
 		sys_mac_addr[3], sys_mac_addr[4], sys_mac_addr[5]);
 	
@@ -216,9 +443,26 @@ static int _add_mac_address(int n)
 }
 
 
+static int _add_web_info(int n)
+{
+	web_stats_t stats;
+	
+	web_get_stats(&stats);
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Web: %lu requests, %lu not modified, %lu bytes sent\n",
+		stats.requests, stats.not_modified, stats.body_bytes);
+	n = strlen(info_buf);
+	
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "Web Encoding: %lu gzip, %lu identity\n",
+		stats.encoding[0], stats.encoding[1]);
+	
+	return (strlen(info_buf));
+}
+
+
 static int _add_copyright_info(int n)
 {
-	sprintf(&info_buf[n], copyright_info);
+	snprintf(&info_buf[n], sizeof(info_buf) - n, "%s", copyright_info);
 	
 	return(strlen(info_buf));
 }
@@ -25,7 +25,10 @@
 //
 // Constants
 //
-#define SYS_INFO_MAX_LEN 1024
+#define SYS_INFO_MAX_LEN 2560
+
+// Maximum age of the gCore snapshot used for the info string (mSec)
+#define SYS_INFO_SNAPSHOT_MAX_AGE_MSEC 1000
 
 
 //
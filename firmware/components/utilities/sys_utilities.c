@@ -20,16 +20,22 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  *
  */
+#include "alarm_utilities.h"
 #include "ctrl_task.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "gcore.h"
 #include "i2c.h"
+#include "pm_utilities.h"
+#include "power_history.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
+#include "task_stats.h"
 #include "time_utilities.h"
+#include "tzdb.h"
 #include "wifi_utilities.h"
 #include "system_config.h"
 #include <string.h>
@@ -73,12 +79,33 @@ bool system_esp_io_init()
 	
 	ESP_LOGI(TAG, "ESP32 Peripheral Initialization");	
 	
+	// Power management first so its locks exist before any driver uses them
+	if (!pm_init()) {
+		ESP_LOGE(TAG, "Power management initialization failed");
+		return false;
+	}
+	
+	if (!task_stats_init()) {
+		ESP_LOGE(TAG, "Task statistics initialization failed");
+		return false;
+	}
+	
+	if (!power_history_init()) {
+		ESP_LOGE(TAG, "Power history initialization failed");
+		return false;
+	}
+	
 	// Attempt to initialize the I2C Master
 	ret = i2c_init(I2C_MASTER_SCL_IO, I2C_MASTER_SDA_IO);
 	if (ret != ESP_OK) {
 		ESP_LOGE(TAG, "I2C Master initialization failed - %d", ret);
 		return false;
 	}
+	
+	if (!gcore_init()) {
+		ESP_LOGE(TAG, "gCore interface initialization failed");
+		return false;
+	}
 
 	return true;
 }
@@ -99,7 +126,12 @@ bool system_peripheral_init()
 	}
 	
 	ps_get_config(PS_CONFIG_TYPE_TZ, &tz_config);
-	time_init(tz_config.tz);
+	time_init(tzdb_get_rule(tzdb_find_id(tz_config.zone_id)));
+	
+	if (!alarm_init()) {
+		ESP_LOGE(TAG, "Alarm initialization failed");
+		return false;
+	}
 	
 	if (!wifi_init()) {
 		ESP_LOGE(TAG, "Wi-Fi initialization failed");
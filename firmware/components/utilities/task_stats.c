@@ -0,0 +1,338 @@
+/*
+ * Task statistics - Periodically sample FreeRTOS per-task run-time counters and stack
+ * high-water marks and keep a short history for display.
+ *
+ * Samples are taken from ctrl_task.  The time LVGL spends in lv_task_handler() is
+ * accumulated by gui_task and reported as its own entry (it is a subset of gui_task).
+ * The cost of each sample is measured and the sample interval is stretched if it
+ * exceeds TASK_STATS_BUDGET_USEC so the overhead stays bounded.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sys_utilities.h"
+#include "task_stats.h"
+#include <stdio.h>
+#include <string.h>
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	bool valid;                // Task existed for this sample
+	uint16_t cpu_permille;     // Tenths of a percent of one core over the sample interval
+	uint32_t stack_free;       // Stack high-water mark (bytes never used)
+} task_stats_entry_t;
+
+
+
+//
+// Variables
+//
+static const char* TAG = "task_stats";
+
+static const char* tracked_names[TASK_STATS_NUM_TRACKED] = {
+	"ctrl_task",
+	"gui_task",
+	"lvgl",
+	"web_task",
+	"httpd",
+	"IDLE0",
+	"IDLE1",
+	"lcd_flush"
+};
+
+// Array filled by uxTaskGetSystemState (statically allocated to keep the sample cost fixed)
+static TaskStatus_t task_status_array[TASK_STATS_MAX_TASKS];
+
+// Previous counter values for computing per-interval deltas
+static bool have_baseline = false;
+static uint32_t prev_total_runtime;
+static uint32_t prev_task_runtime[TASK_STATS_NUM_TRACKED];
+static uint64_t prev_lvgl_usec;
+
+// Time spent in lv_task_handler, accumulated by gui_task
+static uint64_t lvgl_usec;
+static portMUX_TYPE lvgl_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// History ring buffer
+static task_stats_entry_t history[TASK_STATS_HISTORY_LEN][TASK_STATS_NUM_TRACKED];
+static int history_index = 0;
+static int history_count = 0;
+
+// Sample scheduling and overhead measurement
+static int sample_stretch = 1;
+static int sample_elapsed_msec = 0;
+static uint32_t sample_count = 0;
+static uint32_t sample_usec_last = 0;
+static uint32_t sample_usec_max = 0;
+static uint64_t sample_usec_total = 0;
+
+static SemaphoreHandle_t stats_mutex;
+
+// Info string
+static char info_buf[TASK_STATS_MAX_LEN+1];
+
+
+
+//
+// Forward declarations for internal functions
+//
+static int _task_stats_find(UBaseType_t num_tasks, int tracked_index);
+
+
+
+//
+// API
+//
+bool task_stats_init()
+{
+	stats_mutex = xSemaphoreCreateMutex();
+	if (stats_mutex == NULL) {
+		ESP_LOGE(TAG, "Could not create mutex");
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Called periodically with the time since the last call.  Returns true when
+ * task_stats_sample() should be called.
+ */
+bool task_stats_sample_due(int elapsed_msec)
+{
+	sample_elapsed_msec += elapsed_msec;
+	if (sample_elapsed_msec >= (TASK_STATS_SAMPLE_MSEC * sample_stretch)) {
+		sample_elapsed_msec = 0;
+		return true;
+	}
+
+	return false;
+}
+
+
+void task_stats_sample()
+{
+	int i, n;
+	int64_t t0;
+	uint32_t dur;
+	uint32_t cur_total_runtime;
+	uint32_t delta_total;
+	uint32_t cur_task_runtime[TASK_STATS_NUM_TRACKED];
+	uint64_t cur_lvgl_usec;
+	UBaseType_t num_tasks;
+	task_stats_entry_t entry[TASK_STATS_NUM_TRACKED];
+
+	t0 = esp_timer_get_time();
+
+	num_tasks = uxTaskGetSystemState(task_status_array, TASK_STATS_MAX_TASKS, &cur_total_runtime);
+	if (num_tasks == 0) {
+		ESP_LOGE(TAG, "More than %d tasks - increase TASK_STATS_MAX_TASKS", TASK_STATS_MAX_TASKS);
+		return;
+	}
+
+	portENTER_CRITICAL(&lvgl_spinlock);
+	cur_lvgl_usec = lvgl_usec;
+	portEXIT_CRITICAL(&lvgl_spinlock);
+
+	// Extract the tracked tasks
+	for (i=0; i<TASK_STATS_NUM_TRACKED; i++) {
+		entry[i].valid = false;
+		entry[i].cpu_permille = 0;
+		entry[i].stack_free = 0;
+		cur_task_runtime[i] = 0;
+
+		if (i == TASK_STATS_LVGL) {
+			entry[i].valid = true;
+		} else if ((n = _task_stats_find(num_tasks, i)) >= 0) {
+			entry[i].valid = true;
+			entry[i].stack_free = task_status_array[n].usStackHighWaterMark;
+			cur_task_runtime[i] = task_status_array[n].ulRunTimeCounter;
+		}
+	}
+
+	// Compute usage over the interval (the run-time counter is in uSec)
+	delta_total = cur_total_runtime - prev_total_runtime;
+	if (have_baseline && (delta_total != 0)) {
+		for (i=0; i<TASK_STATS_NUM_TRACKED; i++) {
+			if (i == TASK_STATS_LVGL) {
+				entry[i].cpu_permille = (uint16_t) (((cur_lvgl_usec - prev_lvgl_usec) * 1000) / delta_total);
+			} else if (entry[i].valid) {
+				entry[i].cpu_permille = (uint16_t) (((uint64_t) (cur_task_runtime[i] - prev_task_runtime[i]) * 1000) / delta_total);
+			}
+		}
+	}
+
+	prev_total_runtime = cur_total_runtime;
+	prev_lvgl_usec = cur_lvgl_usec;
+	for (i=0; i<TASK_STATS_NUM_TRACKED; i++) {
+		prev_task_runtime[i] = cur_task_runtime[i];
+	}
+
+	dur = (uint32_t) (esp_timer_get_time() - t0);
+
+	xSemaphoreTake(stats_mutex, portMAX_DELAY);
+	if (have_baseline) {
+		for (i=0; i<TASK_STATS_NUM_TRACKED; i++) {
+			history[history_index][i] = entry[i];
+		}
+		if (++history_index == TASK_STATS_HISTORY_LEN) history_index = 0;
+		if (history_count < TASK_STATS_HISTORY_LEN) history_count++;
+	}
+	sample_count += 1;
+	sample_usec_last = dur;
+	sample_usec_total += dur;
+	if (dur > sample_usec_max) sample_usec_max = dur;
+	xSemaphoreGive(stats_mutex);
+
+	have_baseline = true;
+
+	// Keep the sampling overhead bounded
+	if ((dur > TASK_STATS_BUDGET_USEC) && (sample_stretch < TASK_STATS_MAX_STRETCH)) {
+		sample_stretch *= 2;
+		ESP_LOGI(TAG, "Sample took %lu uSec - interval now %d mSec", dur, TASK_STATS_SAMPLE_MSEC * sample_stretch);
+	} else if ((dur < (TASK_STATS_BUDGET_USEC / 2)) && (sample_stretch > 1)) {
+		sample_stretch /= 2;
+	}
+}
+
+
+/**
+ * Called by gui_task with the time spent in each call to lv_task_handler()
+ */
+void task_stats_note_lvgl_usec(uint32_t usec)
+{
+	portENTER_CRITICAL(&lvgl_spinlock);
+	lvgl_usec += usec;
+	portEXIT_CRITICAL(&lvgl_spinlock);
+}
+
+
+char* task_stats_get_string()
+{
+	int i, j, k, n;
+	uint32_t cpu_sum;
+	uint32_t cpu_max;
+	uint32_t stack_min;
+	uint32_t num_valid;
+	uint32_t overhead_ppm;
+	task_stats_entry_t* cur;
+
+	xSemaphoreTake(stats_mutex, portMAX_DELAY);
+
+	if (history_count == 0) {
+		sprintf(info_buf, "Task statistics not yet available\n");
+		xSemaphoreGive(stats_mutex);
+		return info_buf;
+	}
+
+	sprintf(info_buf, "CPU %% of one core: now (avg/max)\nStack free bytes: now (min)\n");
+	n = strlen(info_buf);
+
+	// Most recent entry is just behind the push index
+	k = (history_index == 0) ? (TASK_STATS_HISTORY_LEN - 1) : (history_index - 1);
+
+	for (i=0; i<TASK_STATS_NUM_TRACKED; i++) {
+		cur = &history[k][i];
+		cpu_sum = 0;
+		cpu_max = 0;
+		stack_min = 0xFFFFFFFF;
+		num_valid = 0;
+		for (j=0; j<history_count; j++) {
+			if (history[j][i].valid) {
+				num_valid++;
+				cpu_sum += history[j][i].cpu_permille;
+				if (history[j][i].cpu_permille > cpu_max) cpu_max = history[j][i].cpu_permille;
+				if (history[j][i].stack_free < stack_min) stack_min = history[j][i].stack_free;
+			}
+		}
+
+		if (!cur->valid || (num_valid == 0)) {
+			sprintf(&info_buf[n], "%s: -\n", tracked_names[i]);
+		} else if (i == TASK_STATS_LVGL) {
+			sprintf(&info_buf[n], "  %s: %lu.%lu%% (%lu.%lu/%lu.%lu)\n", tracked_names[i],
+				(uint32_t) cur->cpu_permille / 10, (uint32_t) cur->cpu_permille % 10,
+				(cpu_sum / num_valid) / 10, (cpu_sum / num_valid) % 10,
+				cpu_max / 10, cpu_max % 10);
+		} else {
+			sprintf(&info_buf[n], "%s: %lu.%lu%% (%lu.%lu/%lu.%lu), stack %lu (%lu)\n", tracked_names[i],
+				(uint32_t) cur->cpu_permille / 10, (uint32_t) cur->cpu_permille % 10,
+				(cpu_sum / num_valid) / 10, (cpu_sum / num_valid) % 10,
+				cpu_max / 10, cpu_max % 10,
+				cur->stack_free, stack_min);
+		}
+		n = strlen(info_buf);
+	}
+
+	// Sampling overhead as a fraction of one core
+	overhead_ppm = (uint32_t) ((sample_usec_total / sample_count) * 1000 / (TASK_STATS_SAMPLE_MSEC * sample_stretch));
+	sprintf(&info_buf[n], "Sample: every %d s, %lu uSec (max %lu), %lu ppm\n",
+		(TASK_STATS_SAMPLE_MSEC * sample_stretch) / 1000,
+		sample_usec_last, sample_usec_max, overhead_ppm);
+
+	xSemaphoreGive(stats_mutex);
+
+	return info_buf;
+}
+
+
+
+//
+// Internal functions
+//
+static int _task_stats_find(UBaseType_t num_tasks, int tracked_index)
+{
+	int i;
+	TaskHandle_t h = NULL;
+
+	switch (tracked_index) {
+		case TASK_STATS_CTRL:
+			h = task_handle_ctrl;
+			break;
+		case TASK_STATS_GUI:
+			h = task_handle_gui;
+			break;
+		case TASK_STATS_WEB:
+			h = task_handle_web;
+			break;
+		case TASK_STATS_IDLE0:
+			h = xTaskGetIdleTaskHandleForCore(0);
+			break;
+		case TASK_STATS_IDLE1:
+			h = xTaskGetIdleTaskHandleForCore(1);
+			break;
+	}
+
+	for (i=0; i<num_tasks; i++) {
+		if (h != NULL) {
+			if (task_status_array[i].xHandle == h) return i;
+		} else {
+			// Tasks we don't create are found by name
+			if (strcmp(task_status_array[i].pcTaskName, tracked_names[tracked_index]) == 0) return i;
+		}
+	}
+
+	return -1;
+}
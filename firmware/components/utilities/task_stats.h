@@ -0,0 +1,71 @@
+/*
+ * Task statistics - Periodically sample FreeRTOS per-task run-time counters and stack
+ * high-water marks and keep a short history for display.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Constants
+//
+
+// Nominal sample interval (mSec) - may be stretched if sampling exceeds its budget
+#define TASK_STATS_SAMPLE_MSEC      5000
+
+// Maximum stretch factor applied to the sample interval
+#define TASK_STATS_MAX_STRETCH      8
+
+// Sampling budget (uSec) - a sample taking longer than this stretches the interval
+#define TASK_STATS_BUDGET_USEC      1000
+
+// Number of samples kept in the history ring buffer
+#define TASK_STATS_HISTORY_LEN      12
+
+// Size of the array handed to uxTaskGetSystemState (must be >= number of tasks in the system)
+#define TASK_STATS_MAX_TASKS        24
+
+// Tracked entries
+#define TASK_STATS_CTRL             0
+#define TASK_STATS_GUI              1
+#define TASK_STATS_LVGL             2
+#define TASK_STATS_WEB              3
+#define TASK_STATS_HTTPD            4
+#define TASK_STATS_IDLE0            5
+#define TASK_STATS_IDLE1            6
+#define TASK_STATS_LCD_FLUSH        7
+#define TASK_STATS_NUM_TRACKED      8
+
+// Maximum length of the info string
+#define TASK_STATS_MAX_LEN          1024
+
+
+
+//
+// API
+//
+bool task_stats_init();
+bool task_stats_sample_due(int elapsed_msec);
+void task_stats_sample();
+void task_stats_note_lvgl_usec(uint32_t usec);
+char* task_stats_get_string();
+
+#endif /* TASK_STATS_H */
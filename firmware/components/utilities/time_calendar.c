@@ -0,0 +1,474 @@
+/*
+ * Incremental calendar engine
+ *
+ * A full conversion finds the UTC offset in effect (from the DST transitions of the
+ * surrounding years), splits the local time into calendar fields and records the
+ * start of the local minute and the next DST transition.  Until the clock leaves
+ * that minute only the seconds change.  Moving into the following minute advances
+ * the cached fields (carrying into hours, days, months and years) as long as no
+ * transition is crossed.  Anything else - a clock step in either direction, skipped
+ * minutes or a DST transition - causes a full conversion.
+ *
+ * Only standard C is used so the engine can be compiled on a host and checked
+ * against the C library's localtime().
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "time_calendar.h"
+#include <ctype.h>
+#include <string.h>
+
+
+//
+// Constants
+//
+#define SECS_PER_MIN   60
+#define SECS_PER_HOUR  3600
+#define SECS_PER_DAY   86400
+
+// Transitions examined around the current year (start and end for each of 3 years)
+#define NUM_EVENTS     6
+
+
+//
+// Typedefs
+//
+typedef struct {
+	time_t t;
+	bool dst;
+} time_cal_event_t;
+
+
+//
+// Variables
+//
+static const uint8_t days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+
+
+//
+// Forward declarations for internal functions
+//
+static const char* _time_cal_parse_name(const char* p);
+static const char* _time_cal_parse_num(const char* p, int max, int* n);
+static const char* _time_cal_parse_time(const char* p, int max_hours, int32_t* secs);
+static const char* _time_cal_parse_rule(const char* p, time_cal_rule_t* r);
+static void _time_cal_set_rule(time_cal_rule_t* r, int month, int week);
+static void _time_cal_recompute(time_cal_t* cal, time_t now);
+static void _time_cal_advance_minute(time_cal_t* cal);
+static int64_t _time_cal_rule_local(const time_cal_rule_t* r, int year);
+static bool _time_cal_is_leap(int year);
+static int _time_cal_month_days(int year, int mon);
+static int64_t _time_cal_days_from_civil(int year, int mon, int mday);
+static void _time_cal_civil_from_days(int64_t days, int* year, int* mon, int* mday);
+static int64_t _time_cal_floor_div(int64_t a, int64_t b);
+
+
+
+//
+// API
+//
+
+/**
+ * Compile a POSIX TZ string ("std offset [dst [offset] [,start[/time],end[/time]]]").
+ * Returns false (leaving tz set to UTC) if the string can't be parsed.  A string that
+ * only names a zone (e.g. "GMT") is taken to be UTC.
+ */
+bool time_cal_parse_tz(const char* tz_string, time_cal_tz_t* tz)
+{
+	const char* p;
+	int32_t secs;
+
+	memset(tz, 0, sizeof(time_cal_tz_t));
+
+	if ((tz_string == NULL) || (*tz_string == 0)) return true;
+
+	// Standard zone name and offset (POSIX offsets are positive west of Greenwich)
+	if ((p = _time_cal_parse_name(tz_string)) == NULL) return false;
+	if (*p == 0) return true;
+	if ((p = _time_cal_parse_time(p, 24, &secs)) == NULL) goto error;
+	tz->std_offset = -secs;
+	tz->dst_offset = tz->std_offset;
+	if (*p == 0) return true;
+
+	// DST zone name and optional offset (default one hour ahead of standard time)
+	if ((p = _time_cal_parse_name(p)) == NULL) goto error;
+	tz->has_dst = true;
+	tz->dst_offset = tz->std_offset + SECS_PER_HOUR;
+	if ((*p != 0) && (*p != ',')) {
+		if ((p = _time_cal_parse_time(p, 24, &secs)) == NULL) goto error;
+		tz->dst_offset = -secs;
+	}
+
+	// Rules
+	if (*p == 0) {
+		_time_cal_set_rule(&tz->start, TIME_CAL_DEF_START_MONTH, TIME_CAL_DEF_START_WEEK);
+		_time_cal_set_rule(&tz->end, TIME_CAL_DEF_END_MONTH, TIME_CAL_DEF_END_WEEK);
+		return true;
+	}
+	if (*p++ != ',') goto error;
+	if ((p = _time_cal_parse_rule(p, &tz->start)) == NULL) goto error;
+	if (*p++ != ',') goto error;
+	if ((p = _time_cal_parse_rule(p, &tz->end)) == NULL) goto error;
+	if (*p != 0) goto error;
+
+	return true;
+
+error:
+	memset(tz, 0, sizeof(time_cal_tz_t));
+	return false;
+}
+
+
+/**
+ * Prepare a converter for a compiled timezone (the cache is invalidated)
+ */
+void time_cal_init(time_cal_t* cal, const time_cal_tz_t* tz)
+{
+	memset(cal, 0, sizeof(time_cal_t));
+	cal->tz = *tz;
+}
+
+
+/**
+ * Convert a system time to local broken-down time (all fields including tm_wday,
+ * tm_yday and tm_isdst are filled in)
+ */
+void time_cal_get(time_cal_t* cal, time_t now, struct tm* te)
+{
+	time_t delta;
+
+	if (cal->valid && (now >= cal->minute_start) && (now < cal->next_change)) {
+		delta = now - cal->minute_start;
+		if ((delta >= SECS_PER_MIN) && (delta < 2*SECS_PER_MIN)) {
+			_time_cal_advance_minute(cal);
+			delta -= SECS_PER_MIN;
+		}
+		if (delta < SECS_PER_MIN) {
+			*te = cal->tm;
+			te->tm_sec = (int) delta;
+			return;
+		}
+	}
+
+	_time_cal_recompute(cal, now);
+	*te = cal->tm;
+	te->tm_sec = (int) (now - cal->minute_start);
+}
+
+
+/**
+ * Return the system time the next local minute starts (valid after time_cal_get)
+ */
+time_t time_cal_next_minute(const time_cal_t* cal)
+{
+	return cal->minute_start + SECS_PER_MIN;
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Skip a zone name - either 3 or more letters or a quoted "<...>" form
+ */
+static const char* _time_cal_parse_name(const char* p)
+{
+	const char* s;
+
+	if (*p == '<') {
+		while ((*p != 0) && (*p != '>')) p++;
+		return (*p == '>') ? p + 1 : NULL;
+	}
+
+	s = p;
+	while (isalpha((unsigned char) *p)) p++;
+
+	return ((p - s) >= 3) ? p : NULL;
+}
+
+
+static const char* _time_cal_parse_num(const char* p, int max, int* n)
+{
+	if (!isdigit((unsigned char) *p)) return NULL;
+
+	*n = 0;
+	while (isdigit((unsigned char) *p)) {
+		*n = *n * 10 + (*p++ - '0');
+		if (*n > max) return NULL;
+	}
+
+	return p;
+}
+
+
+/**
+ * Parse "[+|-]hh[:mm[:ss]]" into signed seconds
+ */
+static const char* _time_cal_parse_time(const char* p, int max_hours, int32_t* secs)
+{
+	int h, m = 0, s = 0;
+	int sign = 1;
+
+	if (*p == '+') {
+		p++;
+	} else if (*p == '-') {
+		sign = -1;
+		p++;
+	}
+
+	if ((p = _time_cal_parse_num(p, max_hours, &h)) == NULL) return NULL;
+	if (*p == ':') {
+		if ((p = _time_cal_parse_num(p + 1, 59, &m)) == NULL) return NULL;
+		if (*p == ':') {
+			if ((p = _time_cal_parse_num(p + 1, 59, &s)) == NULL) return NULL;
+		}
+	}
+
+	*secs = sign * (h*SECS_PER_HOUR + m*SECS_PER_MIN + s);
+	return p;
+}
+
+
+static const char* _time_cal_parse_rule(const char* p, time_cal_rule_t* r)
+{
+	int n, m, w, d;
+
+	if (*p == 'J') {
+		if ((p = _time_cal_parse_num(p + 1, 365, &n)) == NULL) return NULL;
+		if (n < 1) return NULL;
+		r->type = TIME_CAL_RULE_JULIAN1;
+		r->day = n;
+	} else if (*p == 'M') {
+		if ((p = _time_cal_parse_num(p + 1, 12, &m)) == NULL) return NULL;
+		if (*p++ != '.') return NULL;
+		if ((p = _time_cal_parse_num(p, 5, &w)) == NULL) return NULL;
+		if (*p++ != '.') return NULL;
+		if ((p = _time_cal_parse_num(p, 6, &d)) == NULL) return NULL;
+		if ((m < 1) || (w < 1)) return NULL;
+		r->type = TIME_CAL_RULE_MONTH;
+		r->month = m;
+		r->week = w;
+		r->wday = d;
+	} else {
+		if ((p = _time_cal_parse_num(p, 365, &n)) == NULL) return NULL;
+		r->type = TIME_CAL_RULE_JULIAN0;
+		r->day = n;
+	}
+
+	// Transition time (POSIX allows -167 to 167 hours)
+	r->secs = TIME_CAL_DEF_RULE_SECS;
+	if (*p == '/') {
+		if ((p = _time_cal_parse_time(p + 1, 167, &r->secs)) == NULL) return NULL;
+	}
+
+	return p;
+}
+
+
+static void _time_cal_set_rule(time_cal_rule_t* r, int month, int week)
+{
+	r->type = TIME_CAL_RULE_MONTH;
+	r->month = month;
+	r->week = week;
+	r->wday = 0;
+	r->day = 0;
+	r->secs = TIME_CAL_DEF_RULE_SECS;
+}
+
+
+/**
+ * Full conversion - find the offset and next transition and split the local time
+ */
+static void _time_cal_recompute(time_cal_t* cal, time_t now)
+{
+	bool dst = false;
+	int i, j, year, mon, mday;
+	int32_t offset;
+	int64_t local, days, secs;
+	time_cal_event_t events[NUM_EVENTS];
+	time_cal_event_t e;
+
+	cal->next_change = TIME_CAL_NEVER;
+
+	if (cal->tz.has_dst) {
+		// Transitions for the years around now (sorted by time)
+		days = _time_cal_floor_div((int64_t) now + cal->tz.std_offset, SECS_PER_DAY);
+		_time_cal_civil_from_days(days, &year, &mon, &mday);
+		for (i=0; i<3; i++) {
+			events[2*i].t = (time_t) (_time_cal_rule_local(&cal->tz.start, year - 1 + i) - cal->tz.std_offset);
+			events[2*i].dst = true;
+			events[2*i+1].t = (time_t) (_time_cal_rule_local(&cal->tz.end, year - 1 + i) - cal->tz.dst_offset);
+			events[2*i+1].dst = false;
+		}
+		for (i=1; i<NUM_EVENTS; i++) {
+			e = events[i];
+			for (j=i; (j > 0) && (events[j-1].t > e.t); j--) events[j] = events[j-1];
+			events[j] = e;
+		}
+
+		// The most recent transition sets the current state, the first later one is next
+		dst = !events[0].dst;
+		for (i=0; i<NUM_EVENTS; i++) {
+			if (events[i].t <= now) {
+				dst = events[i].dst;
+			} else {
+				cal->next_change = events[i].t;
+				break;
+			}
+		}
+	}
+
+	offset = dst ? cal->tz.dst_offset : cal->tz.std_offset;
+	local = (int64_t) now + offset;
+	days = _time_cal_floor_div(local, SECS_PER_DAY);
+	secs = local - days * SECS_PER_DAY;
+	_time_cal_civil_from_days(days, &year, &mon, &mday);
+
+	cal->tm.tm_year = year - 1900;
+	cal->tm.tm_mon = mon - 1;
+	cal->tm.tm_mday = mday;
+	cal->tm.tm_hour = (int) (secs / SECS_PER_HOUR);
+	cal->tm.tm_min = (int) ((secs % SECS_PER_HOUR) / SECS_PER_MIN);
+	cal->tm.tm_sec = 0;
+	cal->tm.tm_wday = (int) (((days % 7) + 11) % 7);     // Jan 1 1970 was a Thursday
+	cal->tm.tm_yday = (int) (days - _time_cal_days_from_civil(year, 1, 1));
+	cal->tm.tm_isdst = dst ? 1 : 0;
+
+	cal->minute_start = now - (time_t) (secs % SECS_PER_MIN);
+	cal->valid = true;
+	cal->recomputes++;
+}
+
+
+static void _time_cal_advance_minute(time_cal_t* cal)
+{
+	struct tm* t = &cal->tm;
+
+	cal->minute_start += SECS_PER_MIN;
+	cal->advances++;
+
+	if (++t->tm_min < 60) return;
+	t->tm_min = 0;
+	if (++t->tm_hour < 24) return;
+	t->tm_hour = 0;
+	t->tm_wday = (t->tm_wday + 1) % 7;
+	t->tm_yday++;
+	if (++t->tm_mday <= _time_cal_month_days(t->tm_year + 1900, t->tm_mon)) return;
+	t->tm_mday = 1;
+	if (++t->tm_mon < 12) return;
+	t->tm_mon = 0;
+	t->tm_yday = 0;
+	t->tm_year++;
+}
+
+
+/**
+ * Return the local time (seconds since the epoch, ignoring the offset) a rule
+ * triggers in year
+ */
+static int64_t _time_cal_rule_local(const time_cal_rule_t* r, int year)
+{
+	int first_wday, n;
+	int64_t days;
+
+	switch (r->type) {
+		case TIME_CAL_RULE_JULIAN1:
+			n = r->day - 1;
+			if (_time_cal_is_leap(year) && (n >= 59)) n++;
+			days = _time_cal_days_from_civil(year, 1, 1) + n;
+			break;
+
+		case TIME_CAL_RULE_JULIAN0:
+			days = _time_cal_days_from_civil(year, 1, 1) + r->day;
+			break;
+
+		default:
+			days = _time_cal_days_from_civil(year, r->month, 1);
+			first_wday = (int) (((days % 7) + 11) % 7);
+			days += (r->wday - first_wday + 7) % 7 + (r->week - 1) * 7;
+			n = _time_cal_month_days(year, r->month - 1);
+			while ((days - _time_cal_days_from_civil(year, r->month, 1)) >= n) days -= 7;
+			break;
+	}
+
+	return days * SECS_PER_DAY + r->secs;
+}
+
+
+static bool _time_cal_is_leap(int year)
+{
+	return (((year % 4) == 0) && ((year % 100) != 0)) || ((year % 400) == 0);
+}
+
+
+/**
+ * Days in month mon (0-11)
+ */
+static int _time_cal_month_days(int year, int mon)
+{
+	if ((mon == 1) && _time_cal_is_leap(year)) return 29;
+
+	return days_in_month[mon];
+}
+
+
+/**
+ * Days since Jan 1 1970 for a proleptic Gregorian date (mon 1-12).  Algorithms from
+ * Howard Hinnant's "chrono-Compatible Low-Level Date Algorithms".
+ */
+static int64_t _time_cal_days_from_civil(int year, int mon, int mday)
+{
+	int64_t y, era, yoe, doy, doe;
+
+	y = year - ((mon <= 2) ? 1 : 0);
+	era = _time_cal_floor_div(y, 400);
+	yoe = y - era * 400;
+	doy = (153 * ((mon > 2) ? (mon - 3) : (mon + 9)) + 2) / 5 + mday - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+
+static void _time_cal_civil_from_days(int64_t days, int* year, int* mon, int* mday)
+{
+	int64_t z, era, doe, yoe, doy, mp;
+
+	z = days + 719468;
+	era = _time_cal_floor_div(z, 146097);
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+
+	*mday = (int) (doy - (153 * mp + 2) / 5 + 1);
+	*mon = (int) ((mp < 10) ? (mp + 3) : (mp - 9));
+	*year = (int) (yoe + era * 400 + ((*mon <= 2) ? 1 : 0));
+}
+
+
+static int64_t _time_cal_floor_div(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+
+	if (((a % b) != 0) && ((a < 0) != (b < 0))) q--;
+
+	return q;
+}
@@ -0,0 +1,96 @@
+/*
+ * Incremental calendar engine
+ *
+ * Converts system time to broken-down local time using a compiled POSIX TZ rule.
+ * Each converter caches the current local minute and the next DST transition so
+ * successive calls only fill in the seconds, or advance the cached fields by one
+ * minute, instead of doing a full calendar and TZ rule evaluation.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TIME_CALENDAR_H
+#define TIME_CALENDAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+
+//
+// Constants
+//
+
+// DST rule types
+#define TIME_CAL_RULE_JULIAN1    0     // Jn - day 1-365, February 29 is never counted
+#define TIME_CAL_RULE_JULIAN0    1     // n  - day 0-365, February 29 is counted in leap years
+#define TIME_CAL_RULE_MONTH      2     // Mm.w.d - day d of week w (5 = last) of month m
+
+// Default DST rules when the TZ string names a DST zone without rules (US rules)
+#define TIME_CAL_DEF_START_MONTH 3
+#define TIME_CAL_DEF_START_WEEK  2
+#define TIME_CAL_DEF_END_MONTH   11
+#define TIME_CAL_DEF_END_WEEK    1
+
+// Default time of day of a transition (seconds)
+#define TIME_CAL_DEF_RULE_SECS   7200
+
+// Next transition value for zones without DST
+#define TIME_CAL_NEVER           ((time_t) INT64_MAX)
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint8_t type;
+	uint8_t month;                     // TIME_CAL_RULE_MONTH: 1-12
+	uint8_t week;                      // TIME_CAL_RULE_MONTH: 1-5
+	uint8_t wday;                      // TIME_CAL_RULE_MONTH: 0 (Sunday) - 6
+	uint16_t day;                      // TIME_CAL_RULE_JULIAN1/0
+	int32_t secs;                      // Local time of day of the transition (may be < 0 or > 24h)
+} time_cal_rule_t;
+
+typedef struct {
+	int32_t std_offset;                // Seconds east of UTC
+	int32_t dst_offset;
+	bool has_dst;
+	time_cal_rule_t start;             // Transition to DST (in standard time)
+	time_cal_rule_t end;               // Transition back to standard time (in DST)
+} time_cal_tz_t;
+
+typedef struct {
+	time_cal_tz_t tz;
+	bool valid;                        // Cached fields hold a converted minute
+	time_t minute_start;               // System time of the start of the cached local minute
+	time_t next_change;                // System time of the next DST transition
+	struct tm tm;                      // Local time at minute_start
+	uint32_t recomputes;               // Full conversions
+	uint32_t advances;                 // Incremental one minute advances
+} time_cal_t;
+
+
+
+//
+// API
+//
+bool time_cal_parse_tz(const char* tz_string, time_cal_tz_t* tz);
+void time_cal_init(time_cal_t* cal, const time_cal_tz_t* tz);
+void time_cal_get(time_cal_t* cal, time_t now, struct tm* te);
+time_t time_cal_next_minute(const time_cal_t* cal);
+
+#endif /* TIME_CALENDAR_H */
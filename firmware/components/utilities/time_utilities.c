@@ -23,7 +23,11 @@
 #include "esp_system.h"
 #include "time_utilities.h"
 #include "esp_log.h"
-#include "rtc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gui_task.h"
+#include "rtc_drift.h"
+#include "sys_utilities.h"
 #include <stdlib.h>
 #include <sys/time.h>
 
@@ -70,41 +74,71 @@ static const char* mon_strings[] = {
 //
 static const char* TAG = "time_utilities";
 
+// Compiled form of the current timezone for time_get_cached().  The generation is
+// incremented each time it changes so caches know to reload it.
+static time_cal_tz_t tz_rules;
+static uint32_t tz_generation = 0;
+static portMUX_TYPE tz_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// Display tick phase statistics
+static time_tick_stats_t tick_stats;
+static uint64_t tick_err_sum_usec;
+static portMUX_TYPE tick_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// Incremented each time the system clock is stepped
+static volatile uint32_t step_count = 0;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _time_set_tz(const char* timezone);
+static void _time_edge_task(void* args);
+
+
 
 //
 // Time Utilities API
 //
 
 /**
- * Initialize system time from the RTC
+ * Initialize system time from the RTC (corrected for its drift).  The RTC only has
+ * whole seconds so the time is set to the middle of the current second and then
+ * refined in the background once the RTC's next seconds edge is seen.
  */
 void time_init(const char *timezone)
 {
 	char buf[32];
 	struct timeval tv;
 	tmElements_t te;
-	uint32_t secs;
 	
 	// Set the timezone first
-	setenv("TZ", timezone, 1);
-	tzset();
+	_time_set_tz(timezone);
 	ESP_LOGI(TAG, "Set timezone: %s", timezone);
 	
-	// Set the system time from the RTC
-	secs = rtc_get_time_secs();
-	if (secs == 0) {
-		secs = MIN_EPOCH_TIME;
+	// Get the time from the RTC
+	(void) rtc_drift_init();
+	if (!rtc_drift_get_time(&tv) || (tv.tv_sec < MIN_EPOCH_TIME)) {
+		tv.tv_sec = MIN_EPOCH_TIME;
+		tv.tv_usec = 0;
 	}
 	
 	// Set ESP32 system clock
-	tv.tv_sec = secs;
-	tv.tv_usec = 0;
 	settimeofday((const struct timeval *) &tv, NULL);
 	
 	// Diagnostic display of time
 	time_get(&te);
 	time_get_disp_string(&te, buf);
 	ESP_LOGI(TAG, "Set time: %s", buf);
+	
+	// Recover the sub-second phase while the rest of the system starts
+	if (tv.tv_sec > MIN_EPOCH_TIME) {
+		if (xTaskCreatePinnedToCore(&_time_edge_task, "time_edge", TIME_EDGE_TASK_STACK, NULL,
+		                            TIME_EDGE_TASK_PRIO, NULL, TIME_EDGE_TASK_CORE) != pdPASS) {
+			ESP_LOGE(TAG, "Could not start edge task");
+		}
+	}
 }
 
 
@@ -122,9 +156,10 @@ void time_set(tmElements_t* te)
 	tv.tv_sec = secs;
 	tv.tv_usec = 0;
 	settimeofday((const struct timeval *) &tv, NULL);
+	time_note_step();
 	
-	// Then attempt to set the RTC
-	if (rtc_set_time_secs(secs)) {
+	// Then attempt to set the RTC (the drift correction follows the new time)
+	if (rtc_drift_set_rtc((uint32_t) secs, true)) {
 		time_get_disp_string(te, buf);
 		ESP_LOGI(TAG, "Update RTC time: %s", buf);
 	} else {
@@ -147,6 +182,95 @@ void time_get(tmElements_t* te)
 }
 
 
+/**
+ * Get the system time using a caller-owned cache.  Intended for callers that need
+ * the local time frequently: the cache advances minute by minute and only does a
+ * full conversion after a clock step, DST transition or timezone change.
+ */
+void time_get_cached(time_cache_t* cache, tmElements_t* te)
+{
+	time_t now;
+	
+	// Reload the timezone if it changed since the cache last saw it
+	if (cache->tz_generation != tz_generation) {
+		portENTER_CRITICAL(&tz_spinlock);
+		time_cal_init(&cache->cal, &tz_rules);
+		cache->tz_generation = tz_generation;
+		portEXIT_CRITICAL(&tz_spinlock);
+	}
+	
+	time(&now);
+	time_cal_get(&cache->cal, now, te);
+}
+
+
+/**
+ * Let tasks that are phase-locked to the system clock know it was stepped
+ */
+void time_note_step()
+{
+	step_count++;
+	
+	if (task_handle_gui != NULL) {
+		xTaskNotify(task_handle_gui, GUI_NOTIFY_TIME_STEP, eSetBits);
+	}
+}
+
+
+/**
+ * Called by gui_task with the phase error of each display tick
+ */
+void time_note_tick_err(int32_t err_usec)
+{
+	uint32_t abs_err_usec;
+	
+	abs_err_usec = (err_usec < 0) ? -err_usec : err_usec;
+	
+	portENTER_CRITICAL(&tick_spinlock);
+	tick_stats.count++;
+	tick_stats.last_err_usec = err_usec;
+	if (abs_err_usec > tick_stats.max_err_usec) tick_stats.max_err_usec = abs_err_usec;
+	if (abs_err_usec > TIME_TICK_TARGET_USEC) tick_stats.late++;
+	tick_err_sum_usec += abs_err_usec;
+	portEXIT_CRITICAL(&tick_spinlock);
+}
+
+
+void time_note_tick_realign()
+{
+	portENTER_CRITICAL(&tick_spinlock);
+	tick_stats.realigns++;
+	portEXIT_CRITICAL(&tick_spinlock);
+}
+
+
+void time_get_tick_stats(time_tick_stats_t* stats)
+{
+	portENTER_CRITICAL(&tick_spinlock);
+	*stats = tick_stats;
+	if (tick_stats.count != 0) {
+		stats->avg_err_usec = (uint32_t) (tick_err_sum_usec / tick_stats.count);
+	}
+	portEXIT_CRITICAL(&tick_spinlock);
+}
+
+
+/**
+ * Counters that change when the system clock is stepped or the timezone changes (for
+ * modules that keep times computed from the local time)
+ */
+uint32_t time_get_step_count()
+{
+	return step_count;
+}
+
+
+uint32_t time_get_tz_generation()
+{
+	return tz_generation;
+}
+
+
 /**
  * Change the timezone
  */
@@ -160,8 +284,7 @@ void time_timezone_set(const char *timezone)
 	ESP_LOGI(TAG, "New timezone: %s", timezone);
 	
 	// Set the new timezone
-	setenv("TZ", timezone, 1);
-	tzset();
+	_time_set_tz(timezone);
 	
 	// Update the RTC
 	gettimeofday(&tv, NULL);
@@ -170,7 +293,7 @@ void time_timezone_set(const char *timezone)
 		secs += 1;
 	}
 	
-	if (rtc_set_time_secs(secs)) {
+	if (rtc_drift_set_rtc(secs, false)) {
 		time_get(&te);
 		time_get_disp_string(&te, buf);
 		ESP_LOGI(TAG, "Set RTC time for timezone change to: %s", buf);
@@ -231,3 +354,53 @@ void time_get_disp_string(tmElements_t* te, char* buf)
 		te->tm_min,
 		te->tm_sec);
 }
+
+
+
+//
+// Internal functions
+//
+static void _time_set_tz(const char* timezone)
+{
+	time_cal_tz_t new_rules;
+	
+	// Used by the C library
+	setenv("TZ", timezone, 1);
+	tzset();
+	
+	// Used by time_get_cached
+	if (!time_cal_parse_tz(timezone, &new_rules)) {
+		ESP_LOGE(TAG, "Could not parse timezone %s - using UTC for cached time", timezone);
+	}
+	portENTER_CRITICAL(&tz_spinlock);
+	tz_rules = new_rules;
+	tz_generation++;
+	portEXIT_CRITICAL(&tz_spinlock);
+}
+
+
+/**
+ * Step the system clock to the RTC's seconds edge - unless something else set the
+ * clock while we were waiting
+ */
+static void _time_edge_task(void* args)
+{
+	int64_t err_usec;
+	struct timeval tv, now;
+	uint32_t start_step_count;
+	
+	start_step_count = step_count;
+	
+	if (rtc_drift_get_edge_time(&tv)) {
+		gettimeofday(&now, NULL);
+		if (step_count == start_step_count) {
+			settimeofday((const struct timeval *) &tv, NULL);
+			time_note_step();
+			
+			err_usec = ((int64_t) tv.tv_sec - (int64_t) now.tv_sec) * 1000000 + (tv.tv_usec - now.tv_usec);
+			ESP_LOGI(TAG, "RTC phase correction %d mSec", (int) (err_usec / 1000));
+		}
+	}
+	
+	vTaskDelete(NULL);
+}
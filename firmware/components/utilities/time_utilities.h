@@ -26,6 +26,22 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
+#include "time_calendar.h"
+
+
+
+//
+// Time Utilities constants
+//
+
+// Display tick phase error target (uSec) - ticks with a larger error are counted as late
+#define TIME_TICK_TARGET_USEC 5000
+
+// Task that recovers the RTC's sub-second phase at boot (runs once, alongside Wi-Fi
+// bring-up, for up to RTC_DRIFT_EDGE_MSEC)
+#define TIME_EDGE_TASK_STACK  2048
+#define TIME_EDGE_TASK_PRIO   1
+#define TIME_EDGE_TASK_CORE   1
 
 
 
@@ -34,6 +50,22 @@
 //
 typedef struct tm tmElements_t;
 
+// Per-caller local time cache for time_get_cached() (zero-initialize before first use)
+typedef struct {
+	time_cal_t cal;
+	uint32_t tz_generation;
+} time_cache_t;
+
+// Phase error of the display tick against the system clock's half-second boundaries
+typedef struct {
+	uint32_t count;                    // Ticks measured
+	uint32_t late;                     // Ticks with an error over TIME_TICK_TARGET_USEC
+	uint32_t realigns;                 // Re-alignments after a clock step
+	int32_t last_err_usec;             // Error (+ late, - early) of the last tick
+	uint32_t avg_err_usec;             // Average absolute error
+	uint32_t max_err_usec;             // Largest absolute error
+} time_tick_stats_t;
+
 
 
 //
@@ -42,7 +74,14 @@ typedef struct tm tmElements_t;
 void time_init(const char *timezone);
 void time_set(tmElements_t* te);
 void time_get(tmElements_t* te);
+void time_get_cached(time_cache_t* cache, tmElements_t* te);
 void time_timezone_set(const char *timezone);
+void time_note_step();
+void time_note_tick_err(int32_t err_usec);
+void time_note_tick_realign();
+void time_get_tick_stats(time_tick_stats_t* stats);
+uint32_t time_get_step_count();
+uint32_t time_get_tz_generation();
 bool time_changed(tmElements_t* te, time_t* prev_time);
 void time_get_disp_string(tmElements_t* te, char* buf);
 
@@ -22,6 +22,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "wifi_utilities.h"
+#include "pm_utilities.h"
 #include "ps_utilities.h"
 #include "esp_system.h"
 #include "esp_app_desc.h"
@@ -29,6 +30,7 @@
 #include "esp_event.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
+#include "esp_sntp.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "mdns.h"
@@ -65,6 +67,7 @@ static const wifi_country_t def_country_info = {
 
 // Wifi configuration
 static net_config_t wifi_config;
+static uint32_t wifi_config_generation = PS_GENERATION_NONE;
 
 // Internal state
 static bool mdns_running = false;
@@ -154,7 +157,7 @@ bool wifi_init()
 	}
 	
 	// Get our wifi configuration
-	ps_get_config(PS_CONFIG_TYPE_NET, &wifi_config);
+	(void) ps_get_config_if_changed(PS_CONFIG_TYPE_NET, &wifi_config, &wifi_config_generation);
 	
 	// Initialize the WiFi interface
 	if (init_esp_wifi()) {
@@ -236,7 +239,7 @@ bool wifi_reinit()
 	}
 	
 	// Update the wifi info because we're called when it's updated
-	ps_get_config(PS_CONFIG_TYPE_NET, &wifi_config);
+	(void) ps_get_config_if_changed(PS_CONFIG_TYPE_NET, &wifi_config, &wifi_config_generation);
 	
 	// Reconfigure the interface if enabled
 	if (wifi_config.sta_mode) {
@@ -455,6 +458,9 @@ static bool enable_esp_wifi_client()
 		// Create the esp_netif object
 		wifi_netif = esp_netif_create_default_wifi_sta();
 		
+		// Let DHCP supply NTP servers to add to the configured ones
+		esp_sntp_servermode_dhcp(true);
+		
 		ret = esp_netif_dhcpc_start(wifi_netif);
 		if (ret != ESP_OK) {
     		ESP_LOGE(TAG, "Start Station DHCP returned %d", ret);
@@ -497,6 +503,12 @@ static bool enable_esp_wifi_client()
     	return false;
     }
     
+    // Let the radio sleep between DTIM beacons so the system can enter light sleep
+    ret = esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    if (ret != ESP_OK) {
+    	ESP_LOGE(TAG, "Could not set modem sleep (%d)", ret);
+    }
+    
     return true;
 }
 
@@ -511,6 +523,15 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 	wifi_event_ap_stadisconnected_t *dis_event;
 	
 	switch (event_id) {
+		case WIFI_EVENT_AP_START:
+			// The Soft AP must keep beaconing so light sleep is not allowed while it runs
+			pm_lock_acquire(PM_LOCK_WIFI);
+			break;
+		
+		case WIFI_EVENT_AP_STOP:
+			pm_lock_release(PM_LOCK_WIFI);
+			break;
+		
 		case WIFI_EVENT_AP_STACONNECTED:
 			con_event = (wifi_event_ap_staconnected_t *) event_data;
 			ESP_LOGI(TAG, "Station:"MACSTR" join, AID=%d", MAC2STR(con_event->mac), con_event->aid);
@@ -123,10 +123,13 @@ bool ws_gui_cmd_init()
 	}
 	
 	// Register command handlers supported on our end (get, set, rsp)
+	(void) cmd_register_cmd_id(CMD_ALARM, cmd_handler_get_alarm, cmd_handler_set_alarm, NULL);
 	(void) cmd_register_cmd_id(CMD_BACKLIGHT, cmd_handler_get_backlight, cmd_handler_set_backlight, NULL);
 	(void) cmd_register_cmd_id(CMD_MODE, cmd_handler_get_mode, cmd_handler_set_mode, NULL);
 	(void) cmd_register_cmd_id(CMD_POWEROFF, NULL, cmd_handler_set_poweroff, NULL);
+	(void) cmd_register_cmd_id(CMD_POWER_HIST, cmd_handler_get_power_hist, NULL, NULL);
 	(void) cmd_register_cmd_id(CMD_SYS_INFO, cmd_handler_get_sys_info, NULL, NULL);
+	(void) cmd_register_cmd_id(CMD_TASK_INFO, cmd_handler_get_task_info, NULL, NULL);
 	(void) cmd_register_cmd_id(CMD_TIME, cmd_handler_get_time, cmd_handler_set_time, NULL);
 	(void) cmd_register_cmd_id(CMD_TIMEZONE, cmd_handler_get_timezone, cmd_handler_set_timezone, NULL);
 	(void) cmd_register_cmd_id(CMD_WIFI_INFO, cmd_handler_get_wifi, cmd_handler_set_wifi, NULL);
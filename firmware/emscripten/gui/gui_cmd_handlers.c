@@ -18,6 +18,7 @@
  */
 #include <arpa/inet.h>
 #include "gui_cmd_handlers.h"
+#include "gui_panel_settings_alarm.h"
 #include "gui_sub_page_info.h"
 #include "gui_sub_page_time.h"
 #include "gui_state.h"
@@ -32,6 +33,7 @@
 //
 
 // These must match code below and in cmd handlers and sender
+#define CMD_ALARM_LEN           (GUI_NUM_ALARMS * 4)
 #define CMD_TIME_LEN            36
 #define CMD_WIFI_INFO_LEN       (3 + 2*(GUI_SSID_MAX_LEN+1) + 2*(GUI_PW_MAX_LEN+1) + 3*4)
 
@@ -40,6 +42,25 @@
 //
 // API
 //
+void cmd_handler_rsp_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	int i, n = 0;
+	
+	if ((data_type == CMD_DATA_BINARY) && (len == CMD_ALARM_LEN)) {
+		// Unpack the byte array in the same order the get command packed it
+		for (i=0; i<GUI_NUM_ALARMS; i++) {
+			gui_state.alarm[i].enable = (bool) data[n++];
+			gui_state.alarm[i].hour = data[n++];
+			gui_state.alarm[i].minute = data[n++];
+			gui_state.alarm[i].days = data[n++];
+		}
+		
+		gui_panel_settings_alarm_refresh();
+		gui_state_note_item_inited(GUI_STATE_INIT_ALARM);
+	}
+}
+
+
 void cmd_handler_rsp_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	if ((data_type == CMD_DATA_INT32) && (len == 4)) {
@@ -58,6 +79,14 @@ void cmd_handler_rsp_mode(cmd_data_t data_type, uint32_t len, uint8_t* data)
 }
 
 
+void cmd_handler_rsp_power_hist(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	if (data_type == CMD_DATA_BINARY) {
+		gui_sub_page_info_set_power_hist(len, data);
+	}
+}
+
+
 void cmd_handler_rsp_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	if (data_type == CMD_DATA_STRING) {
@@ -66,6 +95,14 @@ void cmd_handler_rsp_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
 }
 
 
+void cmd_handler_rsp_task_info(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	if (data_type == CMD_DATA_STRING) {
+		gui_sub_page_info_set_task_string((char*) data);
+	}
+}
+
+
 void cmd_handler_rsp_time(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
 	struct tm te;
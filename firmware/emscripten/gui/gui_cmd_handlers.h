@@ -28,9 +28,12 @@
 //
 // API
 //
+void cmd_handler_rsp_alarm(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_backlight(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_mode(cmd_data_t data_type, uint32_t len, uint8_t* data);
+void cmd_handler_rsp_power_hist(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_sys_info(cmd_data_t data_type, uint32_t len, uint8_t* data);
+void cmd_handler_rsp_task_info(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_time(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_timezone(cmd_data_t data_type, uint32_t len, uint8_t* data);
 void cmd_handler_rsp_wifi(cmd_data_t data_type, uint32_t len, uint8_t* data);
@@ -18,6 +18,7 @@
  */
 #include "gui_main.h"
 #include "gui_page_settings.h"
+#include "gui_panel_settings_alarm.h"
 #include "gui_panel_settings_backlight.h"
 #include "gui_panel_settings_info.h"
 #include "gui_panel_settings_mode.h"
@@ -34,7 +35,7 @@
 //
 
 // Maximum number of control panels we can add to this page
-#define MAX_CONTROL_PANELS  7
+#define MAX_CONTROL_PANELS  8
 
 
 //
@@ -141,6 +142,7 @@ lv_obj_t* gui_page_settings_init(lv_obj_t* screen, uint16_t page_w, uint16_t pag
 	gui_panel_settings_poweroff_init(page_controls);
 	gui_panel_settings_time_init(screen, page_controls);
 	gui_panel_settings_timezone_init(page_controls);
+	gui_panel_settings_alarm_init(page_controls);
 	gui_panel_settings_wifi_init(screen, page_controls);
 	
 	// Setup the page height after adding all content
@@ -170,6 +172,7 @@ void gui_page_settings_set_active(bool is_active)
 	gui_panel_settings_poweroff_set_active(is_active);
 	gui_panel_settings_time_set_active(is_active);
 	gui_panel_settings_timezone_set_active(is_active);
+	gui_panel_settings_alarm_set_active(is_active);
 	gui_panel_settings_wifi_set_active(is_active);
 }
 
@@ -0,0 +1,315 @@
+/*
+ * GUI settings alarm control panel
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "cmd_utilities.h"
+#include "gui_main.h"
+#include "gui_page_settings.h"
+#include "gui_panel_settings_alarm.h"
+#include "gui_state.h"
+#include <stdio.h>
+#include <string.h>
+
+
+//
+// Local variables
+//
+
+// State
+static int cur_alarm = 0;
+static bool cur_hour_mode_24;
+
+// Roller options
+static char num_list[GUI_NUM_ALARMS * 3];
+static char hour_list[24 * 8];
+static char minute_list[60 * 3];
+
+// Day buttons (bit 0 = Sunday)
+static const char* days_map[] = {"S", "M", "T", "W", "T", "F", "S", ""};
+
+//
+// LVGL Objects
+//
+static lv_obj_t* my_panel;
+static lv_obj_t* lbl_name;
+static lv_obj_t* rlr_num;
+static lv_obj_t* rlr_hour;
+static lv_obj_t* rlr_minute;
+static lv_obj_t* sw_assy;
+static lv_obj_t* sw_enable;
+static lv_obj_t* lbl_off;
+static lv_obj_t* lbl_on;
+static lv_obj_t* btn_days;
+
+// Change detect timer task
+static lv_task_t* task_upd_timer;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _cb_rlr_num(lv_obj_t* obj, lv_event_t event);
+static void _cb_rlr_time(lv_obj_t* obj, lv_event_t event);
+static void _cb_sw_enable(lv_obj_t* obj, lv_event_t event);
+static void _cb_btn_days(lv_obj_t* obj, lv_event_t event);
+static void _task_eval_upd_timer(lv_task_t* task);
+static void _start_upd_timer();
+static void _set_hour_list();
+static void _display_alarm();
+
+
+
+//
+// API
+//
+void gui_panel_settings_alarm_init(lv_obj_t* parent_cont)
+{
+	int i;
+	
+	// Control panel - width fits parent, height fits contents with padding
+	my_panel = lv_cont_create(parent_cont, NULL);
+	lv_obj_set_click(my_panel, false);
+	lv_obj_set_auto_realign(my_panel, true);
+	lv_cont_set_fit2(my_panel, LV_FIT_PARENT, LV_FIT_TIGHT);
+	lv_cont_set_layout(my_panel, LV_LAYOUT_PRETTY_MID);
+	lv_obj_set_style_local_pad_top(my_panel, LV_CONT_PART_MAIN, LV_STATE_DEFAULT, GUIP_SETTINGS_TOP_PAD);
+	lv_obj_set_style_local_pad_bottom(my_panel, LV_CONT_PART_MAIN, LV_STATE_DEFAULT, GUIP_SETTINGS_BTM_PAD);
+	lv_obj_set_style_local_pad_left(my_panel, LV_CONT_PART_MAIN, LV_STATE_DEFAULT, GUIP_SETTINGS_LEFT_PAD);
+	lv_obj_set_style_local_pad_right(my_panel, LV_CONT_PART_MAIN, LV_STATE_DEFAULT, GUIP_SETTINGS_RIGHT_PAD);
+	
+	// Panel name
+	lbl_name = lv_label_create(my_panel, NULL);
+	lv_label_set_static_text(lbl_name, "Alarms");
+	
+	// Alarm selection roller
+	num_list[0] = 0;
+	for (i=0; i<GUI_NUM_ALARMS; i++) {
+		sprintf(&num_list[strlen(num_list)], (i == 0) ? "%d" : "\n%d", i + 1);
+	}
+	rlr_num = lv_roller_create(my_panel, NULL);
+	lv_roller_set_options(rlr_num, num_list, LV_ROLLER_MODE_NORMAL);
+	lv_roller_set_auto_fit(rlr_num, false);
+	lv_obj_set_size(rlr_num, GUIPN_SETTINGS_ALARM_NUM_RLR_W, GUIPN_SETTINGS_ALARM_RLR_H);
+	lv_obj_set_style_local_bg_color(rlr_num, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
+	lv_obj_set_event_cb(rlr_num, _cb_rlr_num);
+	
+	// Hour roller (loaded for the current hour mode)
+	rlr_hour = lv_roller_create(my_panel, NULL);
+	lv_roller_set_auto_fit(rlr_hour, false);
+	lv_obj_set_size(rlr_hour, GUIPN_SETTINGS_ALARM_TIME_RLR_W, GUIPN_SETTINGS_ALARM_RLR_H);
+	lv_obj_set_style_local_bg_color(rlr_hour, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
+	lv_obj_set_event_cb(rlr_hour, _cb_rlr_time);
+	cur_hour_mode_24 = !gui_state.hour_mode_24;
+	_set_hour_list();
+	
+	// Minute roller
+	minute_list[0] = 0;
+	for (i=0; i<60; i++) {
+		sprintf(&minute_list[strlen(minute_list)], (i == 0) ? "%02d" : "\n%02d", i);
+	}
+	rlr_minute = lv_roller_create(my_panel, NULL);
+	lv_roller_set_options(rlr_minute, minute_list, LV_ROLLER_MODE_NORMAL);
+	lv_roller_set_auto_fit(rlr_minute, false);
+	lv_obj_set_size(rlr_minute, GUIPN_SETTINGS_ALARM_TIME_RLR_W, GUIPN_SETTINGS_ALARM_RLR_H);
+	lv_obj_set_style_local_bg_color(rlr_minute, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
+	lv_obj_set_event_cb(rlr_minute, _cb_rlr_time);
+	
+	// Switch assembly (labels + switch so my_panel container spaces it correctly)
+	sw_assy = lv_obj_create(my_panel, NULL);
+	lv_obj_set_click(sw_assy, false);
+	lv_obj_set_height(sw_assy, GUIPN_SETTINGS_ALARM_SW_H + 10);
+	lv_obj_set_width(sw_assy, 2*GUIPN_SETTINGS_ALARM_TYP_W + GUIPN_SETTINGS_ALARM_SW_W);
+	lv_obj_set_style_local_border_width(sw_assy, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, 0);
+	
+	// Enable switch
+	sw_enable = lv_switch_create(sw_assy, NULL);
+	lv_obj_align(sw_enable, sw_assy, LV_ALIGN_CENTER, 0, 0);
+	lv_obj_add_protect(sw_enable, LV_PROTECT_CLICK_FOCUS);
+	lv_obj_set_size(sw_enable, GUIPN_SETTINGS_ALARM_SW_W, GUIPN_SETTINGS_ALARM_SW_H);
+	lv_obj_set_style_local_bg_color(sw_enable, LV_SWITCH_PART_BG, LV_STATE_DEFAULT, GUI_THEME_SLD_BG_COLOR);
+	lv_obj_set_event_cb(sw_enable, _cb_sw_enable);
+	
+	lbl_off = lv_label_create(sw_assy, NULL);
+	lv_obj_set_width(lbl_off, GUIPN_SETTINGS_ALARM_TYP_W);
+	lv_obj_align(lbl_off, sw_enable, LV_ALIGN_OUT_LEFT_MID, 0, 0);
+	lv_label_set_static_text(lbl_off, "Off");
+	
+	lbl_on = lv_label_create(sw_assy, NULL);
+	lv_obj_set_width(lbl_on, GUIPN_SETTINGS_ALARM_TYP_W);
+	lv_obj_align(lbl_on, sw_enable, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+	lv_label_set_static_text(lbl_on, "On");
+	
+	// Day selection - no days selected is a one-shot alarm
+	btn_days = lv_btnmatrix_create(my_panel, NULL);
+	lv_btnmatrix_set_map(btn_days, days_map);
+	lv_obj_set_size(btn_days, GUIPN_SETTINGS_ALARM_DAYS_W, GUIPN_SETTINGS_ALARM_DAYS_H);
+	lv_obj_add_protect(btn_days, LV_PROTECT_CLICK_FOCUS);
+	lv_btnmatrix_set_btn_ctrl_all(btn_days, LV_BTNMATRIX_CTRL_CHECKABLE);
+	lv_btnmatrix_set_btn_ctrl_all(btn_days, LV_BTNMATRIX_CTRL_NO_REPEAT);
+	lv_obj_set_event_cb(btn_days, _cb_btn_days);
+	
+	// Register with our parent page
+	gui_page_settings_register_panel(my_panel, NULL, NULL, NULL);
+}
+
+
+void gui_panel_settings_alarm_set_active(bool is_active)
+{
+	if (is_active) {
+		_set_hour_list();
+		_display_alarm();
+	}
+}
+
+
+/**
+ * Redisplay after the controller changes an alarm (one-shot alarms disable themselves
+ * when they fire)
+ */
+void gui_panel_settings_alarm_refresh()
+{
+	if (task_upd_timer == NULL) {
+		_display_alarm();
+	}
+}
+
+
+
+//
+// Internal functions
+//
+static void _cb_rlr_num(lv_obj_t* obj, lv_event_t event)
+{
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		cur_alarm = (int) lv_roller_get_selected(obj);
+		_display_alarm();
+	}
+}
+
+
+static void _cb_rlr_time(lv_obj_t* obj, lv_event_t event)
+{
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		gui_state.alarm[cur_alarm].hour = (uint8_t) lv_roller_get_selected(rlr_hour);
+		gui_state.alarm[cur_alarm].minute = (uint8_t) lv_roller_get_selected(rlr_minute);
+		_start_upd_timer();
+	}
+}
+
+
+static void _cb_sw_enable(lv_obj_t* obj, lv_event_t event)
+{
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		gui_state.alarm[cur_alarm].enable = lv_switch_get_state(obj);
+		_start_upd_timer();
+	}
+}
+
+
+static void _cb_btn_days(lv_obj_t* obj, lv_event_t event)
+{
+	int i;
+	uint8_t days = 0;
+	
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		for (i=0; i<7; i++) {
+			if (lv_btnmatrix_get_btn_ctrl(obj, i, LV_BTNMATRIX_CTRL_CHECK_STATE)) {
+				days |= 1 << i;
+			}
+		}
+		gui_state.alarm[cur_alarm].days = days;
+		_start_upd_timer();
+	}
+}
+
+
+static void _task_eval_upd_timer(lv_task_t* task)
+{
+	int i, n = 0;
+	uint8_t buf[GUI_NUM_ALARMS * 4];
+	
+	// Send all alarms to the controller (in the order it unpacks them)
+	for (i=0; i<GUI_NUM_ALARMS; i++) {
+		buf[n++] = (uint8_t) gui_state.alarm[i].enable;
+		buf[n++] = gui_state.alarm[i].hour;
+		buf[n++] = gui_state.alarm[i].minute;
+		buf[n++] = gui_state.alarm[i].days;
+	}
+	(void) cmd_send_binary(CMD_SET, CMD_ALARM, sizeof(buf), buf);
+	
+	// Terminate the timer
+	lv_task_del(task_upd_timer);
+	task_upd_timer = NULL;
+}
+
+
+static void _start_upd_timer()
+{
+	// Start or update a timer to update NVS after last change
+	if (task_upd_timer == NULL) {
+		// Start the timer
+		task_upd_timer = lv_task_create(_task_eval_upd_timer, GUIPN_ALARM_UPD_MSEC, LV_TASK_PRIO_LOW, NULL);
+	} else {
+		// Reset timer
+		lv_task_reset(task_upd_timer);
+	}
+}
+
+
+static void _set_hour_list()
+{
+	int i;
+	
+	if (gui_state.hour_mode_24 != cur_hour_mode_24) {
+		cur_hour_mode_24 = gui_state.hour_mode_24;
+		hour_list[0] = 0;
+		for (i=0; i<24; i++) {
+			if (i != 0) strcat(hour_list, "\n");
+			if (cur_hour_mode_24) {
+				sprintf(&hour_list[strlen(hour_list)], "%02d", i);
+			} else {
+				sprintf(&hour_list[strlen(hour_list)], "%d %s", (i % 12 == 0) ? 12 : i % 12, (i < 12) ? "AM" : "PM");
+			}
+		}
+		lv_roller_set_options(rlr_hour, hour_list, LV_ROLLER_MODE_NORMAL);
+	}
+}
+
+
+static void _display_alarm()
+{
+	int i;
+	gui_alarm_t* a = &gui_state.alarm[cur_alarm];
+	
+	lv_roller_set_selected(rlr_hour, a->hour, LV_ANIM_OFF);
+	lv_roller_set_selected(rlr_minute, a->minute, LV_ANIM_OFF);
+	
+	if (a->enable) {
+		lv_switch_on(sw_enable, false);
+	} else {
+		lv_switch_off(sw_enable, false);
+	}
+	
+	for (i=0; i<7; i++) {
+		if ((a->days & (1 << i)) != 0) {
+			lv_btnmatrix_set_btn_ctrl(btn_days, i, LV_BTNMATRIX_CTRL_CHECK_STATE);
+		} else {
+			lv_btnmatrix_clear_btn_ctrl(btn_days, i, LV_BTNMATRIX_CTRL_CHECK_STATE);
+		}
+	}
+}
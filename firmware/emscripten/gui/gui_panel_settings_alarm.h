@@ -0,0 +1,54 @@
+/*
+ * GUI settings alarm control panel
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef GUI_SETTINGS_ALARM_H
+#define GUI_SETTINGS_ALARM_H
+
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+//
+// Constants
+//
+#define GUIPN_SETTINGS_ALARM_NUM_RLR_W  50
+#define GUIPN_SETTINGS_ALARM_TIME_RLR_W 70
+#define GUIPN_SETTINGS_ALARM_RLR_H      100
+
+#define GUIPN_SETTINGS_ALARM_TYP_W      40
+#define GUIPN_SETTINGS_ALARM_SW_W       60
+#define GUIPN_SETTINGS_ALARM_SW_H       25
+
+#define GUIPN_SETTINGS_ALARM_DAYS_W     280
+#define GUIPN_SETTINGS_ALARM_DAYS_H     40
+
+
+// Change detect to update timer interval
+#define GUIPN_ALARM_UPD_MSEC            2000
+
+
+//
+// API
+//
+void gui_panel_settings_alarm_init(lv_obj_t* parent_cont);
+void gui_panel_settings_alarm_set_active(bool is_active);
+void gui_panel_settings_alarm_refresh();
+
+#endif /* GUI_SETTINGS_ALARM_H */
@@ -21,6 +21,7 @@
 #include "gui_page_settings.h"
 #include "gui_panel_settings_timezone.h"
 #include "gui_state.h"
+#include "tzdb.h"
 #include <string.h>
 
 
@@ -28,72 +29,36 @@
 // Local variables
 //
 
-// State
-static int cur_timezone_index;
-static int orig_timezone_index;
+// State (zone indices in tzdb)
+static int cur_region;
+static int cur_zone;
+static int orig_zone;
+
+// Roller options
+static char region_list[128];
+static char city_list[TZDB_CITY_LIST_MAX_LEN];
 
 //
 // LVGL Objects
 //
 static lv_obj_t* my_panel;
 static lv_obj_t* lbl_name;
-static lv_obj_t* rlr_timezone;
+static lv_obj_t* rlr_region;
+static lv_obj_t* rlr_city;
 
 // Change detect timer task
 static lv_task_t* task_upd_timer;
 
 
-// Timezone values
-#define NUM_TZ_PARM_VALS 20
-static const char* parm_tz_list = "ACST/ACDT\n"
-                                  "AEST/AEDT\n"
-                                  "AKST/AKDT\n"
-                                  "ANAT\n"
-                                  "AWST\n"
-                                  "GMT/BST\n"
-                                  "CET/CEST\n"
-                                  "CST/CDT\n"
-                                  "CST\n"
-                                  "EET/EEST\n"
-                                  "EST/EDT\n"
-                                  "GMT\n"
-                                  "HST/HDT\n"
-                                  "IST\n"
-                                  "JST\n"
-                                  "MST/MDT\n"
-                                  "MST\n"
-                                  "NZST/NZDT\n"
-                                  "PST/PDT\n"
-                                  "SAST";
-static const char* parm_tz_value[] = {"ACST-9:30ACDT,M10.1.0,M4.1.0/3",
-                                      "AEST-10AEDT,M10.1.0,M4.1.0/3",
-                                      "AKST9AKDT,M3.2.0,M11.1.0",
-                                      "ANAT-12",
-                                      "AWST-8",
-                                      "GMT0BST,M3.5.0/1,M10.5.0",
-                                      "CET-1CEST,M3.5.0,M10.5.0/3",
-                                      "CST6CDT,M3.2.0,M11.1.0",
-                                      "CST-8",
-                                      "EET-2EEST,M3.5.0/3,M10.5.0/4",
-                                      "EST5EDT,M3.2.0,M11.1.0",
-                                      "GMT",
-                                      "HST10HDT,M3.2.0,M11.1.0",
-                                      "IST-5:30",
-                                      "JST-9",
-                                      "MST7MDT,M3.2.0,M11.1.0",
-                                      "MST7",
-                                      "NZST-12NZDT,M9.5.0,M4.1.0/3",
-                                      "PST8PDT,M3.2.0,M11.1.0",
-                                      "SAST-2"};
-
-
 
 //
 // Forward declarations for internal functions
 //
-static void _cb_rlr_timezone(lv_obj_t* obj, lv_event_t event);
+static void _cb_rlr_region(lv_obj_t* obj, lv_event_t event);
+static void _cb_rlr_city(lv_obj_t* obj, lv_event_t event);
 static void _task_eval_upd_timer(lv_task_t* task);
-static int _timezone_to_rlr_index(const char* tz);
+static void _start_upd_timer();
+static void _set_region(int region);
 
 
 
@@ -102,6 +67,8 @@ static int _timezone_to_rlr_index(const char* tz);
 //
 void gui_panel_settings_timezone_init(lv_obj_t* parent_cont)
 {
+	int i;
+	
 	// Control panel - width fits parent, height fits contents with padding
 	my_panel = lv_cont_create(parent_cont, NULL);
 	lv_obj_set_click(my_panel, false);
@@ -117,13 +84,26 @@ void gui_panel_settings_timezone_init(lv_obj_t* parent_cont)
 	lbl_name = lv_label_create(my_panel, NULL);
 	lv_label_set_static_text(lbl_name, "Timezone");
 	
-	// Timezone selection roller
-	rlr_timezone = lv_roller_create(my_panel, NULL);
-	lv_roller_set_options(rlr_timezone, parm_tz_list, LV_ROLLER_MODE_NORMAL);
-	lv_roller_set_auto_fit(rlr_timezone, false);
-	lv_obj_set_size(rlr_timezone, GUIPN_SETTINGS_TIMEZONE_RLR_W, GUIPN_SETTINGS_TIMEZONE_RLR_H);
-	lv_obj_set_style_local_bg_color(rlr_timezone, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
-	lv_obj_set_event_cb(rlr_timezone, _cb_rlr_timezone);
+	// Region selection roller
+	region_list[0] = 0;
+	for (i=0; i<tzdb_get_num_regions(); i++) {
+		if (i != 0) strcat(region_list, "\n");
+		strcat(region_list, tzdb_get_region_name(i));
+	}
+	rlr_region = lv_roller_create(my_panel, NULL);
+	lv_roller_set_options(rlr_region, region_list, LV_ROLLER_MODE_NORMAL);
+	lv_roller_set_auto_fit(rlr_region, false);
+	lv_obj_set_size(rlr_region, GUIPN_SETTINGS_TIMEZONE_REGION_RLR_W, GUIPN_SETTINGS_TIMEZONE_RLR_H);
+	lv_obj_set_style_local_bg_color(rlr_region, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
+	lv_obj_set_event_cb(rlr_region, _cb_rlr_region);
+	
+	// City selection roller (loaded with the selected region's cities)
+	rlr_city = lv_roller_create(my_panel, NULL);
+	lv_roller_set_auto_fit(rlr_city, false);
+	lv_obj_set_size(rlr_city, GUIPN_SETTINGS_TIMEZONE_CITY_RLR_W, GUIPN_SETTINGS_TIMEZONE_RLR_H);
+	lv_obj_set_style_local_bg_color(rlr_city, LV_ROLLER_PART_SELECTED, LV_STATE_DEFAULT, GUI_THEME_RLR_BG_COLOR);
+	lv_obj_set_event_cb(rlr_city, _cb_rlr_city);
+	cur_region = -1;
     
     // Register with our parent page
 	gui_page_settings_register_panel(my_panel, NULL, NULL, NULL);
@@ -132,11 +112,20 @@ void gui_panel_settings_timezone_init(lv_obj_t* parent_cont)
 
 void gui_panel_settings_timezone_set_active(bool is_active)
 {
+	int first;
+	
 	if (is_active) {
 		// Set the current timezone
-		cur_timezone_index = _timezone_to_rlr_index(gui_state.timezone);
-		orig_timezone_index = cur_timezone_index;
-		lv_roller_set_selected(rlr_timezone, (uint16_t) cur_timezone_index, LV_ANIM_OFF);
+		cur_zone = tzdb_find(gui_state.timezone);
+		if (cur_zone < 0) {
+			cur_zone = tzdb_find(TZDB_DEFAULT_ZONE);
+		}
+		orig_zone = cur_zone;
+		
+		_set_region(tzdb_get_region(cur_zone));
+		lv_roller_set_selected(rlr_region, (uint16_t) cur_region, LV_ANIM_OFF);
+		(void) tzdb_get_region_zones(cur_region, &first);
+		lv_roller_set_selected(rlr_city, (uint16_t) (cur_zone - first), LV_ANIM_OFF);
 	}
 }
 
@@ -145,19 +134,29 @@ void gui_panel_settings_timezone_set_active(bool is_active)
 //
 // Internal functions
 //
-static void _cb_rlr_timezone(lv_obj_t* obj, lv_event_t event)
+static void _cb_rlr_region(lv_obj_t* obj, lv_event_t event)
 {
+	int first;
+	
 	if (event == LV_EVENT_VALUE_CHANGED) {
-		cur_timezone_index = (int) lv_roller_get_selected(obj);
-		
-		// Start or update a timer to update NVS after last change
-		if (task_upd_timer == NULL) {
-			// Start the timer
-			task_upd_timer = lv_task_create(_task_eval_upd_timer, GUIPN_IMAGEC_UPD_MSEC, LV_TASK_PRIO_LOW, NULL);
-		} else {
-			// Reset timer
-			lv_task_reset(task_upd_timer);
-		}
+		// Start with the first city in the new region
+		_set_region((int) lv_roller_get_selected(obj));
+		lv_roller_set_selected(rlr_city, 0, LV_ANIM_OFF);
+		(void) tzdb_get_region_zones(cur_region, &first);
+		cur_zone = first;
+		_start_upd_timer();
+	}
+}
+
+
+static void _cb_rlr_city(lv_obj_t* obj, lv_event_t event)
+{
+	int first;
+	
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		(void) tzdb_get_region_zones(cur_region, &first);
+		cur_zone = first + (int) lv_roller_get_selected(obj);
+		_start_upd_timer();
 	}
 }
 
@@ -165,10 +164,11 @@ static void _cb_rlr_timezone(lv_obj_t* obj, lv_event_t event)
 static void _task_eval_upd_timer(lv_task_t* task)
 {
 	// Save any changed timezone to NVS
-	if (cur_timezone_index != orig_timezone_index) {
-		orig_timezone_index = cur_timezone_index;
-		strcpy(gui_state.timezone, parm_tz_value[cur_timezone_index]);
-		(void) cmd_send_string(CMD_SET, CMD_TIMEZONE, (char*) parm_tz_value[cur_timezone_index]);
+	if (cur_zone != orig_zone) {
+		orig_zone = cur_zone;
+		if (tzdb_get_name(cur_zone, gui_state.timezone, sizeof(gui_state.timezone))) {
+			(void) cmd_send_string(CMD_SET, CMD_TIMEZONE, gui_state.timezone);
+		}
 	}
 	
 	// Terminate the timer
@@ -177,13 +177,24 @@ static void _task_eval_upd_timer(lv_task_t* task)
 }
 
 
-static int _timezone_to_rlr_index(const char* tz)
+static void _start_upd_timer()
 {
-	for (int i=0; i<NUM_TZ_PARM_VALS; i++) {
-		if (strcmp(parm_tz_value[i], tz) == 0) {
-			return i;
-		}
+	// Start or update a timer to update NVS after last change
+	if (task_upd_timer == NULL) {
+		// Start the timer
+		task_upd_timer = lv_task_create(_task_eval_upd_timer, GUIPN_IMAGEC_UPD_MSEC, LV_TASK_PRIO_LOW, NULL);
+	} else {
+		// Reset timer
+		lv_task_reset(task_upd_timer);
+	}
+}
+
+
+static void _set_region(int region)
+{
+	if (region != cur_region) {
+		cur_region = region;
+		(void) tzdb_get_city_list(region, city_list, sizeof(city_list));
+		lv_roller_set_options(rlr_city, city_list, LV_ROLLER_MODE_NORMAL);
 	}
-	
-	return 0;
 }
@@ -28,8 +28,9 @@
 //
 // Constants
 //
-#define GUIPN_SETTINGS_TIMEZONE_RLR_W 150
-#define GUIPN_SETTINGS_TIMEZONE_RLR_H 100
+#define GUIPN_SETTINGS_TIMEZONE_REGION_RLR_W 110
+#define GUIPN_SETTINGS_TIMEZONE_CITY_RLR_W   170
+#define GUIPN_SETTINGS_TIMEZONE_RLR_H        100
 
 
 // Change detect to update timer interval
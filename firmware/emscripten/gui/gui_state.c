@@ -48,6 +48,7 @@ void gui_state_init()
 	(void) cmd_send(CMD_GET, CMD_MODE);
 	(void) cmd_send(CMD_GET, CMD_TIMEZONE);
 	(void) cmd_send(CMD_GET, CMD_WIFI_INFO);
+	(void) cmd_send(CMD_GET, CMD_ALARM);
 }
 
 
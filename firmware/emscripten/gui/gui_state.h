@@ -33,11 +33,13 @@
 #define GUI_STATE_INIT_MODE       0x00000002
 #define GUI_STATE_INIT_TIMEZONE   0x00000004
 #define GUI_STATE_INIT_WIFI       0x00000008
+#define GUI_STATE_INIT_ALARM      0x00000010
 
 #define GUI_STATE_INIT_ALL_MASK   (GUI_STATE_INIT_BACKLIGHT | \
                                    GUI_STATE_INIT_MODE | \
                                    GUI_STATE_INIT_TIMEZONE | \
-                                   GUI_STATE_INIT_WIFI \
+                                   GUI_STATE_INIT_WIFI | \
+                                   GUI_STATE_INIT_ALARM \
                                   )
 
 // Field lengths
@@ -45,6 +47,9 @@
 #define GUI_SSID_MAX_LEN          32
 #define GUI_PW_MAX_LEN            63
 
+// Alarms (must match the controller)
+#define GUI_NUM_ALARMS            8
+
 
 // Background color (should match theme background - A kludge, I know.  Specified here because
 // themes don't allow direct access to it and IMHO the LVGL theme system is incredibly hard to use)
@@ -58,6 +63,14 @@
 //
 // Typedefs
 //
+// Alarm (days: bit 0 = Sunday - bit 6 = Saturday, 0 = one-shot)
+typedef struct {
+	bool enable;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t days;
+} gui_alarm_t;
+
 // GUI state
 typedef struct {
 	bool hour_mode_24;
@@ -73,6 +86,7 @@ typedef struct {
 	uint8_t sta_ip_addr[4];
 	uint8_t sta_netmask[4];
 	uint32_t lcd_brightness;
+	gui_alarm_t alarm[GUI_NUM_ALARMS];
 } gui_state_t;
 
 
@@ -16,6 +16,7 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <arpa/inet.h>
 #include "cmd_utilities.h"
 #include "gui_main.h"
 #include "gui_sub_page_info.h"
@@ -39,9 +40,34 @@ static lv_obj_t* lbl_title;
 static lv_obj_t* page_controls;
 static lv_obj_t* page_controls_scrollable;
 static lv_obj_t* lbl_sys_info;
+static lv_obj_t* lbl_task_info;
+static lv_obj_t* lbl_power_legend;
+static lv_obj_t* btnm_power_tier;
+static lv_obj_t* chart_power;
+static lv_chart_series_t* ser_batt_mv;
+static lv_chart_series_t* ser_load_ma;
 
-// [Multi-line] info string
+// [Multi-line] info strings
 static char info[GUISP_INFO_MAX_INFO+1];
+static char task_info[GUISP_INFO_MAX_INFO+1];
+
+// Power history tier buttons
+static const char* btnm_tier_map[] = {"Hour", "Day", "Month", ""};
+
+static const uint32_t tier_span[GUISP_INFO_PH_NUM_TIERS] = {
+	GUISP_INFO_PH_SPAN_0,
+	GUISP_INFO_PH_SPAN_1,
+	GUISP_INFO_PH_SPAN_2
+};
+
+// Power history query state - responses are binned into the chart points
+static int power_tier = 0;
+static uint32_t power_query_uptime;
+static int32_t batt_mv_sum[GUISP_INFO_CHART_POINTS];
+static int32_t load_ma_sum[GUISP_INFO_CHART_POINTS];
+static uint16_t bin_count[GUISP_INFO_CHART_POINTS];
+static lv_coord_t batt_mv_points[GUISP_INFO_CHART_POINTS];
+static lv_coord_t load_ma_points[GUISP_INFO_CHART_POINTS];
 
 
 
@@ -49,6 +75,10 @@ static char info[GUISP_INFO_MAX_INFO+1];
 // Forward declarations for internal routines
 //
 static void _cb_back_button(lv_obj_t* obj, lv_event_t event);
+static void _cb_btnm_power_tier(lv_obj_t* obj, lv_event_t event);
+static void _start_power_query();
+static void _send_power_query(uint32_t start);
+static void _update_power_chart();
 
 
 
@@ -107,6 +137,45 @@ lv_obj_t* gui_sub_page_info_init(lv_obj_t* screen)
 	lv_label_set_align(lbl_sys_info, LV_LABEL_ALIGN_LEFT);
 	lv_label_set_static_text(lbl_sys_info, "");
 	
+	// Task statistics text (multi-line label)
+	lbl_task_info = lv_label_create(page_controls, NULL);
+	lv_label_set_long_mode(lbl_task_info, LV_LABEL_LONG_BREAK);
+	lv_label_set_align(lbl_task_info, LV_LABEL_ALIGN_LEFT);
+	lv_label_set_static_text(lbl_task_info, "");
+	
+	// Power history legend, tier selection and chart
+	lbl_power_legend = lv_label_create(page_controls, NULL);
+	lv_label_set_recolor(lbl_power_legend, true);
+	lv_label_set_long_mode(lbl_power_legend, LV_LABEL_LONG_BREAK);
+	lv_label_set_align(lbl_power_legend, LV_LABEL_ALIGN_LEFT);
+	lv_label_set_static_text(lbl_power_legend, "Power History: #00C000 Battery V# (left), #E0A000 Load mA# (right)");
+	
+	btnm_power_tier = lv_btnmatrix_create(page_controls, NULL);
+	lv_btnmatrix_set_map(btnm_power_tier, btnm_tier_map);
+	lv_obj_set_height(btnm_power_tier, GUISP_INFO_TIER_H);
+	lv_obj_add_protect(btnm_power_tier, LV_PROTECT_CLICK_FOCUS);
+	lv_btnmatrix_set_btn_ctrl_all(btnm_power_tier, LV_BTNMATRIX_CTRL_CHECKABLE);
+	lv_btnmatrix_set_one_check(btnm_power_tier, true);
+	lv_btnmatrix_set_btn_ctrl(btnm_power_tier, power_tier, LV_BTNMATRIX_CTRL_CHECK_STATE);
+	lv_obj_set_event_cb(btnm_power_tier, _cb_btnm_power_tier);
+	
+	chart_power = lv_chart_create(page_controls, NULL);
+	lv_obj_set_height(chart_power, GUISP_INFO_CHART_H);
+	lv_obj_add_protect(chart_power, LV_PROTECT_CLICK_FOCUS);
+	lv_chart_set_type(chart_power, LV_CHART_TYPE_LINE);
+	lv_chart_set_point_count(chart_power, GUISP_INFO_CHART_POINTS);
+	lv_chart_set_div_line_count(chart_power, 3, 5);
+	lv_chart_set_y_range(chart_power, LV_CHART_AXIS_PRIMARY_Y, GUISP_INFO_CHART_MIN_MV, GUISP_INFO_CHART_MAX_MV);
+	lv_chart_set_y_range(chart_power, LV_CHART_AXIS_SECONDARY_Y, 0, GUISP_INFO_CHART_MAX_MA);
+	lv_obj_set_style_local_size(chart_power, LV_CHART_PART_SERIES, LV_STATE_DEFAULT, 0);
+	ser_batt_mv = lv_chart_add_series(chart_power, LV_COLOR_MAKE(0x00, 0xC0, 0x00));
+	ser_load_ma = lv_chart_add_series(chart_power, LV_COLOR_MAKE(0xE0, 0xA0, 0x00));
+	lv_chart_set_series_axis(chart_power, ser_load_ma, LV_CHART_AXIS_SECONDARY_Y);
+	lv_chart_set_ext_array(chart_power, ser_batt_mv, batt_mv_points, GUISP_INFO_CHART_POINTS);
+	lv_chart_set_ext_array(chart_power, ser_load_ma, load_ma_points, GUISP_INFO_CHART_POINTS);
+	lv_chart_init_points(chart_power, ser_batt_mv, LV_CHART_POINT_DEF);
+	lv_chart_init_points(chart_power, ser_load_ma, LV_CHART_POINT_DEF);
+	
 	// We start off disabled
 	lv_obj_set_hidden(my_page, true);
 	
@@ -119,6 +188,8 @@ void gui_sub_page_info_set_active(bool is_active)
 	if (is_active) {
 		// Request system information
 		(void) cmd_send(CMD_GET, CMD_SYS_INFO);
+		(void) cmd_send(CMD_GET, CMD_TASK_INFO);
+		_start_power_query();
 	}
 	
 	// Set our visibility
@@ -146,6 +217,10 @@ void gui_sub_page_info_reset_screen_size(uint16_t page_w, uint16_t page_h)
 	
 	// Set the info text width
 	lv_obj_set_width(lbl_sys_info, page_w - (GUIP_SETTINGS_LEFT_PAD + GUIP_SETTINGS_RIGHT_PAD));
+	lv_obj_set_width(lbl_task_info, page_w - (GUIP_SETTINGS_LEFT_PAD + GUIP_SETTINGS_RIGHT_PAD));
+	lv_obj_set_width(lbl_power_legend, page_w - (GUIP_SETTINGS_LEFT_PAD + GUIP_SETTINGS_RIGHT_PAD));
+	lv_obj_set_width(btnm_power_tier, page_w - (GUIP_SETTINGS_LEFT_PAD + GUIP_SETTINGS_RIGHT_PAD));
+	lv_obj_set_width(chart_power, page_w - (GUIP_SETTINGS_LEFT_PAD + GUIP_SETTINGS_RIGHT_PAD));
 }
 
 
@@ -158,6 +233,65 @@ void gui_sub_page_info_set_string(char* s)
 }
 
 
+void gui_sub_page_info_set_task_string(char* s)
+{
+	strncpy(task_info, s, GUISP_INFO_MAX_INFO);
+	task_info[GUISP_INFO_MAX_INFO] = 0;
+	
+	lv_label_set_static_text(lbl_task_info, task_info);
+}
+
+
+
+/**
+ * Handle one power history response.  Samples are added to the chart bins and the next
+ * block requested until the device returns a partial block.
+ */
+void gui_sub_page_info_set_power_hist(uint32_t len, uint8_t* data)
+{
+	int i, n;
+	uint32_t tier;
+	uint32_t num;
+	uint32_t t = 0;
+	uint32_t age;
+	uint8_t* p;
+	
+	if (len < GUISP_INFO_PH_HDR_LEN) return;
+	
+	tier = ntohl(*((uint32_t*) &data[0]));
+	num = ntohl(*((uint32_t*) &data[16]));
+	if ((tier != power_tier) || (len != (GUISP_INFO_PH_HDR_LEN + num*GUISP_INFO_PH_SAMPLE_LEN))) {
+		// Response to a query for a tier no longer displayed or malformed
+		return;
+	}
+	if (power_query_uptime == 0) {
+		power_query_uptime = ntohl(*((uint32_t*) &data[4]));
+	}
+	
+	p = data + GUISP_INFO_PH_HDR_LEN;
+	for (i=0; i<num; i++) {
+		t = ntohl(*((uint32_t*) p));
+		if (t <= power_query_uptime) {
+			age = power_query_uptime - t;
+			if (age < tier_span[tier]) {
+				n = GUISP_INFO_CHART_POINTS - 1 - (int) (((uint64_t) age * GUISP_INFO_CHART_POINTS) / tier_span[tier]);
+				// avg[0] is battery mV, avg[1] is load mA
+				batt_mv_sum[n] += (p[4] << 8) | p[5];
+				load_ma_sum[n] += (p[6] << 8) | p[7];
+				bin_count[n] += 1;
+			}
+		}
+		p += GUISP_INFO_PH_SAMPLE_LEN;
+	}
+	
+	if (num == GUISP_INFO_PH_MAX_QUERY) {
+		_send_power_query(t + 1);
+	} else {
+		_update_power_chart();
+	}
+}
+
+
 
 //
 // Internal functions
@@ -168,3 +302,62 @@ static void _cb_back_button(lv_obj_t* obj, lv_event_t event)
 		gui_page_settings_close_sub_page(my_page);
 	}
 }
+
+
+static void _cb_btnm_power_tier(lv_obj_t* obj, lv_event_t event)
+{
+	uint16_t n;
+	
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		n = lv_btnmatrix_get_active_btn(obj);
+		if ((n < GUISP_INFO_PH_NUM_TIERS) && (n != power_tier)) {
+			power_tier = n;
+			_start_power_query();
+		}
+	}
+}
+
+
+static void _start_power_query()
+{
+	int i;
+	
+	for (i=0; i<GUISP_INFO_CHART_POINTS; i++) {
+		batt_mv_sum[i] = 0;
+		load_ma_sum[i] = 0;
+		bin_count[i] = 0;
+	}
+	power_query_uptime = 0;
+	
+	_send_power_query(0);
+}
+
+
+static void _send_power_query(uint32_t start)
+{
+	uint8_t buf[GUISP_INFO_PH_QUERY_LEN];
+	
+	*((uint32_t*) &buf[0]) = htonl((uint32_t) power_tier);
+	*((uint32_t*) &buf[4]) = htonl(start);
+	*((uint32_t*) &buf[8]) = htonl(GUISP_INFO_PH_MAX_QUERY);
+	
+	(void) cmd_send_binary(CMD_GET, CMD_POWER_HIST, GUISP_INFO_PH_QUERY_LEN, buf);
+}
+
+
+static void _update_power_chart()
+{
+	int i;
+	
+	for (i=0; i<GUISP_INFO_CHART_POINTS; i++) {
+		if (bin_count[i] != 0) {
+			batt_mv_points[i] = (lv_coord_t) (batt_mv_sum[i] / bin_count[i]);
+			load_ma_points[i] = (lv_coord_t) (load_ma_sum[i] / bin_count[i]);
+		} else {
+			batt_mv_points[i] = LV_CHART_POINT_DEF;
+			load_ma_points[i] = LV_CHART_POINT_DEF;
+		}
+	}
+	
+	lv_chart_refresh(chart_power);
+}
@@ -28,8 +28,27 @@
 // Constants
 //
 
-// Maximum length of info string
-#define GUISP_INFO_MAX_INFO   1024
+// Maximum length of info string (must be at least SYS_INFO_MAX_LEN and TASK_STATS_MAX_LEN
+// in the firmware)
+#define GUISP_INFO_MAX_INFO   2560
+
+// Power history query and response (must match power_history.h in the firmware)
+#define GUISP_INFO_PH_NUM_TIERS    3
+#define GUISP_INFO_PH_MAX_QUERY    256
+#define GUISP_INFO_PH_QUERY_LEN    12
+#define GUISP_INFO_PH_HDR_LEN      20
+#define GUISP_INFO_PH_SAMPLE_LEN   30
+
+// Time covered by each power history tier (seconds)
+#define GUISP_INFO_PH_SPAN_0       3600
+#define GUISP_INFO_PH_SPAN_1       86400
+#define GUISP_INFO_PH_SPAN_2       2678400
+
+// Power history chart (battery mV on the left axis, load mA on the right axis)
+#define GUISP_INFO_CHART_POINTS    120
+#define GUISP_INFO_CHART_MIN_MV    3300
+#define GUISP_INFO_CHART_MAX_MV    4300
+#define GUISP_INFO_CHART_MAX_MA    1000
 
 //
 // LVGL setup
@@ -47,6 +66,10 @@
 // Control panel page
 #define GUISP_INFO_CONTROL_Y  40
 
+// Power history tier buttons and chart
+#define GUISP_INFO_TIER_H     35
+#define GUISP_INFO_CHART_H    160
+
 
 
 //
@@ -61,6 +84,8 @@ void gui_sub_page_info_reset_screen_size(uint16_t page_w, uint16_t page_h);
 
 // From command handler
 void gui_sub_page_info_set_string(char* s);
+void gui_sub_page_info_set_task_string(char* s);
+void gui_sub_page_info_set_power_hist(uint32_t len, uint8_t* data);
 
 
 #endif /* GUI_SUB_PAGE_INFO_H */
\ No newline at end of file
@@ -142,6 +142,15 @@ void gui_main_register_socket_disconnect(socket_activity_handler disconnect_hand
 }
 
 
+void gui_main_display_alarm(const char* msg)
+{
+	// Only shown while the settings are displayed (state is loaded)
+	if (!lv_obj_get_hidden(lv_pages[GUI_MAIN_PAGE_SETTINGS])) {
+		gui_display_message_box(lv_pages[GUI_MAIN_PAGE_SETTINGS], msg, GUI_MSG_BOX_1_BTN, NULL);
+	}
+}
+
+
 void gui_main_shutdown()
 {
 	socket_disconnect_routine(); 
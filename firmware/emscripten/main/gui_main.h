@@ -78,6 +78,7 @@ void gui_main_register_socket_disconnect(socket_activity_handler disconnect_hand
 
 // For use by GUI pages or cmd decoder
 void gui_main_set_page(uint32_t page);
+void gui_main_display_alarm(const char* msg);
 void gui_main_shutdown();
 
 #endif /* GUI_MAIN */
\ No newline at end of file
@@ -65,6 +65,7 @@ EMSCRIPTEN_WEBSOCKET_T web_socket;
 //
 // Forward declarations for internal functions
 //
+static void _cmd_handler_set_alarm_notify(cmd_data_t data_type, uint32_t len, uint8_t* data);
 static void _cmd_handler_set_shutdown(cmd_data_t data_type, uint32_t len, uint8_t* data);
 
 
@@ -80,10 +81,14 @@ bool web_cmd_init()
 	}
 	
 	// Register command handlers supported on our end (get, set, rsp)
+	(void) cmd_register_cmd_id(CMD_ALARM, NULL, NULL, cmd_handler_rsp_alarm);
+	(void) cmd_register_cmd_id(CMD_ALARM_NOTIFY, NULL, _cmd_handler_set_alarm_notify, NULL);
 	(void) cmd_register_cmd_id(CMD_BACKLIGHT, NULL, NULL, cmd_handler_rsp_backlight);
 	(void) cmd_register_cmd_id(CMD_MODE, NULL, NULL, cmd_handler_rsp_mode);
+	(void) cmd_register_cmd_id(CMD_POWER_HIST, NULL, NULL, cmd_handler_rsp_power_hist);
 	(void) cmd_register_cmd_id(CMD_SHUTDOWN, NULL, _cmd_handler_set_shutdown, NULL);
 	(void) cmd_register_cmd_id(CMD_SYS_INFO, NULL, NULL, cmd_handler_rsp_sys_info);
+	(void) cmd_register_cmd_id(CMD_TASK_INFO, NULL, NULL, cmd_handler_rsp_task_info);
 	(void) cmd_register_cmd_id(CMD_TIME, NULL, NULL, cmd_handler_rsp_time);
 	(void) cmd_register_cmd_id(CMD_TIMEZONE, NULL, NULL, cmd_handler_rsp_timezone);
 	(void) cmd_register_cmd_id(CMD_WIFI_INFO, NULL, NULL, cmd_handler_rsp_wifi);
@@ -169,6 +174,18 @@ bool web_cmd_send_handler(cmd_t cmd_type, cmd_id_t cmd_id, cmd_data_t data_type,
 // Internal functions
 //
 
+// Web-specific handling of an alarm firing on the clock
+static void _cmd_handler_set_alarm_notify(cmd_data_t data_type, uint32_t len, uint8_t* data)
+{
+	if (data_type == CMD_DATA_STRING) {
+		gui_main_display_alarm((char*) data);
+		
+		// One-shot alarms disable themselves so reload our copy
+		(void) cmd_send(CMD_GET, CMD_ALARM);
+	}
+}
+
+
 // Web-specific handling of shutdown command
 static void _cmd_handler_set_shutdown(cmd_data_t data_type, uint32_t len, uint8_t* data)
 {
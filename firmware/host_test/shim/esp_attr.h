@@ -0,0 +1,27 @@
+/*
+ * Host test shim - esp_attr.h
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+// Code and data placement has no meaning on the host
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif /* ESP_ATTR_H */
@@ -0,0 +1,39 @@
+/*
+ * Host test shim - esp_log.h
+ *
+ * Log lines are written to stdout in the IDF format.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+// Firmware sources rely on the IDF headers including these
+#include <stdio.h>
+#include <stdlib.h>
+
+// Not declared with the printf format attribute: the firmware formats uint32_t with %lu
+// (unsigned long on the ESP32) which the host compiler would warn about
+void esp_log_write(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) esp_log_write('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while (0)
+#define ESP_LOGV(tag, format, ...) do {} while (0)
+
+#endif /* ESP_LOG_H */
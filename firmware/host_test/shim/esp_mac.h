@@ -0,0 +1,29 @@
+/*
+ * Host test shim - esp_mac.h
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_MAC_H
+#define ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Returns a fixed address
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac);
+
+#endif /* ESP_MAC_H */
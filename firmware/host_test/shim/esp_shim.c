@@ -0,0 +1,110 @@
+/*
+ * Host test shim - ESP-IDF logging, timer, MAC address and random number functions
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+
+//
+// Variables
+//
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static int64_t timer_base_usec;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static int64_t _monotonic_usec();
+static void _timer_init();
+
+
+
+//
+// API
+//
+void esp_log_write(char level, const char* tag, const char* format, ...)
+{
+	va_list args;
+	
+	pthread_mutex_lock(&log_mutex);
+	printf("%c (%lld) %s: ", level, (long long) (esp_timer_get_time() / 1000), tag);
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	printf("\n");
+	fflush(stdout);
+	pthread_mutex_unlock(&log_mutex);
+}
+
+
+int64_t esp_timer_get_time()
+{
+	pthread_once(&timer_once, _timer_init);
+	
+	return _monotonic_usec() - timer_base_usec;
+}
+
+
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac)
+{
+	static const uint8_t host_mac[6] = {0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56};
+	int i;
+	
+	for (i=0; i<6; i++) {
+		mac[i] = host_mac[i];
+	}
+	
+	return ESP_OK;
+}
+
+
+uint32_t esp_random()
+{
+	return (uint32_t) random();
+}
+
+
+
+//
+// Internal functions
+//
+static int64_t _monotonic_usec()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void _timer_init()
+{
+	timer_base_usec = _monotonic_usec();
+}
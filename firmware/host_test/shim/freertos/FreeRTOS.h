@@ -0,0 +1,71 @@
+/*
+ * Host test shim - freertos/FreeRTOS.h
+ *
+ * Tasks are pthreads and critical sections are a recursive mutex per portMUX_TYPE.
+ * Only the parts of the API used by the firmware are provided.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Configuration (matches sdkconfig)
+//
+#define configTICK_RATE_HZ       1000
+
+
+
+//
+// Types
+//
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+typedef struct {
+	pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+
+
+//
+// Constants and macros
+//
+#define pdFALSE                  0
+#define pdTRUE                   1
+#define pdFAIL                   0
+#define pdPASS                   1
+
+#define portMAX_DELAY            ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS       (1000 / configTICK_RATE_HZ)
+
+#define pdMS_TO_TICKS(ms)        ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+#define portMUX_INITIALIZER_UNLOCKED {PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP}
+
+#define portENTER_CRITICAL(mux)      pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)       pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)  portEXIT_CRITICAL(mux)
+
+#endif /* FREERTOS_H */
@@ -0,0 +1,43 @@
+/*
+ * Host test shim - freertos/queue.h
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FREERTOS_QUEUE_H
+#define FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+
+//
+// Types
+//
+typedef struct shim_queue* QueueHandle_t;
+
+
+
+//
+// API
+//
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size);
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+
+#define xQueueSend(q, item, ticks) xQueueSendToBack(q, item, ticks)
+
+#endif /* FREERTOS_QUEUE_H */
@@ -0,0 +1,521 @@
+/*
+ * Host test shim - FreeRTOS tasks, notifications, semaphores and queues built on pthreads
+ *
+ * Priorities and core affinity are ignored.  Blocking calls wait on CLOCK_MONOTONIC.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Typedefs
+//
+struct shim_task {
+	pthread_t thread;
+	TaskFunction_t fn;
+	void* arg;
+	char name[16];
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint32_t notify_value;
+	bool notify_pending;
+};
+
+struct shim_sem {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	UBaseType_t count;
+	UBaseType_t max;
+};
+
+struct shim_queue {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint8_t* buf;
+	UBaseType_t len;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+
+
+//
+// Variables
+//
+static __thread struct shim_task* cur_task = NULL;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void* _task_entry(void* arg);
+static struct shim_task* _task_alloc(const char* name);
+static void _cond_init(pthread_cond_t* cond);
+static bool _deadline(TickType_t ticks, struct timespec* ts);
+static bool _wait(pthread_cond_t* cond, pthread_mutex_t* mutex, bool forever, const struct timespec* ts);
+
+
+
+//
+// Tasks
+//
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t prio, TaskHandle_t* handle, BaseType_t core)
+{
+	struct shim_task* t;
+	
+	t = _task_alloc(name);
+	if (t == NULL) {
+		return pdFAIL;
+	}
+	t->fn = fn;
+	t->arg = arg;
+	
+	// Publish the handle before the task runs (it may be notified immediately)
+	if (handle != NULL) {
+		*handle = t;
+	}
+	
+	if (pthread_create(&t->thread, NULL, _task_entry, t) != 0) {
+		if (handle != NULL) {
+			*handle = NULL;
+		}
+		free(t);
+		return pdFAIL;
+	}
+	pthread_detach(t->thread);
+	
+	return pdPASS;
+}
+
+
+/**
+ * Only deleting the calling task is supported.  Its handle stays valid so late
+ * notifications are harmless.
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+	if ((task == NULL) || (task == cur_task)) {
+		pthread_exit(NULL);
+	}
+}
+
+
+void vTaskDelay(TickType_t ticks)
+{
+	uint64_t nsec;
+	struct timespec ts;
+	
+	if (ticks == 0) {
+		sched_yield();
+		return;
+	}
+	
+	nsec = (uint64_t) ticks * (1000000000 / configTICK_RATE_HZ);
+	ts.tv_sec = nsec / 1000000000;
+	ts.tv_nsec = nsec % 1000000000;
+	while (nanosleep(&ts, &ts) != 0) {}
+}
+
+
+TickType_t xTaskGetTickCount()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (TickType_t) (((uint64_t) ts.tv_sec * configTICK_RATE_HZ) +
+	                     ((uint64_t) ts.tv_nsec * configTICK_RATE_HZ / 1000000000));
+}
+
+
+/**
+ * Threads not created by xTaskCreatePinnedToCore (main) get a handle on first use
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	if (cur_task == NULL) {
+		cur_task = _task_alloc("main");
+		if (cur_task != NULL) {
+			cur_task->thread = pthread_self();
+		}
+	}
+	
+	return cur_task;
+}
+
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+	if (task == NULL) {
+		task = xTaskGetCurrentTaskHandle();
+	}
+	
+	return task->name;
+}
+
+
+
+//
+// Task notifications
+//
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+	BaseType_t ret = pdPASS;
+	
+	if (task == NULL) {
+		return pdFAIL;
+	}
+	
+	pthread_mutex_lock(&task->mutex);
+	switch (action) {
+		case eSetBits:
+			task->notify_value |= value;
+			break;
+		case eIncrement:
+			task->notify_value++;
+			break;
+		case eSetValueWithOverwrite:
+			task->notify_value = value;
+			break;
+		case eSetValueWithoutOverwrite:
+			if (task->notify_pending) {
+				ret = pdFAIL;
+			} else {
+				task->notify_value = value;
+			}
+			break;
+		default:
+			break;
+	}
+	if (ret == pdPASS) {
+		task->notify_pending = true;
+		pthread_cond_broadcast(&task->cond);
+	}
+	pthread_mutex_unlock(&task->mutex);
+	
+	return ret;
+}
+
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+	bool forever;
+	BaseType_t ret = pdFALSE;
+	struct shim_task* t;
+	struct timespec ts;
+	
+	t = xTaskGetCurrentTaskHandle();
+	forever = _deadline(ticks, &ts);
+	
+	pthread_mutex_lock(&t->mutex);
+	if (!t->notify_pending) {
+		t->notify_value &= ~clear_on_entry;
+		while (!t->notify_pending && (ticks != 0)) {
+			if (!_wait(&t->cond, &t->mutex, forever, &ts)) break;
+		}
+	}
+	if (value != NULL) {
+		*value = t->notify_value;
+	}
+	if (t->notify_pending) {
+		t->notify_pending = false;
+		t->notify_value &= ~clear_on_exit;
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&t->mutex);
+	
+	return ret;
+}
+
+
+/**
+ * Wait for the notification value to be non-zero (a counting semaphore given by
+ * xTaskNotifyGive) and return it, decremented or cleared
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+	bool forever;
+	struct shim_task* t;
+	struct timespec ts;
+	uint32_t value;
+	
+	t = xTaskGetCurrentTaskHandle();
+	forever = _deadline(ticks, &ts);
+	
+	pthread_mutex_lock(&t->mutex);
+	while ((t->notify_value == 0) && (ticks != 0)) {
+		if (!_wait(&t->cond, &t->mutex, forever, &ts)) break;
+	}
+	value = t->notify_value;
+	if (value != 0) {
+		t->notify_value = clear_on_exit ? 0 : value - 1;
+	}
+	t->notify_pending = false;
+	pthread_mutex_unlock(&t->mutex);
+	
+	return value;
+}
+
+
+
+//
+// Semaphores
+//
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	return xSemaphoreCreateCounting(1, 1);
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+	return xSemaphoreCreateCounting(1, 0);
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+	struct shim_sem* s;
+	
+	s = calloc(1, sizeof(struct shim_sem));
+	if (s != NULL) {
+		pthread_mutex_init(&s->mutex, NULL);
+		_cond_init(&s->cond);
+		s->count = initial;
+		s->max = max;
+	}
+	
+	return s;
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+	bool forever;
+	BaseType_t ret = pdFALSE;
+	struct timespec ts;
+	
+	forever = _deadline(ticks, &ts);
+	
+	pthread_mutex_lock(&sem->mutex);
+	while ((sem->count == 0) && (ticks != 0)) {
+		if (!_wait(&sem->cond, &sem->mutex, forever, &ts)) break;
+	}
+	if (sem->count > 0) {
+		sem->count--;
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&sem->mutex);
+	
+	return ret;
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	BaseType_t ret = pdFALSE;
+	
+	pthread_mutex_lock(&sem->mutex);
+	if (sem->count < sem->max) {
+		sem->count++;
+		pthread_cond_signal(&sem->cond);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&sem->mutex);
+	
+	return ret;
+}
+
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+	pthread_mutex_destroy(&sem->mutex);
+	pthread_cond_destroy(&sem->cond);
+	free(sem);
+}
+
+
+
+//
+// Queues
+//
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+	struct shim_queue* q;
+	
+	q = calloc(1, sizeof(struct shim_queue));
+	if (q == NULL) {
+		return NULL;
+	}
+	q->buf = malloc((size_t) len * item_size);
+	if (q->buf == NULL) {
+		free(q);
+		return NULL;
+	}
+	pthread_mutex_init(&q->mutex, NULL);
+	_cond_init(&q->cond);
+	q->len = len;
+	q->item_size = item_size;
+	
+	return q;
+}
+
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks)
+{
+	bool forever;
+	BaseType_t ret = pdFALSE;
+	struct timespec ts;
+	
+	forever = _deadline(ticks, &ts);
+	
+	pthread_mutex_lock(&q->mutex);
+	while ((q->count == q->len) && (ticks != 0)) {
+		if (!_wait(&q->cond, &q->mutex, forever, &ts)) break;
+	}
+	if (q->count < q->len) {
+		memcpy(&q->buf[((q->head + q->count) % q->len) * q->item_size], item, q->item_size);
+		q->count++;
+		pthread_cond_broadcast(&q->cond);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&q->mutex);
+	
+	return ret;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks)
+{
+	bool forever;
+	BaseType_t ret = pdFALSE;
+	struct timespec ts;
+	
+	forever = _deadline(ticks, &ts);
+	
+	pthread_mutex_lock(&q->mutex);
+	while ((q->count == 0) && (ticks != 0)) {
+		if (!_wait(&q->cond, &q->mutex, forever, &ts)) break;
+	}
+	if (q->count > 0) {
+		memcpy(item, &q->buf[q->head * q->item_size], q->item_size);
+		q->head = (q->head + 1) % q->len;
+		q->count--;
+		pthread_cond_broadcast(&q->cond);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&q->mutex);
+	
+	return ret;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+	UBaseType_t n;
+	
+	pthread_mutex_lock(&q->mutex);
+	n = q->count;
+	pthread_mutex_unlock(&q->mutex);
+	
+	return n;
+}
+
+
+
+//
+// Internal functions
+//
+static void* _task_entry(void* arg)
+{
+	cur_task = (struct shim_task*) arg;
+	cur_task->fn(cur_task->arg);
+	
+	return NULL;
+}
+
+
+static struct shim_task* _task_alloc(const char* name)
+{
+	struct shim_task* t;
+	
+	t = calloc(1, sizeof(struct shim_task));
+	if (t != NULL) {
+		strncpy(t->name, name, sizeof(t->name) - 1);
+		pthread_mutex_init(&t->mutex, NULL);
+		_cond_init(&t->cond);
+	}
+	
+	return t;
+}
+
+
+static void _cond_init(pthread_cond_t* cond)
+{
+	pthread_condattr_t attr;
+	
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+
+/**
+ * Compute the absolute timeout for a wait of ticks.  Returns true for portMAX_DELAY.
+ */
+static bool _deadline(TickType_t ticks, struct timespec* ts)
+{
+	uint64_t nsec;
+	
+	if (ticks == portMAX_DELAY) {
+		return true;
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	nsec = (uint64_t) ts->tv_nsec + (uint64_t) ticks * (1000000000 / configTICK_RATE_HZ);
+	ts->tv_sec += nsec / 1000000000;
+	ts->tv_nsec = nsec % 1000000000;
+	
+	return false;
+}
+
+
+/**
+ * Returns false when the deadline has passed
+ */
+static bool _wait(pthread_cond_t* cond, pthread_mutex_t* mutex, bool forever, const struct timespec* ts)
+{
+	if (forever) {
+		pthread_cond_wait(cond, mutex);
+		return true;
+	}
+	
+	return pthread_cond_timedwait(cond, mutex, ts) != ETIMEDOUT;
+}
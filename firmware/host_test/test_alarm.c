@@ -0,0 +1,249 @@
+/*
+ * Alarm host test
+ *
+ * Runs alarm_utilities against the gCore emulator with a virtual system clock (linked
+ * with --wrap=time).  Checks fire times across both DST changes in New York (a time
+ * skipped by spring forward and a time repeated by fall back), recomputation after a
+ * timezone change, the gCore alarm programmed with the wake lead and a wake from off
+ * by the gCore alarm.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "alarm_utilities.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include "power_utilities.h"
+#include "ps_utilities.h"
+#include "rtc.h"
+#include "rtc_drift.h"
+#include "test_common.h"
+#include "time_utilities.h"
+#include "tzdb.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+//
+// Constants
+//
+
+// Virtual times (UTC) around the 2025 DST changes in New York
+#define T_MAR_08_1200_EST   1741453200
+#define T_MAR_09_0330_EDT   1741505400     // 02:30 does not exist on Mar 9
+#define T_MAR_09_0700_EDT   1741518000
+#define T_MAR_10_0230_EDT   1741588200
+#define T_MAR_10_0700_EDT   1741604400
+#define T_NOV_01_1200_EDT   1762012800
+#define T_NOV_02_0130_EDT   1762061400     // 01:30 happens twice on Nov 2
+#define T_NOV_02_0130_EST   1762065000
+#define T_NOV_03_0130_EST   1762151400
+
+// The same alarm after changing to London (GMT in November)
+#define T_NOV_03_0130_GMT   1762133400
+
+
+
+//
+// Variables
+//
+static uint32_t virt_secs;
+static uint32_t tz_generation = 0;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _set_zone(const char* name);
+static void _set_alarm(alarm_config_t* ac, int n, bool en, int hour, int minute, int days);
+static bool _powered_off();
+static bool _powered_on();
+
+
+
+//
+// Stubs for the modules alarm_utilities uses that are not under test
+//
+time_t __wrap_time(time_t* t)
+{
+	if (t != NULL) {
+		*t = (time_t) virt_secs;
+	}
+	return (time_t) virt_secs;
+}
+
+uint32_t time_get_step_count() { return 0; }
+uint32_t time_get_tz_generation() { return tz_generation; }
+
+// No drift: the RTC keeps system time
+uint32_t rtc_drift_get_rtc_secs(uint32_t secs) { return secs; }
+
+
+
+//
+// Test
+//
+int main()
+{
+	char msg[ALARM_MSG_MAX_LEN+1];
+	uint8_t reg;
+	alarm_config_t ac;
+	alarm_stats_t stats;
+	gui_config_t gui_config;
+	
+	// Look up rules in tzdb only, not in the host's zoneinfo
+	setenv("TZDIR", "/nonexistent", 1);
+	_set_zone("America/New_York");
+	
+	virt_secs = T_MAR_08_1200_EST;
+	if (!TEST_CHECK(test_start_platform(NULL, true))) {
+		return test_finish("test_alarm");
+	}
+	TEST_CHECK(ps_init());
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	gui_config.hour_mode_24 = false;
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	TEST_CHECK(alarm_init());
+	alarm_get_stats(&stats);
+	TEST_CHECK(!stats.alarm_wake);
+	
+	// Spring forward: a daily 02:30 alarm fires at 03:30 EDT on the day it does not exist
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_ALARM, &ac));
+	_set_alarm(&ac, 0, true, 7, 0, ALARM_DAYS_ALL);
+	_set_alarm(&ac, 1, true, 2, 30, ALARM_DAYS_ALL);
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_ALARM, &ac));
+	TEST_CHECK(!alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.enabled == 2, "%u", stats.enabled);
+	TEST_CHECK(stats.next_index == 1, "%d", stats.next_index);
+	TEST_CHECK(stats.next_secs == T_MAR_09_0330_EDT, "%u", stats.next_secs);
+	
+	// The gCore alarm is programmed early by the wake lead
+	TEST_CHECK(stats.rtc_alarm_secs == T_MAR_09_0330_EDT - ALARM_WAKE_LEAD_SECS, "%u", stats.rtc_alarm_secs);
+	TEST_CHECK(rtc_get_alarm_secs() == T_MAR_09_0330_EDT - ALARM_WAKE_LEAD_SECS, "%u", rtc_get_alarm_secs());
+	
+	virt_secs = T_MAR_09_0330_EDT - 1;
+	TEST_CHECK(!alarm_eval());
+	virt_secs = T_MAR_09_0330_EDT;
+	TEST_CHECK(alarm_eval());
+	alarm_get_msg(msg);
+	TEST_CHECK(strcmp(msg, "Alarm 2:30 AM") == 0, "%s", msg);
+	
+	// The 07:00 alarm follows the change (23 hours after the previous day's) and each
+	// alarm then keeps its local time in EDT
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.next_index == 0, "%d", stats.next_index);
+	TEST_CHECK(stats.next_secs == T_MAR_09_0700_EDT, "%u", stats.next_secs);
+	TEST_CHECK(rtc_get_alarm_secs() == T_MAR_09_0700_EDT - ALARM_WAKE_LEAD_SECS, "%u", rtc_get_alarm_secs());
+	virt_secs = T_MAR_09_0700_EDT;
+	TEST_CHECK(alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.next_index == 1, "%d", stats.next_index);
+	TEST_CHECK(stats.next_secs == T_MAR_10_0230_EDT, "%u", stats.next_secs);
+	virt_secs = T_MAR_10_0230_EDT;
+	TEST_CHECK(alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.next_secs == T_MAR_10_0700_EDT, "%u", stats.next_secs);
+	TEST_CHECK(stats.fired == 3, "%u", stats.fired);
+	
+	// Fall back: a daily 01:30 alarm fires once on the day 01:30 happens twice
+	virt_secs = T_NOV_01_1200_EDT;
+	_set_alarm(&ac, 0, true, 1, 30, ALARM_DAYS_ALL);
+	_set_alarm(&ac, 1, false, 0, 0, 0);
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_ALARM, &ac));
+	TEST_CHECK(!alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.enabled == 1, "%u", stats.enabled);
+	TEST_CHECK(stats.dropped == 0, "%u", stats.dropped);
+	TEST_CHECK(stats.next_secs == T_NOV_02_0130_EDT, "%u", stats.next_secs);
+	virt_secs = T_NOV_02_0130_EDT;
+	TEST_CHECK(alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.next_secs == T_NOV_03_0130_EST, "%u", stats.next_secs);
+	virt_secs = T_NOV_02_0130_EST;
+	TEST_CHECK(!alarm_eval());
+	TEST_CHECK(rtc_get_alarm_secs() == T_NOV_03_0130_EST - ALARM_WAKE_LEAD_SECS, "%u", rtc_get_alarm_secs());
+	
+	// A timezone change recomputes the fire time and reprograms the gCore alarm
+	_set_zone("Europe/London");
+	TEST_CHECK(!alarm_eval());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.next_secs == T_NOV_03_0130_GMT, "%u", stats.next_secs);
+	TEST_CHECK(rtc_get_alarm_secs() == T_NOV_03_0130_GMT - ALARM_WAKE_LEAD_SECS, "%u", rtc_get_alarm_secs());
+	
+	// Shut down for the alarm with the RTC just short of the gCore alarm
+	virt_secs = T_NOV_03_0130_GMT - 60;
+	TEST_CHECK(!alarm_eval());
+	TEST_CHECK(rtc_set_time_secs(T_NOV_03_0130_GMT - ALARM_WAKE_LEAD_SECS - 2));
+	TEST_CHECK(alarm_prepare_shutdown());
+	TEST_CHECK(gcore_set_reg8(GCORE_REG_WK_CTRL, GCORE_WK_ALARM_MASK));
+	ps_commit_now();
+	TEST_CHECK(ps_wait_commit(2000));
+	power_off();
+	TEST_CHECK(test_wait_for(_powered_off, 1000));
+	
+	// gCore powers on for the alarm.  The alarm fires once the system clock reaches it.
+	TEST_CHECK(test_wait_for(_powered_on, 5000));
+	TEST_CHECK(gcore_get_reg8(GCORE_REG_STATUS, &reg));
+	TEST_CHECK((reg & GCORE_ST_PWR_ON_RSN_MASK) == GCORE_PWR_ON_ALARM_MASK, "0x%02x", reg);
+	virt_secs = T_NOV_03_0130_GMT - ALARM_WAKE_LEAD_SECS + 5;
+	TEST_CHECK(alarm_init());
+	alarm_get_stats(&stats);
+	TEST_CHECK(stats.alarm_wake);
+	TEST_CHECK(!alarm_eval());
+	virt_secs = T_NOV_03_0130_GMT;
+	TEST_CHECK(alarm_eval());
+	alarm_get_msg(msg);
+	TEST_CHECK(strcmp(msg, "Alarm 1:30 AM") == 0, "%s", msg);
+	
+	return test_finish("test_alarm");
+}
+
+
+
+//
+// Internal functions
+//
+static void _set_zone(const char* name)
+{
+	setenv("TZ", tzdb_get_rule(tzdb_find(name)), 1);
+	tzset();
+	tz_generation++;
+}
+
+
+static void _set_alarm(alarm_config_t* ac, int n, bool en, int hour, int minute, int days)
+{
+	ac->alarm[n].armed = virt_secs;
+	ac->alarm[n].enable = en;
+	ac->alarm[n].hour = hour;
+	ac->alarm[n].minute = minute;
+	ac->alarm[n].days = days;
+}
+
+
+static bool _powered_off()
+{
+	return gcore_emu_powered_off();
+}
+
+
+static bool _powered_on()
+{
+	return !gcore_emu_powered_off();
+}
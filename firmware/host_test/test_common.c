@@ -0,0 +1,109 @@
+/*
+ * Host test support
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include "i2c.h"
+#include "test_common.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+
+
+//
+// Variables
+//
+static int checks = 0;
+static int failures = 0;
+
+
+
+//
+// API
+//
+bool test_check(bool cond, const char* file, int line, const char* expr, const char* format, ...)
+{
+	va_list args;
+	
+	checks++;
+	if (!cond) {
+		failures++;
+		printf("FAIL %s:%d: %s", file, line, expr);
+		if (format[0] != 0) {
+			printf(" - ");
+			va_start(args, format);
+			vprintf(format, args);
+			va_end(args);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	
+	return cond;
+}
+
+
+/**
+ * Bring up the emulated I2C bus and gCore.  The flash is backed by flash_file (NULL for
+ * RAM only).  A fast bus removes the modelled transfer times.
+ */
+bool test_start_platform(const char* flash_file, bool fast_bus)
+{
+	gcore_emu_config_t cfg;
+	
+	if (i2c_init(0, 0) != ESP_OK) {
+		return false;
+	}
+	
+	cfg.txn_usec = fast_bus ? 0 : GCORE_EMU_DEF_TXN_USEC;
+	cfg.byte_usec = fast_bus ? 0 : GCORE_EMU_DEF_BYTE_USEC;
+	cfg.erase_msec = GCORE_EMU_DEF_ERASE_MSEC;
+	cfg.write_msec = GCORE_EMU_DEF_WRITE_MSEC;
+	cfg.flash_file = flash_file;
+	gcore_emu_init(&cfg);
+	
+	return gcore_init();
+}
+
+
+/**
+ * Poll cond every 10 mSec.  Returns false if it wasn't true within timeout_msec.
+ */
+bool test_wait_for(bool (*cond)(), uint32_t timeout_msec)
+{
+	while (!cond()) {
+		if (timeout_msec < 10) {
+			return false;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+		timeout_msec -= 10;
+	}
+	
+	return true;
+}
+
+
+int test_finish(const char* name)
+{
+	printf("%s: %d checks, %d failed\n", name, checks, failures);
+	
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+/*
+ * Host test support
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+//
+// Macros
+//
+
+// Record a failure (and keep going) if cond is false
+#define TEST_CHECK(cond, ...) test_check((cond), __FILE__, __LINE__, #cond, "" __VA_ARGS__)
+
+
+
+//
+// API
+//
+bool test_check(bool cond, const char* file, int line, const char* expr, const char* format, ...);
+bool test_start_platform(const char* flash_file, bool fast_bus);
+bool test_wait_for(bool (*cond)(), uint32_t timeout_msec);
+int test_finish(const char* name);
+
+#endif /* TEST_COMMON_H */
@@ -0,0 +1,209 @@
+/*
+ * Low battery host test
+ *
+ * Runs ctrl_task against the gCore emulator with a low battery and checks that the
+ * low battery message is shown and kept current (charge and time remaining) while
+ * the load changes.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "alarm_utilities.h"
+#include "ctrl_task.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include "gui_task.h"
+#include "power_history.h"
+#include "power_utilities.h"
+#include "ps_utilities.h"
+#include "rtc_drift.h"
+#include "sntp_utilities.h"
+#include "sys_utilities.h"
+#include "task_stats.h"
+#include "test_common.h"
+#include "web_task.h"
+#include "wifi_utilities.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//
+// Constants
+//
+
+// A low battery (about 9%) whose load doubles after a few seconds
+static const gcore_emu_step_t batt_steps[] = {
+	{0,     3650, 150, 0, 0, GCORE_CHG_IDLE, false},
+	{3000,  3650, 150, 0, 0, GCORE_CHG_IDLE, false},
+	{3100,  3650, 300, 0, 0, GCORE_CHG_IDLE, false},
+	{60000, 3650, 300, 0, 0, GCORE_CHG_IDLE, false}
+};
+
+
+
+//
+// Variables
+//
+TaskHandle_t task_handle_ctrl;
+TaskHandle_t task_handle_gui;
+TaskHandle_t task_handle_web;
+
+static pthread_mutex_t msg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char sec_msg[64];
+static int sec_msg_to;
+static int sec_msg_count = 0;
+
+static int first_tte;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _ctrl_task_entry(void* args);
+static bool _get_msg(char* msg, int* to, int* count);
+static bool _msg_tte(int* percent, int* tte);
+static bool _low_batt_shown();
+static bool _tte_updated();
+
+
+
+//
+// Stubs for the modules ctrl_task uses that are not under test
+//
+void gui_set_primary_msg(const char* msg, int to) {}
+void gui_set_secondary_msg(const char* msg, int to)
+{
+	pthread_mutex_lock(&msg_mutex);
+	strncpy(sec_msg, msg, sizeof(sec_msg) - 1);
+	sec_msg_to = to;
+	sec_msg_count++;
+	pthread_mutex_unlock(&msg_mutex);
+}
+bool web_has_client() { return false; }
+bool wifi_reinit() { return true; }
+bool wifi_is_enabled() { return false; }
+bool wifi_is_connected() { return false; }
+bool wifi_is_sta() { return false; }
+void sntp_start_service() {}
+void sntp_stop_service() {}
+bool task_stats_sample_due(int elapsed_msec) { return false; }
+void task_stats_sample() {}
+bool rtc_drift_discipline_due(int elapsed_msec) { return false; }
+void rtc_drift_discipline() {}
+void power_history_add(const batt_status_t* bs) {}
+bool alarm_eval() { return false; }
+void alarm_get_msg(char* msg) { msg[0] = 0; }
+bool alarm_prepare_shutdown() { return false; }
+
+
+
+//
+// Test
+//
+int main()
+{
+	char msg[64];
+	int count, percent, tte, to;
+	batt_status_t bs;
+
+	if (!TEST_CHECK(test_start_platform(NULL, true))) {
+		return test_finish("test_low_batt");
+	}
+	gcore_emu_load_scenario(batt_steps, sizeof(batt_steps) / sizeof(gcore_emu_step_t), false);
+	TEST_CHECK(ps_init());
+
+	// The message is shown (without a timeout) once the battery is found low
+	TEST_CHECK(xTaskCreatePinnedToCore(&_ctrl_task_entry, "ctrl_task", 3072, NULL, 2, &task_handle_ctrl, 0) == pdPASS);
+	TEST_CHECK(test_wait_for(_low_batt_shown, 3000));
+	TEST_CHECK(_get_msg(msg, &to, &count));
+	TEST_CHECK(to == 0, "%d", to);
+	power_get_batt(&bs);
+	TEST_CHECK(bs.batt_state == BATT_25, "%d", bs.batt_state);
+	TEST_CHECK(_msg_tte(&percent, &first_tte), "%s", msg);
+	TEST_CHECK((percent > 5) && (percent <= 25), "%s", msg);
+
+	// The time remaining follows the doubled load while the message is displayed
+	TEST_CHECK(test_wait_for(_tte_updated, 8000), "%s", msg);
+	TEST_CHECK(_get_msg(msg, &to, &count));
+	TEST_CHECK(to == 0, "%d", to);
+	TEST_CHECK(_msg_tte(&percent, &tte), "%s", msg);
+	TEST_CHECK((tte > first_tte * 4 / 10) && (tte < first_tte * 6 / 10), "%d then %d min", first_tte, tte);
+
+	// Only changes are sent to the GUI
+	TEST_CHECK(count < 20, "%d messages", count);
+
+	return test_finish("test_low_batt");
+}
+
+
+
+//
+// Internal functions
+//
+static void _ctrl_task_entry(void* args)
+{
+	ctrl_task();
+}
+
+
+static bool _get_msg(char* msg, int* to, int* count)
+{
+	pthread_mutex_lock(&msg_mutex);
+	strcpy(msg, sec_msg);
+	*to = sec_msg_to;
+	*count = sec_msg_count;
+	pthread_mutex_unlock(&msg_mutex);
+
+	return *count > 0;
+}
+
+
+static bool _msg_tte(int* percent, int* tte)
+{
+	char msg[64];
+	int count, h, m, to;
+
+	if (!_get_msg(msg, &to, &count)) {
+		return false;
+	}
+	if (sscanf(msg, "Low Battery %d%% (%d:%d)", percent, &h, &m) != 3) {
+		return false;
+	}
+	*tte = h * 60 + m;
+
+	return true;
+}
+
+
+static bool _low_batt_shown()
+{
+	int percent, tte;
+
+	return _msg_tte(&percent, &tte);
+}
+
+
+static bool _tte_updated()
+{
+	int percent, tte;
+
+	// Settled at about half the first estimate
+	return _msg_tte(&percent, &tte) && (tte < first_tte * 6 / 10);
+}
@@ -0,0 +1,271 @@
+/*
+ * Platform host test
+ *
+ * Runs ps_utilities, power_utilities, rtc and ctrl_task against the gCore emulator.
+ * Checks default settings, a settings commit to the emulated flash, the RTC, battery
+ * monitoring, backlight changes following the settings and a power button shutdown
+ * that saves the settings.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "alarm_utilities.h"
+#include "ctrl_task.h"
+#include "gcore.h"
+#include "gcore_emu.h"
+#include "gui_task.h"
+#include "power_history.h"
+#include "power_utilities.h"
+#include "ps_utilities.h"
+#include "rtc.h"
+#include "rtc_drift.h"
+#include "sntp_utilities.h"
+#include "sys_utilities.h"
+#include "task_stats.h"
+#include "test_common.h"
+#include "tzdb.h"
+#include "web_task.h"
+#include "wifi_utilities.h"
+#include <math.h>
+#include <string.h>
+
+
+//
+// Constants
+//
+#define FLASH_FILE       "test_platform_flash.bin"
+
+#define TEST_BRIGHTNESS_1   40
+#define TEST_BRIGHTNESS_2   60
+#define TEST_RTC_SECS       1735689600
+
+// Battery discharging with a steady load
+static const gcore_emu_step_t batt_steps[] = {
+	{0,     3900, 150, 0, 0, GCORE_CHG_IDLE, false},
+	{60000, 3900, 150, 0, 0, GCORE_CHG_IDLE, false}
+};
+
+
+
+//
+// Variables
+//
+TaskHandle_t task_handle_ctrl;
+TaskHandle_t task_handle_gui;
+TaskHandle_t task_handle_web;
+
+static int expected_bl;
+static int power_history_count = 0;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _ctrl_task_entry(void* args);
+static bool _bl_is_expected();
+static bool _batt_sampled();
+static bool _powered_off();
+static bool _powered_on();
+static bool _read_flash_file(uint8_t* buf, int len);
+
+
+
+//
+// Stubs for the modules ctrl_task uses that are not under test
+//
+void gui_set_primary_msg(const char* msg, int to) {}
+void gui_set_secondary_msg(const char* msg, int to) {}
+bool web_has_client() { return false; }
+bool wifi_reinit() { return true; }
+bool wifi_is_enabled() { return false; }
+bool wifi_is_connected() { return false; }
+bool wifi_is_sta() { return false; }
+void sntp_start_service() {}
+void sntp_stop_service() {}
+bool task_stats_sample_due(int elapsed_msec) { return false; }
+void task_stats_sample() {}
+bool rtc_drift_discipline_due(int elapsed_msec) { return false; }
+void rtc_drift_discipline() {}
+void power_history_add(const batt_status_t* bs) { power_history_count++; }
+bool alarm_eval() { return false; }
+void alarm_get_msg(char* msg) { msg[0] = 0; }
+bool alarm_prepare_shutdown() { return false; }
+
+// The ESP32 loses power when gCore switches off.  Park the control task instead
+// (linked with --wrap=power_off).
+void __real_power_off();
+void __wrap_power_off()
+{
+	__real_power_off();
+	while (1) {
+		vTaskDelay(portMAX_DELAY);
+	}
+}
+
+
+
+//
+// Test
+//
+int main()
+{
+	uint8_t reg;
+	uint8_t nvram[PS_RAM_SIZE];
+	uint8_t flash[PS_RAM_SIZE];
+	uint32_t t;
+	batt_status_t bs;
+	gcore_emu_stats_t emu_stats;
+	gui_config_t gui_config;
+	net_config_t net_config;
+	tz_config_t tz_config;
+	
+	// Start with erased flash
+	(void) remove(FLASH_FILE);
+	if (!TEST_CHECK(test_start_platform(FLASH_FILE, false))) {
+		return test_finish("test_platform");
+	}
+	gcore_emu_load_scenario(batt_steps, sizeof(batt_steps) / sizeof(gcore_emu_step_t), false);
+	
+	// Erased NVRAM is initialized with defaults and committed
+	TEST_CHECK(ps_init());
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	TEST_CHECK(gui_config.lcd_brightness == PS_DEFAULT_BACKLIGHT);
+	TEST_CHECK(gui_config.hour_mode_24 == PS_DEFAULT_HOUR_MODE_24);
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_TZ, &tz_config));
+	TEST_CHECK(tz_config.zone_id == tzdb_get_id(tzdb_find(PS_DEFAULT_TZ)), "zone %u", tz_config.zone_id);
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_NET, &net_config));
+	TEST_CHECK(!ps_has_new_ap_name(net_config.ap_ssid), "%s", net_config.ap_ssid);
+	TEST_CHECK(ps_has_new_ap_name("other"));
+	ps_commit_now();
+	TEST_CHECK(ps_wait_commit(2000));
+	gcore_emu_get_stats(&emu_stats);
+	TEST_CHECK(emu_stats.flash_writes == 1, "%u writes", emu_stats.flash_writes);
+	
+	// A settings change is visible immediately and committed on request
+	gui_config.lcd_brightness = TEST_BRIGHTNESS_1;
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	memset(&gui_config, 0, sizeof(gui_config));
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	TEST_CHECK(gui_config.lcd_brightness == TEST_BRIGHTNESS_1);
+	TEST_CHECK(ps_get_commit_state() != PS_COMMIT_IDLE);
+	ps_commit_now();
+	TEST_CHECK(ps_wait_commit(2000));
+	gcore_emu_get_stats(&emu_stats);
+	TEST_CHECK(emu_stats.flash_writes == 2, "%u writes", emu_stats.flash_writes);
+	
+	// RTC time and alarm
+	TEST_CHECK(rtc_set_time_secs(TEST_RTC_SECS));
+	t = rtc_get_time_secs();
+	TEST_CHECK((t >= TEST_RTC_SECS) && (t <= TEST_RTC_SECS + 1), "%u", t);
+	TEST_CHECK(rtc_set_alarm_secs(TEST_RTC_SECS + 3600));
+	TEST_CHECK(rtc_get_alarm_secs() == TEST_RTC_SECS + 3600);
+	
+	// Run the control task: it sets the backlight from the settings and samples the battery
+	expected_bl = TEST_BRIGHTNESS_1;
+	TEST_CHECK(xTaskCreatePinnedToCore(&_ctrl_task_entry, "ctrl_task", 3072, NULL, 2, &task_handle_ctrl, 0) == pdPASS);
+	TEST_CHECK(test_wait_for(_bl_is_expected, 1000), "backlight %d", TEST_BRIGHTNESS_1);
+	TEST_CHECK(test_wait_for(_batt_sampled, 2000));
+	power_get_batt(&bs);
+	TEST_CHECK(fabsf(bs.batt_voltage - 3.9f) < 0.01f, "%.3f V", bs.batt_voltage);
+	TEST_CHECK(bs.load_ma == 150, "%u mA", bs.load_ma);
+	TEST_CHECK(bs.charge_state == CHARGE_OFF);
+	TEST_CHECK(bs.batt_state != BATT_CRIT);
+	
+	// The control task follows settings changes
+	gui_config.lcd_brightness = TEST_BRIGHTNESS_2;
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	expected_bl = TEST_BRIGHTNESS_2;
+	TEST_CHECK(test_wait_for(_bl_is_expected, 1000), "backlight %d", TEST_BRIGHTNESS_2);
+	TEST_CHECK(ps_get_commit_state() != PS_COMMIT_IDLE);
+	
+	// A short power button press shuts down after saving the settings
+	gcore_emu_press_button(300);
+	TEST_CHECK(test_wait_for(_powered_off, 5000));
+	TEST_CHECK(ps_get_commit_state() == PS_COMMIT_IDLE);
+	gcore_emu_get_stats(&emu_stats);
+	TEST_CHECK(emu_stats.flash_writes == 3, "%u writes", emu_stats.flash_writes);
+	
+	// Power on with the button.  The NVRAM (kept while off) matches the flash.
+	gcore_emu_press_button(300);
+	TEST_CHECK(test_wait_for(_powered_on, 1000));
+	TEST_CHECK(gcore_get_nvram_bytes(PS_RAM_STARTADDR, nvram, PS_RAM_SIZE));
+	TEST_CHECK(_read_flash_file(flash, PS_RAM_SIZE));
+	TEST_CHECK(memcmp(nvram, flash, PS_RAM_SIZE) == 0);
+	
+	// Shutdown configured wakeup only for the button (no alarm, not a critical battery)
+	TEST_CHECK(gcore_get_reg8(GCORE_REG_STATUS, &reg));
+	TEST_CHECK((reg & GCORE_ST_PWR_ON_RSN_MASK) == GCORE_PWR_ON_BTN_MASK, "0x%02x", reg);
+	TEST_CHECK(gcore_get_reg8(GCORE_REG_WK_CTRL, &reg));
+	TEST_CHECK(reg == 0, "0x%02x", reg);
+	
+	(void) remove(FLASH_FILE);
+	return test_finish("test_platform");
+}
+
+
+
+//
+// Internal functions
+//
+static void _ctrl_task_entry(void* args)
+{
+	ctrl_task();
+}
+
+
+static bool _bl_is_expected()
+{
+	uint8_t reg;
+	
+	return gcore_get_reg8(GCORE_REG_BL, &reg) && (reg == expected_bl);
+}
+
+
+static bool _batt_sampled()
+{
+	return power_history_count > 0;
+}
+
+
+static bool _powered_off()
+{
+	return gcore_emu_powered_off();
+}
+
+
+static bool _powered_on()
+{
+	return !gcore_emu_powered_off();
+}
+
+
+static bool _read_flash_file(uint8_t* buf, int len)
+{
+	bool ret;
+	FILE* fp;
+	
+	fp = fopen(FLASH_FILE, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	ret = fread(buf, 1, len, fp) == len;
+	fclose(fp);
+	
+	return ret;
+}
@@ -0,0 +1,228 @@
+/*
+ * Power management lock host test
+ *
+ * Drives the PM locks the way their users do and checks the counts and hold times
+ * pm_utilities accounts for:
+ *   SPI  - acquired as disp_spi queues each LCD transaction and released by the
+ *          transaction done ISR (a separate thread here)
+ *   WIFI - held from Soft AP start to stop, with a stray stop ignored
+ *   WEB  - held for each web client session, with nested acquires
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_timer.h"
+#include "pm_utilities.h"
+#include "test_common.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <time.h>
+
+
+//
+// Constants
+//
+
+// LCD bands: each transfer holds the lock this long and bands are this far apart
+#define SPI_NUM_BANDS      100
+#define SPI_XFER_USEC      2000
+#define SPI_GAP_USEC       1000
+
+#define WIFI_AP_MSEC       100
+
+#define WEB_SESSION_1_MSEC 50
+#define WEB_SESSION_2_MSEC 120
+
+// Allowance for sleeps running long on a loaded host
+#define SLACK_USEC         20000
+
+
+
+//
+// Variables
+//
+static sem_t spi_queued;
+static atomic_bool spi_trans_in_progress = false;
+static atomic_bool spi_isr_running = true;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _spi_send(void);
+static void* _spi_isr_thread(void* arg);
+static void _sleep_usec(uint32_t usec);
+
+
+
+//
+// Test
+//
+int main()
+{
+	int i;
+	int64_t start_usec, spi_usec;
+	pthread_t isr_thread;
+	pm_lock_stats_t stats, stats2;
+
+	TEST_CHECK(pm_init());
+	TEST_CHECK(!pm_enabled());
+	for (i=0; i<PM_NUM_LOCKS; i++) {
+		pm_get_lock_stats(i, &stats);
+		TEST_CHECK((stats.acquires == 0) && (stats.total_usec == 0) && !stats.held, "%s", pm_get_lock_name(i));
+	}
+
+	// SPI: one hold per band, each released from the done "ISR"
+	sem_init(&spi_queued, 0, 0);
+	TEST_CHECK(pthread_create(&isr_thread, NULL, _spi_isr_thread, NULL) == 0);
+	start_usec = esp_timer_get_time();
+	for (i=0; i<SPI_NUM_BANDS; i++) {
+		_spi_send();
+		while (spi_trans_in_progress);
+		_sleep_usec(SPI_GAP_USEC);
+	}
+	spi_usec = esp_timer_get_time() - start_usec;
+
+	pm_get_lock_stats(PM_LOCK_SPI, &stats);
+	TEST_CHECK(!stats.held);
+	TEST_CHECK(stats.acquires == SPI_NUM_BANDS, "%u", stats.acquires);
+	TEST_CHECK(stats.total_usec >= (uint64_t) SPI_NUM_BANDS * SPI_XFER_USEC, "%llu", (unsigned long long) stats.total_usec);
+	TEST_CHECK(stats.max_usec >= SPI_XFER_USEC, "%u", stats.max_usec);
+	TEST_CHECK(stats.max_usec < SPI_XFER_USEC + SLACK_USEC, "%u", stats.max_usec);
+
+	// Not held between bands
+	TEST_CHECK(stats.total_usec + (uint64_t) SPI_NUM_BANDS * SPI_GAP_USEC <= (uint64_t) spi_usec,
+		"%llu of %lld uSec", (unsigned long long) stats.total_usec, (long long) spi_usec);
+
+	// Bands queued back to back (the next waits on the previous) are still separate holds
+	for (i=0; i<SPI_NUM_BANDS; i++) {
+		_spi_send();
+	}
+	while (spi_trans_in_progress);
+	spi_isr_running = false;
+	sem_post(&spi_queued);
+	pthread_join(isr_thread, NULL);
+
+	pm_get_lock_stats(PM_LOCK_SPI, &stats);
+	TEST_CHECK(!stats.held);
+	TEST_CHECK(stats.acquires == 2 * SPI_NUM_BANDS, "%u", stats.acquires);
+	TEST_CHECK(stats.max_usec < SPI_XFER_USEC + SLACK_USEC, "%u", stats.max_usec);
+
+	// WIFI: held while the Soft AP runs and the hold in progress is included in the total
+	pm_lock_acquire(PM_LOCK_WIFI);
+	_sleep_usec(WIFI_AP_MSEC * 1000);
+	pm_get_lock_stats(PM_LOCK_WIFI, &stats);
+	TEST_CHECK(stats.held);
+	TEST_CHECK(stats.acquires == 1, "%u", stats.acquires);
+	TEST_CHECK(stats.total_usec >= WIFI_AP_MSEC * 1000, "%llu", (unsigned long long) stats.total_usec);
+	TEST_CHECK(stats.max_usec == 0, "%u", stats.max_usec);
+	pm_lock_release(PM_LOCK_WIFI);
+	pm_get_lock_stats(PM_LOCK_WIFI, &stats);
+	TEST_CHECK(!stats.held);
+	TEST_CHECK(stats.max_usec >= WIFI_AP_MSEC * 1000, "%u", stats.max_usec);
+	TEST_CHECK(stats.max_usec < WIFI_AP_MSEC * 1000 + SLACK_USEC, "%u", stats.max_usec);
+	TEST_CHECK(stats.total_usec == stats.max_usec, "%llu", (unsigned long long) stats.total_usec);
+
+	// A stop without a start does not release a later hold early
+	pm_lock_release(PM_LOCK_WIFI);
+	pm_get_lock_stats(PM_LOCK_WIFI, &stats2);
+	TEST_CHECK((stats2.acquires == stats.acquires) && (stats2.total_usec == stats.total_usec));
+	pm_lock_acquire(PM_LOCK_WIFI);
+	pm_get_lock_stats(PM_LOCK_WIFI, &stats2);
+	TEST_CHECK(stats2.held && (stats2.acquires == 2), "%u", stats2.acquires);
+	pm_lock_release(PM_LOCK_WIFI);
+
+	// WEB: two sessions, the second with a nested acquire that must not end the hold
+	pm_lock_acquire(PM_LOCK_WEB);
+	_sleep_usec(WEB_SESSION_1_MSEC * 1000);
+	pm_lock_release(PM_LOCK_WEB);
+
+	pm_lock_acquire(PM_LOCK_WEB);
+	_sleep_usec(WEB_SESSION_2_MSEC * 500);
+	pm_lock_acquire(PM_LOCK_WEB);
+	_sleep_usec(WEB_SESSION_2_MSEC * 250);
+	pm_lock_release(PM_LOCK_WEB);
+	pm_get_lock_stats(PM_LOCK_WEB, &stats);
+	TEST_CHECK(stats.held);
+	_sleep_usec(WEB_SESSION_2_MSEC * 250);
+	pm_lock_release(PM_LOCK_WEB);
+
+	pm_get_lock_stats(PM_LOCK_WEB, &stats);
+	TEST_CHECK(!stats.held);
+	TEST_CHECK(stats.acquires == 2, "%u", stats.acquires);
+	TEST_CHECK(stats.max_usec >= WEB_SESSION_2_MSEC * 1000, "%u", stats.max_usec);
+	TEST_CHECK(stats.max_usec < WEB_SESSION_2_MSEC * 1000 + SLACK_USEC, "%u", stats.max_usec);
+	TEST_CHECK(stats.total_usec >= (WEB_SESSION_1_MSEC + WEB_SESSION_2_MSEC) * 1000, "%llu", (unsigned long long) stats.total_usec);
+	TEST_CHECK(stats.total_usec < (WEB_SESSION_1_MSEC + WEB_SESSION_2_MSEC) * 1000 + 2 * SLACK_USEC, "%llu", (unsigned long long) stats.total_usec);
+
+	// Locks are independent
+	pm_get_lock_stats(PM_LOCK_SPI, &stats);
+	TEST_CHECK(stats.acquires == 2 * SPI_NUM_BANDS, "%u", stats.acquires);
+
+	// Out of range locks are ignored
+	pm_lock_acquire(PM_NUM_LOCKS);
+	pm_lock_release(-1);
+
+	return test_finish("test_pm");
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Queue a transaction as disp_spi_send_colors does
+ */
+static void _spi_send(void)
+{
+	while (spi_trans_in_progress);
+
+	spi_trans_in_progress = true;
+	pm_lock_acquire(PM_LOCK_SPI);
+	sem_post(&spi_queued);
+}
+
+
+/**
+ * The SPI transaction done callback (spi_ready) for each queued transaction
+ */
+static void* _spi_isr_thread(void* arg)
+{
+	while (1) {
+		sem_wait(&spi_queued);
+		if (!spi_isr_running) break;
+
+		_sleep_usec(SPI_XFER_USEC);
+		pm_lock_release(PM_LOCK_SPI);
+		spi_trans_in_progress = false;
+	}
+
+	return NULL;
+}
+
+
+static void _sleep_usec(uint32_t usec)
+{
+	struct timespec ts;
+
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) != 0);
+}
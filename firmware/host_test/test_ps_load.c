@@ -0,0 +1,234 @@
+/*
+ * Settings load host test
+ *
+ * Drags the brightness "slider" (a change every few mSec) while other tasks read the
+ * settings and follow change notifications.  Checks that the commit task turns the
+ * burst into a single NVRAM write and a single flash commit, and that seqlock readers
+ * never see a partially updated config.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gcore_emu.h"
+#include "ps_utilities.h"
+#include "test_common.h"
+#include <stdatomic.h>
+#include <string.h>
+
+
+//
+// Constants
+//
+#define SLIDER_MSEC          2000
+#define SLIDER_STEP_MSEC     5
+#define NUM_READERS          2
+#define NOTIFY_CHANGE        0x00000001
+
+// I2C traffic allowed while the slider moves (nothing should be written until it stops)
+#define MAX_SLIDER_TXNS      0
+
+// I2C traffic allowed for the single NVRAM write after the slider stops: no more than
+// one pass over the store (a change per step written directly would be hundreds of
+// transactions)
+#define MAX_FLUSH_TXNS       32
+#define MAX_FLUSH_BYTES      PS_RAM_SIZE
+
+
+
+//
+// Variables
+//
+static atomic_bool running = true;
+static atomic_uint reads = 0;
+static atomic_uint torn_reads = 0;
+static atomic_uint notifications = 0;
+static atomic_int follower_brightness = -1;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _reader_task(void* args);
+static void _follower_task(void* args);
+static void _fill_net_config(net_config_t* cfg, char c);
+static bool _net_config_consistent(const net_config_t* cfg);
+
+
+
+//
+// Test
+//
+int main()
+{
+	int i;
+	int n;
+	int brightness = 0;
+	uint32_t txns, bytes;
+	gcore_emu_stats_t emu0, emu1, emu2;
+	gui_config_t gui_config;
+	net_config_t net_config;
+	ps_commit_stats_t ps0, ps1, ps2;
+	
+	if (!TEST_CHECK(test_start_platform(NULL, false))) {
+		return test_finish("test_ps_load");
+	}
+	TEST_CHECK(ps_init());
+	ps_commit_now();
+	TEST_CHECK(ps_wait_commit(2000));
+	
+	// Start readers and a task following brightness changes like ctrl_task
+	for (i=0; i<NUM_READERS; i++) {
+		TEST_CHECK(xTaskCreatePinnedToCore(&_reader_task, "reader", 2048, NULL, 1, NULL, i) == pdPASS);
+	}
+	TEST_CHECK(xTaskCreatePinnedToCore(&_follower_task, "follower", 2048, NULL, 1, NULL, 0) == pdPASS);
+	vTaskDelay(pdMS_TO_TICKS(50));
+	
+	// Drag the slider (and change the network settings now and then)
+	gcore_emu_get_stats(&emu0);
+	ps_get_commit_stats(&ps0);
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config));
+	for (n=0; n<(SLIDER_MSEC / SLIDER_STEP_MSEC); n++) {
+		brightness = 10 + (n % 90);
+		gui_config.lcd_brightness = brightness;
+		TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_GUI, &gui_config));
+		if ((n % 10) == 0) {
+			_fill_net_config(&net_config, 'A' + ((n / 10) % 26));
+			TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_NET, &net_config));
+		}
+		vTaskDelay(pdMS_TO_TICKS(SLIDER_STEP_MSEC));
+	}
+	gcore_emu_get_stats(&emu1);
+	ps_get_commit_stats(&ps1);
+	
+	// Nothing is written while the slider moves
+	txns = emu1.transactions - emu0.transactions;
+	printf("%d changes: %u I2C transactions while changing\n", n, txns);
+	TEST_CHECK(txns <= MAX_SLIDER_TXNS, "%u transactions", txns);
+	TEST_CHECK((ps1.sets - ps0.sets) == n + (n + 9) / 10, "%u sets", ps1.sets - ps0.sets);
+	TEST_CHECK(ps1.nvram_flushes == ps0.nvram_flushes);
+	TEST_CHECK(ps_get_commit_state() == PS_COMMIT_PENDING);
+	
+	// One NVRAM write once the changes have been quiet
+	vTaskDelay(pdMS_TO_TICKS(PS_WRITE_QUIET_MSEC + 250));
+	gcore_emu_get_stats(&emu2);
+	ps_get_commit_stats(&ps2);
+	txns = emu2.transactions - emu1.transactions;
+	bytes = emu2.bytes - emu1.bytes;
+	printf("NVRAM write: %u I2C transactions, %u bytes\n", txns, bytes);
+	TEST_CHECK((ps2.nvram_flushes - ps1.nvram_flushes) == 1, "%u flushes", ps2.nvram_flushes - ps1.nvram_flushes);
+	TEST_CHECK(txns <= MAX_FLUSH_TXNS, "%u transactions", txns);
+	TEST_CHECK(bytes <= MAX_FLUSH_BYTES, "%u bytes", bytes);
+	TEST_CHECK(emu2.flash_writes == emu0.flash_writes);
+	
+	// One flash commit (on request rather than waiting for PS_COMMIT_QUIET_MSEC)
+	ps_commit_now();
+	TEST_CHECK(ps_wait_commit(2000));
+	gcore_emu_get_stats(&emu2);
+	ps_get_commit_stats(&ps2);
+	TEST_CHECK((emu2.flash_writes - emu0.flash_writes) == 1, "%u writes", emu2.flash_writes - emu0.flash_writes);
+	TEST_CHECK((ps2.count - ps0.count) == 1);
+	TEST_CHECK(ps2.failures == 0);
+	
+	// Readers were never blocked out and never saw a torn config.  The follower was
+	// notified and saw the final value.
+	running = false;
+	vTaskDelay(pdMS_TO_TICKS(50));
+	printf("%u reads, %u notifications\n", (unsigned int) reads, (unsigned int) notifications);
+	TEST_CHECK(torn_reads == 0, "%u torn reads", (unsigned int) torn_reads);
+	TEST_CHECK(reads > 1000, "%u reads", (unsigned int) reads);
+	TEST_CHECK(notifications > 0);
+	TEST_CHECK(follower_brightness == brightness, "%d", (int) follower_brightness);
+	
+	return test_finish("test_ps_load");
+}
+
+
+
+//
+// Internal functions
+//
+static void _reader_task(void* args)
+{
+	net_config_t cfg;
+	
+	while (running) {
+		(void) ps_get_config(PS_CONFIG_TYPE_NET, &cfg);
+		if (!_net_config_consistent(&cfg)) {
+			torn_reads++;
+		}
+		reads++;
+	}
+	
+	vTaskDelete(NULL);
+}
+
+
+static void _follower_task(void* args)
+{
+	uint32_t generation = PS_GENERATION_NONE;
+	uint32_t notification_value;
+	gui_config_t cfg;
+	
+	(void) ps_subscribe(PS_CONFIG_TYPE_GUI, xTaskGetCurrentTaskHandle(), NOTIFY_CHANGE);
+	
+	while (running) {
+		if (xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, pdMS_TO_TICKS(10)) == pdTRUE) {
+			notifications++;
+		}
+		if (ps_get_config_if_changed(PS_CONFIG_TYPE_GUI, &cfg, &generation)) {
+			follower_brightness = cfg.lcd_brightness;
+		}
+	}
+	
+	vTaskDelete(NULL);
+}
+
+
+/**
+ * Every string field is filled with c (and every address byte set to it) so a reader
+ * can tell if it saw parts of two different updates
+ */
+static void _fill_net_config(net_config_t* cfg, char c)
+{
+	memset(cfg, 0, sizeof(net_config_t));
+	memset(cfg->ap_ssid, c, PS_SSID_MAX_LEN);
+	memset(cfg->sta_ssid, c, PS_SSID_MAX_LEN);
+	memset(cfg->ap_pw, c, PS_PW_MAX_LEN);
+	memset(cfg->sta_pw, c, PS_PW_MAX_LEN);
+	memset(cfg->ap_ip_addr, c, 4);
+	memset(cfg->sta_ip_addr, c, 4);
+	memset(cfg->sta_netmask, c, 4);
+}
+
+
+static bool _net_config_consistent(const net_config_t* cfg)
+{
+	char c;
+	net_config_t expected;
+	
+	// The defaults haven't been replaced yet
+	if (cfg->ap_pw[0] == 0) {
+		return true;
+	}
+	
+	c = cfg->ap_pw[0];
+	_fill_net_config(&expected, c);
+	
+	return memcmp(cfg, &expected, sizeof(net_config_t)) == 0;
+}
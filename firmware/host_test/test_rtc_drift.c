@@ -0,0 +1,224 @@
+/*
+ * RTC drift model host test
+ *
+ * Runs rtc_drift against a virtual RTC (linked with --wrap=rtc_get_time_secs and
+ * --wrap=rtc_set_time_secs) running 23.4 ppm fast with 1 second resolution.  Feeds it
+ * SNTP syncs with network jitter and one bad sync and checks the fit, the rejection
+ * of the bad sync, that the drift survives a restart (reseeded from the persisted fit)
+ * and that a sync from a clock stepped back does not add a pair.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "ps_utilities.h"
+#include "rtc_drift.h"
+#include "test_common.h"
+#include "time_utilities.h"
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+
+//
+// Constants
+//
+
+// Virtual RTC
+#define RTC_PPB            23400
+#define T_START            1750000000
+
+// Syncs one pair interval apart (plus up to a minute) with up to 50 mSec of network jitter
+#define NUM_SYNCS          20
+#define SYNC_LATE_SECS     60
+#define JITTER_USEC        50000
+
+// The bad sync (4 seconds ahead)
+#define BAD_SYNC           10
+#define BAD_SYNC_SECS      4
+
+// Syncs after the restart
+#define NUM_RESTART_SYNCS  4
+
+// Fit limits: a few standard errors of the slope with the RTC's 1 second resolution
+#define DRIFT_TOL_PPB      2000
+#define RESID_MAX_MSEC     500
+
+
+
+//
+// Variables
+//
+
+// True time and the RTC value it was last set to at true time rtc_set_true
+static double virt_true;
+static double rtc_set_true;
+static uint32_t rtc_set_secs;
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void _sync(double err_secs);
+static double _jitter();
+static void _advance(uint32_t secs);
+
+
+
+//
+// Stubs for the modules rtc_drift uses that are not under test
+//
+uint32_t __wrap_rtc_get_time_secs()
+{
+	return rtc_set_secs + (uint32_t) floor((virt_true - rtc_set_true) * (1.0 + RTC_PPB / 1e9));
+}
+
+bool __wrap_rtc_set_time_secs(uint32_t t)
+{
+	rtc_set_secs = t;
+	rtc_set_true = virt_true;
+	return true;
+}
+
+void time_note_step() {}
+
+
+
+//
+// Test
+//
+int main()
+{
+	int i;
+	rtc_config_t rtc_config;
+	rtc_drift_stats_t stats, stats2;
+	struct timeval tv;
+	
+	srand(1);
+	virt_true = T_START + 0.3;
+	(void) __wrap_rtc_set_time_secs(T_START);
+	
+	if (!TEST_CHECK(test_start_platform(NULL, true))) {
+		return test_finish("test_rtc_drift");
+	}
+	TEST_CHECK(ps_init());
+	TEST_CHECK(rtc_drift_init());
+	rtc_drift_get_stats(&stats);
+	TEST_CHECK(!stats.valid && (stats.pairs == 0), "%u pairs", stats.pairs);
+	
+	// Syncs with jitter and one bad one, each far enough apart to be a pair
+	for (i=0; i<NUM_SYNCS; i++) {
+		_sync((i == BAD_SYNC) ? BAD_SYNC_SECS : _jitter());
+		
+		// A sync before the pair interval only keeps the RTC close
+		if (i == 0) {
+			_advance(SYNC_LATE_SECS);
+			_sync(_jitter());
+			rtc_drift_get_stats(&stats);
+			TEST_CHECK(stats.pairs == 1, "%u pairs", stats.pairs);
+		}
+		
+		_advance(RTC_DRIFT_PAIR_SECS + (rand() % SYNC_LATE_SECS));
+	}
+	
+	rtc_drift_get_stats(&stats);
+	TEST_CHECK(stats.valid);
+	TEST_CHECK(stats.rejected == 1, "%u rejected", stats.rejected);
+	TEST_CHECK(stats.pairs == NUM_SYNCS - 1, "%u pairs", stats.pairs);
+	TEST_CHECK(abs(stats.drift_ppb - RTC_PPB) < DRIFT_TOL_PPB, "%d ppb", (int) stats.drift_ppb);
+	TEST_CHECK(abs(stats.drift_ppb - RTC_PPB) < 4 * (int) stats.drift_sd_ppb, "%d ppb sd %u", (int) stats.drift_ppb, stats.drift_sd_ppb);
+	TEST_CHECK(stats.resid_msec < RESID_MAX_MSEC, "%u mSec", stats.resid_msec);
+	TEST_CHECK(stats.week_raw_msec > 10000, "%u mSec", stats.week_raw_msec);
+	TEST_CHECK((stats.week_err_msec > 0) && (stats.week_err_msec < 2000), "%u mSec", stats.week_err_msec);
+	
+	// A week offline the corrected RTC is still close (the raw RTC is 14 seconds fast)
+	_advance(RTC_DRIFT_PREDICT_SECS);
+	TEST_CHECK(rtc_drift_get_time(&tv));
+	TEST_CHECK(fabs((double) tv.tv_sec + tv.tv_usec / 1e6 - virt_true) < 1.5, "%.3f sec", (double) tv.tv_sec + tv.tv_usec / 1e6 - virt_true);
+	TEST_CHECK(fabs((double) __wrap_rtc_get_time_secs() - virt_true) > 20.0);
+	
+	// Restart: the pairs are gone and the fit's end points persisted in the RTC config
+	// seed the new fit.  Rewriting the config (changed then restored) makes rtc_drift
+	// reload it as it does at boot.
+	TEST_CHECK(ps_get_config(PS_CONFIG_TYPE_RTC, &rtc_config));
+	rtc_config.resid_msec++;
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_RTC, &rtc_config));
+	rtc_config.resid_msec--;
+	TEST_CHECK(ps_set_config(PS_CONFIG_TYPE_RTC, &rtc_config));
+	rtc_drift_get_stats(&stats2);
+	TEST_CHECK(stats2.valid);
+	TEST_CHECK(stats2.drift_ppb == stats.drift_ppb, "%d ppb", (int) stats2.drift_ppb);
+	TEST_CHECK(rtc_drift_get_time(&tv));
+	TEST_CHECK(fabs((double) tv.tv_sec + tv.tv_usec / 1e6 - virt_true) < 1.5, "%.3f sec", (double) tv.tv_sec + tv.tv_usec / 1e6 - virt_true);
+	
+	for (i=0; i<NUM_RESTART_SYNCS; i++) {
+		_sync(_jitter());
+		_advance(RTC_DRIFT_PAIR_SECS + (rand() % SYNC_LATE_SECS));
+	}
+	rtc_drift_get_stats(&stats2);
+	TEST_CHECK(stats2.valid);
+	TEST_CHECK(stats2.pairs == 2 + NUM_RESTART_SYNCS, "%u pairs", stats2.pairs);
+	TEST_CHECK(stats2.rejected == 1, "%u rejected", stats2.rejected);
+	TEST_CHECK(abs(stats2.drift_ppb - RTC_PPB) < DRIFT_TOL_PPB, "%d ppb", (int) stats2.drift_ppb);
+	TEST_CHECK(abs(stats2.drift_ppb - stats.drift_ppb) < DRIFT_TOL_PPB / 2, "%d then %d ppb", (int) stats.drift_ppb, (int) stats2.drift_ppb);
+	
+	// A sync from a clock stepped back before the newest pair adds no pair
+	_advance(60);
+	_sync(-(double) (RTC_DRIFT_PAIR_SECS + 120));
+	rtc_drift_get_stats(&stats);
+	TEST_CHECK(stats.pairs == stats2.pairs, "%u pairs", stats.pairs);
+	TEST_CHECK(stats.drift_ppb == stats2.drift_ppb, "%d ppb", (int) stats.drift_ppb);
+	
+	return test_finish("test_rtc_drift");
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Sync from a time server that is err_secs off true time
+ */
+static void _sync(double err_secs)
+{
+	double t;
+	struct timeval tv;
+	
+	t = virt_true + err_secs;
+	tv.tv_sec = (time_t) t;
+	tv.tv_usec = (suseconds_t) ((t - (double) tv.tv_sec) * 1000000.0);
+	rtc_drift_note_sync(&tv);
+}
+
+
+/**
+ * Network delay error of a good sync
+ */
+static double _jitter()
+{
+	return ((rand() % (2 * JITTER_USEC)) - JITTER_USEC) / 1e6;
+}
+
+
+/**
+ * Move true time on by secs and a random part of a second
+ */
+static void _advance(uint32_t secs)
+{
+	virt_true += (double) secs + (rand() % 1000) / 1000.0;
+}
@@ -0,0 +1,536 @@
+/*
+ * SNTP client host test
+ *
+ * Runs sntp_utilities against three ntp_standin servers on the loopback interface
+ * (SNTP_STANDIN_PORT) with a virtual system clock (linked with --wrap for gettimeofday,
+ * settimeofday and adjtime, slewing as ESP-IDF does) and a virtual uptime that the
+ * test moves forward to the next poll (--wrap=esp_timer_get_time) only while the
+ * client waits between passes (--wrap=ulTaskNotifyTake).  Checks that a 300
+ * mSec offset is slewed, that the poll interval backs off while the clock is stable,
+ * that a 5 second offset is stepped, that a server disagreeing with the others is voted
+ * out as a falseticker and that a kiss-o'-death response backs its server off.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "ntp_standin.h"
+#include "rtc_drift.h"
+#include "sntp_utilities.h"
+#include "test_common.h"
+#include "time_utilities.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+//
+// Constants
+//
+
+// Server offsets (mSec)
+#define SLEW_OFFSET_MSEC   300
+#define STEP_OFFSET_MSEC   (SLEW_OFFSET_MSEC + 5000)
+#define FALSE_OFFSET_MSEC  (STEP_OFFSET_MSEC + 2000)
+
+// Round trip delays (mSec).  The first server is nearer so it is selected while it
+// agrees with the others.
+static const uint16_t server_delay_msec[SNTP_STANDIN_SERVERS] = {10, 30, 30};
+
+// Polls of a server moved away from the others before it is voted out
+#define FALSE_MAX_POLLS    4
+
+// ESP-IDF's adjtime slews the clock by 1/64 of the elapsed time
+#define SLEW_RATE_DIV      64
+
+// Allowed error of a measured offset and of the clock after a correction (uSec).  The
+// stand-ins have no jitter or asymmetry so only host scheduling adds error.
+#define OFFSET_TOL_USEC    5000
+
+// Wait for the initial burst of polls (mSec)
+#define BURST_WAIT_MSEC    ((SNTP_BURST_POLLS + 2) * SNTP_BURST_SECS * 1000)
+
+// Wait for the client to act on a poll that is due (mSec)
+#define POLL_WAIT_MSEC     (3 * SNTP_TASK_EVAL_MSEC)
+
+
+
+//
+// Variables
+//
+
+// Virtual uptime is the real uptime plus the jumps made by the test and the virtual
+// system time is its base plus the uptime plus the part of any slew made so far
+static pthread_mutex_t clock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t jump_usec = 0;
+static int64_t sys_base_usec;
+static int64_t slew_usec = 0;
+static int64_t slew_start_usec;
+
+// Set while the client task waits between passes so no exchange sees a jump
+static bool client_idle = false;
+
+// System time at uptime 0 when the stand-ins started (their reference clock)
+static int64_t ref_base_usec;
+
+// Calls to the modules that are not under test
+static pthread_mutex_t note_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int sync_count = 0;
+static int64_t sync_err_usec;
+static int step_count = 0;
+
+// Conditions for test_wait_for
+static int want_syncs;
+static uint32_t want_polls[SNTP_STANDIN_SERVERS];
+static int want_falseticker;
+
+
+
+//
+// Forward declarations for internal functions
+//
+int64_t __real_esp_timer_get_time();
+int __real_gettimeofday(struct timeval* tv, void* tz);
+uint32_t __real_ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+static int64_t _slew_done(int64_t uptime_usec);
+static int64_t _clock_err_usec(int32_t offset_msec);
+static void _jump(uint32_t secs);
+static void _set_servers(int index, int32_t offset_msec, uint8_t stratum);
+static void _want_polls(int index);
+static bool _synced();
+static bool _polled();
+static bool _falseticker();
+static int _poll_secs(int index);
+
+
+
+//
+// Virtual clock
+//
+int64_t __wrap_esp_timer_get_time()
+{
+	int64_t t;
+	
+	pthread_mutex_lock(&clock_mutex);
+	t = __real_esp_timer_get_time() + jump_usec;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return t;
+}
+
+int __wrap_gettimeofday(struct timeval* tv, void* tz)
+{
+	int64_t uptime_usec, t;
+	
+	pthread_mutex_lock(&clock_mutex);
+	uptime_usec = __real_esp_timer_get_time() + jump_usec;
+	t = sys_base_usec + uptime_usec + _slew_done(uptime_usec);
+	pthread_mutex_unlock(&clock_mutex);
+	
+	tv->tv_sec = (time_t) (t / 1000000);
+	tv->tv_usec = (suseconds_t) (t % 1000000);
+	
+	return 0;
+}
+
+int __wrap_settimeofday(const struct timeval* tv, const struct timezone* tz)
+{
+	pthread_mutex_lock(&clock_mutex);
+	sys_base_usec = (int64_t) tv->tv_sec * 1000000 + tv->tv_usec - (__real_esp_timer_get_time() + jump_usec);
+	slew_usec = 0;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return 0;
+}
+
+int __wrap_adjtime(const struct timeval* delta, struct timeval* olddelta)
+{
+	int64_t uptime_usec, done_usec;
+	
+	pthread_mutex_lock(&clock_mutex);
+	uptime_usec = __real_esp_timer_get_time() + jump_usec;
+	done_usec = _slew_done(uptime_usec);
+	if (olddelta != NULL) {
+		olddelta->tv_sec = (time_t) ((slew_usec - done_usec) / 1000000);
+		olddelta->tv_usec = (suseconds_t) ((slew_usec - done_usec) % 1000000);
+	}
+	if (delta != NULL) {
+		sys_base_usec += done_usec;
+		slew_usec = (int64_t) delta->tv_sec * 1000000 + delta->tv_usec;
+		slew_start_usec = uptime_usec;
+	}
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return 0;
+}
+
+uint32_t __wrap_ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+	uint32_t n;
+	
+	pthread_mutex_lock(&clock_mutex);
+	client_idle = true;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	n = __real_ulTaskNotifyTake(clear_on_exit, ticks);
+	
+	pthread_mutex_lock(&clock_mutex);
+	client_idle = false;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return n;
+}
+
+
+
+//
+// Stubs for the modules sntp_utilities uses that are not under test
+//
+void rtc_drift_note_sync(const struct timeval* tv)
+{
+	int64_t uptime_usec;
+	
+	// Error of the time given to the drift model from the time the servers gave
+	uptime_usec = __wrap_esp_timer_get_time();
+	pthread_mutex_lock(&note_mutex);
+	sync_count++;
+	sync_err_usec = (int64_t) tv->tv_sec * 1000000 + tv->tv_usec - (ref_base_usec + uptime_usec);
+	pthread_mutex_unlock(&note_mutex);
+}
+
+void time_note_step()
+{
+	pthread_mutex_lock(&note_mutex);
+	step_count++;
+	pthread_mutex_unlock(&note_mutex);
+}
+
+void time_get_disp_string(tmElements_t* te, char* buf)
+{
+	strcpy(buf, "--");
+}
+
+
+
+//
+// Test
+//
+int main()
+{
+	int i, expect_secs, falseticker, kod, secs;
+	int64_t err_usec;
+	ntp_standin_config_t cfg = NTP_STANDIN_DEFAULT_CONFIG;
+	ntp_standin_stats_t standin_stats;
+	sntp_server_stats_t server_stats, server_stats2;
+	sntp_stats_t stats;
+	struct timeval tv;
+	
+	srandom(1);
+	
+	// The virtual system clock starts on the host's
+	__real_gettimeofday(&tv, NULL);
+	sys_base_usec = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec - __real_esp_timer_get_time();
+	ref_base_usec = sys_base_usec;
+	
+	// Start the stand-ins ahead of the client (which keeps their config) with no jitter
+	cfg.port = SNTP_STANDIN_PORT;
+	TEST_CHECK(ntp_standin_start(&cfg, SNTP_STANDIN_SERVERS));
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		_set_servers(i, SLEW_OFFSET_MSEC, cfg.stratum);
+	}
+	sntp_start_service();
+	
+	// Slew: the burst fills the filters and the 300 mSec offset is slewed, not stepped
+	want_syncs = 1;
+	if (!TEST_CHECK(test_wait_for(_synced, BURST_WAIT_MSEC))) {
+		return test_finish("test_sntp");
+	}
+	sntp_get_stats(&stats);
+	TEST_CHECK(stats.running);
+	TEST_CHECK(stats.num_servers == SNTP_STANDIN_SERVERS, "%d", stats.num_servers);
+	TEST_CHECK(stats.steps == 0, "%u", stats.steps);
+	TEST_CHECK(abs(stats.last_offset_usec - SLEW_OFFSET_MSEC * 1000) < OFFSET_TOL_USEC, "%d uSec", stats.last_offset_usec);
+	err_usec = _clock_err_usec(SLEW_OFFSET_MSEC);
+	TEST_CHECK(err_usec < -(SLEW_OFFSET_MSEC * 1000 * 9 / 10), "%lld uSec", (long long) err_usec);
+	TEST_CHECK(step_count == 0, "%d", step_count);
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		TEST_CHECK(sntp_get_server_stats(i, &server_stats));
+		TEST_CHECK(server_stats.polls == SNTP_BURST_POLLS, "%d: %u", i, server_stats.polls);
+		TEST_CHECK((server_stats.responses == SNTP_BURST_POLLS) && (server_stats.reach == 0x0F), "%d: %u 0x%02x", i, server_stats.responses, server_stats.reach);
+		TEST_CHECK(server_stats.stratum == cfg.stratum, "%d: %u", i, server_stats.stratum);
+		TEST_CHECK(!server_stats.falseticker);
+	}
+	TEST_CHECK(stats.selected == 0, "%d", stats.selected);
+	TEST_CHECK(_poll_secs(0) == SNTP_MIN_POLL_SECS, "%d", _poll_secs(0));
+	
+	// The drift model gets the corrected time
+	TEST_CHECK(sync_count == 1, "%d", sync_count);
+	TEST_CHECK(llabs(sync_err_usec - SLEW_OFFSET_MSEC * 1000) < OFFSET_TOL_USEC, "%lld uSec", (long long) sync_err_usec);
+	
+	// The slew completes and the next poll finds the clock on time
+	_want_polls(-1);
+	want_syncs = 2;
+	_jump(SNTP_MIN_POLL_SECS);
+	TEST_CHECK(test_wait_for(_polled, POLL_WAIT_MSEC));
+	TEST_CHECK(test_wait_for(_synced, POLL_WAIT_MSEC));
+	err_usec = _clock_err_usec(SLEW_OFFSET_MSEC);
+	TEST_CHECK(llabs(err_usec) < OFFSET_TOL_USEC, "%lld uSec", (long long) err_usec);
+	
+	// Poll backoff: the poll interval doubles with each stable sample up to the maximum
+	for (expect_secs = 2 * SNTP_MIN_POLL_SECS; expect_secs <= 2 * SNTP_MAX_POLL_SECS; expect_secs *= 2) {
+		sntp_get_stats(&stats);
+		TEST_CHECK(_poll_secs(stats.selected) == ((expect_secs > SNTP_MAX_POLL_SECS) ? SNTP_MAX_POLL_SECS : expect_secs),
+			"%d for %d", _poll_secs(stats.selected), expect_secs);
+		want_syncs = sync_count + 1;
+		_jump(_poll_secs(stats.selected));
+		TEST_CHECK(test_wait_for(_synced, POLL_WAIT_MSEC), "%d", expect_secs);
+	}
+	sntp_get_stats(&stats);
+	TEST_CHECK(_poll_secs(stats.selected) == SNTP_MAX_POLL_SECS, "%d", _poll_secs(stats.selected));
+	TEST_CHECK(stats.steps == 0, "%u", stats.steps);
+	err_usec = _clock_err_usec(SLEW_OFFSET_MSEC);
+	TEST_CHECK(llabs(err_usec) < OFFSET_TOL_USEC, "%lld uSec", (long long) err_usec);
+	
+	// Step: all servers 5 seconds ahead.  The clock is stepped at once and every
+	// server's filter starts again with a burst.
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		_set_servers(i, STEP_OFFSET_MSEC, cfg.stratum);
+	}
+	want_syncs = sync_count + 1;
+	_jump(SNTP_MAX_POLL_SECS);
+	TEST_CHECK(test_wait_for(_synced, POLL_WAIT_MSEC));
+	sntp_get_stats(&stats);
+	TEST_CHECK(stats.steps == 1, "%u", stats.steps);
+	TEST_CHECK(abs(stats.last_offset_usec - (STEP_OFFSET_MSEC - SLEW_OFFSET_MSEC) * 1000) < OFFSET_TOL_USEC, "%d uSec", stats.last_offset_usec);
+	err_usec = _clock_err_usec(STEP_OFFSET_MSEC);
+	TEST_CHECK(llabs(err_usec) < OFFSET_TOL_USEC, "%lld uSec", (long long) err_usec);
+	TEST_CHECK(step_count == 1, "%d", step_count);
+	TEST_CHECK(llabs(sync_err_usec - STEP_OFFSET_MSEC * 1000) < OFFSET_TOL_USEC, "%lld uSec", (long long) sync_err_usec);
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		TEST_CHECK(sntp_get_server_stats(i, &server_stats));
+		TEST_CHECK(!server_stats.valid, "%d", i);
+		want_polls[i] = server_stats.polls + SNTP_BURST_POLLS;
+	}
+	
+	// The burst finds the clock on time
+	want_syncs = sync_count + 1;
+	TEST_CHECK(test_wait_for(_synced, BURST_WAIT_MSEC));
+	TEST_CHECK(_polled());
+	sntp_get_stats(&stats);
+	TEST_CHECK(stats.steps == 1, "%u", stats.steps);
+	TEST_CHECK(stats.selected == 0, "%d", stats.selected);
+	TEST_CHECK(abs(stats.last_offset_usec) < OFFSET_TOL_USEC, "%d uSec", stats.last_offset_usec);
+	
+	// Falseticker: the selected server moves 2 seconds from the other two.  Its first
+	// sample there makes its jitter (and so its distance) too large for it to stay
+	// selected.  It is voted out once its filter holds a few samples at the new offset
+	// and the clock is never moved to it.
+	falseticker = stats.selected;
+	_set_servers(falseticker, FALSE_OFFSET_MSEC, cfg.stratum);
+	want_falseticker = falseticker;
+	for (i=0; (i<SNTP_FILTER_LEN) && !_falseticker(); i++) {
+		_want_polls(falseticker);
+		_jump(_poll_secs(falseticker));
+		TEST_CHECK(test_wait_for(_polled, POLL_WAIT_MSEC));
+		sntp_get_stats(&stats);
+		TEST_CHECK((stats.selected >= 0) && (stats.selected != falseticker), "%d: %d", i, stats.selected);
+	}
+	TEST_CHECK(_falseticker());
+	TEST_CHECK(i < FALSE_MAX_POLLS, "%d polls", i);
+	TEST_CHECK(stats.steps == 1, "%u", stats.steps);
+	TEST_CHECK(sntp_get_server_stats(falseticker, &server_stats));
+	TEST_CHECK(llabs(server_stats.offset_usec - (FALSE_OFFSET_MSEC - STEP_OFFSET_MSEC) * 1000) < OFFSET_TOL_USEC, "%d uSec", server_stats.offset_usec);
+	err_usec = _clock_err_usec(STEP_OFFSET_MSEC);
+	TEST_CHECK(llabs(err_usec) < OFFSET_TOL_USEC, "%lld uSec", (long long) err_usec);
+	
+	// Kiss-o'-death: the server sending it is polled as slowly as possible
+	kod = stats.selected;
+	_set_servers(kod, STEP_OFFSET_MSEC, 0);
+	TEST_CHECK(sntp_get_server_stats(kod, &server_stats));
+	_want_polls(kod);
+	_jump(_poll_secs(kod));
+	TEST_CHECK(test_wait_for(_polled, POLL_WAIT_MSEC));
+	TEST_CHECK(sntp_get_server_stats(kod, &server_stats2));
+	TEST_CHECK(server_stats2.poll_secs == SNTP_MAX_POLL_SECS, "%u", server_stats2.poll_secs);
+	TEST_CHECK(server_stats2.stratum == 0, "%u", server_stats2.stratum);
+	TEST_CHECK(server_stats2.responses == server_stats.responses, "%u", server_stats2.responses);
+	TEST_CHECK((server_stats2.reach & 0x01) == 0, "0x%02x", server_stats2.reach);
+	
+	// Its next poll waits while the others continue
+	_want_polls(-1);
+	want_polls[kod] = 0;
+	secs = 0;
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		if ((i != kod) && (_poll_secs(i) > secs)) secs = _poll_secs(i);
+	}
+	TEST_CHECK(secs < SNTP_MAX_POLL_SECS, "%d", secs);
+	_jump(secs);
+	TEST_CHECK(test_wait_for(_polled, POLL_WAIT_MSEC));
+	TEST_CHECK(sntp_get_server_stats(kod, &server_stats));
+	TEST_CHECK(server_stats.polls == server_stats2.polls, "%u", server_stats.polls);
+	ntp_standin_get_stats(kod, &standin_stats);
+	TEST_CHECK(standin_stats.requests == server_stats.polls, "%u", standin_stats.requests);
+	err_usec = _clock_err_usec(STEP_OFFSET_MSEC);
+	TEST_CHECK(llabs(err_usec) < OFFSET_TOL_USEC, "%lld uSec", (long long) err_usec);
+	
+	sntp_stop_service();
+	
+	return test_finish("test_sntp");
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Part of the slew in progress made by uptime_usec - called with clock_mutex held
+ */
+static int64_t _slew_done(int64_t uptime_usec)
+{
+	int64_t d;
+	
+	d = (uptime_usec - slew_start_usec) / SLEW_RATE_DIV;
+	if (d >= llabs(slew_usec)) {
+		return slew_usec;
+	}
+	
+	return (slew_usec < 0) ? -d : d;
+}
+
+
+/**
+ * System time - the time served with offset_msec
+ */
+static int64_t _clock_err_usec(int32_t offset_msec)
+{
+	int64_t t;
+	
+	pthread_mutex_lock(&clock_mutex);
+	t = sys_base_usec + _slew_done(__real_esp_timer_get_time() + jump_usec) - ref_base_usec;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return t - (int64_t) offset_msec * 1000;
+}
+
+
+/**
+ * Move the virtual uptime (and with it the system time) on to when the next poll
+ * of a server polled every secs is due.  Waits for the client to finish any pass
+ * in progress so an exchange never spans the jump.
+ */
+static void _jump(uint32_t secs)
+{
+	while (1) {
+		pthread_mutex_lock(&clock_mutex);
+		if (client_idle) {
+			jump_usec += (int64_t) (secs + 1) * 1000000;
+			pthread_mutex_unlock(&clock_mutex);
+			return;
+		}
+		pthread_mutex_unlock(&clock_mutex);
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+}
+
+
+static void _set_servers(int index, int32_t offset_msec, uint8_t stratum)
+{
+	ntp_standin_config_t cfg = NTP_STANDIN_DEFAULT_CONFIG;
+	
+	cfg.offset_msec = offset_msec;
+	cfg.delay_msec = server_delay_msec[index];
+	cfg.jitter_msec = 0;
+	cfg.stratum = stratum;
+	ntp_standin_set_config(index, &cfg);
+}
+
+
+/**
+ * Wait for the server at index (every server if index < 0) to be polled again
+ */
+static void _want_polls(int index)
+{
+	int i;
+	sntp_server_stats_t server_stats;
+	
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		(void) sntp_get_server_stats(i, &server_stats);
+		want_polls[i] = ((index < 0) || (i == index)) ? server_stats.polls + 1 : 0;
+	}
+}
+
+
+/**
+ * A correction has been completed (the drift model is told last)
+ */
+static bool _synced()
+{
+	bool ret;
+	
+	pthread_mutex_lock(&note_mutex);
+	ret = (sync_count >= want_syncs);
+	pthread_mutex_unlock(&note_mutex);
+	
+	return ret;
+}
+
+
+/**
+ * The wanted polls have been made and the client has finished the pass making them
+ */
+static bool _polled()
+{
+	bool idle;
+	int i;
+	sntp_server_stats_t server_stats;
+	
+	for (i=0; i<SNTP_STANDIN_SERVERS; i++) {
+		(void) sntp_get_server_stats(i, &server_stats);
+		if (server_stats.polls < want_polls[i]) return false;
+	}
+	
+	pthread_mutex_lock(&clock_mutex);
+	idle = client_idle;
+	pthread_mutex_unlock(&clock_mutex);
+	
+	return idle;
+}
+
+
+static bool _falseticker()
+{
+	sntp_server_stats_t server_stats;
+	
+	(void) sntp_get_server_stats(want_falseticker, &server_stats);
+	return server_stats.falseticker;
+}
+
+
+static int _poll_secs(int index)
+{
+	sntp_server_stats_t server_stats;
+	
+	if (!sntp_get_server_stats(index, &server_stats)) {
+		return -1;
+	}
+	
+	return server_stats.poll_secs;
+}
@@ -0,0 +1,180 @@
+/*
+ * Calendar engine host test
+ *
+ * Cross-checks time_calendar against the C library's localtime_r() for the same POSIX
+ * TZ rule.  With zone name arguments every minute of the century starting 1970 is
+ * converted (at a different second within each minute) for each zone, following the
+ * clock like the display does, with a jump to a random time every so often.  With
+ * "--all-rules" every distinct rule in the timezone database is checked every 61
+ * minutes (each a full conversion) from 2000 through 2039.
+ *
+ * Copyright 2024-2025 Dan Julio
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "test_common.h"
+#include "time_calendar.h"
+#include "tzdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+//
+// Constants
+//
+#define CENTURY_START        ((time_t) 0)               // 1970-01-01
+#define CENTURY_END          ((time_t) 3155760000LL)    // 2070-01-01
+
+#define ALL_RULES_START      ((time_t) 946684800)       // 2000-01-01
+#define ALL_RULES_END        ((time_t) 2208988800LL)    // 2040-01-01
+#define ALL_RULES_STEP_SECS  (61 * 60)
+
+// A random jump is checked after this many steps
+#define JUMP_INTERVAL        1009
+
+// Mismatches reported (per rule) before just counting them
+#define MAX_REPORTS          10
+
+
+
+//
+// Forward declarations for internal functions
+//
+static bool _check_rule(const char* name, const char* rule, time_t start, time_t end, time_t step);
+static bool _same(const struct tm* a, const struct tm* b);
+static void _report(const char* name, time_t t, const struct tm* cal_tm, const struct tm* ref_tm);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	int i, j, zone;
+	int num_rules = 0;
+	const char* rule;
+	const char** rules;
+	
+	// Keep the C library from loading a compiled zone file named like the rule
+	// (e.g. "EST5EDT") instead of parsing the rule
+	setenv("TZDIR", "/nonexistent", 1);
+	
+	if ((argc == 2) && (strcmp(argv[1], "--all-rules") == 0)) {
+		rules = malloc(tzdb_get_num_zones() * sizeof(char*));
+		for (i=0; i<tzdb_get_num_zones(); i++) {
+			rule = tzdb_get_rule(i);
+			for (j=0; j<num_rules; j++) {
+				if (strcmp(rules[j], rule) == 0) break;
+			}
+			if (j == num_rules) {
+				rules[num_rules++] = rule;
+				(void) _check_rule(rule, rule, ALL_RULES_START, ALL_RULES_END, ALL_RULES_STEP_SECS);
+			}
+		}
+		printf("%d rules\n", num_rules);
+		free(rules);
+	} else {
+		TEST_CHECK(argc > 1, "usage: %s zone... | --all-rules", argv[0]);
+		for (i=1; i<argc; i++) {
+			zone = tzdb_find(argv[i]);
+			if (TEST_CHECK(zone >= 0, "unknown zone %s", argv[i])) {
+				(void) _check_rule(argv[i], tzdb_get_rule(zone), CENTURY_START, CENTURY_END, 60);
+			}
+		}
+	}
+	
+	return test_finish("test_time_calendar");
+}
+
+
+
+//
+// Internal functions
+//
+
+/**
+ * Step through [start, end) converting times with both the engine and the C library
+ */
+static bool _check_rule(const char* name, const char* rule, time_t start, time_t end, time_t step)
+{
+	int n = 0;
+	uint32_t count = 0;
+	uint32_t errors = 0;
+	uint32_t seed = 1;
+	time_t base_t, t, jump_t;
+	time_cal_tz_t tz;
+	time_cal_t cal, jump_cal;
+	struct tm cal_tm, ref_tm;
+	
+	if (!TEST_CHECK(time_cal_parse_tz(rule, &tz), "%s: could not parse %s", name, rule)) {
+		return false;
+	}
+	setenv("TZ", rule, 1);
+	tzset();
+	time_cal_init(&cal, &tz);
+	time_cal_init(&jump_cal, &tz);
+	
+	for (base_t = start; base_t < end; base_t += step) {
+		// Visit a different second within each step
+		t = base_t + (n * 7) % step;
+		time_cal_get(&cal, t, &cal_tm);
+		(void) localtime_r(&t, &ref_tm);
+		if (!_same(&cal_tm, &ref_tm)) {
+			if (errors++ < MAX_REPORTS) _report(name, t, &cal_tm, &ref_tm);
+		}
+		count++;
+		
+		// A jump from wherever the previous jump left the engine
+		if (++n == JUMP_INTERVAL) {
+			n = 0;
+			seed = seed * 1103515245 + 12345;
+			jump_t = start + (time_t) (((uint64_t) seed << 16 ^ seed) % (uint64_t) (end - start));
+			time_cal_get(&jump_cal, jump_t, &cal_tm);
+			(void) localtime_r(&jump_t, &ref_tm);
+			if (!_same(&cal_tm, &ref_tm)) {
+				if (errors++ < MAX_REPORTS) _report(name, jump_t, &cal_tm, &ref_tm);
+			}
+			count++;
+		}
+	}
+	
+	printf("%s (%s): %u conversions, %u full, %u mismatches\n", name, rule, count,
+	       cal.recomputes + jump_cal.recomputes, errors);
+	
+	return TEST_CHECK(errors == 0, "%s: %u mismatches", name, errors);
+}
+
+
+static bool _same(const struct tm* a, const struct tm* b)
+{
+	return (a->tm_year == b->tm_year) && (a->tm_mon == b->tm_mon) && (a->tm_mday == b->tm_mday) &&
+	       (a->tm_hour == b->tm_hour) && (a->tm_min == b->tm_min) && (a->tm_sec == b->tm_sec) &&
+	       (a->tm_wday == b->tm_wday) && (a->tm_yday == b->tm_yday) && (a->tm_isdst == b->tm_isdst);
+}
+
+
+static void _report(const char* name, time_t t, const struct tm* cal_tm, const struct tm* ref_tm)
+{
+	printf("%s at %lld: engine %04d-%02d-%02d %02d:%02d:%02d wday %d yday %d dst %d, ",
+	       name, (long long) t, cal_tm->tm_year + 1900, cal_tm->tm_mon + 1, cal_tm->tm_mday,
+	       cal_tm->tm_hour, cal_tm->tm_min, cal_tm->tm_sec, cal_tm->tm_wday, cal_tm->tm_yday,
+	       cal_tm->tm_isdst);
+	printf("localtime %04d-%02d-%02d %02d:%02d:%02d wday %d yday %d dst %d\n",
+	       ref_tm->tm_year + 1900, ref_tm->tm_mon + 1, ref_tm->tm_mday, ref_tm->tm_hour,
+	       ref_tm->tm_min, ref_tm->tm_sec, ref_tm->tm_wday, ref_tm->tm_yday, ref_tm->tm_isdst);
+}
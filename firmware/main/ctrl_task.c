@@ -21,14 +21,18 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "alarm_utilities.h"
 #include "ctrl_task.h"
 #include "gcore.h"
 #include "gui_task.h"
+#include "power_history.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
+#include "rtc_drift.h"
 #include "sntp_utilities.h"
 #include "sys_utilities.h"
 #include "system_config.h"
+#include "task_stats.h"
 #include "web_task.h"
 #include "wifi_utilities.h"
 #include <string.h>
@@ -42,12 +46,15 @@ static const char* TAG = "ctrl_task";
 
 // State
 static gui_config_t gui_config;
+static uint32_t gui_generation = PS_GENERATION_NONE;
+static uint32_t net_generation;           // NET config generation wifi was last (re)started with
 
 // Notifications
 static bool notify_network_reset = false;
 static bool notify_network_restart = false;
 static bool notify_shutdown = false;
 static bool notify_update_backlight = false;
+static bool notify_net_config = false;
 
 
 
@@ -56,6 +63,7 @@ static bool notify_update_backlight = false;
 //
 static void _ctrl_handle_notifications();
 static void _ctrl_display_wifi_info();
+static void _ctrl_format_low_batt_msg(const batt_status_t* bs, char* buf);
 
 
 
@@ -66,23 +74,30 @@ void ctrl_task()
 {
 	batt_status_t batt_status;
 	bool low_batt_msg_displayed = false;
+	char low_batt_msg[32];
+	char batt_msg[32];
+	char alarm_msg[ALARM_MSG_MAX_LEN+1];
 	bool cur_client_connected;
 	bool prev_client_connected = false;
 	bool cur_wifi_available;
 	bool prev_wifi_available = false;
 	int batt_sample_count;
-	int nvram_save_count;
+	uint8_t prev_brightness;
 	
 	ESP_LOGI(TAG, "Start task");
 	
 	// Initialize
 	batt_sample_count = CTRL_BATT_SAMPLE_MSEC / CTRL_EVAL_MSEC;
-	nvram_save_count = CTRL_NVRAM_SAVE_MSEC / CTRL_EVAL_MSEC;
-	ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config);
+	(void) ps_get_config_if_changed(PS_CONFIG_TYPE_GUI, &gui_config, &gui_generation);
+	net_generation = ps_get_config_generation(PS_CONFIG_TYPE_NET);
 	
 	// Set the initial screen brightness
 	power_set_brightness(gui_config.lcd_brightness);
 	
+	// Follow changes to the backlight and network settings
+	(void) ps_subscribe(PS_CONFIG_TYPE_GUI, xTaskGetCurrentTaskHandle(), CTRL_NOTIFY_UPD_BACKLIGHT);
+	(void) ps_subscribe(PS_CONFIG_TYPE_NET, xTaskGetCurrentTaskHandle(), CTRL_NOTIFY_NET_CONFIG);
+	
 	// Set the button for network reset detection
 	(void) gcore_set_reg8(GCORE_REG_PWR_TM, NETWORK_RESET_BTN_MSEC/10);
 	
@@ -112,8 +127,20 @@ void ctrl_task()
 		// Handle backlight updates
 		if (notify_update_backlight) {
 			notify_update_backlight = false;
-			ps_get_config(PS_CONFIG_TYPE_GUI, &gui_config);
-			power_set_brightness(gui_config.lcd_brightness);
+			prev_brightness = gui_config.lcd_brightness;
+			if (ps_get_config_if_changed(PS_CONFIG_TYPE_GUI, &gui_config, &gui_generation)) {
+				if (gui_config.lcd_brightness != prev_brightness) {
+					power_set_brightness(gui_config.lcd_brightness);
+				}
+			}
+		}
+		
+		// Restart wifi if its settings changed since it was last (re)started
+		if (notify_net_config) {
+			notify_net_config = false;
+			if (ps_get_config_generation(PS_CONFIG_TYPE_NET) != net_generation) {
+				notify_network_restart = true;
+			}
 		}
 	
 		// Update battery state
@@ -121,22 +148,27 @@ void ctrl_task()
 			batt_sample_count = CTRL_BATT_SAMPLE_MSEC / CTRL_EVAL_MSEC;
 			power_batt_update();
 			power_get_batt(&batt_status);
+			power_history_add(&batt_status);
 			
 			if (batt_status.batt_state >= BATT_25) {
-				if (!low_batt_msg_displayed) {
-					gui_set_secondary_msg("Low Battery", 0);
+				// Updated while displayed so the charge and time remaining stay current
+				_ctrl_format_low_batt_msg(&batt_status, batt_msg);
+				if (!low_batt_msg_displayed || (strcmp(batt_msg, low_batt_msg) != 0)) {
+					strcpy(low_batt_msg, batt_msg);
+					gui_set_secondary_msg(low_batt_msg, 0);
 					xTaskNotify(task_handle_gui, GUI_NOTIFY_SECONDARY_MESSAGE, eSetBits);
 					low_batt_msg_displayed = true;
 				}
 			} else {
 				if (low_batt_msg_displayed) {
-					gui_set_secondary_msg("Low Battery", 1);
+					gui_set_secondary_msg(low_batt_msg, 1);
 					xTaskNotify(task_handle_gui, GUI_NOTIFY_SECONDARY_MESSAGE, eSetBits);
 					low_batt_msg_displayed = false;
 				}
 			}
 			if (batt_status.batt_state == BATT_CRIT) {
 				ESP_LOGI(TAG, "Critical battery voltage detected");
+				ps_commit_now();
 				notify_shutdown = true;
 			}
 		}
@@ -153,8 +185,15 @@ void ctrl_task()
 			if (batt_status.batt_state == BATT_CRIT) {
 				(void) gcore_set_reg8(GCORE_REG_WK_CTRL, GCORE_WK_CHRG_START_MASK);
 			} else {
-				// Disable wake on charge when we've been manually turned off
-				(void) gcore_set_reg8(GCORE_REG_WK_CTRL, 0);
+				// Disable wake on charge when we've been manually turned off but wake
+				// for the next alarm
+				(void) gcore_set_reg8(GCORE_REG_WK_CTRL, alarm_prepare_shutdown() ? GCORE_WK_ALARM_MASK : 0);
+			}
+			
+			// Make sure any settings changes are saved to the gCore flash
+			ps_commit_now();
+			if (!ps_wait_commit(CTRL_SHUTDOWN_COMMIT_MSEC)) {
+				ESP_LOGE(TAG, "Settings not saved before shutdown");
 			}
 			
 			ESP_LOGI(TAG, "Shutdown");
@@ -162,10 +201,22 @@ void ctrl_task()
 			power_off();
 		}
 		
-		// Periodically write NVRAM to backing flash on gCore EFM8
-		if (--nvram_save_count == 0) {
-			nvram_save_count = CTRL_NVRAM_SAVE_MSEC / CTRL_EVAL_MSEC;
-			ps_save_to_flash(); // Only writes if there are changes
+		// Fire alarms that are due
+		if (alarm_eval()) {
+			alarm_get_msg(alarm_msg);
+			gui_set_primary_msg(alarm_msg, ALARM_NOTIFY_SECS);
+			xTaskNotify(task_handle_gui, GUI_NOTIFY_PRIMARY_MESSAGE, eSetBits);
+			xTaskNotify(task_handle_web, WEB_NOTIFY_ALARM_MASK, eSetBits);
+		}
+		
+		// Periodically sample task CPU usage and stack high-water marks
+		if (task_stats_sample_due(CTRL_EVAL_MSEC)) {
+			task_stats_sample();
+		}
+		
+		// Periodically keep the system time on the drift-corrected RTC when not syncing
+		if (rtc_drift_discipline_due(CTRL_EVAL_MSEC)) {
+			rtc_drift_discipline();
 		}
 			
 		// Get current connectivity status
@@ -231,6 +282,7 @@ void ctrl_task()
 			vTaskDelay(pdMS_TO_TICKS(2000));
 			
 			// Display 
+			net_generation = ps_get_config_generation(PS_CONFIG_TYPE_NET);
 			if (!wifi_reinit()) {
 				gui_set_secondary_msg("Wi-Fi failed to restart", 5);
 				xTaskNotify(task_handle_gui, GUI_NOTIFY_SECONDARY_MESSAGE, eSetBits);
@@ -266,6 +318,10 @@ static void _ctrl_handle_notifications()
 		if (Notification(notification_value, CTRL_NOTIFY_UPD_BACKLIGHT)) {
 			notify_update_backlight = true;
 		}
+		
+		if (Notification(notification_value, CTRL_NOTIFY_NET_CONFIG)) {
+			notify_net_config = true;
+		}
 	}
 }
 
@@ -284,4 +340,14 @@ static void _ctrl_display_wifi_info()
 	
 	gui_set_secondary_msg(buf, 5);
 	xTaskNotify(task_handle_gui, GUI_NOTIFY_SECONDARY_MESSAGE, eSetBits);
+}
+
+
+static void _ctrl_format_low_batt_msg(const batt_status_t* bs, char* buf)
+{
+	if (bs->tte_min != POWER_TTE_UNKNOWN) {
+		sprintf(buf, "Low Battery %d%% (%d:%02d)", bs->soc_percent, bs->tte_min / 60, bs->tte_min % 60);
+	} else {
+		sprintf(buf, "Low Battery %d%%", bs->soc_percent);
+	}
 }
\ No newline at end of file
@@ -34,13 +34,14 @@
 // Battery monitoring periods (mSec)
 #define CTRL_BATT_SAMPLE_MSEC          500
 
-// Write NVRAM to flash check period (mSec)
-#define CTRL_NVRAM_SAVE_MSEC           60000
+// Maximum time to wait for settings to be committed to flash at shutdown (mSec)
+#define CTRL_SHUTDOWN_COMMIT_MSEC      2000
 
 // Control Task notifications
 #define CTRL_NOTIFY_RESTART_NETWORK    0x00000001
 #define CTRL_NOTIFY_SHUTDOWN           0x00000002
 #define CTRL_NOTIFY_UPD_BACKLIGHT      0x00000010
+#define CTRL_NOTIFY_NET_CONFIG         0x00000020
 
 
 
@@ -19,13 +19,18 @@
 #include "freertos/FreeRTOS.h"
 #include "esp_system.h"
 #include "esp_log.h"
-#include "esp_freertos_hooks.h"
+#include "esp_timer.h"
 #include "gui_task.h"
 #include "disp_spi.h"
 #include "disp_driver.h"
+#include "disp_pipeline.h"
 #include "gui_screen_main.h"
 #include "lvgl/lvgl.h"
+#include "lvgl/src/lv_misc/lv_gc.h"
+#include "task_stats.h"
+#include "time_utilities.h"
 #include <string.h>
+#include <sys/time.h>
 
 
 //
@@ -48,8 +53,11 @@ static const char* TAG = "gui_task";
 lv_theme_t* gui_theme;
 
 // Dual display update buffers to allow DMA/SPI transfer of one while the other is updated
+// (the pipelined driver supplies these from its buffer ring)
+#ifndef LCD_PIPELINE_ENABLE
 static lv_color_t lvgl_disp_buf1[LVGL_DISP_BUF_SIZE];
 static lv_color_t lvgl_disp_buf2[LVGL_DISP_BUF_SIZE];
+#endif
 static lv_disp_buf_t lvgl_disp_buf;
 
 // Display driver
@@ -59,8 +67,15 @@ static lv_disp_drv_t lvgl_disp_drv;
 static lv_obj_t* gui_screens[GUI_NUM_SCREENS];
 static int gui_cur_screen_index = -1;
 
-// LVGL sub-task 
-static lv_task_t* lvgl_task_handle;
+// LVGL animation task (excluded from the sleep deadline while no animations run)
+static lv_task_t* lvgl_anim_task;
+
+// LVGL timebase
+static int64_t lvgl_tick_usec;
+
+// Display tick
+static TaskHandle_t gui_task_handle;
+static esp_timer_handle_t tick_timer;
 
 // Caller ID messages
 static char primary_message[MAX_MSG_LEN+1];
@@ -76,9 +91,14 @@ static int secondary_message_to;
 static bool gui_lvgl_init();
 static void gui_theme_init();
 static void gui_screen_init();
-static void gui_add_subtasks();
-static void gui_task_event_handler_task(lv_task_t * task);
-static void lv_tick_callback();
+static bool gui_tick_init();
+static void gui_arm_tick();
+static void gui_realign_tick();
+static void gui_tick_callback(void* arg);
+static void gui_handle_tick();
+static void gui_handle_notifications(uint32_t notification_value);
+static void gui_update_lv_tick();
+static uint32_t gui_next_deadline_msec();
 
 
 
@@ -88,6 +108,9 @@ static void lv_tick_callback();
 //
 void gui_task(void* args)
 {
+	int64_t t;
+	uint32_t notification_value;
+	
 	ESP_LOGI(TAG, "Start task");
 
 	// Initialize
@@ -96,15 +119,33 @@ void gui_task(void* args)
 	}
 	gui_theme_init();
 	gui_screen_init();
-	gui_add_subtasks();
 	
 	// Set the initially displayed screen
 	gui_set_screen(GUI_SCREEN_MAIN);
 	
+	// Start the display tick
+	if (!gui_tick_init()) {
+		vTaskDelete(NULL);
+	}
+	
 	while (1) {
-		// This task runs every GUI_EVAL_MSEC mSec
-		vTaskDelay(pdMS_TO_TICKS(GUI_EVAL_MSEC));
+		// Block until the next LVGL task is due or another task notifies us.  Blocking
+		// (instead of polling) lets the system drop to light sleep between deadlines.
+		gui_update_lv_tick();
+		notification_value = 0;
+		(void) xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value,
+			pdMS_TO_TICKS(gui_next_deadline_msec()));
+		
+		gui_update_lv_tick();
+		
+		if (notification_value != 0) {
+			gui_handle_notifications(notification_value);
+		}
+		
+		// Time spent in LVGL is accounted separately from the rest of this task
+		t = esp_timer_get_time();
 		lv_task_handler();
+		task_stats_note_lvgl_usec((uint32_t) (esp_timer_get_time() - t));
 	}
 }
 
@@ -144,23 +185,38 @@ void gui_set_secondary_msg(const char* msg, int to)
 //
 static bool gui_lvgl_init()
 {
+#ifdef LCD_PIPELINE_ENABLE
+	lv_color_t* lvgl_disp_buf1;
+	lv_color_t* lvgl_disp_buf2;
+#endif
+
 	// Initialize lvgl
 	lv_init();
 	
+	// lv_init() creates exactly one task (for animations) so it is at the head of the list
+	lvgl_anim_task = lv_ll_get_head(&LV_GC_ROOT(_lv_task_ll));
+	
 	//
 	// Interface and driver initialization
 	//
 	disp_driver_init(true);
 	
 	// Install the display driver
+#ifdef LCD_PIPELINE_ENABLE
+	disp_pipeline_get_lvgl_bufs(&lvgl_disp_buf1, &lvgl_disp_buf2);
+#endif
 	lv_disp_buf_init(&lvgl_disp_buf, lvgl_disp_buf1, lvgl_disp_buf2, LVGL_DISP_BUF_SIZE);
 	lv_disp_drv_init(&lvgl_disp_drv);
 	lvgl_disp_drv.flush_cb = disp_driver_flush;
+#ifdef LCD_PIPELINE_BENCHMARK
+	lvgl_disp_drv.monitor_cb = disp_driver_monitor;
+#endif
 	lvgl_disp_drv.buffer = &lvgl_disp_buf;
 	lv_disp_drv_register(&lvgl_disp_drv);
     
-    // Hook LittleVGL's timebase to its CPU system tick so it can keep track of time
-    esp_register_freertos_tick_hook(lv_tick_callback);
+    // LittleVGL's timebase is advanced from esp_timer each time through the task loop
+    // (a FreeRTOS tick hook would not see the ticks skipped during tickless idle)
+    lvgl_tick_usec = esp_timer_get_time();
     
     return true;
 }
@@ -182,32 +238,165 @@ static void gui_screen_init()
 }
 
 
-static void gui_add_subtasks()
+static bool gui_tick_init()
 {
-	// Event handler sub-task runs every GUI_EVAL_MSEC mSec
-	lvgl_task_handle = lv_task_create(gui_task_event_handler_task, GUI_EVAL_MSEC,
-		LV_TASK_PRIO_MID, NULL);
+	esp_err_t ret;
+	const esp_timer_create_args_t tick_timer_args = {
+		.callback = &gui_tick_callback,
+		.arg = NULL,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "gui_tick"
+	};
+	
+	gui_task_handle = xTaskGetCurrentTaskHandle();
+	
+	ret = esp_timer_create(&tick_timer_args, &tick_timer);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Could not create tick timer - %d", ret);
+		tick_timer = NULL;
+		return false;
+	}
+	
+	gui_arm_tick();
+	
+	return true;
 }
 
 
-static void gui_task_event_handler_task(lv_task_t * task)
+/**
+ * Arm the one-shot tick timer for the next half-second boundary of the system clock.
+ * The delay is recomputed from gettimeofday() every time so clock steps and slews are
+ * followed automatically.
+ */
+static void gui_arm_tick()
 {
-	uint32_t notification_value;
+	struct timeval tv;
+	int64_t delay_usec;
 	
-	// Look for incoming notifications (clear them upon reading)
-	if (xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, 0)) {
-		if (Notification(notification_value, GUI_NOTIFY_PRIMARY_MESSAGE)) {
-			gui_screen_main_set_prim_msg(primary_message, primary_message_to);
-		}
-		
-		if (Notification(notification_value, GUI_NOTIFY_SECONDARY_MESSAGE)) {
-			gui_screen_main_set_sec_msg(secondary_message, secondary_message_to);
-		}
+	gettimeofday(&tv, NULL);
+	delay_usec = GUI_TICK_PERIOD_USEC - (tv.tv_usec % GUI_TICK_PERIOD_USEC);
+	if (delay_usec < GUI_TICK_MIN_DELAY_USEC) {
+		delay_usec += GUI_TICK_PERIOD_USEC;
 	}
+	
+	// Fails harmlessly if the timer callback re-armed it first during a re-alignment
+	(void) esp_timer_start_once(tick_timer, (uint64_t) delay_usec);
 }
 
 
-static void IRAM_ATTR lv_tick_callback()
+/**
+ * Re-align the display tick immediately after the system clock has been stepped
+ * (otherwise the pending tick would fire once at the old phase)
+ */
+static void gui_realign_tick()
+{
+	(void) esp_timer_stop(tick_timer);
+	gui_arm_tick();
+	
+	time_note_tick_realign();
+}
+
+
+static void gui_tick_callback(void* arg)
+{
+	xTaskNotify(gui_task_handle, GUI_NOTIFY_TICK, eSetBits);
+	gui_arm_tick();
+}
+
+
+/**
+ * Measure the phase error of a tick against the nearest half-second boundary and
+ * pass it on to the screen
+ */
+static void gui_handle_tick()
 {
-	lv_tick_inc(portTICK_PERIOD_MS);
+	bool second_start;
+	int32_t err_usec;
+	struct timeval tv;
+	
+	gettimeofday(&tv, NULL);
+	err_usec = (int32_t) (tv.tv_usec % GUI_TICK_PERIOD_USEC);
+	if (err_usec >= (GUI_TICK_PERIOD_USEC / 2)) {
+		err_usec -= GUI_TICK_PERIOD_USEC;
+	}
+	second_start = (tv.tv_usec < (GUI_TICK_PERIOD_USEC / 2)) ||
+	               (tv.tv_usec >= (GUI_TICK_PERIOD_USEC + GUI_TICK_PERIOD_USEC / 2));
+	
+	time_note_tick_err(err_usec);
+	
+	gui_screen_main_tick(second_start);
+}
+
+
+static void gui_handle_notifications(uint32_t notification_value)
+{
+	if (Notification(notification_value, GUI_NOTIFY_TIME_STEP)) {
+		gui_realign_tick();
+	}
+	
+	if (Notification(notification_value, GUI_NOTIFY_TICK)) {
+		gui_handle_tick();
+	}
+	
+	if (Notification(notification_value, GUI_NOTIFY_PRIMARY_MESSAGE)) {
+		gui_screen_main_set_prim_msg(primary_message, primary_message_to);
+	}
+	
+	if (Notification(notification_value, GUI_NOTIFY_SECONDARY_MESSAGE)) {
+		gui_screen_main_set_sec_msg(secondary_message, secondary_message_to);
+	}
+}
+
+
+static void gui_update_lv_tick()
+{
+	uint32_t elapsed_msec;
+	
+	// Whole milliseconds are passed on, the remainder carries to the next update
+	elapsed_msec = (uint32_t) ((esp_timer_get_time() - lvgl_tick_usec) / 1000);
+	if (elapsed_msec != 0) {
+		lv_tick_inc(elapsed_msec);
+		lvgl_tick_usec += (int64_t) elapsed_msec * 1000;
+	}
+}
+
+
+/**
+ * Return the time until the next LVGL task has to run.  The display refresh task is
+ * skipped while nothing is invalid and the animation task while no animation runs
+ * because they would otherwise wake us every LV_DISP_DEF_REFR_PERIOD mSec with nothing
+ * to do.  Anything that invalidates the display or starts an animation runs from
+ * lv_task_handler() or a notification so it is seen before we block again.
+ */
+static uint32_t gui_next_deadline_msec()
+{
+	uint32_t elapsed;
+	uint32_t wait = GUI_MAX_SLEEP_MSEC;
+	lv_disp_t* disp;
+	lv_task_t* task;
+	
+	disp = lv_disp_get_default();
+	
+	task = lv_ll_get_head(&LV_GC_ROOT(_lv_task_ll));
+	while (task != NULL) {
+		if ((task->prio == LV_TASK_PRIO_OFF) ||
+		    ((disp != NULL) && (task == disp->refr_task) && (disp->inv_p == 0)) ||
+		    ((task == lvgl_anim_task) && (lv_anim_count_running() == 0))) {
+			task = lv_ll_get_next(&LV_GC_ROOT(_lv_task_ll), task);
+			continue;
+		}
+		
+		elapsed = lv_tick_elaps(task->last_run);
+		if (elapsed >= task->period) {
+			wait = 0;
+			break;
+		} else if ((task->period - elapsed) < wait) {
+			wait = task->period - elapsed;
+		}
+		
+		task = lv_ll_get_next(&LV_GC_ROOT(_lv_task_ll), task);
+	}
+	
+	// Always yield for at least one tick
+	return (wait < GUI_MIN_SLEEP_MSEC) ? GUI_MIN_SLEEP_MSEC : wait;
 }
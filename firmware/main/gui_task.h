@@ -35,8 +35,17 @@
 #define GUI_SCREEN_MAIN            0
 #define GUI_NUM_SCREENS            1
 
-// LVGL evaluation rate (mSec)
-#define GUI_EVAL_MSEC              25
+// LVGL evaluation bounds (mSec) - the task sleeps until the next LVGL task deadline
+// but never less than the minimum (one tick) or longer than the maximum
+#define GUI_MIN_SLEEP_MSEC         1
+#define GUI_MAX_SLEEP_MSEC         1000
+
+// Display tick - phase-locked to the system clock's half-second boundaries
+#define GUI_TICK_PERIOD_USEC       500000
+
+// A tick timer firing closer than this to the following boundary (i.e. early) is
+// re-armed for the boundary after it so a tick is never repeated
+#define GUI_TICK_MIN_DELAY_USEC    100000
 
 //
 // GUI Task notifications
@@ -45,6 +54,12 @@
 #define GUI_NOTIFY_PRIMARY_MESSAGE         0x00000001
 #define GUI_NOTIFY_SECONDARY_MESSAGE       0x00000002
 
+// From the display tick timer
+#define GUI_NOTIFY_TICK                    0x00000004
+
+// From time_utilities when the system clock is stepped
+#define GUI_NOTIFY_TIME_STEP               0x00000008
+
 
 
 //
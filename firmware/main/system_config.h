@@ -47,20 +47,36 @@
 #define LCD_SPI_FREQ_HZ 80000000 
 #define LCD_SPI_MODE    0
 
+// Display pipeline - when defined LVGL renders on core 1 while a flush task on core 0
+// drives the SPI transfers from a ring of LCD_PIPELINE_NUM_BUFS band buffers.  Comment
+// out to render and flush in gui_task using two buffers.
+#define LCD_PIPELINE_ENABLE
+#define LCD_PIPELINE_NUM_BUFS 4
+
+// Uncomment to log the timing of each full-screen redraw (render, SPI and their overlap)
+//#define LCD_PIPELINE_BENCHMARK
+
 
 
 // ======================================================================================
 // System configuration
 //
 
-// Battery state-of-charge curve
-//   Based on 0.2C discharge rate on https://www.richtek.com/battery-management/en/designing-liion.html
-//   This isn't particularly accurate...
-#define BATT_75_THRESHOLD     3.9
-#define BATT_50_THRESHOLD     3.72
-#define BATT_25_THRESHOLD     3.66
-#define BATT_0_THRESHOLD      3.55
-#define BATT_CRIT_THRESHOLD   3.5
+// Battery state-of-charge estimation
+//   The estimator integrates the gCore load and USB currents and slowly corrects the
+//   count toward the resting voltage curve in power_utilities.c.  Set the capacity for
+//   the installed battery.
+#define BATT_CAPACITY_MAH         2000
+#define BATT_INT_RESISTANCE_MOHM  150
+
+// Battery state thresholds (percent state-of-charge, not volts as they once were)
+#define BATT_75_THRESHOLD_PCT  75
+#define BATT_50_THRESHOLD_PCT  50
+#define BATT_25_THRESHOLD_PCT  25
+#define BATT_0_THRESHOLD_PCT   5
+
+// Critical battery voltage (always from the measured voltage)
+#define BATT_CRIT_THRESHOLD_V  3.5
 
 // Critical Battery Detection timeout
 #define CRIT_BATTERY_DET_SEC 30
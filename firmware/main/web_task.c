@@ -22,20 +22,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include "alarm_utilities.h"
 #include "cmd_handlers.h"
 #include "cmd_list.h"
 #include "cmd_utilities.h"
 #include "ctrl_task.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "pm_utilities.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_wifi.h"
 #include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp32/rom/miniz.h"
 #include "sys_utilities.h"
 #include "ws_cmd_utilities.h"
 #include "web_task.h"
+#include "web_assets_etag.h"
 #include "wifi_utilities.h"
 
 
@@ -46,6 +52,19 @@
 // Maximum number of connections
 #define max_sockets 3
 
+// Longest If-None-Match header we check (a browser sends back the ETag we gave it)
+#define WEB_IF_NONE_MATCH_MAX_LEN 64
+
+// Longest Accept-Encoding header we parse (longer headers are truncated)
+#define WEB_ACCEPT_ENCODING_MAX_LEN 128
+
+// gzip header (RFC 1952)
+#define WEB_GZIP_HDR_LEN          10
+#define WEB_GZIP_FLG_FHCRC        0x02
+#define WEB_GZIP_FLG_FEXTRA       0x04
+#define WEB_GZIP_FLG_FNAME        0x08
+#define WEB_GZIP_FLG_FCOMMENT     0x10
+
 
 
 //
@@ -55,8 +74,31 @@
 // Command packet data types
 typedef enum {
 	SEND_CMD_SHUTDOWN,
+	SEND_CMD_ALARM,
 } send_cmd_type_t;
 
+// Content codings we can send, in order of preference
+typedef enum {
+	WEB_ENC_GZIP,
+	WEB_ENC_IDENTITY
+} web_encoding_t;
+
+// One stored representation of a served file
+typedef struct {
+	const uint8_t* start;             // NULL if not stored
+	const uint8_t* end;
+	const char* etag;                 // NULL if not available
+} web_asset_data_t;
+
+// Served file.  The identity representation of a compressed file is not stored but is
+// inflated from the gzip representation for the rare client that accepts neither coding.
+typedef struct {
+	const char* name;
+	const char* type;
+	const char* cache_control;
+	web_asset_data_t data[WEB_NUM_ENCODINGS];
+} web_asset_t;
+
 
 //
 // WEB Task variables
@@ -69,14 +111,48 @@ static bool client_connected = false;
 // Notifications (clear after use)
 static bool notify_network_disconnect = false;
 static bool notify_shutdown = false;
+static bool notify_alarm = false;
+
+// Request statistics
+static web_stats_t web_stats;
+
+// Content-Encoding header values
+static const char* encoding_names[WEB_NUM_ENCODINGS] = {"gzip", NULL};
+
+// Inflate state for identity responses (allocated on first use - the server handles one
+// request at a time)
+static tinfl_decompressor* inflator = NULL;
+static uint8_t* inflate_dict = NULL;
 
 // served web page and favicon
-extern const uint8_t index_html_start[] asm("_binary_index_html_gz_start");
-extern const uint8_t index_html_end[] asm("_binary_index_html_gz_end");
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
 
 extern const uint8_t favicon_ico_start[] asm("_binary_favicon_ico_start");
 extern const uint8_t favicon_ico_end[] asm("_binary_favicon_ico_end");
 
+// The page (with its javascript and web assembly built in) is revalidated on every load so a
+// firmware update is seen immediately (the browser gets a 304 response while it is unchanged).
+// The favicon may be used for a day.
+static const web_asset_t asset_index_html = {
+	.name          = "index.html",
+	.type          = "text/html",
+	.cache_control = "no-cache",
+	.data          = {
+		[WEB_ENC_GZIP]     = {index_html_gz_start, index_html_gz_end, WEB_INDEX_HTML_GZ_ETAG},
+		[WEB_ENC_IDENTITY] = {NULL, NULL, WEB_INDEX_HTML_ETAG}
+	}
+};
+
+static const web_asset_t asset_favicon_ico = {
+	.name          = "favicon.ico",
+	.type          = "image/x-icon",
+	.cache_control = "max-age=86400",
+	.data          = {
+		[WEB_ENC_IDENTITY] = {favicon_ico_start, favicon_ico_end, WEB_FAVICON_ICO_ETAG}
+	}
+};
+
 
 
 //
@@ -88,7 +164,11 @@ static esp_err_t _web_stop_webserver(httpd_handle_t server);
 static void _web_connect_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static void _web_disconnect_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static esp_err_t _web_req_handler(httpd_req_t *req);
-static esp_err_t _web_favicon_handler(httpd_req_t *req);
+static web_encoding_t _web_select_encoding(httpd_req_t *req, const web_asset_t* asset);
+static bool _web_accepts_encoding(const char* accept, const char* coding);
+static bool _web_etag_matches(httpd_req_t *req, const char* etag);
+static esp_err_t _web_send_inflated(httpd_req_t *req, const web_asset_t* asset);
+static bool _web_skip_gzip_header(const uint8_t** data, size_t* len);
 static esp_err_t _web_ws_handler(httpd_req_t *req);
 static void _web_send_cmd(httpd_handle_t handle, int sock, send_cmd_type_t cmd_type);
 
@@ -101,15 +181,15 @@ static const httpd_uri_t uri_get = {
         .uri        = "/",
         .method     = HTTP_GET,
         .handler    = _web_req_handler,
-        .user_ctx   = NULL,
+        .user_ctx   = (void*) &asset_index_html,
         .is_websocket = false
 };
 
 static const httpd_uri_t uri_get_favicon = {
         .uri        = "/favicon.ico",
         .method     = HTTP_GET,
-        .handler    = _web_favicon_handler,
-        .user_ctx   = NULL,
+        .handler    = _web_req_handler,
+        .user_ctx   = (void*) &asset_favicon_ico,
         .is_websocket = false
 };
 
@@ -130,6 +210,7 @@ void web_task()
 {
 	esp_err_t ret;
 	size_t clients;
+	bool has_client;
 	int client_fds[max_sockets];
 	int sock;
 	static httpd_handle_t server = NULL;
@@ -157,19 +238,20 @@ void web_task()
 		ESP_LOGE(TAG, "Could not start web server");
 		vTaskDelete(NULL);
 	}
-
+	
 	
 	while (1) {
 		_web_handle_notifications();
-
+		
 		// Give the scheduler some time between images
-		vTaskDelay(pdMS_TO_TICKS(10));
+		vTaskDelay(pdMS_TO_TICKS(client_connected ? WEB_ACTIVE_EVAL_MSEC : WEB_IDLE_EVAL_MSEC));
 		
+		has_client = false;
 		if (server != NULL) {
 			// Look for connectivity changes or messages to send
 			clients = max_sockets;
 			if ((ret = httpd_get_client_list(server, &clients, client_fds)) == ESP_OK) {
-				client_connected = (clients != 0);
+				has_client = (clients != 0);
 				for (int i=0; i<clients; i++) {
 					sock = client_fds[i];
 					if (httpd_ws_get_fd_info(server, sock) == HTTPD_WS_CLIENT_WEBSOCKET) {
@@ -184,6 +266,10 @@ void web_task()
 						if (notify_shutdown) {
 							_web_send_cmd(server, sock, SEND_CMD_SHUTDOWN);
 						}
+						
+						if (notify_alarm) {
+							_web_send_cmd(server, sock, SEND_CMD_ALARM);
+						}
 					}
 				}
 			} else {
@@ -191,10 +277,21 @@ void web_task()
 			}
 		}
 		
+		// Hold the CPU at full speed for the duration of a web session
+		if (has_client != client_connected) {
+			client_connected = has_client;
+			if (client_connected) {
+				pm_lock_acquire(PM_LOCK_WEB);
+			} else {
+				pm_lock_release(PM_LOCK_WEB);
+			}
+		}
+		
 		// Clear notifications every time through loop to handle case where nothing
 		// is connected and we ignore them
 		notify_network_disconnect = false;
 		notify_shutdown = false;
+		notify_alarm = false;
 	}
 }
 
@@ -205,6 +302,12 @@ bool web_has_client()
 }
 
 
+void web_get_stats(web_stats_t* stats)
+{
+	*stats = web_stats;
+}
+
+
 
 //
 // WEB Task Internal functions
@@ -215,7 +318,7 @@ static void _web_handle_notifications()
 	
 	notification_value = 0;
 	if (xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, 0)) {
-	
+		
 		if (Notification(notification_value, WEB_NOTIFY_NETWORK_DISC_MASK)) {
 			notify_network_disconnect = true;
 		}
@@ -223,6 +326,10 @@ static void _web_handle_notifications()
 		if (Notification(notification_value, WEB_NOTIFY_SHUTDOWN_MASK)) {
 			notify_shutdown = true;
 		}
+		
+		if (Notification(notification_value, WEB_NOTIFY_ALARM_MASK)) {
+			notify_alarm = true;
+		}
 	}
 }
 
@@ -231,10 +338,10 @@ static httpd_handle_t _web_start_webserver(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    
+	
     // Setup our specific config items
     config.max_open_sockets = max_sockets;
-
+	
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
@@ -245,7 +352,7 @@ static httpd_handle_t _web_start_webserver(void)
         httpd_register_uri_handler(server, &uri_ws);
         return server;
     }
-
+	
     ESP_LOGI(TAG, "Error starting server!");
     return NULL;
 }
@@ -286,30 +393,258 @@ static void _web_disconnect_handler(void* arg, esp_event_base_t event_base, int3
 }
 
 
+/**
+ * Send one of our files in the best encoding the browser accepts or, if the browser's cached
+ * copy is current, a 304 response
+ */
 static esp_err_t _web_req_handler(httpd_req_t *req)
 {
-	uint32_t len = index_html_end - index_html_start;
+	const web_asset_t* asset = (const web_asset_t*) req->user_ctx;
+	const web_asset_data_t* data;
+	web_encoding_t enc;
+	uint32_t len;
+	
+	web_stats.requests++;
+	
+	enc = _web_select_encoding(req, asset);
+	data = &asset->data[enc];
+	
+	// Validators are sent with both responses.  Each representation has its own ETag.
+	(void) httpd_resp_set_hdr(req, "ETag", data->etag);
+	(void) httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+	if (asset->data[WEB_ENC_GZIP].start != NULL) {
+		(void) httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+	}
+	
+	if (_web_etag_matches(req, data->etag)) {
+		ESP_LOGI(TAG, "%s not modified", asset->name);
+		web_stats.not_modified++;
+		(void) httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
+	
+	(void) httpd_resp_set_type(req, asset->type);
+	web_stats.encoding[enc]++;
+	
+	if (data->start == NULL) {
+		ESP_LOGI(TAG, "Sending %s (inflated)", asset->name);
+		return _web_send_inflated(req, asset);
+	}
+	
+	len = data->end - data->start;
+	ESP_LOGI(TAG, "Sending %s (%s, %lu bytes)", asset->name,
+		(encoding_names[enc] != NULL) ? encoding_names[enc] : "identity", len);
+	
+	if (encoding_names[enc] != NULL) {
+		if (httpd_resp_set_hdr(req, "Content-Encoding", encoding_names[enc]) != ESP_OK) {
+			ESP_LOGE(TAG, "set_hdr failed");
+			return ESP_FAIL;
+		}
+	}
+	
+	web_stats.body_bytes += len;
+	return httpd_resp_send(req, (const char*) data->start, (ssize_t) len);
+}
+
+
+/**
+ * Choose gzip, then identity based on the request's Accept-Encoding header.  A request
+ * without the header gets gzip.  Brotli isn't stored since browsers only accept it over
+ * HTTPS and the clock serves plain HTTP.
+ */
+static web_encoding_t _web_select_encoding(httpd_req_t *req, const web_asset_t* asset)
+{
+	char buf[WEB_ACCEPT_ENCODING_MAX_LEN];
+	size_t len;
+	
+	if (asset->data[WEB_ENC_GZIP].start == NULL) {
+		return WEB_ENC_IDENTITY;
+	}
+	
+	len = httpd_req_get_hdr_value_len(req, "Accept-Encoding");
+	if (len == 0) {
+		return WEB_ENC_GZIP;
+	}
+	
+	// A truncated value is parsed as far as it goes
+	(void) httpd_req_get_hdr_value_str(req, "Accept-Encoding", buf, sizeof(buf));
+	buf[sizeof(buf)-1] = 0;
+	
+	if (_web_accepts_encoding(buf, "gzip")) {
+		return WEB_ENC_GZIP;
+	}
+	
+	return WEB_ENC_IDENTITY;
+}
+
+
+/**
+ * Returns true if an Accept-Encoding value ("gzip, deflate, br;q=0.9") lists the coding,
+ * or "*", without q=0
+ */
+static bool _web_accepts_encoding(const char* accept, const char* coding)
+{
+	const char* p = accept;
+	const char* name;
+	const char* q;
+	int name_len;
+	bool star = false;
+	bool star_ok = false;
+	bool ok;
 	
-	ESP_LOGI(TAG, "Sending index.html");
+	while (*p != 0) {
+		// Coding name
+		while ((*p == ' ') || (*p == '\t') || (*p == ',')) p++;
+		name = p;
+		while ((*p != 0) && (*p != ',') && (*p != ';') && (*p != ' ') && (*p != '\t')) p++;
+		name_len = p - name;
+		
+		// Parameters up to the next element - only a zero weight matters
+		ok = true;
+		while ((*p != 0) && (*p != ',')) {
+			if ((*p == 'q') || (*p == 'Q')) {
+				q = p + 1;
+				while (*q == ' ') q++;
+				if (*q == '=') {
+					q++;
+					while (*q == ' ') q++;
+					ok = (strtof(q, NULL) > 0);
+				}
+			}
+			p++;
+		}
+		
+		if (name_len == 0) continue;
+		
+		if ((name_len == strlen(coding)) && (strncasecmp(name, coding, name_len) == 0)) {
+			return ok;
+		}
+		if ((name_len == 1) && (*name == '*')) {
+			star = true;
+			star_ok = ok;
+		}
+	}
 	
-	if (httpd_resp_set_hdr(req, "Content-Encoding", "gzip") != ESP_OK) {
-		ESP_LOGE(TAG, "set_hdr failed");
+	return (star && star_ok);
+}
+
+
+/**
+ * Returns true if the request's If-None-Match header contains our ETag (or is "*")
+ */
+static bool _web_etag_matches(httpd_req_t *req, const char* etag)
+{
+	char buf[WEB_IF_NONE_MATCH_MAX_LEN];
+	size_t len;
+	
+	len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+	if ((len == 0) || (len >= sizeof(buf))) {
 		return false;
 	}
 	
-	return httpd_resp_send(req, (const char*) index_html_start, (ssize_t) len);
+	if (httpd_req_get_hdr_value_str(req, "If-None-Match", buf, sizeof(buf)) != ESP_OK) {
+		return false;
+	}
+	
+	return ((strcmp(buf, "*") == 0) || (strstr(buf, etag) != NULL));
 }
 
 
-static esp_err_t _web_favicon_handler(httpd_req_t *req)
+/**
+ * Send the identity representation of a file as chunks inflated from its gzip
+ * representation using the ROM's tinfl through a circular dictionary buffer
+ */
+static esp_err_t _web_send_inflated(httpd_req_t *req, const web_asset_t* asset)
 {
-	uint32_t len = favicon_ico_end - favicon_ico_start;
+	const uint8_t* in;
+	size_t in_len, in_bytes, out_bytes;
+	size_t dict_ofs = 0;
+	tinfl_status status;
 	
-	ESP_LOGI(TAG, "Sending favicon");
+	if (inflator == NULL) {
+		inflator = (tinfl_decompressor*) heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_SPIRAM);
+		inflate_dict = (uint8_t*) heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_SPIRAM);
+		if ((inflator == NULL) || (inflate_dict == NULL)) {
+			ESP_LOGE(TAG, "Could not allocate inflate buffers");
+			free(inflator);
+			free(inflate_dict);
+			inflator = NULL;
+			inflate_dict = NULL;
+			return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+		}
+	}
+	
+	in = asset->data[WEB_ENC_GZIP].start;
+	in_len = asset->data[WEB_ENC_GZIP].end - in;
+	if (!_web_skip_gzip_header(&in, &in_len)) {
+		ESP_LOGE(TAG, "%s is not gzip data", asset->name);
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+	}
+	
+	tinfl_init(inflator);
+	do {
+		in_bytes = in_len;
+		out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+		status = tinfl_decompress(inflator, in, &in_bytes, inflate_dict, inflate_dict + dict_ofs, &out_bytes, 0);
+		in += in_bytes;
+		in_len -= in_bytes;
+		
+		if (out_bytes != 0) {
+			if (httpd_resp_send_chunk(req, (const char*) inflate_dict + dict_ofs, (ssize_t) out_bytes) != ESP_OK) {
+				return ESP_FAIL;
+			}
+			web_stats.body_bytes += out_bytes;
+			dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+		}
+	} while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+	
+	if (status != TINFL_STATUS_DONE) {
+		// Too late for an error status - the truncated body shows the failure
+		ESP_LOGE(TAG, "Inflate %s failed (%d)", asset->name, status);
+	}
+	
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+
+/**
+ * Advance past the gzip header to the deflate data
+ */
+static bool _web_skip_gzip_header(const uint8_t** data, size_t* len)
+{
+	const uint8_t* p = *data;
+	const uint8_t* end = *data + *len;
+	uint8_t flg;
+	size_t xlen;
+	
+	if ((*len < WEB_GZIP_HDR_LEN) || (p[0] != 0x1F) || (p[1] != 0x8B) || (p[2] != 8)) {
+		return false;
+	}
+	flg = p[3];
+	p += WEB_GZIP_HDR_LEN;
 	
-	(void) httpd_resp_set_type(req, "image/x-icon");
+	if (flg & WEB_GZIP_FLG_FEXTRA) {
+		if ((end - p) < 2) return false;
+		xlen = p[0] | (p[1] << 8);
+		if ((end - p) < (2 + xlen)) return false;
+		p += 2 + xlen;
+	}
+	if (flg & WEB_GZIP_FLG_FNAME) {
+		while ((p < end) && (*p != 0)) p++;
+		if (p++ >= end) return false;
+	}
+	if (flg & WEB_GZIP_FLG_FCOMMENT) {
+		while ((p < end) && (*p != 0)) p++;
+		if (p++ >= end) return false;
+	}
+	if (flg & WEB_GZIP_FLG_FHCRC) {
+		if ((end - p) < 2) return false;
+		p += 2;
+	}
 	
-	return httpd_resp_send(req, (const char*) favicon_ico_start, (ssize_t) len);
+	*len -= p - *data;
+	*data = p;
+	return true;
 }
 
 
@@ -323,7 +658,7 @@ static esp_err_t _web_ws_handler(httpd_req_t *req)
         ESP_LOGI(TAG, "Handshake done, socket opened");
         return ESP_OK;
     }
-    
+	
     // Look for incoming packets to process
     memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
     ws_pkt.type = HTTPD_WS_TYPE_BINARY;
@@ -332,7 +667,7 @@ static esp_err_t _web_ws_handler(httpd_req_t *req)
         ESP_LOGE(TAG, "httpd_ws_recv_frame failed to get frame len with %d", ret);
         return ret;
     }
-    
+	
     if (ws_pkt.len) {
     	// Get and process the websocket packet
     	ws_pkt.payload = ws_cmd_get_rx_data_buffer();
@@ -341,10 +676,10 @@ static esp_err_t _web_ws_handler(httpd_req_t *req)
             ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
             return ret;
         }
-        
+		
         // May push response data into the tx buffer
         (void) ws_cmd_process_socket_rx_data(ws_pkt.len, ws_pkt.payload);
-        
+		
         // Check for response data (from a GET)
         while (ws_cmd_get_tx_data((uint32_t*) &ws_pkt.len, &ws_pkt.payload)) {
         	// Send the response
@@ -357,13 +692,14 @@ static esp_err_t _web_ws_handler(httpd_req_t *req)
 		    }
         }
     }
-    
+	
     return ESP_OK;
 }
 
 
 static void _web_send_cmd(httpd_handle_t handle, int sock, send_cmd_type_t cmd_type)
 {
+	char msg[ALARM_MSG_MAX_LEN+1];
 	esp_err_t ret;
 	httpd_ws_frame_t ws_pkt;
 	
@@ -374,6 +710,11 @@ static void _web_send_cmd(httpd_handle_t handle, int sock, send_cmd_type_t cmd_t
 		case SEND_CMD_SHUTDOWN:
 			(void) cmd_send(CMD_SET, CMD_SHUTDOWN);
 			break;
+		
+		case SEND_CMD_ALARM:
+			alarm_get_msg(msg);
+			(void) cmd_send_string(CMD_SET, CMD_ALARM_NOTIFY, msg);
+			break;
 	}
 	
 	// Synchronously send the packet
@@ -28,6 +28,14 @@
 // WEB Task Constants
 //
 
+// Evaluation interval (mSec) with and without a connected client - polling slowly
+// while idle lets the system stay in light sleep longer
+#define WEB_ACTIVE_EVAL_MSEC                10
+#define WEB_IDLE_EVAL_MSEC                  100
+
+// Content codings served (gzip, identity)
+#define WEB_NUM_ENCODINGS                   2
+
 //
 // WEB Task notifications
 //
@@ -35,13 +43,26 @@
 // From ctrl_task
 #define WEB_NOTIFY_NETWORK_DISC_MASK        0x00000001
 #define WEB_NOTIFY_SHUTDOWN_MASK            0x00000002
+#define WEB_NOTIFY_ALARM_MASK               0x00000004
+
 
 
+//
+// WEB Task typedefs
+//
+typedef struct {
+	uint32_t requests;                 // Page and favicon requests
+	uint32_t not_modified;             // Requests answered from the browser's cache (304)
+	uint32_t body_bytes;               // Content bytes sent
+	uint32_t encoding[WEB_NUM_ENCODINGS]; // Files sent gzip and identity encoded
+} web_stats_t;
+
 
 //
 // WEB Task API
 //
 void web_task();
 bool web_has_client();
+void web_get_stats(web_stats_t* stats);
 
 #endif /* WEB_TASK_H */